@@ -23,11 +23,16 @@
 #include "sized_range.hpp"
 #include <memory>
 #include <forward_list>
+#include <chrono>
 
 namespace redis {
 	class Command;
 	class AsyncConnection;
 	class ThreadContext;
+	class ScriptManager;
+	struct LuaScript;
+	class StoredCommand;
+	struct ScriptFallback;
 
 	class Batch {
 		friend class Command;
@@ -42,6 +47,8 @@ namespace redis {
 		ConstReplies replies ( void ) const;
 		Replies replies_nonconst ( void );
 		bool replies_ready ( void ) const;
+		//Returns false if some replies are still missing after parTimeout
+		bool wait_for_replies ( std::chrono::microseconds parTimeout ) const;
 		void throw_if_failed ( void );
 
 		template <typename... Args>
@@ -50,13 +57,35 @@ namespace redis {
 		template <typename... Args>
 		Batch& operator() ( const char* parCommand, Args&&... parArgs );
 
+		//Same as run(), for commands whose argument count is only known at
+		//runtime. parArgv[0] is the command name.
+		Batch& run_argv ( int parArgc, const char** parArgv, const std::size_t* parLengths );
+
+		//Same as run_argv(), preceded by an ASKING that is queued under
+		//the same event lock so no command from another thread can get
+		//between the two. Both replies are added to the batch.
+		Batch& run_asking ( int parArgc, const char** parArgv, const std::size_t* parLengths );
+
+		//Sends an EVALSHA built by Script. Should the server reply
+		//NOSCRIPT, the same call is sent again as EVAL with the full
+		//script and its reply takes the place of the error. Notice the
+		//EVAL then runs after any command queued in the meantime, so a
+		//GET queued right after an EVALSHA doing a SET would not see the
+		//new value. Script loads a script before its first EVALSHA and
+		//again after IncRedis::script_flush() to avoid this, but if the
+		//server loses its scripts behind the client's back (a restart, a
+		//SCRIPT FLUSH from someone else) the first batch after that can
+		//still run out of order. Command::forget_loaded_scripts() tells
+		//the client about such events.
+		Batch& run_evalsha ( StoredCommand&& parEvalSha, const LuaScript& parScript, ScriptManager& parManager );
+
 		void reset ( void ) noexcept;
 
 	private:
 		struct LocalData;
 
 		explicit Batch ( AsyncConnection* parConn, ThreadContext& parThreadContext );
-		void run_pvt ( int parArgc, const char** parArgv, std::size_t* parLengths );
+		void run_pvt ( int parArgc, const char** parArgv, const std::size_t* parLengths, ScriptFallback* parFallback=nullptr, bool parAsking=false );
 
 		std::unique_ptr<LocalData> m_local_data;
 		AsyncConnection* m_async_conn;
@@ -0,0 +1,115 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id6CFD418A09614CF3B4ABF72E542FB484
+#define id6CFD418A09614CF3B4ABF72E542FB484
+
+#include "reply.hpp"
+#include "stored_command.hpp"
+#include "hash_slot.hpp"
+#include <boost/utility/string_view.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace redis {
+	class Command;
+	class ClusterBatch;
+
+	//Client for a Redis Cluster. The slot map is read with CLUSTER SLOTS
+	//from the first seed that answers, then one Command is kept for every
+	//primary. Commands are routed by the hash slot of their keys, as found
+	//in the command table, MOVED and ASK redirections are followed
+	//transparently and a MOVED triggers a refresh of the whole slot map.
+	class ClusterCommand {
+		friend class ClusterBatch;
+	public:
+		typedef std::pair<std::string, uint16_t> NodeAddress;
+
+		explicit ClusterCommand ( std::vector<NodeAddress>&& parSeeds );
+		ClusterCommand ( ClusterCommand&& );
+		~ClusterCommand ( void ) noexcept;
+
+		void connect ( void );
+		//Throws std::logic_error if any ClusterBatch made by this object
+		//is still alive, as it would be left pointing to closed nodes
+		void disconnect ( void );
+		bool is_connected ( void ) const;
+		void refresh_slots ( void );
+
+		ClusterBatch make_batch ( void );
+		std::size_t node_count ( void ) const;
+		Command& node_for_slot ( uint16_t parSlot );
+		Command& node_for_key ( boost::string_view parKey ) { return node_for_slot(key_hash_slot(parKey)); }
+
+		template <typename... Args>
+		Reply run ( const char* parCommand, Args&&... parArgs );
+
+	private:
+		struct LocalData;
+
+		std::unique_ptr<LocalData> m_local_data;
+	};
+
+	//Like Batch, but commands are spread over the cluster nodes according to
+	//the slot of their keys. Commands without keys go to any node, run()
+	//throws std::invalid_argument for commands whose keys hash to different
+	//slots. Commands are sent as soon as they are added, redirections are
+	//resolved when replies are requested. Replies are in the same order the
+	//commands were added in.
+	class ClusterBatch {
+		friend class ClusterCommand;
+	public:
+		ClusterBatch ( ClusterBatch&& parOther );
+		ClusterBatch ( const ClusterBatch& ) = delete;
+		~ClusterBatch ( void ) noexcept;
+
+		template <typename... Args>
+		ClusterBatch& run ( const char* parCommand, Args&&... parArgs );
+		ClusterBatch& run ( StoredCommand&& parCommand );
+
+		const std::vector<Reply>& replies ( void );
+		std::vector<Reply>& replies_nonconst ( void );
+		void throw_if_failed ( void );
+		void reset ( void ) noexcept;
+
+	private:
+		struct LocalData;
+
+		explicit ClusterBatch ( ClusterCommand::LocalData* parCluster );
+
+		std::unique_ptr<LocalData> m_local_data;
+	};
+
+	template <typename... Args>
+	Reply ClusterCommand::run (const char* parCommand, Args&&... parArgs) {
+		auto batch = make_batch();
+		batch.run(parCommand, std::forward<Args>(parArgs)...);
+		batch.throw_if_failed();
+		return std::move(batch.replies_nonconst().front());
+	}
+
+	template <typename... Args>
+	ClusterBatch& ClusterBatch::run (const char* parCommand, Args&&... parArgs) {
+		return this->run(StoredCommand(parCommand, std::forward<Args>(parArgs)...));
+	}
+} //namespace redis
+
+#endif
@@ -21,6 +21,9 @@
 #include "reply.hpp"
 #include "batch.hpp"
 #include "script.hpp"
+#include "stored_command.hpp"
+#include "metrics.hpp"
+#include "command_observer.hpp"
 #include <array>
 #include <string>
 #include <cstdint>
@@ -32,8 +35,35 @@
 #include <boost/range/iterator_range_core.hpp>
 #include <ciso646>
 #include <stdexcept>
+#include <chrono>
 
 namespace redis {
+	class KeyFilter;
+
+	//mean + 2 * deviation is a rough, cheap stand-in for the 95th
+	//percentile: the mean deviation of a normal distribution is about 0.8
+	//sigma, and mean + 1.6 sigma is close to its 95th percentile.
+	struct LatencyEstimate {
+		std::chrono::nanoseconds mean;
+		std::chrono::nanoseconds deviation;
+		uint64_t samples;
+
+		std::chrono::nanoseconds p95 ( void ) const { return mean + 2 * deviation; }
+	};
+
+	struct AutoBatchOptions {
+		AutoBatchOptions ( void ) :
+			max_commands(64),
+			window(50)
+		{
+		}
+
+		//Send as soon as this many commands are queued...
+		std::size_t max_commands;
+		//...or when the first queued command has waited this long
+		std::chrono::microseconds window;
+	};
+
 	class Command {
 	public:
 		Command ( std::string&& parAddress, uint16_t parPort );
@@ -48,21 +78,65 @@ namespace redis {
 
 		bool is_connected ( void ) const;
 		boost::string_view connection_error ( void ) const;
+		LatencyEstimate latency ( void ) const;
+		//Host name or socket path, port is 0 for socket connections
+		const std::string& address ( void ) const;
+		uint16_t port ( void ) const;
 
 		Batch make_batch ( void );
 		Script make_script ( const boost::string_view& parScript );
+		//Loads all scripts with a single round trip, they are loaded again
+		//by wait_for_connect() after a reconnection
+		std::vector<Script> preload_scripts ( const std::vector<boost::string_view>& parScripts );
+		//Call after the server lost its scripts, ie after SCRIPT FLUSH, so
+		//that scripts are loaded again before they run
+		void forget_loaded_scripts ( void );
 
 		template <typename... Args>
 		Reply run ( const char* parCommand, Args&&... parArgs );
 
+		//When enabled, concurrent run() calls with the same read-only
+		//command and arguments share a single request and reply
+		void set_single_flight ( bool parEnable );
+		uint64_t coalesced_reads ( void ) const;
+
+		//Queues run() calls made concurrently by different threads into
+		//shared batches, like Nagle's algorithm does for small writes. Both
+		//calls are safe while other threads are sending commands.
+		void set_auto_batching ( const AutoBatchOptions& parOptions );
+		void disable_auto_batching ( void );
+		uint64_t auto_batch_flushes ( void ) const;
+
+		//Off by default, enabling it costs a command table lookup per
+		//command, a walk over each reply to count its bytes and a few
+		//clock readings on the event thread
+		void set_metrics ( bool parEnable );
+		MetricsSnapshot metrics ( void ) const;
+
+		//Null to stop tracing. Throws std::logic_error if the library was
+		//built without INCREDIS_WITH_TRACING. The observer must outlive
+		//every Batch that was in use while it was set.
+		void set_observer ( CommandObserver* parObserver );
+
+		//Keys of every write command sent from now on are inserted into
+		//parFilter, null to stop. The filter must outlive every Batch that
+		//was in use while it was set.
+		void set_key_filter ( KeyFilter* parFilter );
+
 	private:
 		struct LocalData;
 
+		bool shared_path_enabled ( void ) const;
+		Reply run_shared ( StoredCommand&& parCommand );
+
 		std::unique_ptr<LocalData> m_local_data;
 	};
 
 	template <typename... Args>
 	Reply Command::run (const char* parCommand, Args&&... parArgs) {
+		if (shared_path_enabled())
+			return run_shared(StoredCommand(parCommand, std::forward<Args>(parArgs)...));
+
 		auto batch = make_batch();
 		batch.run(parCommand, std::forward<Args>(parArgs)...);
 		batch.throw_if_failed();
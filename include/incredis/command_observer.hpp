@@ -0,0 +1,62 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef idDFD79E70FA554540ABB791048A024670
+#define idDFD79E70FA554540ABB791048A024670
+
+#include <boost/utility/string_view.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace redis {
+	struct CommandTrace {
+		//Unique within the process, the same id is passed to all the
+		//callbacks for the same command
+		uint64_t id;
+		boost::string_view name;
+		//Sizes of the arguments after the command name, only valid for
+		//the duration of the callback
+		const std::size_t* arg_sizes;
+		std::size_t arg_count;
+		std::chrono::steady_clock::time_point time;
+	};
+
+	//Hooks for tracing single commands. Only called when the library is
+	//built with INCREDIS_WITH_TRACING, otherwise the hooks are compiled
+	//out entirely. on_enqueue() and on_write() run on the thread calling
+	//Batch::run(), on_reply() runs on the event thread with the event
+	//mutex held, so keep it short and don't send commands from there.
+	class CommandObserver {
+	public:
+		virtual ~CommandObserver ( void ) noexcept = default;
+
+		//Before waiting for room among the commands in flight
+		virtual void on_enqueue ( const CommandTrace& parTrace ) { static_cast<void>(parTrace); }
+		//The command is in hiredis' output buffer, the event thread writes
+		//it to the socket as soon as it gets woken up
+		virtual void on_write ( uint64_t parId, std::chrono::steady_clock::time_point parTime ) { static_cast<void>(parId); static_cast<void>(parTime); }
+		virtual void on_reply ( uint64_t parId, std::chrono::steady_clock::time_point parTime, bool parError ) { static_cast<void>(parId); static_cast<void>(parTime); static_cast<void>(parError); }
+		//The first time the caller gets hold of the reply through
+		//Batch::replies()
+		virtual void on_consume ( uint64_t parId, std::chrono::steady_clock::time_point parTime ) { static_cast<void>(parId); static_cast<void>(parTime); }
+	};
+
+	bool tracing_available ( void );
+} //namespace redis
+
+#endif
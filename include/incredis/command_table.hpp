@@ -0,0 +1,71 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id976B641A5A5C485688995AD6940076F4
+#define id976B641A5A5C485688995AD6940076F4
+
+#include <boost/utility/string_view.hpp>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+namespace redis {
+	enum CommandFlags {
+		CommandFlag_None = 0x00,
+		CommandFlag_ReadOnly = 0x01,
+		CommandFlag_Write = 0x02,
+		CommandFlag_Blocking = 0x04,
+		CommandFlag_Admin = 0x08,
+		CommandFlag_PubSub = 0x10,
+		//first_key is the position of an argument telling how many keys
+		//follow it, like in EVAL
+		CommandFlag_KeyCount = 0x20,
+		//Acts on the connection it is sent on, like WAIT which waits for
+		//the writes made on that connection
+		CommandFlag_ConnectionBound = 0x40
+	};
+
+	//Key positions work like in the reply to COMMAND INFO: positions count
+	//the command name as 0, a negative last_key counts from the end and 0
+	//in first_key means the command takes no keys.
+	struct CommandInfo {
+		const char* name;
+		uint32_t flags;
+		int8_t first_key;
+		int8_t last_key;
+		int8_t key_step;
+	};
+
+	//Static table of the commands the library knows about, sorted by name.
+	//Lookups are case insensitive. Commands missing from the table are
+	//considered writes, so they are always sent to the primary.
+	const CommandInfo* find_command_info ( boost::string_view parName );
+	std::size_t command_table_size ( void );
+	const CommandInfo& command_info ( std::size_t parIndex );
+	//Returns command_table_size() for unknown commands
+	std::size_t command_index ( boost::string_view parName );
+	bool is_read_only_command ( boost::string_view parName );
+	//Blocking commands that are better sent on a connection of their own,
+	//that is all of them but the ones flagged CommandFlag_ConnectionBound
+	bool needs_own_connection ( boost::string_view parName );
+	//Calls parCallback with each key in parArgv, which starts with the
+	//command name. For commands missing from the table every argument is
+	//reported, since any of them could be a key.
+	void for_each_key ( int parArgc, const char* const* parArgv, const std::size_t* parLengths, const std::function<void(boost::string_view)>& parCallback );
+} //namespace redis
+
+#endif
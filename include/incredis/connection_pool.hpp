@@ -0,0 +1,99 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef idD4695437195E4540AEDD245CA3933DC9
+#define idD4695437195E4540AEDD245CA3933DC9
+
+#include "reply.hpp"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace redis {
+	class Command;
+	class StoredCommand;
+	class KeyFilter;
+
+	//Small set of extra connections for commands that block on the server,
+	//like BLPOP, so they don't hold up the pipeline of the main Command.
+	//Connections are opened on demand up to max_size, each one is leased
+	//to a single caller at a time.
+	class ConnectionPool {
+		struct Slot;
+	public:
+		class Lease {
+			friend class ConnectionPool;
+		public:
+			Lease ( Lease&& parOther );
+			Lease ( const Lease& ) = delete;
+			~Lease ( void ) noexcept;
+
+			Command& command ( void );
+			long long client_id ( void ) const;
+			//Closes the connection instead of returning it to the pool,
+			//for when its state is unknown
+			void discard ( void );
+
+		private:
+			Lease ( ConnectionPool* parPool, Slot* parSlot );
+
+			ConnectionPool* m_pool;
+			Slot* m_slot;
+			bool m_discard;
+		};
+
+		ConnectionPool ( std::string&& parAddress, uint16_t parPort, uint32_t parDb, std::size_t parMaxSize );
+		ConnectionPool ( std::string&& parSocket, uint32_t parDb, std::size_t parMaxSize );
+		~ConnectionPool ( void ) noexcept;
+
+		//Throws if no connection frees up within parTimeout, or within
+		//the timeout set with set_acquire_timeout()
+		Lease acquire ( std::chrono::milliseconds parTimeout );
+		Lease acquire ( void );
+		//Runs parCommand on a leased connection. parServerTimeout is the
+		//timeout given to the command itself; the reply is waited for
+		//that long plus a grace period, after which the connection is
+		//dropped and an exception is thrown. Zero waits forever.
+		Reply run ( const StoredCommand& parCommand, std::chrono::milliseconds parServerTimeout );
+		//Same, for commands whose timeout is not known, with the timeout
+		//set with set_reply_timeout()
+		Reply run ( const StoredCommand& parCommand );
+		//Sends CLIENT UNBLOCK through parVia for every leased connection,
+		//blocked commands then return as if they had timed out
+		void unblock_all ( Command& parVia );
+
+		std::size_t size ( void ) const;
+		std::size_t idle_count ( void ) const;
+		std::size_t max_size ( void ) const;
+		void set_acquire_timeout ( std::chrono::milliseconds parTimeout );
+		//60 seconds by default, zero waits forever
+		void set_reply_timeout ( std::chrono::milliseconds parTimeout );
+		//Applied to every connection, see Command::set_key_filter()
+		void set_key_filter ( KeyFilter* parFilter );
+
+	private:
+		struct LocalData;
+
+		void release ( Slot* parSlot, bool parDiscard );
+
+		std::unique_ptr<LocalData> m_local_data;
+	};
+} //namespace redis
+
+#endif
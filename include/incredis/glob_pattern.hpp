@@ -0,0 +1,74 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id19714451928B4C8FBE24F893D87E762B
+#define id19714451928B4C8FBE24F893D87E762B
+
+#include <boost/utility/string_view.hpp>
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+
+namespace redis {
+	//Client-side implementation of the glob-style patterns accepted by
+	//SCAN ... MATCH and KEYS. The pattern is compiled once so matching
+	//doesn't need to parse it again; the leading literal part is checked
+	//with a single memcmp() before anything else.
+	class GlobPattern {
+	public:
+		explicit GlobPattern ( boost::string_view parPattern );
+		GlobPattern ( GlobPattern&& ) = default;
+		GlobPattern ( const GlobPattern& ) = default;
+		~GlobPattern ( void ) noexcept = default;
+
+		GlobPattern& operator= ( GlobPattern&& ) = default;
+		GlobPattern& operator= ( const GlobPattern& ) = default;
+
+		bool match ( boost::string_view parText ) const;
+		const std::string& pattern ( void ) const { return m_pattern; }
+		const std::string& literal_prefix ( void ) const { return m_prefix; }
+		bool matches_everything ( void ) const { return m_prefix.empty() and m_trailing_star_only; }
+
+	private:
+		enum TokenType {
+			Token_Literal,
+			Token_AnyChar,
+			Token_Class,
+			Token_Star
+		};
+		struct Token {
+			TokenType type;
+			uint8_t literal;
+			uint16_t class_index;
+		};
+		using CharClass = std::array<uint64_t, 4>;
+
+		bool token_matches ( const Token& parToken, uint8_t parChar ) const;
+
+		std::string m_pattern;
+		std::string m_prefix;
+		std::vector<Token> m_tokens;
+		std::vector<CharClass> m_classes;
+		bool m_trailing_star_only;
+	};
+
+	//Escapes characters that have a special meaning in glob patterns
+	std::string glob_escape ( boost::string_view parLiteral );
+} //namespace redis
+
+#endif
@@ -15,13 +15,20 @@
  * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef id2F97AF7626CE45F08742867A2A737482
-#define id2F97AF7626CE45F08742867A2A737482
+#ifndef idCA5D320206F94E85AF58C283A2D81524
+#define idCA5D320206F94E85AF58C283A2D81524
 
-#include "duckhandy/cmake_on_off.h"
+#include <boost/utility/string_view.hpp>
+#include <cstdint>
 
-#if CMAKE_@has_cryptopp_lib@
-#	define WITH_CRYPTOPP
-#endif
+namespace redis {
+	const uint16_t g_cluster_slot_count = 16384;
+
+	//Returns the part of parKey that is used for hashing: the content of
+	//the first non-empty {...} section if any, otherwise the whole key
+	boost::string_view hash_tag ( boost::string_view parKey );
+	uint16_t crc16 ( boost::string_view parData );
+	uint16_t key_hash_slot ( boost::string_view parKey );
+} //namespace redis
 
 #endif
@@ -21,6 +21,14 @@
 #include "command.hpp"
 #include "incredis_batch.hpp"
 #include "scan_iterator.hpp"
+#include "scan_fetch.hpp"
+#include "replica_router.hpp"
+#include "command_table.hpp"
+#include "stored_command.hpp"
+#include "near_cache.hpp"
+#include "key_filter.hpp"
+#include "connection_pool.hpp"
+#include "transaction.hpp"
 #include <boost/optional.hpp>
 #include <string>
 #include <boost/utility/string_view.hpp>
@@ -28,8 +36,16 @@
 #include <boost/range/iterator_range_core.hpp>
 #include <boost/range/empty.hpp>
 #include <utility>
+#include <memory>
+#include <chrono>
+#include <initializer_list>
 
 namespace redis {
+	enum ListEnd {
+		ListEnd_Left,
+		ListEnd_Right
+	};
+
 	class IncRedis {
 	public:
 		typedef ScanIterator<ScanSingleValues<std::string>> scan_iterator;
@@ -40,9 +56,22 @@ namespace redis {
 		typedef boost::iterator_range<sscan_iterator> sscan_range;
 		typedef ScanIterator<ScanPairs<std::pair<std::string, std::string>, ScanCommands::ZSCAN>> zscan_iterator;
 		typedef boost::iterator_range<zscan_iterator> zscan_range;
+		typedef ScanPageIterator<ScanSingleValues<std::string>> scan_page_iterator;
+		typedef boost::iterator_range<scan_page_iterator> scan_page_range;
+		typedef ScanPageIterator<ScanPairs<std::pair<std::string, std::string>, ScanCommands::HSCAN>> hscan_page_iterator;
+		typedef boost::iterator_range<hscan_page_iterator> hscan_page_range;
+		typedef ScanPageIterator<ScanSingleValuesInKey<std::string>> sscan_page_iterator;
+		typedef boost::iterator_range<sscan_page_iterator> sscan_page_range;
+		typedef ScanPageIterator<ScanPairs<std::pair<std::string, std::string>, ScanCommands::ZSCAN>> zscan_page_iterator;
+		typedef boost::iterator_range<zscan_page_iterator> zscan_page_range;
+		typedef ScanFetchIterator<ScanSingleValues<std::string>> scan_fetch_iterator;
+		typedef boost::iterator_range<scan_fetch_iterator> scan_fetch_range;
+		typedef ScanFetchIterator<ScanSingleValuesInKey<std::string>> sscan_fetch_iterator;
+		typedef boost::iterator_range<sscan_fetch_iterator> sscan_fetch_range;
 
 		typedef boost::optional<std::string> opt_string;
 		typedef boost::optional<std::vector<opt_string>> opt_string_list;
+		typedef boost::optional<std::pair<std::string, std::string>> opt_key_value;
 
 		IncRedis ( std::string&& parAddress, uint16_t parPort );
 		IncRedis ( IncRedis&& ) = default;
@@ -60,11 +89,80 @@ namespace redis {
 		Command& command ( void ) { return m_command; }
 		const Command& command ( void ) const { return m_command; }
 
+		//Replicas, read-only commands are spread over them according to
+		//the replica policy while everything else goes to the primary
+		void add_replica ( std::string&& parAddress, uint16_t parPort, uint32_t parDb=0 );
+		void add_replica ( std::string&& parSocket, uint32_t parDb=0 );
+		void set_replica_policy ( const ReplicaPolicy& parPolicy ) { m_replicas.set_policy(parPolicy); }
+		ReplicaRouter& replicas ( void ) { return m_replicas; }
+		Command& read_command ( void ) { return m_replicas.read_command(m_command); }
+		//Turns single-flight coalescing on or off for the primary and for the
+		//replicas added so far
+		void set_single_flight ( bool parEnable );
+		void set_auto_batching ( const AutoBatchOptions& parOptions );
+		void disable_auto_batching ( void );
+		//Turns on per-command counters and latency histograms plus event
+		//loop timings on the primary and on the replicas added so far.
+		//Each connection keeps its own figures: read them with
+		//command().metrics() and replicas().replica(n).metrics().
+		void set_metrics ( bool parEnable );
+		template <typename... Args>
+		Reply run ( const char* parCommand, Args&&... parArgs );
+
+		//Near cache, get(), hget() and hmget() are served from memory while
+		//the server reports no change to the keys. Writes made through this
+		//object drop the affected keys right away, everything else is
+		//handled by the server's invalidation messages.
+		void enable_near_cache ( const NearCacheOptions& parOptions=NearCacheOptions() );
+		void disable_near_cache ( void );
+		NearCache* near_cache ( void ) { return m_near_cache.get(); }
+
+		//Negative lookup filter, get(), hget() and hmget() on keys under the
+		//filter's prefix that were never written return nil without a round
+		//trip. The filter is seeded with a SCAN of the prefix and answers
+		//nothing until that is done, then it learns the keys of every write
+		//command sent through this object, its batches, scripts and the
+		//blocking pool. Keys created by other clients are not seen.
+		KeyFilter& enable_key_filter ( std::size_t parExpectedKeys, double parFalsePositiveRate=0.01, boost::string_view parPrefix=boost::string_view() );
+		void disable_key_filter ( void );
+		KeyFilter* key_filter ( void ) { return m_key_filter.get(); }
+
+		//Blocking commands, sent on connections leased from a pool so the
+		//main pipeline keeps flowing. parDb must match the database the
+		//main connection works on. Once the pool is enabled run() also
+		//sends blocking commands through it, except for WAIT and WAITAOF,
+		//and waits for their reply as long as the pool's reply timeout.
+		//Transactions lease their connection from the same pool.
+		void enable_blocking_pool ( uint32_t parDb, std::size_t parMaxConnections=4 );
+		ConnectionPool* blocking_pool ( void ) { return m_blocking_pool.get(); }
+		//Makes all blocking calls in progress return nil
+		void cancel_blocking ( void );
+		opt_key_value blpop ( std::initializer_list<boost::string_view> parKeys, std::chrono::milliseconds parTimeout );
+		opt_key_value brpop ( std::initializer_list<boost::string_view> parKeys, std::chrono::milliseconds parTimeout );
+		opt_string blmove ( boost::string_view parSource, boost::string_view parDestination, ListEnd parFrom, ListEnd parTo, std::chrono::milliseconds parTimeout );
+		Transaction make_transaction ( const TransactionOptions& parOptions=TransactionOptions() );
+
 		//Scan
 		scan_range scan ( boost::string_view parPattern=boost::string_view() );
 		hscan_range hscan ( boost::string_view parKey, boost::string_view parPattern=boost::string_view() );
 		sscan_range sscan ( boost::string_view parKey, boost::string_view parPattern=boost::string_view() );
 		zscan_range zscan ( boost::string_view parKey, boost::string_view parPattern=boost::string_view() );
+		scan_range scan ( const ScanOptions& parOptions, boost::string_view parPattern=boost::string_view() );
+		hscan_range hscan ( boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern=boost::string_view() );
+		sscan_range sscan ( boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern=boost::string_view() );
+		zscan_range zscan ( boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern=boost::string_view() );
+		scan_page_range scan_pages ( boost::string_view parPattern=boost::string_view() );
+		hscan_page_range hscan_pages ( boost::string_view parKey, boost::string_view parPattern=boost::string_view() );
+		sscan_page_range sscan_pages ( boost::string_view parKey, boost::string_view parPattern=boost::string_view() );
+		zscan_page_range zscan_pages ( boost::string_view parKey, boost::string_view parPattern=boost::string_view() );
+		scan_page_range scan_pages ( const ScanOptions& parOptions, boost::string_view parPattern=boost::string_view() );
+		hscan_page_range hscan_pages ( boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern=boost::string_view() );
+		sscan_page_range sscan_pages ( boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern=boost::string_view() );
+		zscan_page_range zscan_pages ( boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern=boost::string_view() );
+		scan_fetch_range scan_fetch ( ScanFetchCommand parFetch, boost::string_view parPattern=boost::string_view() );
+		sscan_fetch_range sscan_fetch ( boost::string_view parKey, ScanFetchCommand parFetch, boost::string_view parPattern=boost::string_view() );
+		scan_fetch_range scan_fetch ( ScanFetchCommand parFetch, const ScanOptions& parOptions, boost::string_view parPattern=boost::string_view() );
+		sscan_fetch_range sscan_fetch ( boost::string_view parKey, ScanFetchCommand parFetch, const ScanOptions& parOptions, boost::string_view parPattern=boost::string_view() );
 
 		//Hash
 		opt_string hget ( boost::string_view parKey, boost::string_view parField );
@@ -97,22 +195,62 @@ namespace redis {
 		bool set ( boost::string_view parKey, boost::string_view parField );
 		RedisInt incr ( boost::string_view parKey );
 
+		//Pub/Sub, see Subscriber for the receiving side
+		RedisInt publish ( boost::string_view parChannel, boost::string_view parMessage );
+
 	private:
 		static opt_string_list reply_to_string_list ( const Reply& parReply );
+		opt_key_value blocking_pop ( const char* parCommand, std::initializer_list<boost::string_view> parKeys, std::chrono::milliseconds parTimeout );
+		ConnectionPool& blocking_pool_or_throw ( void );
+		template <typename... Args>
+		Reply run_read_only ( const char* parCommand, Args&&... parArgs );
+		bool near_cache_active ( void ) { return m_near_cache and m_near_cache->is_active(m_command); }
+		bool known_absent ( boost::string_view parKey ) { return m_key_filter and m_key_filter->definitely_absent(parKey); }
+		void near_cache_invalidate ( boost::string_view parKey );
+		opt_string_list cached_hmget ( boost::string_view parKey, const boost::string_view* parFields, std::size_t parCount );
 
 		Command m_command;
+		ReplicaRouter m_replicas;
+		std::unique_ptr<NearCache> m_near_cache;
+		std::unique_ptr<KeyFilter> m_key_filter;
+		std::unique_ptr<ConnectionPool> m_blocking_pool;
 	};
 
+	template <typename... Args>
+	Reply IncRedis::run (const char* parCommand, Args&&... parArgs) {
+		if (m_blocking_pool and needs_own_connection(parCommand))
+			return m_blocking_pool->run(StoredCommand(parCommand, std::forward<Args>(parArgs)...));
+		else if (is_read_only_command(parCommand))
+			return run_read_only(parCommand, std::forward<Args>(parArgs)...);
+		else
+			return m_command.run(parCommand, std::forward<Args>(parArgs)...);
+	}
+
+	template <typename... Args>
+	Reply IncRedis::run_read_only (const char* parCommand, Args&&... parArgs) {
+		if (m_replicas.hedging_enabled())
+			return m_replicas.run_hedged(m_command, StoredCommand(parCommand, std::forward<Args>(parArgs)...));
+		else
+			return read_command().run(parCommand, std::forward<Args>(parArgs)...);
+	}
+
 	template <typename... Args>
 	auto IncRedis::hmget (boost::string_view parKey, Args&&... parArgs) -> opt_string_list {
 		static_assert(sizeof...(Args) > 0, "No fields specified");
-		return reply_to_string_list(m_command.run("HMGET", parKey, std::forward<Args>(parArgs)...));
+		if (known_absent(parKey))
+			return opt_string_list(std::vector<opt_string>(sizeof...(Args)));
+		if (near_cache_active()) {
+			const boost::string_view fields[] = { boost::string_view(parArgs)... };
+			return cached_hmget(parKey, fields, sizeof...(Args));
+		}
+		return reply_to_string_list(run_read_only("HMGET", parKey, std::forward<Args>(parArgs)...));
 	}
 
 	template <typename... Args>
 	bool IncRedis::hmset (boost::string_view parKey, Args&&... parArgs) {
 		static_assert(sizeof...(Args) > 0, "No fields specified");
 		static_assert(sizeof...(Args) % 2 == 0, "Uneven number of parameters received");
+		near_cache_invalidate(parKey);
 		const auto ret = redis::get<StatusString>(m_command.run("HMSET", parKey, std::forward<Args>(parArgs)...));
 		return ret.is_ok();
 	}
@@ -120,6 +258,8 @@ namespace redis {
 	template <typename... Args>
 	RedisInt IncRedis::del (Args&&... parArgs) {
 		static_assert(sizeof...(Args) > 0, "No keys specified");
+		if (m_near_cache)
+			(near_cache_invalidate(boost::string_view(parArgs)), ...);
 		const auto ret = m_command.run("DEL", std::forward<Args>(parArgs)...);
 		return get_integer(ret);
 	}
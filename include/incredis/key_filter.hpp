@@ -0,0 +1,88 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id7FC073FB7D1745ECBFA17CBD81710CF4
+#define id7FC073FB7D1745ECBFA17CBD81710CF4
+
+#include "scan_iterator.hpp"
+#include <boost/utility/string_view.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace redis {
+	class IncRedis;
+
+	struct KeyFilterStats {
+		uint64_t lookups;
+		uint64_t definitely_absent;
+		//Only counted by IncRedis::get(), a nil from hget() doesn't tell
+		//whether the key or just the field is missing
+		uint64_t false_positives;
+		uint64_t inserted;
+	};
+
+	//Split block Bloom filter answering "definitely absent" for keys that
+	//start with a given prefix. Every key hashes to a single 32 byte block
+	//and sets one bit in each of its eight 32 bit words, so a lookup
+	//touches one cache line. Keys can be inserted concurrently with lookups.
+	//Bloom filters can't forget keys, so deleted keys simply keep costing a
+	//round trip; keys created by other clients are not seen at all unless
+	//the filter is rebuilt with load_from_scan().
+	//A filter that is not ready never reports a key as absent, which is
+	//how a filter that is still being seeded stays out of the way.
+	class KeyFilter {
+	public:
+		KeyFilter ( std::size_t parExpectedKeys, double parFalsePositiveRate, boost::string_view parPrefix=boost::string_view() );
+		~KeyFilter ( void ) noexcept;
+
+		bool covers ( boost::string_view parKey ) const { return parKey.starts_with(m_prefix); }
+		void insert ( boost::string_view parKey );
+		bool may_contain ( boost::string_view parKey ) const;
+		//Covered keys only, updates the counters
+		bool definitely_absent ( boost::string_view parKey );
+		void record_false_positive ( void ) { m_false_positives.fetch_add(1, std::memory_order_relaxed); }
+		void clear ( void );
+		//Marks the filter ready once the scan is over
+		std::size_t load_from_scan ( IncRedis& parRedis, const ScanOptions& parOptions=ScanOptions() );
+		void set_ready ( bool parReady ) { m_ready.store(parReady, std::memory_order_release); }
+		bool is_ready ( void ) const { return m_ready.load(std::memory_order_acquire); }
+
+		const std::string& prefix ( void ) const { return m_prefix; }
+		std::size_t size_bytes ( void ) const;
+		KeyFilterStats stats ( void ) const;
+
+	private:
+		struct Block;
+
+		static uint64_t hash ( boost::string_view parKey );
+		Block& block_for ( uint64_t parHash ) const;
+
+		std::unique_ptr<Block[]> m_blocks;
+		std::size_t m_block_count;
+		std::string m_prefix;
+		std::atomic<uint64_t> m_lookups;
+		std::atomic<uint64_t> m_definitely_absent;
+		std::atomic<uint64_t> m_false_positives;
+		std::atomic<uint64_t> m_inserted;
+		std::atomic<bool> m_ready;
+	};
+} //namespace redis
+
+#endif
@@ -0,0 +1,107 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id3E0FBC4F1F7F4DBEA9A183532298E2A7
+#define id3E0FBC4F1F7F4DBEA9A183532298E2A7
+
+#include <boost/utility/string_view.hpp>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace redis {
+	//Log-linear buckets in the spirit of HdrHistogram: every power of two
+	//is split into 16 buckets, so any value is off by at most 1/16. Values
+	//past about 68 seconds all end up in the last bucket.
+	struct LatencyHistogram {
+		enum {
+			SubBucketBits = 4,
+			SubBucketCount = 1 << SubBucketBits,
+			MaxExponent = 36,
+			BucketCount = (MaxExponent - SubBucketBits + 1) * SubBucketCount
+		};
+
+		LatencyHistogram ( void );
+
+		static std::size_t bucket_index ( uint64_t parNanoseconds );
+		static uint64_t bucket_lower_bound ( std::size_t parIndex );
+		static uint64_t bucket_upper_bound ( std::size_t parIndex );
+
+		//Upper bound of the bucket holding the requested percentile
+		std::chrono::nanoseconds percentile ( double parPercentile ) const;
+		std::chrono::nanoseconds mean ( void ) const;
+
+		std::vector<uint64_t> counts;
+		uint64_t count;
+		std::chrono::nanoseconds sum;
+		std::chrono::nanoseconds min;
+		std::chrono::nanoseconds max;
+	};
+
+	struct CommandMetrics {
+		std::string name;
+		uint64_t errors;
+		uint64_t bytes_sent;
+		uint64_t bytes_received;
+		//Time from the moment the command is handed to hiredis to the
+		//moment its reply is parsed, count is the number of calls
+		LatencyHistogram latency;
+	};
+
+	//Health of the event thread of a connection. "Event mutex" is the
+	//mutex that libev holds while it runs callbacks and that callers take
+	//to queue commands into hiredis.
+	struct EventLoopStats {
+		//From waking the event thread up to its wakeup callback running
+		LatencyHistogram wakeup_latency;
+		//Work done by each loop iteration, from poll() returning to the
+		//next call to poll()
+		LatencyHistogram iteration;
+		//The event thread waiting for the event mutex after poll()
+		LatencyHistogram loop_mutex_wait;
+		//Other threads waiting for and holding the event mutex
+		LatencyHistogram caller_mutex_wait;
+		LatencyHistogram caller_mutex_hold;
+		//Turning hiredis replies into Reply objects
+		LatencyHistogram reply_parse;
+		uint64_t wakeups_sent;
+		//Wakeups skipped because one was already pending
+		uint64_t wakeups_coalesced;
+	};
+
+	struct MetricsSnapshot {
+		//Only commands that were sent at least once, commands missing
+		//from the command table are grouped under "other"
+		std::vector<CommandMetrics> commands;
+		std::size_t in_flight;
+		//Times a caller had to wait because too many commands were
+		//waiting for a reply
+		uint64_t backpressure_waits;
+		uint64_t connections;
+		uint64_t connections_lost;
+		EventLoopStats event_loop;
+	};
+
+	//Prometheus text exposition format. Latencies are exported as
+	//histograms with fixed buckets from 50us to 10s, each metric name is
+	//prefixed with parPrefix and an underscore.
+	std::string to_prometheus ( const MetricsSnapshot& parSnapshot, boost::string_view parPrefix="incredis" );
+} //namespace redis
+
+#endif
@@ -0,0 +1,96 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id1FFEC4BFE3EB45C1923BD1820D63BF99
+#define id1FFEC4BFE3EB45C1923BD1820D63BF99
+
+#include <boost/optional.hpp>
+#include <boost/utility/string_view.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace redis {
+	class Command;
+
+	struct NearCacheOptions {
+		NearCacheOptions ( void ) :
+			max_entries(10000),
+			shards(16),
+			ttl(0),
+			prefixes()
+		{
+		}
+
+		std::size_t max_entries;
+		std::size_t shards;
+		//Zero keeps entries until they are invalidated or evicted
+		std::chrono::milliseconds ttl;
+		//If not empty tracking runs in broadcasting mode for these prefixes
+		//and only keys under them are cached, otherwise the server
+		//remembers every key that was read
+		std::vector<std::string> prefixes;
+	};
+
+	struct NearCacheStats {
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t invalidations;
+		uint64_t evictions;
+	};
+
+	//In-process cache of string values and hash fields, kept coherent with
+	//CLIENT TRACKING. Invalidations come in on a second connection that the
+	//tracked connection redirects to (RESP2 style). The cache is sharded by
+	//key, each shard being an LRU list under its own mutex. If either
+	//connection drops everything is flushed and the cache stays inactive
+	//until enable() is called again.
+	class NearCache {
+	public:
+		typedef boost::optional<std::string> opt_string;
+
+		explicit NearCache ( const NearCacheOptions& parOptions );
+		~NearCache ( void ) noexcept;
+
+		void enable ( Command& parTracked );
+		void disable ( Command& parTracked );
+		bool is_active ( const Command& parTracked );
+
+		bool find ( boost::string_view parKey, opt_string& parValue );
+		bool find ( boost::string_view parKey, boost::string_view parField, opt_string& parValue );
+		//Get a ticket before sending the read and pass it to store(), so
+		//values that were invalidated while in flight are not cached
+		uint64_t fetch_ticket ( boost::string_view parKey ) const;
+		void store ( boost::string_view parKey, uint64_t parTicket, const opt_string& parValue );
+		void store ( boost::string_view parKey, boost::string_view parField, uint64_t parTicket, const opt_string& parValue );
+		void invalidate ( boost::string_view parKey );
+		void clear ( void );
+
+		std::size_t size ( void ) const;
+		NearCacheStats stats ( void ) const;
+
+	private:
+		struct LocalData;
+
+		std::unique_ptr<LocalData> m_local_data;
+	};
+} //namespace redis
+
+#endif
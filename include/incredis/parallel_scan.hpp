@@ -0,0 +1,62 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id67F7C0AF0F594CB28D1AA0D238A7E76E
+#define id67F7C0AF0F594CB28D1AA0D238A7E76E
+
+#include "scan_iterator.hpp"
+#include <boost/utility/string_view.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace redis {
+	//Scans several databases and/or servers at the same time. Every source
+	//gets its own connection and producer thread, pages are handed over
+	//through a bounded queue to a pool of worker threads that invoke the
+	//callback. The callback is therefore called concurrently and must be
+	//thread safe. The first exception thrown by a connection or by the
+	//callback stops the scan and is rethrown by run(); calls already in
+	//progress on other workers finish, but no new ones are made.
+	class ParallelScan {
+	public:
+		typedef std::function<void(std::size_t, std::string&&)> Callback;
+
+		ParallelScan ( std::size_t parWorkerCount, std::size_t parQueuedPages );
+		~ParallelScan ( void ) noexcept;
+
+		std::size_t add_source ( std::string&& parAddress, uint16_t parPort, uint32_t parDB );
+		std::size_t add_source ( std::string&& parSocket, uint32_t parDB );
+
+		std::size_t run ( Callback parCallback, boost::string_view parPattern=boost::string_view(), const ScanOptions& parOptions=ScanOptions() );
+
+	private:
+		struct Source {
+			std::string address;
+			uint16_t port;
+			uint32_t db;
+		};
+
+		std::vector<Source> m_sources;
+		std::size_t m_worker_count;
+		std::size_t m_queued_pages;
+	};
+} //namespace redis
+
+#endif
@@ -0,0 +1,113 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef idFBE68D36E2D745019F4D20FED834F88E
+#define idFBE68D36E2D745019F4D20FED834F88E
+
+#include "reply.hpp"
+#include "stored_command.hpp"
+#include <boost/utility/string_view.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace redis {
+	class Command;
+	class Batch;
+
+	struct ReplicaPolicy {
+		enum ReadFrom {
+			ReadFrom_Primary,
+			ReadFrom_Replica
+		};
+
+		ReplicaPolicy ( void ) :
+			read_from(ReadFrom_Replica),
+			max_staleness(10),
+			health_check_interval(1),
+			min_hedge_delay(500),
+			latency_aware(true),
+			hedge_reads(false)
+		{
+		}
+
+		ReadFrom read_from;
+		//A replica is only used while its link to the primary is up and it
+		//heard from the primary at most this long ago, as reported by
+		//master_last_io_seconds_ago in INFO replication
+		std::chrono::seconds max_staleness;
+		//Zero disables health checks, connected replicas are always used.
+		//Checks are sent in the background and never delay a read.
+		std::chrono::seconds health_check_interval;
+		//Hedged reads are sent to a second node once the first one has been
+		//silent for longer than its estimated p95, but never sooner than this
+		std::chrono::microseconds min_hedge_delay;
+		//Pick the faster of two candidate replicas instead of plain round robin
+		bool latency_aware;
+		bool hedge_reads;
+	};
+
+	//Spreads read-only commands over a set of replicas, falling back to the
+	//primary when no replica is fresh enough. Whether a command is read-only
+	//is decided by the command table. When latency_aware is set the faster
+	//of two round robin candidates is used, which keeps most of the load off
+	//a slow node without sending everything to the single fastest one. A
+	//small share of reads ignores latency, so that a node that was slow for
+	//a while keeps being measured and can win its share back.
+	class ReplicaRouter {
+	public:
+		ReplicaRouter ( void );
+		ReplicaRouter ( ReplicaRouter&& );
+		~ReplicaRouter ( void ) noexcept;
+
+		void add_replica ( std::string&& parAddress, uint16_t parPort, uint32_t parDb=0 );
+		void add_replica ( std::string&& parSocket, uint32_t parDb=0 );
+
+		void connect ( void );
+		void wait_for_connect ( void );
+		void disconnect ( void );
+		void wait_for_disconnect ( void );
+
+		void set_policy ( const ReplicaPolicy& parPolicy );
+		ReplicaPolicy policy ( void ) const;
+		std::size_t replica_count ( void ) const;
+		Command& replica ( std::size_t parIndex );
+		//Blocking health check of all replicas
+		void check_replicas ( void );
+
+		Command& read_command ( Command& parPrimary );
+		Command& command_for ( Command& parPrimary, boost::string_view parCommandName );
+
+		//Runs a read-only command, hedging it on a second node if enabled.
+		//The reply that arrives first is returned, the other is dropped.
+		bool hedging_enabled ( void ) const;
+		Reply run_hedged ( Command& parPrimary, const StoredCommand& parCommand );
+
+	private:
+		struct LocalData;
+
+		void check_replicas_if_due ( void );
+		Command* hedge_target ( Command& parPrimary, const Command& parFirst );
+		void abandon ( Batch&& parBatch );
+
+		std::unique_ptr<LocalData> m_local_data;
+	};
+} //namespace redis
+
+#endif
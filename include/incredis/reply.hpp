@@ -97,10 +97,15 @@ namespace redis {
 	RedisInt get_integer_autoconv_if_str ( const Reply& parReply );
 	const std::string& get_string ( const Reply& parReply );
 	const std::vector<Reply>& get_array ( const Reply& parReply );
+	std::vector<Reply>& get_array ( Reply& parReply );
 	const ErrorString& get_error_string ( const Reply& parReply );
 
 	template <typename T>
 	const T& get ( const Reply& parReply );
+
+	//Moves the value out of parReply, leaving a valid but unspecified value
+	template <typename T>
+	T take ( Reply& parReply );
 } //namespace redis
 
 #endif
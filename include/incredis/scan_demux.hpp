@@ -0,0 +1,67 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id1ECA85B6A44B4BBFADA8602BD8D4A376
+#define id1ECA85B6A44B4BBFADA8602BD8D4A376
+
+#include "glob_pattern.hpp"
+#include "scan_iterator.hpp"
+#include <boost/utility/string_view.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+#include <array>
+#include <cstddef>
+
+namespace redis {
+	class IncRedis;
+
+	//Walks the keyspace once and hands every key to the callbacks of all
+	//the registered patterns it matches. Matching happens client-side; if
+	//all patterns share a literal prefix that prefix is also sent to the
+	//server as a MATCH filter.
+	class ScanDemux {
+	public:
+		typedef std::function<void(const std::string&)> Callback;
+
+		ScanDemux ( void );
+		~ScanDemux ( void ) noexcept;
+
+		std::size_t add ( boost::string_view parPattern, Callback parCallback );
+		std::size_t run ( IncRedis& parIncRedis, const ScanOptions& parOptions=ScanOptions() );
+		std::size_t dispatch ( const std::string& parKey );
+
+		std::size_t pattern_count ( void ) const { return m_patterns.size(); }
+		std::size_t match_count ( std::size_t parIndex ) const;
+		std::string server_pattern ( void ) const;
+
+	private:
+		struct Entry {
+			Entry ( boost::string_view parPattern, Callback&& parCallback );
+
+			GlobPattern pattern;
+			Callback callback;
+			std::size_t matches;
+		};
+
+		std::vector<Entry> m_patterns;
+		std::array<std::vector<std::size_t>, 256> m_by_first_char;
+		std::vector<std::size_t> m_unprefixed;
+	};
+} //namespace redis
+
+#endif
@@ -0,0 +1,212 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id91A13B5D53E140039022410D5645B872
+#define id91A13B5D53E140039022410D5645B872
+
+#include "scan_iterator.hpp"
+#include "batch.hpp"
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/utility/string_view.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	//Read command to be pipelined for every key returned by a scan. The key
+	//is inserted in the argument list at the given position, so for example
+	//"MEMORY USAGE <key>" has the key at position 2.
+	class ScanFetchCommand {
+	public:
+		ScanFetchCommand ( std::vector<std::string>&& parArgs, std::size_t parKeyPosition );
+
+		static ScanFetchCommand get ( void );
+		static ScanFetchCommand hgetall ( void );
+		static ScanFetchCommand hget ( boost::string_view parField );
+		static ScanFetchCommand hmget ( std::vector<std::string>&& parFields );
+		static ScanFetchCommand type ( void );
+		static ScanFetchCommand ttl ( void );
+		static ScanFetchCommand pttl ( void );
+		static ScanFetchCommand memory_usage ( void );
+
+		void enqueue ( Batch& parBatch, boost::string_view parKey, std::vector<const char*>& parArgv, std::vector<std::size_t>& parLengths ) const;
+
+	private:
+		std::vector<std::string> m_args;
+		std::size_t m_key_position;
+	};
+
+	template <typename ValueFetch>
+	class ScanFetchIterator;
+
+	namespace implem {
+		template <typename ValueFetch>
+		using ScanFetchIteratorBaseIterator = boost::iterator_facade<ScanFetchIterator<ValueFetch>, const std::pair<std::string, Reply>, boost::forward_traversal_tag>;
+	} //namespace implem
+
+	//Iterates over the keys returned by a scan, together with the reply of
+	//the fetch command for each of them. The fetch commands for a whole page
+	//are pipelined in one batch. Error replies (ie: WRONGTYPE) are returned
+	//to the caller as they are instead of being thrown.
+	template <typename ValueFetch>
+	class ScanFetchIterator : private implem::ScanPager<ValueFetch>, public implem::ScanFetchIteratorBaseIterator<ValueFetch> {
+		static_assert(std::is_same<std::string, typename ValueFetch::value_type>::value, "Only scans returning keys can be used to fetch values");
+		friend class boost::iterator_core_access;
+		typedef implem::ScanFetchIteratorBaseIterator<ValueFetch> base_iterator;
+		typedef implem::ScanPager<ValueFetch> pager;
+		define_has_method(scan_target, ScanTarget);
+	public:
+		typedef typename base_iterator::difference_type difference_type;
+		typedef typename base_iterator::value_type value_type;
+		typedef typename base_iterator::pointer pointer;
+		typedef typename base_iterator::reference reference;
+		typedef typename base_iterator::iterator_category iterator_category;
+
+		template <typename Dummy=ValueFetch, typename=typename std::enable_if<not HasScanTargetMethod<Dummy>::value>::type>
+		ScanFetchIterator ( Command* parCommand, std::shared_ptr<const ScanFetchCommand> parFetch, bool parEnd, boost::string_view parMatchPattern=boost::string_view(), const ScanOptions& parOptions=ScanOptions() );
+		template <typename Dummy=ValueFetch, typename=typename std::enable_if<HasScanTargetMethod<Dummy>::value>::type>
+		ScanFetchIterator ( Command* parCommand, std::shared_ptr<const ScanFetchCommand> parFetch, boost::string_view parKey, bool parEnd, boost::string_view parMatchPattern=boost::string_view(), const ScanOptions& parOptions=ScanOptions() );
+
+	private:
+		bool is_end ( void ) const;
+		void fetch_next_page ( void );
+
+		void increment ( void );
+		bool equal ( const ScanFetchIterator& parOther ) const;
+		const value_type& dereference ( void ) const;
+
+		std::shared_ptr<const ScanFetchCommand> m_fetch;
+		std::vector<std::pair<std::string, Reply>> m_items;
+		std::vector<std::string> m_keys;
+		std::vector<const char*> m_argv;
+		std::vector<std::size_t> m_lengths;
+		RedisInt m_scan_context;
+		std::size_t m_curr_index;
+	};
+
+	template <typename ValueFetch>
+	template <typename Dummy, typename>
+	ScanFetchIterator<ValueFetch>::ScanFetchIterator (Command* parCommand, std::shared_ptr<const ScanFetchCommand> parFetch, bool parEnd, boost::string_view parMatchPattern, const ScanOptions& parOptions) :
+		pager(parCommand, parMatchPattern, parOptions),
+		implem::ScanFetchIteratorBaseIterator<ValueFetch>(),
+		m_fetch(std::move(parFetch)),
+		m_scan_context(0),
+		m_curr_index(0)
+	{
+		assert(m_fetch);
+		if (not parEnd) {
+			m_curr_index = 1; //Some arbitrary value so is_end()==false
+			assert(not is_end());
+			this->increment();
+		}
+		else {
+			assert(is_end());
+		}
+	}
+
+	template <typename ValueFetch>
+	template <typename Dummy, typename>
+	ScanFetchIterator<ValueFetch>::ScanFetchIterator (Command* parCommand, std::shared_ptr<const ScanFetchCommand> parFetch, boost::string_view parKey, bool parEnd, boost::string_view parMatchPattern, const ScanOptions& parOptions) :
+		pager(parCommand, parMatchPattern, parOptions, parKey),
+		implem::ScanFetchIteratorBaseIterator<ValueFetch>(),
+		m_fetch(std::move(parFetch)),
+		m_scan_context(0),
+		m_curr_index(0)
+	{
+		assert(m_fetch);
+		if (not parEnd) {
+			m_curr_index = 1; //Some arbitrary value so is_end()==false
+			assert(not is_end());
+			this->increment();
+		}
+		else {
+			assert(is_end());
+		}
+	}
+
+	template <typename ValueFetch>
+	bool ScanFetchIterator<ValueFetch>::is_end() const {
+		return not m_curr_index and m_items.empty() and not m_scan_context;
+	}
+
+	template <typename ValueFetch>
+	void ScanFetchIterator<ValueFetch>::fetch_next_page() {
+		m_scan_context = this->next_page(m_scan_context, m_keys);
+		m_items.clear();
+		if (m_keys.empty())
+			return;
+
+		auto batch = this->command()->make_batch();
+		for (const auto& key : m_keys) {
+			m_fetch->enqueue(batch, key, m_argv, m_lengths);
+		}
+
+		auto replies = batch.replies_nonconst();
+		assert(replies.size() == m_keys.size());
+		m_items.reserve(m_keys.size());
+		auto it_key = m_keys.begin();
+		for (auto& reply : replies) {
+			m_items.emplace_back(std::move(*it_key), std::move(reply));
+			++it_key;
+		}
+	}
+
+	template <typename ValueFetch>
+	void ScanFetchIterator<ValueFetch>::increment() {
+		assert(not is_end());
+
+		if (m_curr_index + 1 < m_items.size()) {
+			++m_curr_index;
+		}
+		else if (m_curr_index + 1 == m_items.size() and not m_scan_context) {
+			m_items.clear();
+			m_curr_index = 0;
+		}
+		else {
+			this->fetch_next_page();
+			m_curr_index = 0;
+		}
+	}
+
+	template <typename ValueFetch>
+	bool ScanFetchIterator<ValueFetch>::equal (const ScanFetchIterator& parOther) const {
+		return
+			(&parOther == this) or
+			(is_end() and parOther.is_end()) or
+			(
+				not (is_end() or parOther.is_end()) and
+				pager::is_same_scan(parOther) and
+				(m_scan_context == parOther.m_scan_context) and
+				(m_curr_index == parOther.m_curr_index) and
+				(m_items.size() == parOther.m_items.size())
+			);
+	}
+
+	template <typename ValueFetch>
+	auto ScanFetchIterator<ValueFetch>::dereference() const -> const value_type& {
+		assert(not m_items.empty());
+		assert(m_curr_index < m_items.size());
+
+		return m_items[m_curr_index];
+	}
+} //namespace redis
+
+#endif
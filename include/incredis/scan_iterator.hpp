@@ -25,33 +25,75 @@
 #include <type_traits>
 #include <vector>
 #include <cstddef>
+#include <memory>
+#include <chrono>
 #include <boost/utility/string_view.hpp>
 
 namespace redis {
 	template <typename ValueFetch>
 	class ScanIterator;
+	template <typename ValueFetch>
+	class ScanPageIterator;
 
 	class Command;
+	class Batch;
+
+	//Tuning knobs for the SCAN family. With prefetch enabled the request for
+	//the next page is sent as soon as the current one arrives, so the
+	//round trip overlaps with the caller consuming the current page. If
+	//target_latency is non-zero the COUNT hint is grown or shrunk between
+	//min_count and max_count so that each page takes about that long.
+	struct ScanOptions {
+		ScanOptions ( void ) :
+			count(0),
+			min_count(10),
+			max_count(10000),
+			target_latency(0),
+			prefetch(false)
+		{
+		}
+
+		std::size_t count; //0 means use the default of the scan command
+		std::size_t min_count;
+		std::size_t max_count;
+		std::chrono::microseconds target_latency;
+		bool prefetch;
+	};
 
 	namespace implem {
 		template <typename ValueFetch>
 		using ScanIteratorBaseIterator = boost::iterator_facade<ScanIterator<ValueFetch>, const typename ValueFetch::value_type, boost::forward_traversal_tag>;
+		template <typename ValueFetch>
+		using ScanPageIteratorBaseIterator = boost::iterator_facade<ScanPageIterator<ValueFetch>, std::vector<typename ValueFetch::value_type>, boost::forward_traversal_tag>;
+
+		struct PendingScan;
 
 		class ScanIteratorBaseClass {
 		protected:
-			explicit ScanIteratorBaseClass ( Command* parCommand );
-			ScanIteratorBaseClass ( Command* parCommand, boost::string_view parMatchPattern );
+			ScanIteratorBaseClass ( Command* parCommand, boost::string_view parMatchPattern, const ScanOptions& parOptions, std::size_t parDefaultCount );
 			~ScanIteratorBaseClass ( void ) noexcept = default;
 
 			bool is_connected ( void ) const;
-			Reply run ( const char* parCommand, RedisInt parScanContext, std::size_t parCount );
-			Reply run ( const char* parCommand, const boost::string_view& parParameter, RedisInt parScanContext, std::size_t parCount );
+			Reply run ( const char* parCommand, RedisInt parScanContext );
+			Reply run ( const char* parCommand, const boost::string_view& parParameter, RedisInt parScanContext );
+			void prefetch ( const char* parCommand, RedisInt parScanContext );
+			void prefetch ( const char* parCommand, const boost::string_view& parParameter, RedisInt parScanContext );
+			std::size_t count_hint ( void ) const { return m_count; }
+			Command* command ( void ) const { return m_command; }
 
 			bool is_equal ( const ScanIteratorBaseClass& parOther ) const { return m_command == parOther.m_command; }
 
 		private:
+			Reply fetch ( const char* parCommand, const boost::string_view* parParameter, RedisInt parScanContext );
+			void start_prefetch ( const char* parCommand, const boost::string_view* parParameter, RedisInt parScanContext );
+			void enqueue ( Batch& parBatch, const char* parCommand, const boost::string_view* parParameter, RedisInt parScanContext ) const;
+			void update_count_hint ( std::chrono::steady_clock::duration parElapsed, bool parWasReady );
+
 			Command* m_command;
 			boost::string_view m_match_pattern;
+			std::shared_ptr<PendingScan> m_pending;
+			ScanOptions m_options;
+			std::size_t m_count;
 		};
 	} //namespace implem
 
@@ -59,10 +101,39 @@ namespace redis {
 		SCAN, SSCAN, ZSCAN, HSCAN
 	);
 
+	namespace implem {
+		//Runs the scan command and turns each reply into a page of values.
+		//Strings are moved out of the reply, so no character data is copied.
+		template <typename ValueFetch>
+		class ScanPager : private ScanIteratorBaseClass, private ValueFetch {
+			define_has_method(scan_target, ScanTarget);
+		protected:
+			typedef typename ValueFetch::value_type fetch_value_type;
+
+			template <typename... FetchArgs>
+			ScanPager ( Command* parCommand, boost::string_view parMatchPattern, const ScanOptions& parOptions, FetchArgs&&... parFetchArgs );
+
+			RedisInt next_page ( RedisInt parScanContext, std::vector<fetch_value_type>& parPage );
+			using ScanIteratorBaseClass::command;
+			bool is_same_scan ( const ScanPager& parOther ) const { return ScanIteratorBaseClass::is_equal(parOther); }
+
+		private:
+			template <typename T>
+			Reply forward_scan_command ( typename std::enable_if<HasScanTargetMethod<T>::value, RedisInt>::type parContext );
+			template <typename T>
+			Reply forward_scan_command ( typename std::enable_if<not HasScanTargetMethod<T>::value, RedisInt>::type parContext );
+			template <typename T>
+			void forward_prefetch ( typename std::enable_if<HasScanTargetMethod<T>::value, RedisInt>::type parContext );
+			template <typename T>
+			void forward_prefetch ( typename std::enable_if<not HasScanTargetMethod<T>::value, RedisInt>::type parContext );
+		};
+	} //namespace implem
+
 	template <typename ValueFetch>
-	class ScanIterator : private implem::ScanIteratorBaseClass, public implem::ScanIteratorBaseIterator<ValueFetch>, private ValueFetch {
+	class ScanIterator : private implem::ScanPager<ValueFetch>, public implem::ScanIteratorBaseIterator<ValueFetch> {
 		friend class boost::iterator_core_access;
 		typedef implem::ScanIteratorBaseIterator<ValueFetch> base_iterator;
+		typedef implem::ScanPager<ValueFetch> pager;
 		define_has_method(scan_target, ScanTarget);
 	public:
 		typedef typename base_iterator::difference_type difference_type;
@@ -72,15 +143,11 @@ namespace redis {
 		typedef typename base_iterator::iterator_category iterator_category;
 
 		template <typename Dummy=ValueFetch, typename=typename std::enable_if<not HasScanTargetMethod<Dummy>::value>::type>
-		ScanIterator ( Command* parCommand, bool parEnd, boost::string_view parMatchPattern=boost::string_view() );
+		ScanIterator ( Command* parCommand, bool parEnd, boost::string_view parMatchPattern=boost::string_view(), const ScanOptions& parOptions=ScanOptions() );
 		template <typename Dummy=ValueFetch, typename=typename std::enable_if<HasScanTargetMethod<Dummy>::value>::type>
-		ScanIterator ( Command* parCommand, boost::string_view parKey, bool parEnd, boost::string_view parMatchPattern=boost::string_view() );
+		ScanIterator ( Command* parCommand, boost::string_view parKey, bool parEnd, boost::string_view parMatchPattern=boost::string_view(), const ScanOptions& parOptions=ScanOptions() );
 
 	private:
-		template <typename T>
-		Reply forward_scan_command ( typename std::enable_if<HasScanTargetMethod<T>::value, RedisInt>::type parContext );
-		template <typename T>
-		Reply forward_scan_command ( typename std::enable_if<not HasScanTargetMethod<T>::value, RedisInt>::type parContext );
 		bool is_end ( void ) const;
 
 		void increment ( void );
@@ -92,6 +159,39 @@ namespace redis {
 		std::size_t m_curr_index;
 	};
 
+	//Same as ScanIterator, but each step yields a whole page as returned by
+	//the server. The page is handed out by non-const reference so callers
+	//can move the values out instead of copying them.
+	template <typename ValueFetch>
+	class ScanPageIterator : private implem::ScanPager<ValueFetch>, public implem::ScanPageIteratorBaseIterator<ValueFetch> {
+		friend class boost::iterator_core_access;
+		typedef implem::ScanPageIteratorBaseIterator<ValueFetch> base_iterator;
+		typedef implem::ScanPager<ValueFetch> pager;
+		define_has_method(scan_target, ScanTarget);
+	public:
+		typedef typename base_iterator::difference_type difference_type;
+		typedef typename base_iterator::value_type value_type;
+		typedef typename base_iterator::pointer pointer;
+		typedef typename base_iterator::reference reference;
+		typedef typename base_iterator::iterator_category iterator_category;
+
+		template <typename Dummy=ValueFetch, typename=typename std::enable_if<not HasScanTargetMethod<Dummy>::value>::type>
+		ScanPageIterator ( Command* parCommand, bool parEnd, boost::string_view parMatchPattern=boost::string_view(), const ScanOptions& parOptions=ScanOptions() );
+		template <typename Dummy=ValueFetch, typename=typename std::enable_if<HasScanTargetMethod<Dummy>::value>::type>
+		ScanPageIterator ( Command* parCommand, boost::string_view parKey, bool parEnd, boost::string_view parMatchPattern=boost::string_view(), const ScanOptions& parOptions=ScanOptions() );
+
+	private:
+		bool is_end ( void ) const { return not m_page_number; }
+
+		void increment ( void );
+		bool equal ( const ScanPageIterator& parOther ) const;
+		reference dereference ( void ) const;
+
+		mutable value_type m_page;
+		RedisInt m_scan_context;
+		std::size_t m_page_number;
+	};
+
 	template <typename T>
 	struct ScanSingleValues {
 		typedef T value_type;
@@ -101,6 +201,7 @@ namespace redis {
 		static constexpr const std::size_t work_count = 10;
 
 		static const T& make_value ( const Reply* parItem );
+		static T take_value ( Reply* parItem );
 	};
 
 	template <typename T>
@@ -114,6 +215,7 @@ namespace redis {
 		static constexpr const std::size_t work_count = 10;
 
 		static const T& make_value ( const Reply* parItem );
+		static T take_value ( Reply* parItem );
 		boost::string_view scan_target ( void ) const { return m_scan_target; }
 
 	private:
@@ -132,6 +234,7 @@ namespace redis {
 		static constexpr const std::size_t work_count = 10;
 
 		static value_type make_value ( const Reply* parItem );
+		static value_type take_value ( Reply* parItem );
 		boost::string_view scan_target ( void ) const { return m_scan_target; }
 
 	private:
@@ -21,14 +21,76 @@
 
 namespace redis {
 	namespace implem {
+		template <typename ValueFetch>
+		template <typename... FetchArgs>
+		ScanPager<ValueFetch>::ScanPager (Command* parCommand, boost::string_view parMatchPattern, const ScanOptions& parOptions, FetchArgs&&... parFetchArgs) :
+			ScanIteratorBaseClass(parCommand, parMatchPattern, parOptions, ValueFetch::work_count),
+			ValueFetch(std::forward<FetchArgs>(parFetchArgs)...)
+		{
+		}
+
+		template <typename ValueFetch>
+		RedisInt ScanPager<ValueFetch>::next_page (RedisInt parScanContext, std::vector<fetch_value_type>& parPage) {
+			static_assert(ValueFetch::step > 0, "Can't have an increase step of 0");
+
+			Reply whole_reply;
+			RedisInt new_context = parScanContext;
+			bool empty_page;
+
+			do {
+				whole_reply = this->forward_scan_command<ValueFetch>(new_context);
+
+				const auto& array_reply = get_array(static_cast<const Reply&>(whole_reply));
+				assert(2 == array_reply.size());
+				new_context = get_integer_autoconv_if_str(array_reply[0]);
+				empty_page = get_array(array_reply[1]).empty();
+
+				//Get the next page on its way before doing any work on this one
+				this->forward_prefetch<ValueFetch>(new_context);
+			} while (new_context and empty_page);
+
+			auto& variant_array = get_array(get_array(whole_reply)[1]);
+			assert(variant_array.size() % ValueFetch::step == 0);
+			const std::size_t expected_reply_count = variant_array.size() / ValueFetch::step;
+			parPage.clear();
+			parPage.reserve(expected_reply_count);
+			for (std::size_t z = 0; z < variant_array.size(); z += ValueFetch::step) {
+				parPage.push_back(ValueFetch::take_value(variant_array.data() + z));
+			}
+			assert(expected_reply_count == parPage.size());
+			return new_context;
+		}
+
+		template <typename ValueFetch>
+		template <typename T>
+		Reply ScanPager<ValueFetch>::forward_scan_command (typename std::enable_if<HasScanTargetMethod<T>::value, RedisInt>::type parContext) {
+			return ScanIteratorBaseClass::run(T::command(), T::scan_target(), parContext);
+		}
+
+		template <typename ValueFetch>
+		template <typename T>
+		Reply ScanPager<ValueFetch>::forward_scan_command (typename std::enable_if<not HasScanTargetMethod<T>::value, RedisInt>::type parContext) {
+			return ScanIteratorBaseClass::run(T::command(), parContext);
+		}
+
+		template <typename ValueFetch>
+		template <typename T>
+		void ScanPager<ValueFetch>::forward_prefetch (typename std::enable_if<HasScanTargetMethod<T>::value, RedisInt>::type parContext) {
+			ScanIteratorBaseClass::prefetch(T::command(), T::scan_target(), parContext);
+		}
+
+		template <typename ValueFetch>
+		template <typename T>
+		void ScanPager<ValueFetch>::forward_prefetch (typename std::enable_if<not HasScanTargetMethod<T>::value, RedisInt>::type parContext) {
+			ScanIteratorBaseClass::prefetch(T::command(), parContext);
+		}
 	} //namespace implem
 
 	template <typename ValueFetch>
 	template <typename Dummy, typename>
-	ScanIterator<ValueFetch>::ScanIterator (Command* parCommand, bool parEnd, boost::string_view parMatchPattern) :
-		implem::ScanIteratorBaseClass(parCommand, parMatchPattern),
+	ScanIterator<ValueFetch>::ScanIterator (Command* parCommand, bool parEnd, boost::string_view parMatchPattern, const ScanOptions& parOptions) :
+		pager(parCommand, parMatchPattern, parOptions),
 		implem::ScanIteratorBaseIterator<ValueFetch>(),
-		ValueFetch(),
 		m_reply(),
 		m_scan_context(0),
 		m_curr_index(0)
@@ -45,10 +107,9 @@ namespace redis {
 
 	template <typename ValueFetch>
 	template <typename Dummy, typename>
-	ScanIterator<ValueFetch>::ScanIterator (Command* parCommand, boost::string_view parKey, bool parEnd, boost::string_view parMatchPattern) :
-		implem::ScanIteratorBaseClass(parCommand, parMatchPattern),
+	ScanIterator<ValueFetch>::ScanIterator (Command* parCommand, boost::string_view parKey, bool parEnd, boost::string_view parMatchPattern, const ScanOptions& parOptions) :
+		pager(parCommand, parMatchPattern, parOptions, parKey),
 		implem::ScanIteratorBaseIterator<ValueFetch>(),
-		ValueFetch(parKey),
 		m_reply(),
 		m_scan_context(0),
 		m_curr_index(0)
@@ -71,7 +132,6 @@ namespace redis {
 	template <typename ValueFetch>
 	void ScanIterator<ValueFetch>::increment() {
 		assert(not is_end());
-		static_assert(ValueFetch::step > 0, "Can't have an increase step of 0");
 
 		if (m_curr_index + 1 < m_reply.size()) {
 			++m_curr_index;
@@ -81,28 +141,7 @@ namespace redis {
 			m_curr_index = 0;
 		}
 		else {
-			std::vector<Reply> array_reply;
-			RedisInt new_context = m_scan_context;
-
-			do {
-				auto whole_reply = this->forward_scan_command<ValueFetch>(new_context);
-
-				array_reply = get_array(whole_reply);
-				assert(2 == array_reply.size());
-				assert(array_reply.size() % ValueFetch::step == 0);
-				new_context = get_integer_autoconv_if_str(array_reply[0]);
-			} while (new_context and get_array(array_reply[1]).empty());
-
-			const auto variant_array = get_array(array_reply[1]);
-			assert(variant_array.size() % ValueFetch::step == 0);
-			const std::size_t expected_reply_count = variant_array.size() / ValueFetch::step;
-			m_reply.clear();
-			m_reply.reserve(expected_reply_count);
-			for (std::size_t z = 0; z < variant_array.size(); z += ValueFetch::step) {
-				m_reply.push_back(ValueFetch::make_value(variant_array.data() + z));
-			}
-			assert(expected_reply_count == m_reply.size());
-			m_scan_context = new_context;
+			m_scan_context = this->next_page(m_scan_context, m_reply);
 			m_curr_index = 0;
 		}
 	}
@@ -114,7 +153,7 @@ namespace redis {
 			(is_end() and parOther.is_end()) or
 			(
 				not (is_end() or parOther.is_end()) and
-				implem::ScanIteratorBaseClass::is_equal(parOther) and
+				pager::is_same_scan(parOther) and
 				(m_scan_context == parOther.m_scan_context) and
 				(m_curr_index == parOther.m_curr_index) and
 				(m_reply.size() == parOther.m_reply.size())
@@ -130,15 +169,75 @@ namespace redis {
 	}
 
 	template <typename ValueFetch>
-	template <typename T>
-	Reply ScanIterator<ValueFetch>::forward_scan_command (typename std::enable_if<HasScanTargetMethod<T>::value, RedisInt>::type parContext) {
-		return implem::ScanIteratorBaseClass::run(T::command(), T::scan_target(), parContext, T::work_count);
+	template <typename Dummy, typename>
+	ScanPageIterator<ValueFetch>::ScanPageIterator (Command* parCommand, bool parEnd, boost::string_view parMatchPattern, const ScanOptions& parOptions) :
+		pager(parCommand, parMatchPattern, parOptions),
+		implem::ScanPageIteratorBaseIterator<ValueFetch>(),
+		m_page(),
+		m_scan_context(0),
+		m_page_number(0)
+	{
+		if (not parEnd) {
+			m_page_number = 1; //Pretend there is a previous page so is_end()==false
+			this->increment();
+		}
+		assert(parEnd or m_page_number <= 1);
 	}
 
 	template <typename ValueFetch>
-	template <typename T>
-	Reply ScanIterator<ValueFetch>::forward_scan_command (typename std::enable_if<not HasScanTargetMethod<T>::value, RedisInt>::type parContext) {
-		return implem::ScanIteratorBaseClass::run(T::command(), parContext, T::work_count);
+	template <typename Dummy, typename>
+	ScanPageIterator<ValueFetch>::ScanPageIterator (Command* parCommand, boost::string_view parKey, bool parEnd, boost::string_view parMatchPattern, const ScanOptions& parOptions) :
+		pager(parCommand, parMatchPattern, parOptions, parKey),
+		implem::ScanPageIteratorBaseIterator<ValueFetch>(),
+		m_page(),
+		m_scan_context(0),
+		m_page_number(0)
+	{
+		if (not parEnd) {
+			m_page_number = 1; //Pretend there is a previous page so is_end()==false
+			this->increment();
+		}
+		assert(parEnd or m_page_number <= 1);
+	}
+
+	template <typename ValueFetch>
+	void ScanPageIterator<ValueFetch>::increment() {
+		assert(not is_end());
+
+		//m_page_number is 1 only before the first page has been requested
+		if (m_page_number > 1 and not m_scan_context) {
+			m_page.clear();
+			m_page_number = 0;
+			return;
+		}
+
+		m_scan_context = this->next_page(m_scan_context, m_page);
+		if (m_page.empty()) {
+			assert(not m_scan_context);
+			m_page_number = 0;
+		}
+		else {
+			++m_page_number;
+		}
+	}
+
+	template <typename ValueFetch>
+	bool ScanPageIterator<ValueFetch>::equal (const ScanPageIterator& parOther) const {
+		return
+			(&parOther == this) or
+			(is_end() and parOther.is_end()) or
+			(
+				not (is_end() or parOther.is_end()) and
+				pager::is_same_scan(parOther) and
+				(m_scan_context == parOther.m_scan_context) and
+				(m_page_number == parOther.m_page_number)
+			);
+	}
+
+	template <typename ValueFetch>
+	auto ScanPageIterator<ValueFetch>::dereference() const -> reference {
+		assert(not is_end());
+		return m_page;
 	}
 
 	template <typename T>
@@ -147,15 +246,33 @@ namespace redis {
 		return get<T>(*parItem);
 	}
 
+	template <typename T>
+	T ScanSingleValues<T>::take_value (Reply* parItem) {
+		assert(parItem);
+		return take<T>(*parItem);
+	}
+
 	template <typename T>
 	auto ScanSingleValuesInKey<T>::make_value (const Reply* parItem) -> const value_type& {
 		assert(parItem);
 		return get<T>(*parItem);
 	}
 
+	template <typename T>
+	T ScanSingleValuesInKey<T>::take_value (Reply* parItem) {
+		assert(parItem);
+		return take<T>(*parItem);
+	}
+
 	template <typename P, char Command, typename A, typename B>
 	auto ScanPairs<P, Command, A, B>::make_value (const Reply* parItem) -> value_type {
 		assert(parItem);
 		return value_type(get<A>(parItem[0]), get<B>(parItem[1]));
 	}
+
+	template <typename P, char Command, typename A, typename B>
+	auto ScanPairs<P, Command, A, B>::take_value (Reply* parItem) -> value_type {
+		assert(parItem);
+		return value_type(take<A>(parItem[0]), take<B>(parItem[1]));
+	}
 } //namespace redis
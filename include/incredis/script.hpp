@@ -19,36 +19,68 @@
 #define id5B30CDA57F894CD6888093B64F9433DA
 
 #include "batch.hpp"
+#include "stored_command.hpp"
+#include "script_manager.hpp"
 #include "incredis/int_conv.hpp"
 #include "duckhandy/sequence_bt.hpp"
 #include <boost/utility/string_view.hpp>
 #include <tuple>
+#include <iterator>
+#include <type_traits>
+#include <cstddef>
 #include <cassert>
 #include <ciso646>
 
 namespace redis {
-	class ScriptManager;
-
 	class Script {
 	public:
 		Script ( void );
 		Script ( Script&& ) = default;
-		Script ( boost::string_view parSha1, ScriptManager& parManager );
+		Script ( const LuaScript& parScript, ScriptManager& parManager );
 		~Script ( void ) noexcept = default;
 
 		template <typename... Keys, typename... Values>
 		void run ( Batch& parBatch, const std::tuple<Keys...>& parKeys, const std::tuple<Values...>& parValues );
+		//For when the number of keys is only known at runtime, ranges can
+		//be anything with begin() and end() over string_view, std::string
+		//or RedisInt
+		template <typename KeyRange, typename ValueRange>
+		void run ( Batch& parBatch, const KeyRange& parKeys, const ValueRange& parValues );
 
 		Script& operator= ( Script&& ) = default;
 
+		boost::string_view sha1 ( void ) const { return m_script.sha1; }
+
 	private:
+		void send ( Batch& parBatch, StoredCommand&& parEvalSha );
+
 		template <typename... Keys, typename... Values, std::size_t... KeyIndices, std::size_t... ValueIndices>
 		void run_with_indices ( Batch& parBatch, const std::tuple<Keys...>& parKeys, const std::tuple<Values...>& parValues, dhandy::bt::index_seq<KeyIndices...>, dhandy::bt::index_seq<ValueIndices...> );
 
-		boost::string_view m_sha1;
+		LuaScript m_script;
 		ScriptManager* m_manager;
 	};
 
+	namespace implem {
+		template <typename Range>
+		struct RangeArgs {
+			typedef typename std::decay<decltype(*std::begin(std::declval<const Range&>()))>::type value_type;
+
+			static void measure (const Range& parRange, std::size_t& parCount, std::size_t& parBytes) {
+				for (const auto& arg : parRange) {
+					++parCount;
+					parBytes += MakeCharInfo<value_type>(arg).size();
+				}
+			}
+
+			static void append (const Range& parRange, StoredCommand& parCommand) {
+				for (const auto& arg : parRange) {
+					parCommand.push_arg(static_cast<const value_type&>(arg));
+				}
+			}
+		};
+	} //namespace implem
+
 	template <typename... Keys, typename... Values>
 	void Script::run (Batch& parBatch, const std::tuple<Keys...>& parKeys, const std::tuple<Values...>& parValues) {
 		this->run_with_indices(
@@ -60,6 +92,29 @@ namespace redis {
 		);
 	}
 
+	template <typename KeyRange, typename ValueRange>
+	void Script::run (Batch& parBatch, const KeyRange& parKeys, const ValueRange& parValues) {
+		assert(not m_script.sha1.empty());
+		assert(m_manager);
+
+		std::size_t key_count = 0, value_count = 0, bytes = 0;
+		implem::RangeArgs<KeyRange>::measure(parKeys, key_count, bytes);
+		implem::RangeArgs<ValueRange>::measure(parValues, value_count, bytes);
+		const auto key_count_ary = int_to_ary_dec(key_count);
+		const auto key_count_str = key_count_ary.to<boost::string_view>();
+
+		//One allocation for the whole argument list, which has to outlive
+		//this call in case EVALSHA needs to be sent again as EVAL
+		StoredCommand evalsha;
+		evalsha.reserve(3 + key_count + value_count, 7 + m_script.sha1.size() + key_count_str.size() + bytes);
+		evalsha.push_back(boost::string_view("EVALSHA"));
+		evalsha.push_back(m_script.sha1);
+		evalsha.push_back(key_count_str);
+		implem::RangeArgs<KeyRange>::append(parKeys, evalsha);
+		implem::RangeArgs<ValueRange>::append(parValues, evalsha);
+		this->send(parBatch, std::move(evalsha));
+	}
+
 	template <typename... Keys, typename... Values, std::size_t... KeyIndices, std::size_t... ValueIndices>
 	void Script::run_with_indices (Batch& parBatch, const std::tuple<Keys...>& parKeys, const std::tuple<Values...>& parValues, dhandy::bt::index_seq<KeyIndices...>, dhandy::bt::index_seq<ValueIndices...>) {
 		static_assert(sizeof...(Keys) == sizeof...(KeyIndices), "Wrong index count");
@@ -67,16 +122,16 @@ namespace redis {
 		static_assert(sizeof...(Keys) == std::tuple_size<std::tuple<Keys...>>::value, "Wrong key count");
 		static_assert(sizeof...(Values) == std::tuple_size<std::tuple<Values...>>::value, "Wrong value count");
 
-		assert(not m_sha1.empty());
+		assert(not m_script.sha1.empty());
 		assert(m_manager);
 
-		parBatch.run(
+		this->send(parBatch, StoredCommand(
 			"EVALSHA",
-			m_sha1,
-			int_conv<std::string>(sizeof...(Keys)),
+			m_script.sha1,
+			int_to_ary_dec(sizeof...(Keys)).to<boost::string_view>(),
 			std::get<KeyIndices>(parKeys)...,
 			std::get<ValueIndices>(parValues)...
-		);
+		));
 	}
 } //namespace redis
 
@@ -18,45 +18,78 @@
 #ifndef id8E124FF76DF449CDB8FBA806F8EF4E78
 #define id8E124FF76DF449CDB8FBA806F8EF4E78
 
-#include "incredisConfig.h"
-#if defined(WITH_CRYPTOPP)
-#	define MAKE_SHA1_WITH_CRYPTOPP
-#endif
 #include <boost/utility/string_view.hpp>
-#if defined(MAKE_SHA1_WITH_CRYPTOPP)
-#	include <set>
-#else
-#	include <map>
-#endif
+#include <map>
 #include <string>
 #include <array>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
 
 namespace redis {
 	class Command;
 
+	struct LuaScript {
+		boost::string_view sha1;
+		boost::string_view text;
+		//Set once the server is known to have the script
+		std::atomic<bool>* loaded;
+	};
+
+	//Keeps the text of every script submitted, so that EVALSHA can fall
+	//back to EVAL and scripts can be loaded again after the server lost
+	//them. Views returned stay valid for as long as the manager lives.
+	//Hashes are computed locally, the server is never asked for them.
 	class ScriptManager {
 	public:
 		explicit ScriptManager ( Command* parCommand );
 
-		boost::string_view submit_lua_script ( const boost::string_view& parScript );
+		//Doesn't talk to the server, load() is called before the script
+		//runs for the first time
+		LuaScript submit_lua_script ( const boost::string_view& parScript );
+		//Like submit_lua_script(), but also sends SCRIPT LOAD for all
+		//scripts not loaded yet in a single batch
+		std::vector<LuaScript> preload ( const std::vector<boost::string_view>& parScripts );
+		//Blocking SCRIPT LOAD, unless the script is already loaded. It has
+		//to happen before the first EVALSHA so that the EVALSHA doesn't
+		//fail and run as EVAL after the commands queued behind it.
+		void load ( const LuaScript& parScript );
+		//Loads all known scripts again in a single batch
+		void reload ( void );
+		void reload_if_stale ( void );
+		//Called from the event thread when an EVALSHA of a script that
+		//had been loaded got NOSCRIPT, so the server lost its scripts
+		void mark_stale ( void ) noexcept;
+		//For when the server is known to have dropped its scripts, like
+		//after a SCRIPT FLUSH sent by this client. Each script is loaded
+		//again before its next EVALSHA.
+		void mark_unloaded ( void );
+		std::size_t script_count ( void ) const;
 		void update_command_ptr (Command* parNewPtr);
 
 	private:
 		using Sha1Array = std::array<char, 40>;
 
-		boost::string_view add_lua_script_ifn ( const boost::string_view& parScript );
+		struct KnownScript {
+			explicit KnownScript ( boost::string_view parText ) :
+				text(parText),
+				loaded(false)
+			{
+			}
+
+			std::string text;
+			std::atomic<bool> loaded;
+		};
+
+		LuaScript add_script ( const boost::string_view& parScript );
 
 		Command* m_command;
-#if defined(MAKE_SHA1_WITH_CRYPTOPP)
-		std::set<Sha1Array> m_known_hashes;
-#else
-		std::map<std::string, Sha1Array> m_known_scripts;
-#endif
+		std::map<Sha1Array, KnownScript> m_known_scripts;
+		mutable std::mutex m_mutex;
+		std::atomic<bool> m_stale;
 	};
 
-	inline boost::string_view ScriptManager::submit_lua_script (const boost::string_view& parScript) {
-		return add_lua_script_ifn(parScript);
-	}
 } //namespace redis
 
 #endif
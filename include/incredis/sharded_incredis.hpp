@@ -0,0 +1,133 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id68426F234C85468FAF4C0F38B9FA4DBF
+#define id68426F234C85468FAF4C0F38B9FA4DBF
+
+#include "incredis.hpp"
+#include "batch.hpp"
+#include "reply.hpp"
+#include <boost/utility/string_view.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace redis {
+	class ShardedBatch;
+
+	//Maps parKey to one of parShardCount shards using jump consistent hash
+	//over the key's hash tag, so {user1000}.a and {user1000}.b always end up
+	//on the same shard. Appending a shard only moves about 1/n of the keys.
+	std::size_t shard_for_key ( boost::string_view parKey, std::size_t parShardCount );
+
+	//Client side sharding over standalone servers. Nodes must always be
+	//added in the same order, and new nodes should only be appended at the
+	//end, otherwise keys will be looked up on the wrong server.
+	class ShardedIncRedis {
+	public:
+		ShardedIncRedis ( void );
+		ShardedIncRedis ( ShardedIncRedis&& ) = default;
+		~ShardedIncRedis ( void ) noexcept = default;
+
+		void add_node ( std::string&& parAddress, uint16_t parPort );
+		void add_node ( std::string&& parSocket );
+
+		void connect ( void );
+		void wait_for_connect ( void );
+		void disconnect ( void );
+		void wait_for_disconnect ( void );
+		bool is_connected ( void ) const;
+
+		ShardedBatch make_batch ( void );
+
+		std::size_t node_count ( void ) const { return m_nodes.size(); }
+		std::size_t node_index_for_key ( boost::string_view parKey ) const;
+		IncRedis& node ( std::size_t parIndex );
+		IncRedis& node_for_key ( boost::string_view parKey ) { return node(node_index_for_key(parKey)); }
+
+	private:
+		std::vector<std::unique_ptr<IncRedis>> m_nodes;
+	};
+
+	//Batch whose commands are split by key over the nodes of a
+	//ShardedIncRedis. Each node gets its own Batch so sub-batches travel in
+	//parallel, each on the event thread of its own connection. Replies are
+	//moved back into a single list in the same order as the calls. Nodes
+	//added after the batch was made are used as keys map to them.
+	class ShardedBatch {
+		friend class ShardedIncRedis;
+	public:
+		ShardedBatch ( ShardedBatch&& );
+		ShardedBatch ( const ShardedBatch& ) = delete;
+		~ShardedBatch ( void ) noexcept;
+
+		template <typename... Args>
+		ShardedBatch& run ( const char* parCommand, boost::string_view parKey, Args&&... parArgs );
+
+		std::vector<Reply>& replies ( void );
+		void throw_if_failed ( void );
+		void reset ( void ) noexcept;
+
+		ShardedBatch& set ( boost::string_view parKey, boost::string_view parValue ) { return run("SET", parKey, parValue); }
+		ShardedBatch& get ( boost::string_view parKey ) { return run("GET", parKey); }
+		ShardedBatch& del ( boost::string_view parKey ) { return run("DEL", parKey); }
+		ShardedBatch& hget ( boost::string_view parKey, boost::string_view parField ) { return run("HGET", parKey, parField); }
+		template <typename... Args>
+		ShardedBatch& hmget ( boost::string_view parKey, Args&&... parArgs );
+		template <typename... Args>
+		ShardedBatch& hmset ( boost::string_view parKey, Args&&... parArgs );
+		template <typename... Args>
+		ShardedBatch& sadd ( boost::string_view parKey, Args&&... parArgs );
+
+	private:
+		struct LocalData;
+
+		explicit ShardedBatch ( ShardedIncRedis* parRedis );
+		Batch& batch_for_key ( boost::string_view parKey );
+
+		std::unique_ptr<LocalData> m_local_data;
+	};
+
+	template <typename... Args>
+	ShardedBatch& ShardedBatch::run (const char* parCommand, boost::string_view parKey, Args&&... parArgs) {
+		batch_for_key(parKey).run(parCommand, parKey, std::forward<Args>(parArgs)...);
+		return *this;
+	}
+
+	template <typename... Args>
+	ShardedBatch& ShardedBatch::hmget (boost::string_view parKey, Args&&... parArgs) {
+		static_assert(sizeof...(Args) > 0, "No fields specified");
+		return run("HMGET", parKey, std::forward<Args>(parArgs)...);
+	}
+
+	template <typename... Args>
+	ShardedBatch& ShardedBatch::hmset (boost::string_view parKey, Args&&... parArgs) {
+		static_assert(sizeof...(Args) >= 1, "No parameters specified");
+		static_assert(sizeof...(Args) % 2 == 0, "Uneven number of parameters received");
+		return run("HMSET", parKey, std::forward<Args>(parArgs)...);
+	}
+
+	template <typename... Args>
+	ShardedBatch& ShardedBatch::sadd (boost::string_view parKey, Args&&... parArgs) {
+		static_assert(sizeof...(Args) > 0, "No members specified");
+		return run("SADD", parKey, std::forward<Args>(parArgs)...);
+	}
+} //namespace redis
+
+#endif
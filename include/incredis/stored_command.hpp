@@ -0,0 +1,97 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef idD41BF5B8FE97436DBFB4E0B8A73E9432
+#define idD41BF5B8FE97436DBFB4E0B8A73E9432
+
+#include "reply.hpp"
+#include "arg_to_bin_safe.hpp"
+#include <boost/utility/string_view.hpp>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	class Batch;
+
+	//A command together with a copy of its arguments, for when it has to
+	//be sent (or sent again) after the original arguments have gone out of
+	//scope. All arguments are stored one after the other in a single buffer.
+	class StoredCommand {
+	public:
+		StoredCommand ( void );
+		template <typename... Args>
+		explicit StoredCommand ( const char* parCommand, Args&&... parArgs );
+		StoredCommand ( StoredCommand&& ) = default;
+		StoredCommand ( const StoredCommand& ) = default;
+		~StoredCommand ( void ) noexcept;
+
+		StoredCommand& operator= ( StoredCommand&& ) = default;
+		StoredCommand& operator= ( const StoredCommand& ) = default;
+
+		void push_back ( const char* parData, std::size_t parLength );
+		void push_back ( boost::string_view parArg ) { push_back(parArg.data(), parArg.size()); }
+		template <typename T>
+		void push_arg ( const T& parArg );
+		void reserve ( std::size_t parArgCount, std::size_t parByteCount );
+		void clear ( void );
+
+		std::size_t size ( void ) const { return m_ends.size(); }
+		bool empty ( void ) const { return m_ends.empty(); }
+		boost::string_view operator[] ( std::size_t parIndex ) const;
+		boost::string_view name ( void ) const { return (*this)[0]; }
+		std::size_t hash ( void ) const;
+		bool operator== ( const StoredCommand& parOther ) const { return m_ends == parOther.m_ends and m_buffer == parOther.m_buffer; }
+
+		void run ( Batch& parBatch ) const;
+		void run ( Batch& parBatch, std::vector<const char*>& parArgv, std::vector<std::size_t>& parLengths ) const;
+
+	private:
+		std::string m_buffer;
+		std::vector<std::size_t> m_ends;
+	};
+
+	struct StoredCommandHash {
+		std::size_t operator() ( const StoredCommand& parCommand ) const { return parCommand.hash(); }
+	};
+
+	template <typename... Args>
+	StoredCommand::StoredCommand (const char* parCommand, Args&&... parArgs) :
+		m_buffer(),
+		m_ends()
+	{
+		m_ends.reserve(sizeof...(Args) + 1);
+		push_back(boost::string_view(parCommand));
+		(push_arg(parArgs), ...);
+	}
+
+	template <typename T>
+	inline void StoredCommand::push_arg (const T& parArg) {
+		implem::MakeCharInfo<T> info(parArg);
+		push_back(info.data(), info.size());
+	}
+
+	inline boost::string_view StoredCommand::operator[] (std::size_t parIndex) const {
+		assert(parIndex < m_ends.size());
+		const std::size_t start = (parIndex ? m_ends[parIndex - 1] : 0);
+		return boost::string_view(m_buffer.data() + start, m_ends[parIndex] - start);
+	}
+} //namespace redis
+
+#endif
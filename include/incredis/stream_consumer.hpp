@@ -0,0 +1,118 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id681AC06699A24162864393AF1CD2E114
+#define id681AC06699A24162864393AF1CD2E114
+
+#include "command.hpp"
+#include "stored_command.hpp"
+#include <boost/utility/string_view.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace redis {
+	struct StreamEntry {
+		std::string id;
+		//Empty if the entry was deleted while still pending
+		std::vector<std::pair<std::string, std::string>> fields;
+	};
+
+	struct StreamConsumerOptions {
+		StreamConsumerOptions ( void ) :
+			count(128),
+			block(2000),
+			ack_batch(256),
+			min_idle(60000)
+		{
+		}
+
+		//COUNT for XREADGROUP and XAUTOCLAIM
+		std::size_t count;
+		//How long read() waits for new entries, zero means don't block
+		std::chrono::milliseconds block;
+		//Acknowledged ids are sent once this many are queued, in XACK
+		//commands of at most this many ids each
+		std::size_t ack_batch;
+		//Pending entries idle for longer than this can be reclaimed
+		std::chrono::milliseconds min_idle;
+	};
+
+	//Consumer group client for a single stream. Blocking reads go through
+	//a connection of their own, so they never hold up the Command the
+	//consumer was created from, which is used for XADD and XACK. Acks are
+	//queued by ack() and sent as multi-id XACK commands; read() pipelines
+	//the queued ones on the main connection while it waits for new entries.
+	class StreamConsumer {
+	public:
+		StreamConsumer ( Command& parCommand, uint32_t parDb, std::string&& parStream, std::string&& parGroup, std::string&& parConsumer, const StreamConsumerOptions& parOptions=StreamConsumerOptions() );
+		~StreamConsumer ( void ) noexcept;
+
+		void connect ( void );
+		void wait_for_connect ( void );
+		void disconnect ( void );
+		bool is_connected ( void ) const;
+
+		//Returns false if the group exists already
+		bool create_group ( boost::string_view parStartId="$", bool parMakeStream=true );
+		template <typename... Args>
+		std::string add ( Args&&... parFieldValues );
+
+		//New entries for this consumer, empty if none arrived in time
+		std::vector<StreamEntry> read ( void );
+		//All entries delivered to this consumer but never acknowledged, as
+		//after a restart, read count entries at a time
+		std::vector<StreamEntry> read_pending ( void );
+		//Takes over all entries other consumers left idle for min_idle,
+		//following the XAUTOCLAIM cursor until the scan is complete
+		std::vector<StreamEntry> reclaim ( void );
+
+		void ack ( boost::string_view parId );
+		//Sends the queued acks and waits for the replies, returns how many
+		//entries the server acknowledged
+		std::size_t flush_acks ( void );
+
+		uint64_t read_count ( void ) const;
+		uint64_t acked_count ( void ) const;
+		const std::string& stream ( void ) const;
+
+	private:
+		struct LocalData;
+
+		//Appends to parOut, returns how many entries were added
+		std::size_t read_group ( boost::string_view parId, bool parBlock, std::vector<StreamEntry>& parOut );
+		std::size_t send_acks ( void );
+		std::size_t collect_acks ( void );
+
+		std::unique_ptr<LocalData> m_local_data;
+		Command& m_command;
+	};
+
+	template <typename... Args>
+	std::string StreamConsumer::add (Args&&... parFieldValues) {
+		static_assert(sizeof...(Args) > 0, "No fields specified");
+		static_assert(sizeof...(Args) % 2 == 0, "Uneven number of parameters received");
+		auto reply = m_command.run("XADD", stream(), "*", std::forward<Args>(parFieldValues)...);
+		return take<std::string>(reply);
+	}
+} //namespace redis
+
+#endif
@@ -0,0 +1,103 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef idDD5B5E9585F44280B6B67A19A84FF3BF
+#define idDD5B5E9585F44280B6B67A19A84FF3BF
+
+#include <boost/utility/string_view.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace redis {
+	struct PubSubMessage {
+		std::string channel;
+		//Only set for messages received through a PSUBSCRIBE
+		std::string pattern;
+		std::string payload;
+	};
+
+	enum OverflowPolicy {
+		//Discard the incoming message if the worker's queue is full
+		Overflow_Drop,
+		//Stop reading from the socket until the worker catches up, the
+		//server will buffer (and eventually disconnect us)
+		Overflow_Block
+	};
+
+	struct SubscriberOptions {
+		SubscriberOptions ( void ) :
+			worker_threads(1),
+			queue_capacity(8192),
+			overflow(Overflow_Drop)
+		{
+		}
+
+		std::size_t worker_threads;
+		//Per worker, rounded up to a power of two
+		std::size_t queue_capacity;
+		OverflowPolicy overflow;
+	};
+
+	struct SubscriptionStats {
+		uint64_t received;
+		uint64_t dropped;
+	};
+
+	//Pub/Sub client on a dedicated connection. Messages are unpacked
+	//straight from the hiredis reply and pushed to one of the worker
+	//threads over a lock-free queue, picked by channel name so messages of
+	//the same channel are always handled in order by the same worker. The
+	//handler runs on the worker threads.
+	class Subscriber {
+	public:
+		typedef std::function<void(const PubSubMessage&)> Handler;
+
+		Subscriber ( std::string&& parAddress, uint16_t parPort, Handler parHandler, const SubscriberOptions& parOptions=SubscriberOptions() );
+		Subscriber ( std::string&& parSocket, Handler parHandler, const SubscriberOptions& parOptions=SubscriberOptions() );
+		~Subscriber ( void ) noexcept;
+
+		void connect ( void );
+		void wait_for_connect ( void );
+		void disconnect ( void );
+		bool is_connected ( void ) const;
+
+		//These return once the server confirmed the change
+		void subscribe ( boost::string_view parChannel );
+		void unsubscribe ( boost::string_view parChannel );
+		void psubscribe ( boost::string_view parPattern );
+		void punsubscribe ( boost::string_view parPattern );
+		std::size_t subscription_count ( void ) const;
+
+		//Counters are kept per channel or pattern as given to subscribe()
+		//or psubscribe()
+		SubscriptionStats stats ( boost::string_view parSubscription ) const;
+		SubscriptionStats total_stats ( void ) const;
+		uint64_t handler_errors ( void ) const;
+
+	private:
+		struct LocalData;
+
+		void change_subscription ( const char* parCommand, boost::string_view parName );
+
+		std::unique_ptr<LocalData> m_local_data;
+	};
+} //namespace redis
+
+#endif
@@ -0,0 +1,101 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id97D95967E08F4EA4AEA485571FC3D61D
+#define id97D95967E08F4EA4AEA485571FC3D61D
+
+#include "reply.hpp"
+#include "stored_command.hpp"
+#include "connection_pool.hpp"
+#include <boost/utility/string_view.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+#include <cstddef>
+
+namespace redis {
+	class Command;
+
+	struct TransactionOptions {
+		TransactionOptions ( void ) :
+			max_attempts(16),
+			initial_backoff(100),
+			max_backoff(20000)
+		{
+		}
+
+		std::size_t max_attempts;
+		//Wait between attempts after EXEC returned nil, doubling each time
+		std::chrono::microseconds initial_backoff;
+		std::chrono::microseconds max_backoff;
+	};
+
+	//Optimistic MULTI/EXEC transaction. Each attempt takes two round trips:
+	//WATCH and the read commands are pipelined together, then MULTI, the
+	//commands queued by the builder and EXEC are sent as one batch. If EXEC
+	//returns nil because a watched key changed the whole thing is retried.
+	//Transactions need a connection nobody else sends commands on in the
+	//meantime, either leased from a pool or given by the caller.
+	class Transaction {
+	public:
+		//Called once per attempt with the replies to the read commands, it
+		//appends to parQueue the commands to run inside MULTI/EXEC.
+		//Returning false gives up the transaction.
+		typedef std::function<bool(const std::vector<Reply>& parReads, std::vector<StoredCommand>& parQueue)> Builder;
+
+		explicit Transaction ( ConnectionPool::Lease&& parLease, const TransactionOptions& parOptions=TransactionOptions() );
+		explicit Transaction ( Command& parExclusiveCommand, const TransactionOptions& parOptions=TransactionOptions() );
+		Transaction ( Transaction&& ) = default;
+		~Transaction ( void ) noexcept;
+
+		Transaction& watch ( boost::string_view parKey );
+		template <typename... Args>
+		Transaction& read ( const char* parCommand, Args&&... parArgs );
+
+		//Returns false if the builder gave up, throws if all attempts ran
+		//into a conflict or if the server refused to queue a command.
+		//Replies to the queued commands, errors included, are in replies().
+		bool run ( const Builder& parBuilder );
+		const std::vector<Reply>& replies ( void ) const { return m_replies; }
+		std::size_t attempts ( void ) const { return m_attempts; }
+
+	private:
+		std::vector<Reply> send_reads ( void );
+		bool send_queued ( const std::vector<StoredCommand>& parQueue );
+		void unwatch ( void );
+		void back_off ( std::size_t parAttempt );
+
+		std::unique_ptr<ConnectionPool::Lease> m_lease;
+		Command* m_command;
+		TransactionOptions m_options;
+		std::vector<std::string> m_watched;
+		std::vector<StoredCommand> m_reads;
+		std::vector<Reply> m_replies;
+		std::minstd_rand m_random;
+		std::size_t m_attempts;
+	};
+
+	template <typename... Args>
+	Transaction& Transaction::read (const char* parCommand, Args&&... parArgs) {
+		m_reads.emplace_back(parCommand, std::forward<Args>(parArgs)...);
+		return *this;
+	}
+} //namespace redis
+
+#endif
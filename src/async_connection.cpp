@@ -16,6 +16,7 @@
  */
 
 #include "async_connection.hpp"
+#include "loop_stats.hpp"
 #include <hiredis/async.h>
 #include <hiredis/adapters/libev.h>
 #include <ev.h>
@@ -26,31 +27,68 @@
 #include <signal.h>
 #include <cassert>
 #include <sstream>
+#include <chrono>
 
 namespace redis {
 	namespace {
-		void async_callback (ev_loop* /*parLoop*/, ev_async* /*parObject*/, int /*parRevents*/) {
+		//What the libev release/acquire callbacks get through ev_userdata()
+		struct LoopHooks {
+			LoopHooks ( std::mutex& parMutex, LoopStatsRecorder& parStats ) :
+				mutex(parMutex),
+				stats(parStats),
+				acquired()
+			{
+			}
+
+			std::mutex& mutex;
+			LoopStatsRecorder& stats;
+			std::chrono::steady_clock::time_point acquired;
+		};
+
+		void async_callback (ev_loop* /*parLoop*/, ev_async* parObject, int /*parRevents*/) {
+			assert(parObject->data);
+			LoopStatsRecorder& stats = *static_cast<LoopStatsRecorder*>(parObject->data);
+			const int64_t sent_at = stats.wakeup_sent_at.exchange(0, std::memory_order_relaxed);
+			LoopStatsRecorder::Histograms* const histograms = stats.histograms();
+			if (sent_at and histograms) {
+				const auto sent = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(sent_at));
+				histograms->wakeup_latency.record_exclusive(std::chrono::steady_clock::now() - sent);
+			}
 		}
 
 		void async_halt_loop (ev_loop* parLoop, ev_async* /*parObject*/, int /*parRevents*/) {
 			ev_break(parLoop, EVBREAK_ALL);
 		}
 
+		//Called by libev when poll() returns
 		void lock_mutex_libev (ev_loop* parLoop) noexcept {
-			std::mutex* mtx = static_cast<std::mutex*>(ev_userdata(parLoop));
-			assert(mtx);
+			LoopHooks* hooks = static_cast<LoopHooks*>(ev_userdata(parLoop));
+			assert(hooks);
+			LoopStatsRecorder::Histograms* const histograms = hooks->stats.histograms();
+			const auto start = (histograms ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point());
 			try {
-				mtx->lock();
+				hooks->mutex.lock();
 			}
 			catch (const std::system_error&) {
 				assert(false);
 			}
+			if (histograms) {
+				hooks->acquired = std::chrono::steady_clock::now();
+				histograms->loop_mutex_wait.record_exclusive(hooks->acquired - start);
+			}
+			else {
+				hooks->acquired = std::chrono::steady_clock::time_point();
+			}
 		}
 
+		//Called by libev right before poll()
 		void unlock_mutex_libev (ev_loop* parLoop) noexcept {
-			std::mutex* mtx = static_cast<std::mutex*>(ev_userdata(parLoop));
-			assert(mtx);
-			mtx->unlock();
+			LoopHooks* hooks = static_cast<LoopHooks*>(ev_userdata(parLoop));
+			assert(hooks);
+			LoopStatsRecorder::Histograms* const histograms = hooks->stats.histograms();
+			if (hooks->acquired != std::chrono::steady_clock::time_point() and histograms)
+				histograms->iteration.record_exclusive(std::chrono::steady_clock::now() - hooks->acquired);
+			hooks->mutex.unlock();
 		}
 	} //unnamed namespace
 
@@ -58,7 +96,11 @@ namespace redis {
 		LocalData() :
 			redis_poll_thread(),
 			connect_processed(false),
-			disconnect_processed(true)
+			disconnect_processed(true),
+			connection_count(0),
+			connection_lost_count(0),
+			loop_stats(),
+			loop_hooks(libev_mutex, loop_stats)
 		{
 		}
 
@@ -72,6 +114,10 @@ namespace redis {
 		std::string connect_err_msg;
 		std::atomic_bool connect_processed;
 		std::atomic_bool disconnect_processed;
+		std::atomic<uint64_t> connection_count;
+		std::atomic<uint64_t> connection_lost_count;
+		LoopStatsRecorder loop_stats;
+		LoopHooks loop_hooks;
 	};
 
 	void on_connect (const redisAsyncContext* parContext, int parStatus) {
@@ -82,6 +128,8 @@ namespace redis {
 
 		self.m_connection_lost = false;
 		self.m_connected = (parStatus == REDIS_OK);
+		if (self.m_connected)
+			++self.m_local_data->connection_count;
 		self.m_local_data->connect_processed = true;
 		self.m_local_data->connect_err_msg = parContext->errstr;
 		self.m_local_data->condition_connected.notify_one();
@@ -94,6 +142,8 @@ namespace redis {
 		assert(not self.m_local_data->disconnect_processed);
 
 		self.m_connection_lost = (REDIS_ERR == parStatus);
+		if (self.m_connection_lost)
+			++self.m_local_data->connection_lost_count;
 		self.m_connected = false;
 		self.m_local_data->disconnect_processed = true;
 		self.m_local_data->connect_err_msg.clear();
@@ -115,10 +165,11 @@ namespace redis {
 
 			//See: http://pod.tst.eu/http://cvs.schmorp.de/libev/ev.pod#THREAD_LOCKING_EXAMPLE
 			ev_async_init(&m_local_data->watcher_wakeup, &async_callback);
+			m_local_data->watcher_wakeup.data = &m_local_data->loop_stats;
 			ev_async_start(m_libev_loop_thread.get(), &m_local_data->watcher_wakeup);
 			ev_async_init(&m_local_data->watcher_halt, &async_halt_loop);
 			ev_async_start(m_libev_loop_thread.get(), &m_local_data->watcher_halt);
-			ev_set_userdata(m_libev_loop_thread.get(), &m_local_data->libev_mutex);
+			ev_set_userdata(m_libev_loop_thread.get(), &m_local_data->loop_hooks);
 			ev_set_loop_release_cb(m_libev_loop_thread.get(), &unlock_mutex_libev, &lock_mutex_libev);
 		}
 	}
@@ -204,16 +255,41 @@ namespace redis {
 	}
 
 	void AsyncConnection::wakeup_event_thread() {
+		LoopStatsRecorder& stats = m_local_data->loop_stats;
 		if (ev_async_pending(&m_local_data->watcher_wakeup) == false) {
-			std::lock_guard<std::mutex> lock(m_local_data->libev_mutex);
+			TimedEventLock lock(m_local_data->libev_mutex, stats);
+			if (stats.is_enabled()) {
+				int64_t expected = 0;
+				stats.wakeup_sent_at.compare_exchange_strong(expected, std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+				stats.wakeups_sent.fetch_add(1, std::memory_order_relaxed);
+			}
 			ev_async_send(m_libev_loop_thread.get(), &m_local_data->watcher_wakeup);
 		}
+		else if (stats.is_enabled()) {
+			stats.wakeups_coalesced.fetch_add(1, std::memory_order_relaxed);
+		}
 	}
 
 	std::mutex& AsyncConnection::event_mutex() {
 		return m_local_data->libev_mutex;
 	}
 
+	uint64_t AsyncConnection::connection_count() const {
+		return m_local_data->connection_count.load(std::memory_order_relaxed);
+	}
+
+	uint64_t AsyncConnection::connection_lost_count() const {
+		return m_local_data->connection_lost_count.load(std::memory_order_relaxed);
+	}
+
+	LoopStatsRecorder& AsyncConnection::loop_stats() {
+		return m_local_data->loop_stats;
+	}
+
+	const LoopStatsRecorder& AsyncConnection::loop_stats() const {
+		return m_local_data->loop_stats;
+	}
+
 	bool AsyncConnection::is_socket_connection() const {
 		return not (m_port or m_address.empty());
 	}
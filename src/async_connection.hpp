@@ -31,6 +31,8 @@ namespace std {
 } //namespace std
 
 namespace redis {
+	struct LoopStatsRecorder;
+
 	class AsyncConnection {
 		friend void on_connect ( const redisAsyncContext*, int );
 		friend void on_disconnect ( const redisAsyncContext*, int );
@@ -48,6 +50,12 @@ namespace redis {
 		void wakeup_event_thread ( void );
 		std::mutex& event_mutex ( void );
 		redisAsyncContext* connection ( void );
+		const std::string& address ( void ) const { return m_address; }
+		uint16_t port ( void ) const { return m_port; }
+		uint64_t connection_count ( void ) const;
+		uint64_t connection_lost_count ( void ) const;
+		LoopStatsRecorder& loop_stats ( void );
+		const LoopStatsRecorder& loop_stats ( void ) const;
 
 	private:
 		using RedisConnection = std::unique_ptr<redisAsyncContext, void(*)(redisAsyncContext*)>;
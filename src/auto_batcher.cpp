@@ -0,0 +1,125 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "auto_batcher.hpp"
+#include "reply_errors.hpp"
+#include <boost/range/iterator_range_core.hpp>
+#include <stdexcept>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	AutoBatcher::AutoBatcher (const AutoBatchOptions& parOptions) :
+		m_options(parOptions),
+		m_queue(),
+		m_mutex(),
+		m_full(),
+		m_active_callers(0),
+		m_has_leader(false),
+		m_flushes(0),
+		m_commands(0)
+	{
+		assert(m_options.max_commands > 0);
+		m_queue.reserve(m_options.max_commands);
+	}
+
+	AutoBatcher::~AutoBatcher() noexcept {
+		assert(m_queue.empty());
+	}
+
+	void AutoBatcher::set_options (const AutoBatchOptions& parOptions) {
+		assert(parOptions.max_commands > 0);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_options = parOptions;
+		m_queue.reserve(m_options.max_commands);
+	}
+
+	Reply AutoBatcher::run (const StoredCommand& parCommand, Command& parTarget) {
+		struct ActiveCaller {
+			explicit ActiveCaller ( std::atomic<std::size_t>& parCount ) : count(parCount) { ++count; }
+			~ActiveCaller ( void ) noexcept { --count; }
+			std::atomic<std::size_t>& count;
+		} active_caller(m_active_callers);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_queue.emplace_back(parCommand);
+		std::future<Reply> reply = m_queue.back().reply.get_future();
+
+		if (m_has_leader) {
+			if (m_queue.size() >= m_options.max_commands)
+				m_full.notify_one();
+			lock.unlock();
+			return reply.get();
+		}
+
+		m_has_leader = true;
+		if (m_active_callers.load(std::memory_order_relaxed) > 1)
+			m_full.wait_for(lock, m_options.window, [this]() { return m_queue.size() >= m_options.max_commands; });
+
+		std::vector<Pending> pending;
+		pending.reserve(m_options.max_commands);
+		pending.swap(m_queue);
+		m_has_leader = false;
+		lock.unlock();
+
+		flush(pending, parTarget);
+		return reply.get();
+	}
+
+	void AutoBatcher::flush (std::vector<Pending>& parPending, Command& parTarget) {
+		m_flushes.fetch_add(1, std::memory_order_relaxed);
+		m_commands.fetch_add(parPending.size(), std::memory_order_relaxed);
+
+		try {
+			Batch batch = parTarget.make_batch();
+			std::vector<const char*> argv;
+			std::vector<std::size_t> lengths;
+			for (const auto& item : parPending) {
+				item.command.run(batch, argv, lengths);
+			}
+
+			auto it_item = parPending.begin();
+			for (auto& reply : batch.replies_nonconst()) {
+				assert(parPending.end() != it_item);
+				//Same check Command::run() does, nested errors included
+				std::exception_ptr reply_error;
+				try {
+					throw_if_reply_errors(boost::make_iterator_range(&reply, &reply + 1), 1);
+				}
+				catch (const std::runtime_error&) {
+					reply_error = std::current_exception();
+				}
+				if (reply_error)
+					it_item->reply.set_exception(reply_error);
+				else
+					it_item->reply.set_value(std::move(reply));
+				++it_item;
+			}
+		}
+		catch (...) {
+			//Promises that were already fulfilled throw again, skip them
+			const std::exception_ptr error = std::current_exception();
+			for (auto& item : parPending) {
+				try {
+					item.reply.set_exception(error);
+				}
+				catch (const std::future_error&) {
+				}
+			}
+		}
+	}
+} //namespace redis
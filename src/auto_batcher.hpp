@@ -0,0 +1,77 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id90F424533EC84C209A81E5AA1DEF5A63
+#define id90F424533EC84C209A81E5AA1DEF5A63
+
+#include "reply.hpp"
+#include "stored_command.hpp"
+#include "command.hpp"
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace redis {
+	//Collects commands from concurrent synchronous callers into shared
+	//batches. The first caller to find the queue empty becomes the leader:
+	//it waits until the queue is full or the time window expires, then
+	//sends everything queued so far as one Batch and hands each reply back
+	//to its caller. Callers arriving meanwhile just wait for their reply.
+	//A leader with no other caller in run() sends right away, so single
+	//threaded use pays no extra latency.
+	class AutoBatcher {
+	public:
+		explicit AutoBatcher ( const AutoBatchOptions& parOptions );
+		~AutoBatcher ( void ) noexcept;
+
+		//Applies from the next flush on
+		void set_options ( const AutoBatchOptions& parOptions );
+
+		Reply run ( const StoredCommand& parCommand, Command& parTarget );
+		uint64_t flush_count ( void ) const { return m_flushes.load(std::memory_order_relaxed); }
+		uint64_t command_count ( void ) const { return m_commands.load(std::memory_order_relaxed); }
+
+	private:
+		struct Pending {
+			explicit Pending ( const StoredCommand& parCommand ) :
+				command(parCommand),
+				reply()
+			{
+			}
+
+			StoredCommand command;
+			std::promise<Reply> reply;
+		};
+
+		void flush ( std::vector<Pending>& parPending, Command& parTarget );
+
+		AutoBatchOptions m_options;
+		std::vector<Pending> m_queue;
+		std::mutex m_mutex;
+		std::condition_variable m_full;
+		std::atomic<std::size_t> m_active_callers;
+		bool m_has_leader;
+		std::atomic<uint64_t> m_flushes;
+		std::atomic<uint64_t> m_commands;
+	};
+} //namespace redis
+
+#endif
@@ -17,8 +17,15 @@
 
 #include "batch.hpp"
 #include "async_connection.hpp"
+#include "loop_stats.hpp"
 #include "thread_context.hpp"
 #include "reply_list.hpp"
+#include "reply_errors.hpp"
+#include "script_manager.hpp"
+#include "incredis/stored_command.hpp"
+#include "command_table.hpp"
+#include "command_observer.hpp"
+#include "key_filter.hpp"
 #include <hiredis/hiredis.h>
 #include <hiredis/async.h>
 #include <cassert>
@@ -27,6 +34,9 @@
 #include <mutex>
 #include <condition_variable>
 #include <sstream>
+#include <chrono>
+#include <memory>
+#include <vector>
 
 //#define VERBOSE_HIREDIS_COMM
 
@@ -35,16 +45,44 @@
 #endif
 
 namespace redis {
+	//What's needed to turn an EVALSHA into an EVAL, the script text lives
+	//in the ScriptManager
+	struct ScriptFallback {
+		ScriptFallback ( StoredCommand&& parEvalSha, const LuaScript& parScript, ScriptManager& parManager ) :
+			evalsha(std::move(parEvalSha)),
+			script(parScript),
+			manager(parManager)
+		{
+		}
+
+		StoredCommand evalsha;
+		LuaScript script;
+		ScriptManager& manager;
+	};
+
 	namespace {
 		const std::size_t g_max_redis_unanswered_commands = 1000;
+#if defined(INCREDIS_WITH_TRACING)
+		std::atomic<uint64_t> g_next_trace_id(1);
+#endif
 
 		struct HiredisCallbackData {
-			HiredisCallbackData ( std::atomic_size_t& parPendingFutures, std::atomic_size_t& parLocalPendingFutures, std::condition_variable& parSendCmdCond, std::condition_variable& parLocalCmdsCond ) :
+			HiredisCallbackData ( std::atomic_size_t& parPendingFutures, std::atomic_size_t& parLocalPendingFutures, std::condition_variable& parSendCmdCond, std::condition_variable& parLocalCmdsCond, LatencyStats& parLatency ) :
 				pending_futures(parPendingFutures),
 				local_pending_futures(parLocalPendingFutures),
 				reply_ptr(),
 				send_command_condition(parSendCmdCond),
-				local_commands_condition(parLocalCmdsCond)
+				local_commands_condition(parLocalCmdsCond),
+				latency(parLatency),
+				sent(),
+				fallback(),
+				metrics(nullptr),
+				command_index(0),
+				bytes_sent(0)
+#if defined(INCREDIS_WITH_TRACING)
+				, observer(nullptr)
+				, trace_id(0)
+#endif
 			{
 			}
 
@@ -53,8 +91,109 @@ namespace redis {
 			std::atomic_size_t& local_pending_futures;
 			std::condition_variable& send_command_condition;
 			std::condition_variable& local_commands_condition;
+			LatencyStats& latency;
+			std::chrono::steady_clock::time_point sent;
+			std::unique_ptr<ScriptFallback> fallback;
+			//Only set when metrics are enabled
+			MetricsRecorder* metrics;
+			std::size_t command_index;
+			std::size_t bytes_sent;
+#if defined(INCREDIS_WITH_TRACING)
+			CommandObserver* observer;
+			uint64_t trace_id;
+#endif
 		};
 
+		//Commands missing from the command table count as writes
+		void note_written_keys (KeyFilter& parFilter, int parArgc, const char** parArgv, const std::size_t* parLengths) {
+			const CommandInfo* const info = find_command_info(boost::string_view(parArgv[0], parLengths[0]));
+			if (info and not (info->flags & CommandFlag_Write))
+				return;
+			for_each_key(parArgc, parArgv, parLengths, [&parFilter](boost::string_view parKey) {
+				parFilter.insert(parKey);
+			});
+		}
+
+		//Type byte, number and CRLF
+		std::size_t resp_header_size (long long parValue) {
+			const unsigned long long magnitude = (parValue < 0 ? 0ULL - static_cast<unsigned long long>(parValue) : static_cast<unsigned long long>(parValue));
+			std::size_t digits = 1;
+			for (unsigned long long z = magnitude; z >= 10; z /= 10) {
+				++digits;
+			}
+			return 1 + (parValue < 0 ? 1 : 0) + digits + 2;
+		}
+
+		//Size of the command once hiredis encodes it as a RESP array of
+		//bulk strings
+		std::size_t resp_size (int parArgc, const std::size_t* parLengths) {
+			std::size_t retval = resp_header_size(parArgc);
+			for (int z = 0; z < parArgc; ++z) {
+				retval += resp_header_size(static_cast<long long>(parLengths[z])) + parLengths[z] + 2;
+			}
+			return retval;
+		}
+
+		//Size of the reply as the server sent it, rebuilt from what hiredis
+		//parsed since it doesn't keep count of the bytes it read
+		std::size_t resp_size (const redisReply* parReply) {
+			switch (parReply->type) {
+			case REDIS_REPLY_INTEGER:
+				return resp_header_size(parReply->integer);
+			case REDIS_REPLY_STRING:
+				return resp_header_size(static_cast<long long>(parReply->len)) + parReply->len + 2;
+			case REDIS_REPLY_ARRAY:
+				{
+					std::size_t retval = resp_header_size(static_cast<long long>(parReply->elements));
+					for (std::size_t z = 0; z < parReply->elements; ++z) {
+						retval += resp_size(parReply->element[z]);
+					}
+					return retval;
+				}
+			case REDIS_REPLY_NIL:
+				return 5;
+			default:
+				return 1 + parReply->len + 2;
+			}
+		}
+
+		bool is_noscript (const redisReply* parReply) {
+			return parReply and REDIS_REPLY_ERROR == parReply->type and
+				boost::string_view(parReply->str, parReply->len).substr(0, 8) == "NOSCRIPT";
+		}
+
+		void hiredis_run_callback ( redisAsyncContext* parContext, void* parReply, void* parPrivData );
+
+		//Runs on the event thread with the event mutex held, the EVAL goes
+		//out with the same callback data so the reply lands in the slot
+		//reserved for the EVALSHA
+		void resend_as_eval (redisAsyncContext* parContext, HiredisCallbackData* parData) {
+			std::unique_ptr<ScriptFallback> fallback(std::move(parData->fallback));
+			//A script that was never loaded is expected to be missing, one
+			//that was means the server lost its scripts
+			if (fallback->script.loaded->load(std::memory_order_acquire))
+				fallback->manager.mark_stale();
+
+			const StoredCommand& evalsha = fallback->evalsha;
+			assert(evalsha.size() >= 3);
+			thread_local std::vector<const char*> argv;
+			thread_local std::vector<std::size_t> lengths;
+			argv.resize(evalsha.size());
+			lengths.resize(evalsha.size());
+			argv[0] = "EVAL";
+			lengths[0] = 4;
+			argv[1] = fallback->script.text.data();
+			lengths[1] = fallback->script.text.size();
+			for (std::size_t z = 2; z < evalsha.size(); ++z) {
+				argv[z] = evalsha[z].data();
+				lengths[z] = evalsha[z].size();
+			}
+			parData->sent = std::chrono::steady_clock::now();
+			const int command_added = redisAsyncCommandArgv(parContext, &hiredis_run_callback, parData, static_cast<int>(argv.size()), argv.data(), lengths.data());
+			assert(REDIS_OK == command_added);
+			static_cast<void>(command_added);
+		}
+
 		Reply make_redis_reply_type (redisReply* parReply) {
 			using boost::transform_iterator;
 			using PtrToReplyIterator = transform_iterator<Reply(*)(redisReply*), redisReply**>;
@@ -81,9 +220,14 @@ namespace redis {
 			};
 		}
 
-		void hiredis_run_callback (redisAsyncContext*, void* parReply, void* parPrivData) {
+		void hiredis_run_callback (redisAsyncContext* parContext, void* parReply, void* parPrivData) {
 			assert(parPrivData);
 			auto* data = static_cast<HiredisCallbackData*>(parPrivData);
+			if (data->fallback and is_noscript(static_cast<redisReply*>(parReply))) {
+				resend_as_eval(parContext, data);
+				return;
+			}
+
 			{
 				const auto old_count = data->pending_futures.fetch_add(-1);
 				assert(old_count > 0);
@@ -91,13 +235,38 @@ namespace redis {
 					data->send_command_condition.notify_one();
 			}
 
+			const auto elapsed = std::chrono::steady_clock::now() - data->sent;
 			if (parReply) {
-				auto reply = make_redis_reply_type(static_cast<redisReply*>(parReply));
-				*data->reply_ptr = std::move(reply);
+				data->latency.record(elapsed);
+				LoopStatsRecorder::Histograms* const loop_histograms = static_cast<AsyncConnection*>(parContext->data)->loop_stats().histograms();
+				if (loop_histograms) {
+					const auto parse_start = std::chrono::steady_clock::now();
+					*data->reply_ptr = make_redis_reply_type(static_cast<redisReply*>(parReply));
+					loop_histograms->reply_parse.record_exclusive(std::chrono::steady_clock::now() - parse_start);
+				}
+				else {
+					auto reply = make_redis_reply_type(static_cast<redisReply*>(parReply));
+					*data->reply_ptr = std::move(reply);
+				}
 			}
 			else {
-				assert(false); //Should this case also be managed?
+				//hiredis passes a null reply to the commands still pending
+				//when the connection is closed
+				const char message[] = "Connection closed before a reply was received";
+				*data->reply_ptr = Reply(ErrorString(message, sizeof(message) - 1));
+			}
+
+			if (data->metrics) {
+				const auto* const reply = static_cast<const redisReply*>(parReply);
+				const bool error = (not reply or REDIS_REPLY_ERROR == reply->type);
+				data->metrics->record_reply(data->command_index, elapsed, data->bytes_sent, (reply ? resp_size(reply) : 0), error);
 			}
+#if defined(INCREDIS_WITH_TRACING)
+			if (data->observer) {
+				const auto* const reply = static_cast<const redisReply*>(parReply);
+				data->observer->on_reply(data->trace_id, std::chrono::steady_clock::now(), not reply or REDIS_REPLY_ERROR == reply->type);
+			}
+#endif
 
 			{
 				const auto old_value = data->local_pending_futures.fetch_add(-1);
@@ -107,22 +276,6 @@ namespace redis {
 			}
 			delete data;
 		}
-
-		template <typename R>
-		int array_throw_if_failed (int parErrCount, int parMaxReportedErrors, const R& parReplies, std::ostream& parStream) {
-			int err_count = 0;
-			for (const auto& rep : parReplies) {
-				if (rep.which() == RedisVariantType_Error) {
-					++err_count;
-					if (err_count + parErrCount <= parMaxReportedErrors)
-						parStream << '"' << get_error_string(rep).message() << "\" ";
-				}
-				else if (rep.which() == RedisVariantType_Array) {
-					err_count += array_throw_if_failed(err_count + parErrCount, parMaxReportedErrors, get_array(rep), parStream);
-				}
-			}
-			return err_count;
-		}
 	} //unnamed namespace
 
 	struct Batch::LocalData {
@@ -133,6 +286,10 @@ namespace redis {
 			pending_futures_mutex(),
 			local_pending_futures(0),
 			thread_context(parThreadContext)
+#if defined(INCREDIS_WITH_TRACING)
+			, unconsumed_trace_ids()
+			, observer(nullptr)
+#endif
 		{
 		}
 
@@ -143,6 +300,11 @@ namespace redis {
 		std::mutex pending_futures_mutex;
 		std::atomic_size_t local_pending_futures;
 		ThreadContext& thread_context;
+#if defined(INCREDIS_WITH_TRACING)
+		//Commands whose replies haven't been handed out yet
+		std::vector<uint64_t> unconsumed_trace_ids;
+		CommandObserver* observer;
+#endif
 	};
 
 	Batch::Batch (Batch&&) = default;
@@ -160,15 +322,46 @@ namespace redis {
 			this->reset();
 	}
 
-	void Batch::run_pvt (int parArgc, const char** parArgv, std::size_t* parLengths) {
+	void Batch::run_pvt (int parArgc, const char** parArgv, const std::size_t* parLengths, ScriptFallback* parFallback, bool parAsking) {
 		assert(parArgc >= 1);
 		assert(parArgv);
 		assert(parLengths); //This /could/ be null, but I don't see why it should
 		assert(m_local_data);
 
-		m_local_data->local_pending_futures.fetch_add(1);
-		const auto pending_futures = m_local_data->thread_context.pending_futures.fetch_add(1);
-		auto* data = new HiredisCallbackData(m_local_data->thread_context.pending_futures, m_local_data->local_pending_futures, m_local_data->free_cmd_slot, m_local_data->no_more_pending_futures);
+		const std::size_t command_count = (parAsking ? 2 : 1);
+		m_local_data->local_pending_futures.fetch_add(command_count);
+		const auto pending_futures = m_local_data->thread_context.pending_futures.fetch_add(command_count);
+		std::unique_ptr<HiredisCallbackData> asking_data;
+		if (parAsking)
+			asking_data.reset(new HiredisCallbackData(m_local_data->thread_context.pending_futures, m_local_data->local_pending_futures, m_local_data->free_cmd_slot, m_local_data->no_more_pending_futures, m_local_data->thread_context.latency));
+		auto* data = new HiredisCallbackData(m_local_data->thread_context.pending_futures, m_local_data->local_pending_futures, m_local_data->free_cmd_slot, m_local_data->no_more_pending_futures, m_local_data->thread_context.latency);
+		data->fallback.reset(parFallback);
+		if (KeyFilter* const key_filter = m_local_data->thread_context.key_filter.load(std::memory_order_acquire))
+			note_written_keys(*key_filter, parArgc, parArgv, parLengths);
+		MetricsRecorder& metrics = m_local_data->thread_context.metrics;
+		if (metrics.enabled()) {
+			data->metrics = &metrics;
+			data->command_index = command_index(boost::string_view(parArgv[0], parLengths[0]));
+			data->bytes_sent = resp_size(parArgc, parLengths);
+		}
+#if defined(INCREDIS_WITH_TRACING)
+		CommandObserver* const observer = m_local_data->thread_context.observer.load(std::memory_order_acquire);
+		const uint64_t trace_id = (observer ? g_next_trace_id.fetch_add(1, std::memory_order_relaxed) : 0);
+		if (observer) {
+			data->observer = observer;
+			data->trace_id = trace_id;
+			m_local_data->observer = observer;
+			m_local_data->unconsumed_trace_ids.push_back(trace_id);
+
+			CommandTrace trace;
+			trace.id = trace_id;
+			trace.name = boost::string_view(parArgv[0], parLengths[0]);
+			trace.arg_sizes = parLengths + 1;
+			trace.arg_count = static_cast<std::size_t>(parArgc - 1);
+			trace.time = std::chrono::steady_clock::now();
+			observer->on_enqueue(trace);
+		}
+#endif
 
 #if defined(VERBOSE_HIREDIS_COMM)
 		std::cout << "run_pvt(), " << pending_futures << " items pending... ";
@@ -177,6 +370,8 @@ namespace redis {
 #if defined(VERBOSE_HIREDIS_COMM)
 			std::cout << " waiting... ";
 #endif
+			if (data->metrics)
+				data->metrics->record_backpressure_wait();
 			std::unique_lock<std::mutex> u_lock(m_local_data->futures_mutex);
 			m_local_data->free_cmd_slot.wait(u_lock, [this]() { return m_local_data->thread_context.pending_futures < g_max_redis_unanswered_commands; });
 		}
@@ -184,13 +379,32 @@ namespace redis {
 		std::cout << " emplace_back(future)... ";
 #endif
 
+		if (asking_data)
+			asking_data->reply_ptr = m_local_data->replies.add();
 		data->reply_ptr = m_local_data->replies.add();
 		{
-			std::lock_guard<std::mutex> lock(m_async_conn->event_mutex());
+			TimedEventLock lock(m_async_conn->event_mutex(), m_async_conn->loop_stats());
+			data->sent = std::chrono::steady_clock::now();
+			if (asking_data) {
+				//Nothing else may reach the node between ASKING and the
+				//command it applies to
+				const char* asking_argv[] = { "ASKING" };
+				const std::size_t asking_length[] = { 6 };
+				asking_data->sent = data->sent;
+				const int asking_added = redisAsyncCommandArgv(m_async_conn->connection(), &hiredis_run_callback, asking_data.get(), 1, asking_argv, asking_length);
+				assert(REDIS_OK == asking_added);
+				static_cast<void>(asking_added);
+				asking_data.release();
+			}
 			const int command_added = redisAsyncCommandArgv(m_async_conn->connection(), &hiredis_run_callback, data, parArgc, parArgv, parLengths);
 			assert(REDIS_OK == command_added); // REDIS_ERR if error
 			static_cast<void>(command_added);
 		}
+#if defined(INCREDIS_WITH_TRACING)
+		//data belongs to the event thread by now
+		if (observer)
+			observer->on_write(trace_id, std::chrono::steady_clock::now());
+#endif
 
 #if defined(VERBOSE_HIREDIS_COMM)
 		std::cout << "command sent to hiredis" << std::endl;
@@ -198,10 +412,45 @@ namespace redis {
 		m_async_conn->wakeup_event_thread();
 	}
 
+	Batch& Batch::run_argv (int parArgc, const char** parArgv, const std::size_t* parLengths) {
+		this->run_pvt(parArgc, parArgv, parLengths);
+		return *this;
+	}
+
+	Batch& Batch::run_asking (int parArgc, const char** parArgv, const std::size_t* parLengths) {
+		this->run_pvt(parArgc, parArgv, parLengths, nullptr, true);
+		return *this;
+	}
+
+	Batch& Batch::run_evalsha (StoredCommand&& parEvalSha, const LuaScript& parScript, ScriptManager& parManager) {
+		std::unique_ptr<ScriptFallback> fallback(new ScriptFallback(std::move(parEvalSha), parScript, parManager));
+		const StoredCommand& evalsha = fallback->evalsha;
+		//Scripts can take hundreds of keys, don't allocate the argv for
+		//each call
+		thread_local std::vector<const char*> argv;
+		thread_local std::vector<std::size_t> lengths;
+		argv.resize(evalsha.size());
+		lengths.resize(evalsha.size());
+		for (std::size_t z = 0; z < evalsha.size(); ++z) {
+			argv[z] = evalsha[z].data();
+			lengths[z] = evalsha[z].size();
+		}
+		this->run_pvt(static_cast<int>(argv.size()), argv.data(), lengths.data(), fallback.release());
+		return *this;
+	}
+
 	bool Batch::replies_ready() const {
 		return static_cast<bool>(0 == m_local_data->local_pending_futures);
 	}
 
+	bool Batch::wait_for_replies (std::chrono::microseconds parTimeout) const {
+		if (replies_ready())
+			return true;
+
+		std::unique_lock<std::mutex> u_lock(m_local_data->pending_futures_mutex);
+		return m_local_data->no_more_pending_futures.wait_for(u_lock, parTimeout, [this]() { return m_local_data->local_pending_futures == 0; });
+	}
+
 	auto Batch::replies() const -> ConstReplies {
 		if (not replies_ready()) {
 			if (m_local_data->local_pending_futures > 0) {
@@ -209,6 +458,15 @@ namespace redis {
 				m_local_data->no_more_pending_futures.wait(u_lock, [this]() { return m_local_data->local_pending_futures == 0; });
 			}
 		}
+#if defined(INCREDIS_WITH_TRACING)
+		if (not m_local_data->unconsumed_trace_ids.empty()) {
+			const auto now = std::chrono::steady_clock::now();
+			for (const uint64_t id : m_local_data->unconsumed_trace_ids) {
+				m_local_data->observer->on_consume(id, now);
+			}
+			m_local_data->unconsumed_trace_ids.clear();
+		}
+#endif
 		return ConstReplies(m_local_data->replies.begin(), m_local_data->replies.end(), m_local_data->replies.size());
 	}
 
@@ -218,15 +476,7 @@ namespace redis {
 	}
 
 	void Batch::throw_if_failed() {
-		std::ostringstream oss;
-		const int max_reported_errors = 3;
-
-		oss << "Error in reply: ";
-		const int err_count = array_throw_if_failed(0, max_reported_errors, replies(), oss);
-		if (err_count) {
-			oss << " (showing " << err_count << '/' << max_reported_errors << " errors on " << m_local_data->replies.size() << " total replies)";
-			throw std::runtime_error(oss.str());
-		}
+		throw_if_reply_errors(replies(), m_local_data->replies.size());
 	}
 
 	void Batch::reset() noexcept {
@@ -242,6 +492,14 @@ namespace redis {
 		m_local_data->replies.clear();
 	}
 
+	bool tracing_available() {
+#if defined(INCREDIS_WITH_TRACING)
+		return true;
+#else
+		return false;
+#endif
+	}
+
 	RedisError::RedisError (const char* parMessage, std::size_t parLength) :
 		std::runtime_error(std::string(parMessage, parLength))
 	{
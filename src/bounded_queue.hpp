@@ -0,0 +1,95 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id1801D83F51184B9C831092BDB79283DD
+#define id1801D83F51184B9C831092BDB79283DD
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	//Blocking multi-producer, multi-consumer queue with a fixed capacity.
+	//Once closed, push() fails and pop() drains whatever is left.
+	template <typename T>
+	class BoundedQueue {
+	public:
+		explicit BoundedQueue ( std::size_t parCapacity );
+		~BoundedQueue ( void ) noexcept = default;
+
+		bool push ( T&& parItem );
+		bool pop ( T& parItem );
+		void close ( void );
+
+	private:
+		std::deque<T> m_items;
+		std::mutex m_mutex;
+		std::condition_variable m_not_full;
+		std::condition_variable m_not_empty;
+		const std::size_t m_capacity;
+		bool m_closed;
+	};
+
+	template <typename T>
+	BoundedQueue<T>::BoundedQueue (std::size_t parCapacity) :
+		m_items(),
+		m_capacity(parCapacity),
+		m_closed(false)
+	{
+		assert(m_capacity > 0);
+	}
+
+	template <typename T>
+	bool BoundedQueue<T>::push (T&& parItem) {
+		std::unique_lock<std::mutex> u_lock(m_mutex);
+		m_not_full.wait(u_lock, [this]() { return m_closed or m_items.size() < m_capacity; });
+		if (m_closed)
+			return false;
+		m_items.push_back(std::move(parItem));
+		u_lock.unlock();
+		m_not_empty.notify_one();
+		return true;
+	}
+
+	template <typename T>
+	bool BoundedQueue<T>::pop (T& parItem) {
+		std::unique_lock<std::mutex> u_lock(m_mutex);
+		m_not_empty.wait(u_lock, [this]() { return m_closed or not m_items.empty(); });
+		if (m_items.empty())
+			return false;
+		parItem = std::move(m_items.front());
+		m_items.pop_front();
+		u_lock.unlock();
+		m_not_full.notify_one();
+		return true;
+	}
+
+	template <typename T>
+	void BoundedQueue<T>::close() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closed = true;
+		}
+		m_not_full.notify_all();
+		m_not_empty.notify_all();
+	}
+} //namespace redis
+
+#endif
@@ -0,0 +1,521 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluster_command.hpp"
+#include "command.hpp"
+#include "command_table.hpp"
+#include "reply_errors.hpp"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <sstream>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		const int g_max_redirections = 16;
+		const std::size_t g_dropped_reply = static_cast<std::size_t>(-1);
+		//Slot of commands that take no keys, any node can run them
+		const uint16_t g_no_slot = g_cluster_slot_count;
+
+		enum RedirectionType {
+			Redirect_None,
+			Redirect_Moved,
+			Redirect_Ask,
+			Redirect_TryAgain
+		};
+
+		struct Redirection {
+			Redirection ( void ) : type(Redirect_None), slot(0), host(), port(0) {}
+
+			RedirectionType type;
+			uint16_t slot;
+			std::string host;
+			uint16_t port;
+		};
+
+		bool starts_with (const std::string& parString, boost::string_view parPrefix) {
+			return parString.size() >= parPrefix.size() and 0 == parString.compare(0, parPrefix.size(), parPrefix.data(), parPrefix.size());
+		}
+
+		//Parses errors in the form "MOVED 3999 127.0.0.1:6381"
+		Redirection parse_redirection (const Reply& parReply) {
+			Redirection retval;
+			if (not parReply.is_error())
+				return retval;
+
+			const std::string& message = get_error_string(parReply).message();
+			if (starts_with(message, "TRYAGAIN")) {
+				retval.type = Redirect_TryAgain;
+				return retval;
+			}
+
+			std::size_t slot_start;
+			if (starts_with(message, "MOVED ")) {
+				retval.type = Redirect_Moved;
+				slot_start = 6;
+			}
+			else if (starts_with(message, "ASK ")) {
+				retval.type = Redirect_Ask;
+				slot_start = 4;
+			}
+			else {
+				return retval;
+			}
+
+			const auto endpoint_start = message.find(' ', slot_start);
+			const auto port_start = message.rfind(':');
+			if (std::string::npos == endpoint_start or std::string::npos == port_start or port_start < endpoint_start) {
+				retval.type = Redirect_None;
+				return retval;
+			}
+			retval.slot = static_cast<uint16_t>(std::stoul(message.substr(slot_start, endpoint_start - slot_start)));
+			retval.host = message.substr(endpoint_start + 1, port_start - endpoint_start - 1);
+			retval.port = static_cast<uint16_t>(std::stoul(message.substr(port_start + 1)));
+			return retval;
+		}
+
+		//Keys are found through the command table. Commands missing from
+		//it are routed by their first argument like before, treating every
+		//argument as a key would reject most of them as cross slot.
+		uint16_t command_slot (const StoredCommand& parCommand, std::vector<const char*>& parArgv, std::vector<std::size_t>& parLengths) {
+			if (not find_command_info(parCommand[0]))
+				return (parCommand.size() > 1 ? key_hash_slot(parCommand[1]) : g_no_slot);
+
+			parArgv.resize(parCommand.size());
+			parLengths.resize(parCommand.size());
+			for (std::size_t z = 0; z < parCommand.size(); ++z) {
+				parArgv[z] = parCommand[z].data();
+				parLengths[z] = parCommand[z].size();
+			}
+			uint16_t retval = g_no_slot;
+			for_each_key(static_cast<int>(parArgv.size()), parArgv.data(), parLengths.data(), [&retval, &parCommand](boost::string_view parKey) {
+				const uint16_t slot = key_hash_slot(parKey);
+				if (g_no_slot == retval) {
+					retval = slot;
+				}
+				else if (slot != retval) {
+					std::ostringstream oss;
+					oss << "Keys of " << parCommand[0] << " don't hash to the same cluster slot";
+					throw std::invalid_argument(oss.str());
+				}
+			});
+			return retval;
+		}
+
+		std::string node_name (const std::string& parHost, uint16_t parPort) {
+			std::ostringstream oss;
+			oss << parHost << ':' << parPort;
+			return oss.str();
+		}
+	} //unnamed namespace
+
+	struct ClusterCommand::LocalData {
+		explicit LocalData ( std::vector<NodeAddress>&& parSeeds ) :
+			mutex(),
+			seeds(std::move(parSeeds)),
+			nodes(),
+			slots(g_cluster_slot_count, nullptr),
+			live_batches(0)
+		{
+		}
+
+		Command& node ( const std::string& parHost, uint16_t parPort );
+		Command& slot_node ( uint16_t parSlot );
+		Command& any_node ( void );
+		Command& moved ( uint16_t parSlot, const std::string& parHost, uint16_t parPort );
+		bool load_slots ( Command& parFrom, const std::string& parFromHost );
+		void refresh_slots ( void );
+
+		//mutex guards nodes and slots only, connecting to a node and
+		//reading the slot map are done without holding it
+
+		std::mutex mutex;
+		std::vector<NodeAddress> seeds;
+		std::map<std::string, std::pair<NodeAddress, std::unique_ptr<Command>>> nodes;
+		std::vector<Command*> slots;
+		//ClusterBatches hold pointers to the nodes, which must stay alive
+		std::atomic<std::size_t> live_batches;
+	};
+
+	//Nodes are never removed, so pointers handed out stay valid for as long
+	//as the ClusterCommand is alive
+	Command& ClusterCommand::LocalData::node (const std::string& parHost, uint16_t parPort) {
+		const std::string name = node_name(parHost, parPort);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it_found = nodes.find(name);
+			if (nodes.end() != it_found)
+				return *it_found->second.second;
+		}
+
+		std::unique_ptr<Command> new_node(new Command(std::string(parHost), parPort));
+		new_node->connect();
+		new_node->wait_for_connect();
+		if (not new_node->is_connected()) {
+			std::ostringstream oss;
+			oss << "Unable to connect to cluster node " << name << ": " << new_node->connection_error();
+			throw std::runtime_error(oss.str());
+		}
+
+		//Another thread might have connected to the same node meanwhile,
+		//in which case new_node is dropped once the lock is released
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& entry = nodes[name];
+		if (not entry.second)
+			entry = std::make_pair(NodeAddress(parHost, parPort), std::move(new_node));
+		return *entry.second;
+	}
+
+	Command& ClusterCommand::LocalData::slot_node (uint16_t parSlot) {
+		assert(parSlot < g_cluster_slot_count);
+		std::lock_guard<std::mutex> lock(mutex);
+		Command* retval = slots[parSlot];
+		if (not retval) {
+			std::ostringstream oss;
+			oss << "No cluster node is serving hash slot " << parSlot;
+			throw std::runtime_error(oss.str());
+		}
+		return *retval;
+	}
+
+	Command& ClusterCommand::LocalData::any_node() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (nodes.empty())
+			throw std::runtime_error("Not connected to any cluster node");
+		return *nodes.begin()->second.second;
+	}
+
+	Command& ClusterCommand::LocalData::moved (uint16_t parSlot, const std::string& parHost, uint16_t parPort) {
+		assert(parSlot < g_cluster_slot_count);
+		Command& retval = node(parHost, parPort);
+		std::lock_guard<std::mutex> lock(mutex);
+		slots[parSlot] = &retval;
+		return retval;
+	}
+
+	//CLUSTER SLOTS replies with an array of
+	//[first slot, last slot, [primary ip, primary port, ...], replicas...]
+	//The new map is built aside and swapped in as a whole.
+	bool ClusterCommand::LocalData::load_slots (Command& parFrom, const std::string& parFromHost) {
+		const Reply reply = parFrom.run("CLUSTER", "SLOTS");
+		if (not reply.is_array() or get_array(reply).empty())
+			return false;
+
+		std::vector<Command*> new_slots(g_cluster_slot_count, nullptr);
+
+		for (const auto& range : get_array(reply)) {
+			const auto& fields = get_array(range);
+			if (fields.size() < 3)
+				continue;
+
+			const auto first_slot = get_integer(fields[0]);
+			const auto last_slot = get_integer(fields[1]);
+			const auto& primary = get_array(fields[2]);
+			assert(primary.size() >= 2);
+			std::string host = get_string(primary[0]);
+			if (host.empty())
+				host = parFromHost;
+			const auto port = static_cast<uint16_t>(get_integer(primary[1]));
+
+			Command& primary_node = node(host, port);
+			for (auto slot = first_slot; slot <= last_slot and slot < g_cluster_slot_count; ++slot) {
+				new_slots[static_cast<std::size_t>(slot)] = &primary_node;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		slots.swap(new_slots);
+		return true;
+	}
+
+	void ClusterCommand::LocalData::refresh_slots() {
+		std::vector<std::pair<Command*, std::string>> known_nodes;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			known_nodes.reserve(nodes.size());
+			for (auto& node : nodes) {
+				known_nodes.emplace_back(node.second.second.get(), node.second.first.first);
+			}
+		}
+
+		for (auto& node : known_nodes) {
+			if (not node.first->is_connected())
+				continue;
+			try {
+				if (load_slots(*node.first, node.second))
+					return;
+			}
+			catch (const std::exception&) {
+			}
+		}
+
+		for (const auto& seed : seeds) {
+			try {
+				if (load_slots(node(seed.first, seed.second), seed.first))
+					return;
+			}
+			catch (const std::exception&) {
+			}
+		}
+		throw std::runtime_error("Unable to read the slot map from any cluster node");
+	}
+
+	ClusterCommand::ClusterCommand (std::vector<NodeAddress>&& parSeeds) :
+		m_local_data(new LocalData(std::move(parSeeds)))
+	{
+		assert(not m_local_data->seeds.empty());
+	}
+
+	ClusterCommand::ClusterCommand (ClusterCommand&&) = default;
+
+	ClusterCommand::~ClusterCommand() noexcept = default;
+
+	void ClusterCommand::connect() {
+		m_local_data->refresh_slots();
+	}
+
+	void ClusterCommand::disconnect() {
+		std::lock_guard<std::mutex> lock(m_local_data->mutex);
+		if (m_local_data->live_batches.load())
+			throw std::logic_error("Can't disconnect from the cluster while ClusterBatch objects made from it are alive");
+		for (auto& node : m_local_data->nodes) {
+			node.second.second->disconnect();
+			node.second.second->wait_for_disconnect();
+		}
+		m_local_data->nodes.clear();
+		std::fill(m_local_data->slots.begin(), m_local_data->slots.end(), nullptr);
+	}
+
+	bool ClusterCommand::is_connected() const {
+		std::lock_guard<std::mutex> lock(m_local_data->mutex);
+		if (m_local_data->nodes.empty())
+			return false;
+		for (const auto& node : m_local_data->nodes) {
+			if (not node.second.second->is_connected())
+				return false;
+		}
+		return true;
+	}
+
+	void ClusterCommand::refresh_slots() {
+		m_local_data->refresh_slots();
+	}
+
+	ClusterBatch ClusterCommand::make_batch() {
+		return ClusterBatch(m_local_data.get());
+	}
+
+	std::size_t ClusterCommand::node_count() const {
+		std::lock_guard<std::mutex> lock(m_local_data->mutex);
+		return m_local_data->nodes.size();
+	}
+
+	Command& ClusterCommand::node_for_slot (uint16_t parSlot) {
+		return m_local_data->slot_node(parSlot);
+	}
+
+	struct ClusterBatch::LocalData {
+		struct NodeBatch {
+			explicit NodeBatch ( Command& parNode ) :
+				node(&parNode),
+				batch(parNode.make_batch()),
+				positions()
+			{
+			}
+
+			Command* node;
+			Batch batch;
+			std::vector<std::size_t> positions;
+		};
+
+		explicit LocalData ( ClusterCommand::LocalData* parCluster ) :
+			cluster(parCluster),
+			commands(),
+			slots(),
+			replies(),
+			node_batches(),
+			argv(),
+			lengths()
+		{
+			assert(cluster);
+		}
+
+		NodeBatch& batch_for ( Command& parNode );
+		Command& node_for ( uint16_t parSlot );
+		void send ( std::size_t parPosition, Command& parNode, bool parAsking );
+		void resolve ( void );
+
+		ClusterCommand::LocalData* cluster;
+		std::vector<StoredCommand> commands;
+		std::vector<uint16_t> slots;
+		std::vector<Reply> replies;
+		std::vector<NodeBatch> node_batches;
+		std::vector<const char*> argv;
+		std::vector<std::size_t> lengths;
+	};
+
+	auto ClusterBatch::LocalData::batch_for (Command& parNode) -> NodeBatch& {
+		for (auto& node_batch : node_batches) {
+			if (node_batch.node == &parNode)
+				return node_batch;
+		}
+		node_batches.emplace_back(parNode);
+		return node_batches.back();
+	}
+
+	Command& ClusterBatch::LocalData::node_for (uint16_t parSlot) {
+		return (g_no_slot == parSlot ? cluster->any_node() : cluster->slot_node(parSlot));
+	}
+
+	void ClusterBatch::LocalData::send (std::size_t parPosition, Command& parNode, bool parAsking) {
+		assert(parPosition < commands.size());
+		NodeBatch& node_batch = batch_for(parNode);
+		if (parAsking) {
+			const StoredCommand& command = commands[parPosition];
+			argv.resize(command.size());
+			lengths.resize(command.size());
+			for (std::size_t z = 0; z < command.size(); ++z) {
+				argv[z] = command[z].data();
+				lengths[z] = command[z].size();
+			}
+			node_batch.batch.run_asking(static_cast<int>(argv.size()), argv.data(), lengths.data());
+			node_batch.positions.push_back(g_dropped_reply);
+		}
+		else {
+			commands[parPosition].run(node_batch.batch, argv, lengths);
+		}
+		node_batch.positions.push_back(parPosition);
+	}
+
+	void ClusterBatch::LocalData::resolve() {
+		bool slot_map_changed = false;
+
+		for (int round = 0; not node_batches.empty(); ++round) {
+			std::vector<NodeBatch> finished;
+			finished.swap(node_batches);
+
+			std::vector<std::pair<std::size_t, Redirection>> redirections;
+			for (auto& node_batch : finished) {
+				auto it_position = node_batch.positions.begin();
+				for (auto& reply : node_batch.batch.replies_nonconst()) {
+					assert(node_batch.positions.end() != it_position);
+					const std::size_t position = *it_position;
+					++it_position;
+					if (g_dropped_reply == position)
+						continue;
+
+					//Keep the error as the reply in case we have to give up
+					Redirection redirection = parse_redirection(reply);
+					//"MOVED 3999 :6381" means the same host as the sender
+					if (redirection.host.empty())
+						redirection.host = node_batch.node->address();
+					if (Redirect_None != redirection.type and round < g_max_redirections)
+						redirections.emplace_back(position, std::move(redirection));
+					replies[position] = std::move(reply);
+				}
+			}
+
+			bool slept = false;
+			for (auto& redirection : redirections) {
+				const std::size_t position = redirection.first;
+				const Redirection& target = redirection.second;
+				switch (target.type) {
+				case Redirect_Moved:
+					send(position, cluster->moved(target.slot, target.host, target.port), false);
+					slot_map_changed = true;
+					break;
+				case Redirect_Ask:
+					send(position, cluster->node(target.host, target.port), true);
+					break;
+				case Redirect_TryAgain:
+					//Slot is being migrated, give the cluster a moment
+					if (not slept) {
+						std::this_thread::sleep_for(std::chrono::milliseconds(10 * (round + 1)));
+						slept = true;
+					}
+					send(position, node_for(slots[position]), false);
+					break;
+				case Redirect_None:
+					assert(false); //not reached
+				}
+			}
+		}
+
+		if (slot_map_changed)
+			cluster->refresh_slots();
+	}
+
+	ClusterBatch::ClusterBatch (ClusterCommand::LocalData* parCluster) :
+		m_local_data(new LocalData(parCluster))
+	{
+		++parCluster->live_batches;
+	}
+
+	ClusterBatch::ClusterBatch (ClusterBatch&&) = default;
+
+	ClusterBatch::~ClusterBatch() noexcept {
+		if (m_local_data) {
+			this->reset();
+			--m_local_data->cluster->live_batches;
+		}
+	}
+
+	ClusterBatch& ClusterBatch::run (StoredCommand&& parCommand) {
+		assert(not parCommand.empty());
+		assert(m_local_data);
+
+		const uint16_t slot = command_slot(parCommand, m_local_data->argv, m_local_data->lengths);
+		const std::size_t position = m_local_data->commands.size();
+		m_local_data->commands.push_back(std::move(parCommand));
+		m_local_data->slots.push_back(slot);
+		m_local_data->replies.emplace_back();
+
+		m_local_data->send(position, m_local_data->node_for(slot), false);
+		return *this;
+	}
+
+	const std::vector<Reply>& ClusterBatch::replies() {
+		return replies_nonconst();
+	}
+
+	std::vector<Reply>& ClusterBatch::replies_nonconst() {
+		m_local_data->resolve();
+		return m_local_data->replies;
+	}
+
+	void ClusterBatch::throw_if_failed() {
+		throw_if_reply_errors(replies(), m_local_data->replies.size());
+	}
+
+	void ClusterBatch::reset() noexcept {
+		assert(m_local_data);
+		try {
+			m_local_data->resolve();
+		}
+		catch (...) {
+		}
+		m_local_data->node_batches.clear();
+		m_local_data->commands.clear();
+		m_local_data->slots.clear();
+		m_local_data->replies.clear();
+	}
+} //namespace redis
@@ -19,28 +19,47 @@
 #include "script_manager.hpp"
 #include "async_connection.hpp"
 #include "thread_context.hpp"
+#include "single_flight.hpp"
+#include "auto_batcher.hpp"
+#include "loop_stats.hpp"
+#include "command_table.hpp"
 #include <hiredis/hiredis.h>
 #include <ciso646>
 #include <cassert>
 #include <algorithm>
+#include <atomic>
 #include <stdexcept>
 
 //See docs directory for info about hiredis/libev with multithreading
 
 namespace redis {
 	namespace {
+		//A blocking command would hold up every other caller queued in the
+		//same batch
+		bool can_share_batch (boost::string_view parName) {
+			const CommandInfo* const info = find_command_info(parName);
+			return not info or not (info->flags & (CommandFlag_Blocking | CommandFlag_PubSub));
+		}
 	} //unnamed namespace
 
 	struct Command::LocalData {
 		explicit LocalData (Command* parCommand, std::string&& parAddress, uint16_t parPort) :
 			async_connection(std::move(parAddress), parPort),
-			lua_scripts(parCommand)
+			lua_scripts(parCommand),
+			single_flight(),
+			auto_batcher(AutoBatchOptions()),
+			single_flight_enabled(false),
+			auto_batching_enabled(false)
 		{
 		}
 
 		AsyncConnection async_connection;
 		ScriptManager lua_scripts;
 		ThreadContext thread_context;
+		SingleFlight single_flight;
+		AutoBatcher auto_batcher;
+		std::atomic<bool> single_flight_enabled;
+		std::atomic<bool> auto_batching_enabled;
 	};
 
 	Command::Command (std::string&& parAddress, uint16_t parPort) :
@@ -67,6 +86,8 @@ namespace redis {
 
 	void Command::wait_for_connect() {
 		m_local_data->async_connection.wait_for_connect();
+		if (is_connected() and m_local_data->lua_scripts.script_count())
+			m_local_data->lua_scripts.reload();
 	}
 
 	void Command::disconnect() {
@@ -85,13 +106,113 @@ namespace redis {
 		return m_local_data->async_connection.connection_error();
 	}
 
+	const std::string& Command::address() const {
+		return m_local_data->async_connection.address();
+	}
+
+	uint16_t Command::port() const {
+		return m_local_data->async_connection.port();
+	}
+
+	LatencyEstimate Command::latency() const {
+		const LatencyStats& stats = m_local_data->thread_context.latency;
+		LatencyEstimate retval;
+		retval.mean = std::chrono::nanoseconds(stats.mean_ns.load(std::memory_order_relaxed));
+		retval.deviation = std::chrono::nanoseconds(stats.deviation_ns.load(std::memory_order_relaxed));
+		retval.samples = stats.samples.load(std::memory_order_relaxed);
+		return retval;
+	}
+
 	Batch Command::make_batch() {
 		assert(is_connected());
 		return Batch(&m_local_data->async_connection, m_local_data->thread_context);
 	}
 
+	void Command::set_single_flight (bool parEnable) {
+		m_local_data->single_flight_enabled = parEnable;
+	}
+
+	uint64_t Command::coalesced_reads() const {
+		return m_local_data->single_flight.coalesced_count();
+	}
+
+	void Command::set_auto_batching (const AutoBatchOptions& parOptions) {
+		m_local_data->auto_batcher.set_options(parOptions);
+		m_local_data->auto_batching_enabled = true;
+	}
+
+	void Command::disable_auto_batching() {
+		m_local_data->auto_batching_enabled = false;
+	}
+
+	uint64_t Command::auto_batch_flushes() const {
+		return m_local_data->auto_batcher.flush_count();
+	}
+
+	void Command::set_metrics (bool parEnable) {
+		m_local_data->thread_context.metrics.set_enabled(parEnable);
+		m_local_data->async_connection.loop_stats().set_enabled(parEnable);
+	}
+
+	MetricsSnapshot Command::metrics() const {
+		const AsyncConnection& connection = m_local_data->async_connection;
+		MetricsSnapshot retval = m_local_data->thread_context.metrics.snapshot();
+		retval.in_flight = m_local_data->thread_context.pending_futures.load(std::memory_order_relaxed);
+		retval.connections = connection.connection_count();
+		retval.connections_lost = connection.connection_lost_count();
+		retval.event_loop = connection.loop_stats().snapshot();
+		return retval;
+	}
+
+	void Command::set_observer (CommandObserver* parObserver) {
+#if defined(INCREDIS_WITH_TRACING)
+		m_local_data->thread_context.observer.store(parObserver, std::memory_order_release);
+#else
+		if (parObserver)
+			throw std::logic_error("incredis was built without INCREDIS_WITH_TRACING");
+#endif
+	}
+
+	void Command::set_key_filter (KeyFilter* parFilter) {
+		m_local_data->thread_context.key_filter.store(parFilter, std::memory_order_release);
+	}
+
+	bool Command::shared_path_enabled() const {
+		return m_local_data->single_flight_enabled.load(std::memory_order_relaxed) or m_local_data->auto_batching_enabled.load(std::memory_order_relaxed);
+	}
+
+	Reply Command::run_shared (StoredCommand&& parCommand) {
+		auto send = [this](const StoredCommand& parToSend) {
+			if (m_local_data->auto_batching_enabled.load(std::memory_order_relaxed) and can_share_batch(parToSend.name()))
+				return m_local_data->auto_batcher.run(parToSend, *this);
+
+			auto batch = make_batch();
+			parToSend.run(batch);
+			batch.throw_if_failed();
+			return std::move(batch.replies_nonconst().front());
+		};
+
+		if (m_local_data->single_flight_enabled.load(std::memory_order_relaxed) and is_read_only_command(parCommand.name()))
+			return m_local_data->single_flight.run(std::move(parCommand), send);
+		else
+			return send(parCommand);
+	}
+
 	Script Command::make_script (const boost::string_view &parScript) {
-		auto sha1 = m_local_data->lua_scripts.submit_lua_script(parScript);
-		return Script(sha1, m_local_data->lua_scripts);
+		const auto script = m_local_data->lua_scripts.submit_lua_script(parScript);
+		return Script(script, m_local_data->lua_scripts);
+	}
+
+	void Command::forget_loaded_scripts() {
+		m_local_data->lua_scripts.mark_unloaded();
+	}
+
+	std::vector<Script> Command::preload_scripts (const std::vector<boost::string_view>& parScripts) {
+		std::vector<Script> retval;
+		retval.reserve(parScripts.size());
+		for (const auto& script : m_local_data->lua_scripts.preload(parScripts)) {
+			retval.emplace_back(script, m_local_data->lua_scripts);
+		}
+		return retval;
 	}
 } //namespace redis
@@ -0,0 +1,273 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "command_table.hpp"
+#include "duckhandy/lengthof.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <string>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		const CommandInfo g_command_table[] = {
+			{"APPEND", CommandFlag_Write, 1, 1, 1},
+			{"ASKING", CommandFlag_None, 0, 0, 0},
+			{"BITCOUNT", CommandFlag_ReadOnly, 1, 1, 1},
+			{"BITPOS", CommandFlag_ReadOnly, 1, 1, 1},
+			{"BLMOVE", CommandFlag_Write | CommandFlag_Blocking, 1, 2, 1},
+			{"BLMPOP", CommandFlag_Write | CommandFlag_Blocking | CommandFlag_KeyCount, 2, 0, 1},
+			{"BLPOP", CommandFlag_Write | CommandFlag_Blocking, 1, -2, 1},
+			{"BRPOP", CommandFlag_Write | CommandFlag_Blocking, 1, -2, 1},
+			{"BRPOPLPUSH", CommandFlag_Write | CommandFlag_Blocking, 1, 2, 1},
+			{"BZMPOP", CommandFlag_Write | CommandFlag_Blocking | CommandFlag_KeyCount, 2, 0, 1},
+			{"BZPOPMAX", CommandFlag_Write | CommandFlag_Blocking, 1, -2, 1},
+			{"BZPOPMIN", CommandFlag_Write | CommandFlag_Blocking, 1, -2, 1},
+			{"CLIENT", CommandFlag_Admin, 0, 0, 0},
+			{"CLUSTER", CommandFlag_Admin, 0, 0, 0},
+			{"CONFIG", CommandFlag_Admin, 0, 0, 0},
+			{"DBSIZE", CommandFlag_ReadOnly, 0, 0, 0},
+			{"DECR", CommandFlag_Write, 1, 1, 1},
+			{"DECRBY", CommandFlag_Write, 1, 1, 1},
+			{"DEL", CommandFlag_Write, 1, -1, 1},
+			{"DISCARD", CommandFlag_None, 0, 0, 0},
+			{"DUMP", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ECHO", CommandFlag_None, 0, 0, 0},
+			{"EVAL", CommandFlag_Write | CommandFlag_KeyCount, 2, 0, 1},
+			{"EVALSHA", CommandFlag_Write | CommandFlag_KeyCount, 2, 0, 1},
+			{"EVALSHA_RO", CommandFlag_ReadOnly | CommandFlag_KeyCount, 2, 0, 1},
+			{"EVAL_RO", CommandFlag_ReadOnly | CommandFlag_KeyCount, 2, 0, 1},
+			{"EXEC", CommandFlag_None, 0, 0, 0},
+			{"EXISTS", CommandFlag_ReadOnly, 1, -1, 1},
+			{"EXPIRE", CommandFlag_Write, 1, 1, 1},
+			{"EXPIREAT", CommandFlag_Write, 1, 1, 1},
+			{"FLUSHALL", CommandFlag_Write | CommandFlag_Admin, 0, 0, 0},
+			{"FLUSHDB", CommandFlag_Write | CommandFlag_Admin, 0, 0, 0},
+			{"GEODIST", CommandFlag_ReadOnly, 1, 1, 1},
+			{"GEOHASH", CommandFlag_ReadOnly, 1, 1, 1},
+			{"GEOPOS", CommandFlag_ReadOnly, 1, 1, 1},
+			{"GEOSEARCH", CommandFlag_ReadOnly, 1, 1, 1},
+			{"GET", CommandFlag_ReadOnly, 1, 1, 1},
+			{"GETBIT", CommandFlag_ReadOnly, 1, 1, 1},
+			{"GETDEL", CommandFlag_Write, 1, 1, 1},
+			{"GETEX", CommandFlag_Write, 1, 1, 1},
+			{"GETRANGE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"HDEL", CommandFlag_Write, 1, 1, 1},
+			{"HEXISTS", CommandFlag_ReadOnly, 1, 1, 1},
+			{"HGET", CommandFlag_ReadOnly, 1, 1, 1},
+			{"HGETALL", CommandFlag_ReadOnly, 1, 1, 1},
+			{"HINCRBY", CommandFlag_Write, 1, 1, 1},
+			{"HINCRBYFLOAT", CommandFlag_Write, 1, 1, 1},
+			{"HKEYS", CommandFlag_ReadOnly, 1, 1, 1},
+			{"HLEN", CommandFlag_ReadOnly, 1, 1, 1},
+			{"HMGET", CommandFlag_ReadOnly, 1, 1, 1},
+			{"HMSET", CommandFlag_Write, 1, 1, 1},
+			{"HRANDFIELD", CommandFlag_ReadOnly, 1, 1, 1},
+			{"HSCAN", CommandFlag_ReadOnly, 1, 1, 1},
+			{"HSET", CommandFlag_Write, 1, 1, 1},
+			{"HSETNX", CommandFlag_Write, 1, 1, 1},
+			{"HSTRLEN", CommandFlag_ReadOnly, 1, 1, 1},
+			{"HVALS", CommandFlag_ReadOnly, 1, 1, 1},
+			{"INCR", CommandFlag_Write, 1, 1, 1},
+			{"INCRBY", CommandFlag_Write, 1, 1, 1},
+			{"INCRBYFLOAT", CommandFlag_Write, 1, 1, 1},
+			{"INFO", CommandFlag_Admin, 0, 0, 0},
+			{"KEYS", CommandFlag_ReadOnly, 0, 0, 0},
+			{"LINDEX", CommandFlag_ReadOnly, 1, 1, 1},
+			{"LLEN", CommandFlag_ReadOnly, 1, 1, 1},
+			{"LPOP", CommandFlag_Write, 1, 1, 1},
+			{"LPOS", CommandFlag_ReadOnly, 1, 1, 1},
+			{"LPUSH", CommandFlag_Write, 1, 1, 1},
+			{"LRANGE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"LREM", CommandFlag_Write, 1, 1, 1},
+			{"LSET", CommandFlag_Write, 1, 1, 1},
+			{"LTRIM", CommandFlag_Write, 1, 1, 1},
+			{"MEMORY", CommandFlag_ReadOnly, 0, 0, 0},
+			{"MGET", CommandFlag_ReadOnly, 1, -1, 1},
+			{"MSET", CommandFlag_Write, 1, -1, 2},
+			{"MULTI", CommandFlag_None, 0, 0, 0},
+			{"OBJECT", CommandFlag_ReadOnly, 0, 0, 0},
+			{"PERSIST", CommandFlag_Write, 1, 1, 1},
+			{"PEXPIRE", CommandFlag_Write, 1, 1, 1},
+			{"PING", CommandFlag_None, 0, 0, 0},
+			{"PSUBSCRIBE", CommandFlag_PubSub, 0, 0, 0},
+			{"PTTL", CommandFlag_ReadOnly, 1, 1, 1},
+			{"PUBLISH", CommandFlag_PubSub, 0, 0, 0},
+			{"PUNSUBSCRIBE", CommandFlag_PubSub, 0, 0, 0},
+			{"RANDOMKEY", CommandFlag_ReadOnly, 0, 0, 0},
+			{"RENAME", CommandFlag_Write, 1, 2, 1},
+			{"RPOP", CommandFlag_Write, 1, 1, 1},
+			{"RPUSH", CommandFlag_Write, 1, 1, 1},
+			{"SADD", CommandFlag_Write, 1, 1, 1},
+			{"SCAN", CommandFlag_ReadOnly, 0, 0, 0},
+			{"SCARD", CommandFlag_ReadOnly, 1, 1, 1},
+			{"SCRIPT", CommandFlag_Admin, 0, 0, 0},
+			{"SDIFF", CommandFlag_ReadOnly, 1, -1, 1},
+			{"SDIFFSTORE", CommandFlag_Write, 1, -1, 1},
+			{"SELECT", CommandFlag_None, 0, 0, 0},
+			{"SET", CommandFlag_Write, 1, 1, 1},
+			{"SETEX", CommandFlag_Write, 1, 1, 1},
+			{"SETNX", CommandFlag_Write, 1, 1, 1},
+			{"SINTER", CommandFlag_ReadOnly, 1, -1, 1},
+			{"SINTERCARD", CommandFlag_ReadOnly | CommandFlag_KeyCount, 1, 0, 1},
+			{"SINTERSTORE", CommandFlag_Write, 1, -1, 1},
+			{"SISMEMBER", CommandFlag_ReadOnly, 1, 1, 1},
+			{"SMEMBERS", CommandFlag_ReadOnly, 1, 1, 1},
+			{"SMISMEMBER", CommandFlag_ReadOnly, 1, 1, 1},
+			{"SMOVE", CommandFlag_Write, 1, 2, 1},
+			{"SPOP", CommandFlag_Write, 1, 1, 1},
+			{"SRANDMEMBER", CommandFlag_ReadOnly, 1, 1, 1},
+			{"SREM", CommandFlag_Write, 1, 1, 1},
+			{"SSCAN", CommandFlag_ReadOnly, 1, 1, 1},
+			{"STRLEN", CommandFlag_ReadOnly, 1, 1, 1},
+			{"SUBSCRIBE", CommandFlag_PubSub, 0, 0, 0},
+			{"SUNION", CommandFlag_ReadOnly, 1, -1, 1},
+			{"SUNIONSTORE", CommandFlag_Write, 1, -1, 1},
+			{"TOUCH", CommandFlag_ReadOnly, 1, -1, 1},
+			{"TTL", CommandFlag_ReadOnly, 1, 1, 1},
+			{"TYPE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"UNLINK", CommandFlag_Write, 1, -1, 1},
+			{"UNSUBSCRIBE", CommandFlag_PubSub, 0, 0, 0},
+			{"UNWATCH", CommandFlag_None, 0, 0, 0},
+			{"WAIT", CommandFlag_Blocking | CommandFlag_ConnectionBound, 0, 0, 0},
+			{"WAITAOF", CommandFlag_Blocking | CommandFlag_ConnectionBound, 0, 0, 0},
+			{"WATCH", CommandFlag_None, 1, -1, 1},
+			{"XACK", CommandFlag_Write, 1, 1, 1},
+			{"XADD", CommandFlag_Write, 1, 1, 1},
+			{"XAUTOCLAIM", CommandFlag_Write, 1, 1, 1},
+			{"XCLAIM", CommandFlag_Write, 1, 1, 1},
+			{"XDEL", CommandFlag_Write, 1, 1, 1},
+			{"XGROUP", CommandFlag_Write, 0, 0, 0},
+			{"XINFO", CommandFlag_ReadOnly, 0, 0, 0},
+			{"XLEN", CommandFlag_ReadOnly, 1, 1, 1},
+			{"XPENDING", CommandFlag_ReadOnly, 1, 1, 1},
+			{"XRANGE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"XREAD", CommandFlag_ReadOnly | CommandFlag_Blocking, 0, 0, 0},
+			{"XREADGROUP", CommandFlag_Write | CommandFlag_Blocking, 0, 0, 0},
+			{"XREVRANGE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"XTRIM", CommandFlag_Write, 1, 1, 1},
+			{"ZADD", CommandFlag_Write, 1, 1, 1},
+			{"ZCARD", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZCOUNT", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZINCRBY", CommandFlag_Write, 1, 1, 1},
+			{"ZLEXCOUNT", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZMSCORE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZPOPMAX", CommandFlag_Write, 1, 1, 1},
+			{"ZPOPMIN", CommandFlag_Write, 1, 1, 1},
+			{"ZRANDMEMBER", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZRANGE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZRANGEBYLEX", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZRANGEBYSCORE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZRANK", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZREM", CommandFlag_Write, 1, 1, 1},
+			{"ZREMRANGEBYRANK", CommandFlag_Write, 1, 1, 1},
+			{"ZREMRANGEBYSCORE", CommandFlag_Write, 1, 1, 1},
+			{"ZREVRANGE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZREVRANGEBYSCORE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZREVRANK", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZSCAN", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZSCORE", CommandFlag_ReadOnly, 1, 1, 1},
+			{"ZUNIONSTORE", CommandFlag_Write, 1, 1, 1},
+		};
+
+		inline char to_upper (char parChar) {
+			return (parChar >= 'a' and parChar <= 'z' ? static_cast<char>(parChar - 'a' + 'A') : parChar);
+		}
+
+		//Compares a table entry (always upper case) with a name in any case
+		int compare_name (const char* parEntry, boost::string_view parName) {
+			std::size_t z = 0;
+			for (; parEntry[z] and z < parName.size(); ++z) {
+				const auto a = static_cast<unsigned char>(parEntry[z]);
+				const auto b = static_cast<unsigned char>(to_upper(parName[z]));
+				if (a != b)
+					return (a < b ? -1 : 1);
+			}
+			if (not parEntry[z] and z == parName.size())
+				return 0;
+			return (parEntry[z] ? 1 : -1);
+		}
+	} //unnamed namespace
+
+	const CommandInfo* find_command_info (boost::string_view parName) {
+		const CommandInfo* const table_end = g_command_table + lengthof(g_command_table);
+		const CommandInfo* found = std::lower_bound(g_command_table, table_end, parName, [](const CommandInfo& parInfo, boost::string_view parValue) {
+			return compare_name(parInfo.name, parValue) < 0;
+		});
+		if (table_end != found and 0 == compare_name(found->name, parName))
+			return found;
+		else
+			return nullptr;
+	}
+
+	std::size_t command_table_size() {
+		return lengthof(g_command_table);
+	}
+
+	const CommandInfo& command_info (std::size_t parIndex) {
+		assert(parIndex < lengthof(g_command_table));
+		return g_command_table[parIndex];
+	}
+
+	std::size_t command_index (boost::string_view parName) {
+		const CommandInfo* info = find_command_info(parName);
+		return (info ? static_cast<std::size_t>(info - g_command_table) : lengthof(g_command_table));
+	}
+
+	bool is_read_only_command (boost::string_view parName) {
+		const CommandInfo* info = find_command_info(parName);
+		return info and (info->flags & CommandFlag_ReadOnly) and not (info->flags & CommandFlag_Write);
+	}
+
+	bool needs_own_connection (boost::string_view parName) {
+		const CommandInfo* info = find_command_info(parName);
+		return info and (info->flags & CommandFlag_Blocking) and not (info->flags & CommandFlag_ConnectionBound);
+	}
+
+	void for_each_key (int parArgc, const char* const* parArgv, const std::size_t* parLengths, const std::function<void(boost::string_view)>& parCallback) {
+		assert(parArgc >= 1);
+		const CommandInfo* info = find_command_info(boost::string_view(parArgv[0], parLengths[0]));
+		if (not info) {
+			for (int z = 1; z < parArgc; ++z) {
+				parCallback(boost::string_view(parArgv[z], parLengths[z]));
+			}
+			return;
+		}
+		if (not info->first_key or info->first_key >= parArgc)
+			return;
+
+		int first = info->first_key;
+		int last = info->last_key;
+		if (info->flags & CommandFlag_KeyCount) {
+			const std::string count_str(parArgv[first], parLengths[first]);
+			const long count = std::strtol(count_str.c_str(), nullptr, 10);
+			if (count <= 0)
+				return;
+			last = std::min(first + static_cast<int>(count), parArgc - 1);
+			++first;
+		}
+		else if (last < 0) {
+			last += parArgc;
+		}
+
+		assert(info->key_step > 0);
+		for (int z = first; z <= last and z < parArgc; z += info->key_step) {
+			parCallback(boost::string_view(parArgv[z], parLengths[z]));
+		}
+	}
+} //namespace redis
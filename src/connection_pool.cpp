@@ -0,0 +1,309 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "incredis/connection_pool.hpp"
+#include "incredis/command.hpp"
+#include "incredis/stored_command.hpp"
+#include "incredis/int_conv.hpp"
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <sstream>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		//How much longer than the server side timeout a reply may take
+		const std::chrono::milliseconds g_reply_grace(2000);
+	} //unnamed namespace
+
+	struct ConnectionPool::Slot {
+		Slot ( void ) :
+			command(),
+			client_id(0),
+			leased(true)
+		{
+		}
+
+		std::unique_ptr<Command> command;
+		long long client_id;
+		bool leased;
+	};
+
+	struct ConnectionPool::LocalData {
+		LocalData ( std::string&& parAddress, uint16_t parPort, uint32_t parDb, std::size_t parMaxSize ) :
+			address(std::move(parAddress)),
+			slots(),
+			mutex(),
+			slot_freed(),
+			acquire_timeout(std::chrono::seconds(5)),
+			reply_timeout(std::chrono::seconds(60)),
+			max_size(parMaxSize ? parMaxSize : 1),
+			key_filter(nullptr),
+			db(parDb),
+			port(parPort)
+		{
+		}
+
+		void open ( Slot& parSlot );
+
+		std::string address;
+		std::list<Slot> slots;
+		mutable std::mutex mutex;
+		std::condition_variable slot_freed;
+		std::chrono::milliseconds acquire_timeout;
+		std::chrono::milliseconds reply_timeout;
+		std::size_t max_size;
+		KeyFilter* key_filter;
+		uint32_t db;
+		uint16_t port;
+	};
+
+	//The slot is leased while it's being opened, but other threads still
+	//walk the slot list, so it's only filled in under the lock at the end
+	void ConnectionPool::LocalData::open (Slot& parSlot) {
+		std::unique_ptr<Command> command(new Command(std::string(address), port));
+		command->connect();
+		command->wait_for_connect();
+		if (not command->is_connected()) {
+			std::ostringstream oss;
+			oss << "Unable to open a connection for blocking commands: " << command->connection_error();
+			throw std::runtime_error(oss.str());
+		}
+
+		long long client_id = 0;
+		{
+			auto batch = command->make_batch();
+			if (db)
+				batch.run("SELECT", int_to_ary_dec(db).to<boost::string_view>());
+			batch.run("CLIENT", "ID");
+			batch.throw_if_failed();
+			for (const auto& reply : batch.replies()) {
+				if (reply.is_integer())
+					client_id = get_integer(reply);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		command->set_key_filter(key_filter);
+		parSlot.command = std::move(command);
+		parSlot.client_id = client_id;
+	}
+
+	ConnectionPool::Lease::Lease (ConnectionPool* parPool, Slot* parSlot) :
+		m_pool(parPool),
+		m_slot(parSlot),
+		m_discard(false)
+	{
+	}
+
+	ConnectionPool::Lease::Lease (Lease&& parOther) :
+		m_pool(parOther.m_pool),
+		m_slot(parOther.m_slot),
+		m_discard(parOther.m_discard)
+	{
+		parOther.m_slot = nullptr;
+	}
+
+	ConnectionPool::Lease::~Lease() noexcept {
+		if (m_slot)
+			m_pool->release(m_slot, m_discard);
+	}
+
+	Command& ConnectionPool::Lease::command() {
+		assert(m_slot);
+		return *m_slot->command;
+	}
+
+	long long ConnectionPool::Lease::client_id() const {
+		assert(m_slot);
+		return m_slot->client_id;
+	}
+
+	void ConnectionPool::Lease::discard() {
+		m_discard = true;
+	}
+
+	ConnectionPool::ConnectionPool (std::string&& parAddress, uint16_t parPort, uint32_t parDb, std::size_t parMaxSize) :
+		m_local_data(new LocalData(std::move(parAddress), parPort, parDb, parMaxSize))
+	{
+	}
+
+	ConnectionPool::ConnectionPool (std::string&& parSocket, uint32_t parDb, std::size_t parMaxSize) :
+		ConnectionPool(std::move(parSocket), 0, parDb, parMaxSize)
+	{
+	}
+
+	ConnectionPool::~ConnectionPool() noexcept {
+		assert(0 == size() - idle_count());
+	}
+
+	auto ConnectionPool::acquire (std::chrono::milliseconds parTimeout) -> Lease {
+		auto& local = *m_local_data;
+		const auto deadline = std::chrono::steady_clock::now() + parTimeout;
+		std::unique_lock<std::mutex> lock(local.mutex);
+		while (true) {
+			for (auto it_slot = local.slots.begin(); it_slot != local.slots.end(); ) {
+				if (it_slot->leased) {
+					++it_slot;
+				}
+				else if (not it_slot->command->is_connected()) {
+					it_slot = local.slots.erase(it_slot);
+				}
+				else {
+					it_slot->leased = true;
+					return Lease(this, &*it_slot);
+				}
+			}
+
+			if (local.slots.size() < local.max_size) {
+				//Connect without holding the lock, the new slot is already
+				//marked as leased so nobody else will touch it
+				local.slots.emplace_back();
+				Slot& slot = local.slots.back();
+				lock.unlock();
+				try {
+					local.open(slot);
+				}
+				catch (...) {
+					release(&slot, true);
+					throw;
+				}
+				return Lease(this, &slot);
+			}
+
+			if (std::cv_status::timeout == local.slot_freed.wait_until(lock, deadline))
+				throw std::runtime_error("No connection available for blocking commands");
+		}
+	}
+
+	auto ConnectionPool::acquire() -> Lease {
+		std::chrono::milliseconds timeout;
+		{
+			std::lock_guard<std::mutex> lock(m_local_data->mutex);
+			timeout = m_local_data->acquire_timeout;
+		}
+		return acquire(timeout);
+	}
+
+	void ConnectionPool::release (Slot* parSlot, bool parDiscard) {
+		auto& local = *m_local_data;
+		std::unique_ptr<Command> closing;
+		{
+			std::lock_guard<std::mutex> lock(local.mutex);
+			if (parDiscard) {
+				auto it_slot = local.slots.begin();
+				while (&*it_slot != parSlot) {
+					++it_slot;
+				}
+				closing = std::move(it_slot->command);
+				local.slots.erase(it_slot);
+			}
+			else {
+				parSlot->leased = false;
+			}
+		}
+		local.slot_freed.notify_one();
+	}
+
+	Reply ConnectionPool::run (const StoredCommand& parCommand, std::chrono::milliseconds parServerTimeout) {
+		Lease lease = acquire();
+		auto batch = lease.command().make_batch();
+		parCommand.run(batch);
+
+		if (parServerTimeout.count() and not batch.wait_for_replies(parServerTimeout + g_reply_grace)) {
+			//The connection is closed before the batch goes away, so the
+			//pending reply gets completed and the batch can be destroyed
+			lease.discard();
+			lease.command().disconnect();
+			lease.command().wait_for_disconnect();
+			throw std::runtime_error("Timed out waiting for the reply to a blocking command");
+		}
+		batch.throw_if_failed();
+		return std::move(batch.replies_nonconst().front());
+	}
+
+	Reply ConnectionPool::run (const StoredCommand& parCommand) {
+		std::chrono::milliseconds timeout;
+		{
+			std::lock_guard<std::mutex> lock(m_local_data->mutex);
+			timeout = m_local_data->reply_timeout;
+		}
+		return run(parCommand, timeout);
+	}
+
+	void ConnectionPool::unblock_all (Command& parVia) {
+		std::vector<long long> client_ids;
+		{
+			std::lock_guard<std::mutex> lock(m_local_data->mutex);
+			for (const auto& slot : m_local_data->slots) {
+				if (slot.leased and slot.client_id)
+					client_ids.push_back(slot.client_id);
+			}
+		}
+		if (client_ids.empty())
+			return;
+
+		auto batch = parVia.make_batch();
+		for (auto client_id : client_ids) {
+			batch.run("CLIENT", "UNBLOCK", int_to_ary_dec(client_id).to<boost::string_view>());
+		}
+		batch.throw_if_failed();
+	}
+
+	std::size_t ConnectionPool::size() const {
+		std::lock_guard<std::mutex> lock(m_local_data->mutex);
+		return m_local_data->slots.size();
+	}
+
+	std::size_t ConnectionPool::idle_count() const {
+		std::lock_guard<std::mutex> lock(m_local_data->mutex);
+		std::size_t retval = 0;
+		for (const auto& slot : m_local_data->slots) {
+			if (not slot.leased)
+				++retval;
+		}
+		return retval;
+	}
+
+	std::size_t ConnectionPool::max_size() const {
+		return m_local_data->max_size;
+	}
+
+	void ConnectionPool::set_acquire_timeout (std::chrono::milliseconds parTimeout) {
+		std::lock_guard<std::mutex> lock(m_local_data->mutex);
+		m_local_data->acquire_timeout = parTimeout;
+	}
+
+	void ConnectionPool::set_reply_timeout (std::chrono::milliseconds parTimeout) {
+		std::lock_guard<std::mutex> lock(m_local_data->mutex);
+		m_local_data->reply_timeout = parTimeout;
+	}
+
+	void ConnectionPool::set_key_filter (KeyFilter* parFilter) {
+		std::lock_guard<std::mutex> lock(m_local_data->mutex);
+		m_local_data->key_filter = parFilter;
+		for (auto& slot : m_local_data->slots) {
+			if (slot.command)
+				slot.command->set_key_filter(parFilter);
+		}
+	}
+} //namespace redis
@@ -0,0 +1,200 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glob_pattern.hpp"
+#include <cassert>
+#include <ciso646>
+#include <cstring>
+#include <algorithm>
+
+namespace redis {
+	namespace {
+		void set_class_bit (std::array<uint64_t, 4>& parClass, uint8_t parChar) {
+			parClass[parChar >> 6] |= (uint64_t(1) << (parChar & 63));
+		}
+
+		bool is_glob_special (char parChar) {
+			return '*' == parChar or '?' == parChar or '[' == parChar or '\\' == parChar;
+		}
+	} //unnamed namespace
+
+	//Follows the semantics of stringmatchlen() in Redis' util.c
+	GlobPattern::GlobPattern (boost::string_view parPattern) :
+		m_pattern(parPattern),
+		m_prefix(),
+		m_tokens(),
+		m_classes(),
+		m_trailing_star_only(false)
+	{
+		const char* it = m_pattern.data();
+		const char* const end = m_pattern.data() + m_pattern.size();
+		bool in_prefix = true;
+
+		while (it != end) {
+			Token token;
+			token.literal = 0;
+			token.class_index = 0;
+
+			switch (*it) {
+			case '*':
+				token.type = Token_Star;
+				++it;
+				while (it != end and '*' == *it)
+					++it;
+				break;
+
+			case '?':
+				token.type = Token_AnyChar;
+				++it;
+				break;
+
+			case '[':
+				{
+					++it;
+					CharClass char_class = {{0, 0, 0, 0}};
+					const bool negate = (it != end and '^' == *it);
+					if (negate)
+						++it;
+					//An unterminated class takes all the remaining characters
+					while (it != end and ']' != *it) {
+						if ('\\' == *it and end - it >= 2) {
+							++it;
+							set_class_bit(char_class, static_cast<uint8_t>(*it));
+						}
+						else if (end - it >= 3 and '-' == it[1]) {
+							uint8_t start = static_cast<uint8_t>(it[0]);
+							uint8_t stop = static_cast<uint8_t>(it[2]);
+							if (start > stop)
+								std::swap(start, stop);
+							for (unsigned int c = start; c <= stop; ++c)
+								set_class_bit(char_class, static_cast<uint8_t>(c));
+							it += 2;
+						}
+						else {
+							set_class_bit(char_class, static_cast<uint8_t>(*it));
+						}
+						++it;
+					}
+					if (it != end)
+						++it; //skip ']'
+					if (negate) {
+						for (auto& part : char_class)
+							part = ~part;
+					}
+					token.type = Token_Class;
+					token.class_index = static_cast<uint16_t>(m_classes.size());
+					m_classes.push_back(char_class);
+				}
+				break;
+
+			case '\\':
+				if (end - it >= 2)
+					++it;
+				token.type = Token_Literal;
+				token.literal = static_cast<uint8_t>(*it);
+				++it;
+				break;
+
+			default:
+				token.type = Token_Literal;
+				token.literal = static_cast<uint8_t>(*it);
+				++it;
+			}
+
+			if (in_prefix and Token_Literal == token.type) {
+				m_prefix.push_back(static_cast<char>(token.literal));
+			}
+			else {
+				in_prefix = false;
+				m_tokens.push_back(token);
+			}
+		}
+
+		m_trailing_star_only = (1 == m_tokens.size() and Token_Star == m_tokens.front().type);
+	}
+
+	bool GlobPattern::match (boost::string_view parText) const {
+		if (parText.size() < m_prefix.size() or 0 != std::memcmp(parText.data(), m_prefix.data(), m_prefix.size()))
+			return false;
+		if (m_tokens.empty())
+			return parText.size() == m_prefix.size();
+		if (m_trailing_star_only)
+			return true;
+
+		//Every token but * consumes exactly one character, so the classic
+		//greedy match with backtracking to the last star is enough
+		const std::size_t text_len = parText.size();
+		const std::size_t no_star = m_tokens.size();
+		std::size_t tok = 0;
+		std::size_t pos = m_prefix.size();
+		std::size_t star_tok = no_star;
+		std::size_t star_pos = 0;
+
+		while (pos < text_len) {
+			if (tok < m_tokens.size()) {
+				const Token& token = m_tokens[tok];
+				if (Token_Star == token.type) {
+					star_tok = ++tok;
+					star_pos = pos;
+					continue;
+				}
+				else if (token_matches(token, static_cast<uint8_t>(parText[pos]))) {
+					++tok;
+					++pos;
+					continue;
+				}
+			}
+			if (no_star != star_tok) {
+				tok = star_tok;
+				pos = ++star_pos;
+				continue;
+			}
+			return false;
+		}
+
+		while (tok < m_tokens.size() and Token_Star == m_tokens[tok].type)
+			++tok;
+		return m_tokens.size() == tok;
+	}
+
+	bool GlobPattern::token_matches (const Token& parToken, uint8_t parChar) const {
+		switch (parToken.type) {
+		case Token_Literal:
+			return parToken.literal == parChar;
+		case Token_AnyChar:
+			return true;
+		case Token_Class:
+			assert(parToken.class_index < m_classes.size());
+			return static_cast<bool>((m_classes[parToken.class_index][parChar >> 6] >> (parChar & 63)) & 1);
+		case Token_Star:
+		default:
+			assert(false); //not reached
+			return false;
+		}
+	}
+
+	std::string glob_escape (boost::string_view parLiteral) {
+		std::string retval;
+		retval.reserve(parLiteral.size());
+		for (char c : parLiteral) {
+			if (is_glob_special(c))
+				retval.push_back('\\');
+			retval.push_back(c);
+		}
+		return retval;
+	}
+} //namespace redis
@@ -20,6 +20,8 @@
 #include "incredis/int_conv.hpp"
 #include <cassert>
 #include <ciso646>
+#include <stdexcept>
+#include <string>
 
 namespace redis {
 	namespace {
@@ -49,77 +51,363 @@ namespace redis {
 				return IncRedis::opt_string_list(std::move(retval));
 			}
 		}
+
+		//Blocking commands take their timeout in seconds, fractions are
+		//accepted since Redis 6
+		std::string timeout_seconds (std::chrono::milliseconds parTimeout) {
+			const auto millisec = parTimeout.count() % 1000;
+			std::string retval = std::to_string(parTimeout.count() / 1000);
+			if (millisec) {
+				retval += (millisec < 100 ? (millisec < 10 ? ".00" : ".0") : ".");
+				retval += std::to_string(millisec);
+			}
+			return retval;
+		}
+
+		boost::string_view list_end_name (ListEnd parEnd) {
+			return (ListEnd_Left == parEnd ? "LEFT" : "RIGHT");
+		}
 	} //unnamed namespace
 
 	IncRedis::IncRedis (std::string &&parAddress, uint16_t parPort) :
-		m_command(std::move(parAddress), parPort)
+		m_command(std::move(parAddress), parPort),
+		m_replicas(),
+		m_near_cache(),
+		m_key_filter(),
+		m_blocking_pool()
 	{
 	}
 
 	IncRedis::IncRedis (std::string&& parSocket) :
-		m_command(std::move(parSocket))
+		m_command(std::move(parSocket)),
+		m_replicas(),
+		m_near_cache(),
+		m_key_filter(),
+		m_blocking_pool()
 	{
 	}
 
 	void IncRedis::connect() {
 		m_command.connect();
+		m_replicas.connect();
 	}
 
 	void IncRedis::wait_for_connect() {
 		m_command.wait_for_connect();
+		m_replicas.wait_for_connect();
+		if (m_near_cache and m_command.is_connected())
+			m_near_cache->enable(m_command);
+		if (m_key_filter and not m_key_filter->is_ready() and m_command.is_connected())
+			m_key_filter->load_from_scan(*this);
 	}
 
 	void IncRedis::disconnect() {
+		if (m_near_cache)
+			m_near_cache->disable(m_command);
 		m_command.disconnect();
+		m_replicas.disconnect();
 	}
 
 	void IncRedis::wait_for_disconnect() {
 		m_command.wait_for_disconnect();
+		m_replicas.wait_for_disconnect();
+	}
+
+	void IncRedis::add_replica (std::string&& parAddress, uint16_t parPort, uint32_t parDb) {
+		m_replicas.add_replica(std::move(parAddress), parPort, parDb);
+	}
+
+	void IncRedis::add_replica (std::string&& parSocket, uint32_t parDb) {
+		m_replicas.add_replica(std::move(parSocket), parDb);
+	}
+
+	void IncRedis::set_single_flight (bool parEnable) {
+		m_command.set_single_flight(parEnable);
+		for (std::size_t z = 0; z < m_replicas.replica_count(); ++z) {
+			m_replicas.replica(z).set_single_flight(parEnable);
+		}
+	}
+
+	void IncRedis::set_auto_batching (const AutoBatchOptions& parOptions) {
+		m_command.set_auto_batching(parOptions);
+		for (std::size_t z = 0; z < m_replicas.replica_count(); ++z) {
+			m_replicas.replica(z).set_auto_batching(parOptions);
+		}
+	}
+
+	void IncRedis::disable_auto_batching() {
+		m_command.disable_auto_batching();
+		for (std::size_t z = 0; z < m_replicas.replica_count(); ++z) {
+			m_replicas.replica(z).disable_auto_batching();
+		}
+	}
+
+	void IncRedis::set_metrics (bool parEnable) {
+		m_command.set_metrics(parEnable);
+		for (std::size_t z = 0; z < m_replicas.replica_count(); ++z) {
+			m_replicas.replica(z).set_metrics(parEnable);
+		}
+	}
+
+	void IncRedis::enable_near_cache (const NearCacheOptions& parOptions) {
+		if (m_near_cache)
+			m_near_cache->disable(m_command);
+		m_near_cache.reset(new NearCache(parOptions));
+		if (m_command.is_connected())
+			m_near_cache->enable(m_command);
+	}
+
+	void IncRedis::disable_near_cache() {
+		if (m_near_cache) {
+			m_near_cache->disable(m_command);
+			m_near_cache.reset();
+		}
+	}
+
+	void IncRedis::near_cache_invalidate (boost::string_view parKey) {
+		if (m_near_cache)
+			m_near_cache->invalidate(parKey);
+	}
+
+	//Tracking is enabled on the primary connection only, so cached reads
+	//always go there rather than to a replica
+	auto IncRedis::cached_hmget (boost::string_view parKey, const boost::string_view* parFields, std::size_t parCount) -> opt_string_list {
+		assert(m_near_cache);
+		opt_string_list::value_type retval(parCount);
+		bool all_cached = true;
+		for (std::size_t z = 0; z < parCount and all_cached; ++z) {
+			all_cached = m_near_cache->find(parKey, parFields[z], retval[z]);
+		}
+		if (all_cached)
+			return opt_string_list(std::move(retval));
+
+		const auto ticket = m_near_cache->fetch_ticket(parKey);
+		StoredCommand command("HMGET", parKey);
+		for (std::size_t z = 0; z < parCount; ++z) {
+			command.push_back(parFields[z]);
+		}
+		auto batch = m_command.make_batch();
+		command.run(batch);
+		batch.throw_if_failed();
+
+		opt_string_list fetched = optional_string_list(batch.replies().front());
+		if (fetched) {
+			assert(fetched->size() == parCount);
+			for (std::size_t z = 0; z < parCount; ++z) {
+				m_near_cache->store(parKey, parFields[z], ticket, (*fetched)[z]);
+			}
+		}
+		return fetched;
+	}
+
+	//The filter is hooked up before the scan starts, so keys written in
+	//the meantime are not lost
+	KeyFilter& IncRedis::enable_key_filter (std::size_t parExpectedKeys, double parFalsePositiveRate, boost::string_view parPrefix) {
+		disable_key_filter();
+		m_key_filter.reset(new KeyFilter(parExpectedKeys, parFalsePositiveRate, parPrefix));
+		m_key_filter->set_ready(false);
+		m_command.set_key_filter(m_key_filter.get());
+		if (m_blocking_pool)
+			m_blocking_pool->set_key_filter(m_key_filter.get());
+		if (m_command.is_connected())
+			m_key_filter->load_from_scan(*this);
+		return *m_key_filter;
+	}
+
+	void IncRedis::disable_key_filter() {
+		m_command.set_key_filter(nullptr);
+		if (m_blocking_pool)
+			m_blocking_pool->set_key_filter(nullptr);
+		m_key_filter.reset();
+	}
+
+	void IncRedis::enable_blocking_pool (uint32_t parDb, std::size_t parMaxConnections) {
+		m_blocking_pool.reset(new ConnectionPool(std::string(m_command.address()), m_command.port(), parDb, parMaxConnections));
+		m_blocking_pool->set_key_filter(m_key_filter.get());
+	}
+
+	void IncRedis::cancel_blocking() {
+		if (m_blocking_pool)
+			m_blocking_pool->unblock_all(m_command);
+	}
+
+	auto IncRedis::blpop (std::initializer_list<boost::string_view> parKeys, std::chrono::milliseconds parTimeout) -> opt_key_value {
+		return blocking_pop("BLPOP", parKeys, parTimeout);
+	}
+
+	auto IncRedis::brpop (std::initializer_list<boost::string_view> parKeys, std::chrono::milliseconds parTimeout) -> opt_key_value {
+		return blocking_pop("BRPOP", parKeys, parTimeout);
+	}
+
+	auto IncRedis::blmove (boost::string_view parSource, boost::string_view parDestination, ListEnd parFrom, ListEnd parTo, std::chrono::milliseconds parTimeout) -> opt_string {
+		near_cache_invalidate(parDestination);
+		const StoredCommand command(
+			"BLMOVE", parSource, parDestination,
+			list_end_name(parFrom), list_end_name(parTo),
+			timeout_seconds(parTimeout)
+		);
+		return optional_string(blocking_pool_or_throw().run(command, parTimeout));
+	}
+
+	Transaction IncRedis::make_transaction (const TransactionOptions& parOptions) {
+		return Transaction(blocking_pool_or_throw().acquire(), parOptions);
+	}
+
+	auto IncRedis::blocking_pop (const char* parCommand, std::initializer_list<boost::string_view> parKeys, std::chrono::milliseconds parTimeout) -> opt_key_value {
+		assert(parKeys.size() > 0);
+		StoredCommand command(parCommand);
+		for (const auto& key : parKeys) {
+			command.push_back(key);
+		}
+		command.push_back(timeout_seconds(parTimeout));
+
+		//Nil on timeout, [key, value] otherwise
+		Reply reply = blocking_pool_or_throw().run(command, parTimeout);
+		if (reply.is_nil())
+			return opt_key_value();
+		auto& key_value = get_array(reply);
+		near_cache_invalidate(get_string(key_value[0]));
+		return opt_key_value(std::make_pair(take<std::string>(key_value[0]), take<std::string>(key_value[1])));
+	}
+
+	ConnectionPool& IncRedis::blocking_pool_or_throw() {
+		if (not m_blocking_pool)
+			throw std::runtime_error("Blocking commands need enable_blocking_pool() to be called first");
+		return *m_blocking_pool;
 	}
 
 	IncRedisBatch IncRedis::make_batch() {
-		return m_command.make_batch();
+		return IncRedisBatch(m_command.make_batch());
 	}
 
 	auto IncRedis::scan (boost::string_view parPattern) -> scan_range {
-		return scan_range(scan_iterator(&m_command, false, parPattern), scan_iterator(&m_command, true));
+		return scan(ScanOptions(), parPattern);
 	}
 
 	auto IncRedis::hscan (boost::string_view parKey, boost::string_view parPattern) -> hscan_range {
-		return hscan_range(hscan_iterator(&m_command, parKey, false, parPattern), hscan_iterator(&m_command, parKey, true));
+		return hscan(parKey, ScanOptions(), parPattern);
 	}
 
 	auto IncRedis::sscan (boost::string_view parKey, boost::string_view parPattern) -> sscan_range {
-		return sscan_range(sscan_iterator(&m_command, parKey, false, parPattern), sscan_iterator(&m_command, parKey, true));
+		return sscan(parKey, ScanOptions(), parPattern);
 	}
 
 	auto IncRedis::zscan (boost::string_view parKey, boost::string_view parPattern) -> zscan_range {
-		return zscan_range(zscan_iterator(&m_command, parKey, false, parPattern), zscan_iterator(&m_command, parKey, true));
+		return zscan(parKey, ScanOptions(), parPattern);
+	}
+
+	auto IncRedis::scan (const ScanOptions& parOptions, boost::string_view parPattern) -> scan_range {
+		Command* const command = &read_command();
+		return scan_range(scan_iterator(command, false, parPattern, parOptions), scan_iterator(command, true));
+	}
+
+	auto IncRedis::hscan (boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern) -> hscan_range {
+		Command* const command = &read_command();
+		return hscan_range(hscan_iterator(command, parKey, false, parPattern, parOptions), hscan_iterator(command, parKey, true));
+	}
+
+	auto IncRedis::sscan (boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern) -> sscan_range {
+		Command* const command = &read_command();
+		return sscan_range(sscan_iterator(command, parKey, false, parPattern, parOptions), sscan_iterator(command, parKey, true));
+	}
+
+	auto IncRedis::zscan (boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern) -> zscan_range {
+		Command* const command = &read_command();
+		return zscan_range(zscan_iterator(command, parKey, false, parPattern, parOptions), zscan_iterator(command, parKey, true));
+	}
+
+	auto IncRedis::scan_pages (boost::string_view parPattern) -> scan_page_range {
+		return scan_pages(ScanOptions(), parPattern);
+	}
+
+	auto IncRedis::hscan_pages (boost::string_view parKey, boost::string_view parPattern) -> hscan_page_range {
+		return hscan_pages(parKey, ScanOptions(), parPattern);
+	}
+
+	auto IncRedis::sscan_pages (boost::string_view parKey, boost::string_view parPattern) -> sscan_page_range {
+		return sscan_pages(parKey, ScanOptions(), parPattern);
+	}
+
+	auto IncRedis::zscan_pages (boost::string_view parKey, boost::string_view parPattern) -> zscan_page_range {
+		return zscan_pages(parKey, ScanOptions(), parPattern);
+	}
+
+	auto IncRedis::scan_pages (const ScanOptions& parOptions, boost::string_view parPattern) -> scan_page_range {
+		Command* const command = &read_command();
+		return scan_page_range(scan_page_iterator(command, false, parPattern, parOptions), scan_page_iterator(command, true));
+	}
+
+	auto IncRedis::hscan_pages (boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern) -> hscan_page_range {
+		Command* const command = &read_command();
+		return hscan_page_range(hscan_page_iterator(command, parKey, false, parPattern, parOptions), hscan_page_iterator(command, parKey, true));
+	}
+
+	auto IncRedis::sscan_pages (boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern) -> sscan_page_range {
+		Command* const command = &read_command();
+		return sscan_page_range(sscan_page_iterator(command, parKey, false, parPattern, parOptions), sscan_page_iterator(command, parKey, true));
+	}
+
+	auto IncRedis::zscan_pages (boost::string_view parKey, const ScanOptions& parOptions, boost::string_view parPattern) -> zscan_page_range {
+		Command* const command = &read_command();
+		return zscan_page_range(zscan_page_iterator(command, parKey, false, parPattern, parOptions), zscan_page_iterator(command, parKey, true));
+	}
+
+	auto IncRedis::scan_fetch (ScanFetchCommand parFetch, boost::string_view parPattern) -> scan_fetch_range {
+		return scan_fetch(std::move(parFetch), ScanOptions(), parPattern);
+	}
+
+	auto IncRedis::sscan_fetch (boost::string_view parKey, ScanFetchCommand parFetch, boost::string_view parPattern) -> sscan_fetch_range {
+		return sscan_fetch(parKey, std::move(parFetch), ScanOptions(), parPattern);
+	}
+
+	auto IncRedis::scan_fetch (ScanFetchCommand parFetch, const ScanOptions& parOptions, boost::string_view parPattern) -> scan_fetch_range {
+		Command* const command = &read_command();
+		auto fetch = std::make_shared<const ScanFetchCommand>(std::move(parFetch));
+		return scan_fetch_range(scan_fetch_iterator(command, fetch, false, parPattern, parOptions), scan_fetch_iterator(command, fetch, true));
+	}
+
+	auto IncRedis::sscan_fetch (boost::string_view parKey, ScanFetchCommand parFetch, const ScanOptions& parOptions, boost::string_view parPattern) -> sscan_fetch_range {
+		Command* const command = &read_command();
+		auto fetch = std::make_shared<const ScanFetchCommand>(std::move(parFetch));
+		return sscan_fetch_range(sscan_fetch_iterator(command, fetch, parKey, false, parPattern, parOptions), sscan_fetch_iterator(command, fetch, parKey, true));
 	}
 
 	auto IncRedis::hget (boost::string_view parKey, boost::string_view parField) -> opt_string {
-		return optional_string(m_command.run("HGET", parKey, parField));
+		if (known_absent(parKey))
+			return boost::none;
+		if (near_cache_active()) {
+			opt_string retval;
+			if (m_near_cache->find(parKey, parField, retval))
+				return retval;
+
+			const auto ticket = m_near_cache->fetch_ticket(parKey);
+			retval = optional_string(m_command.run("HGET", parKey, parField));
+			m_near_cache->store(parKey, parField, ticket, retval);
+			return retval;
+		}
+		return optional_string(run_read_only("HGET", parKey, parField));
 	}
 
 	RedisInt IncRedis::hincrby (boost::string_view parKey, boost::string_view parField, int parInc) {
+		near_cache_invalidate(parKey);
 		auto reply = m_command.run("HINCRBY", parKey, parField, int_to_ary_dec(parInc).to<boost::string_view>());
 		return get_integer(reply);
 	}
 
 	auto IncRedis::srandmember (boost::string_view parKey, int parCount) -> opt_string_list {
-		return optional_string_list(m_command.run("SRANDMEMBER", parKey, int_to_ary_dec(parCount).to<boost::string_view>()));
+		return optional_string_list(run_read_only("SRANDMEMBER", parKey, int_to_ary_dec(parCount).to<boost::string_view>()));
 	}
 
 	auto IncRedis::srandmember (boost::string_view parKey) -> opt_string {
-		return optional_string(m_command.run("SRANDMEMBER", parKey));
+		return optional_string(run_read_only("SRANDMEMBER", parKey));
 	}
 
 	auto IncRedis::smembers (boost::string_view parKey) -> opt_string_list {
-		return optional_string_list(m_command.run("SMEMBERS", parKey));
+		return optional_string_list(run_read_only("SMEMBERS", parKey));
 	}
 
 	auto IncRedis::zrangebyscore (boost::string_view parKey, double parMin, bool parMinIncl, double parMax, bool parMaxIncl, bool parWithScores) -> opt_string_list {
-		auto batch = make_batch();
+		IncRedisBatch batch(read_command().make_batch());
 		batch.zrangebyscore(parKey, parMin, parMinIncl, parMax, parMaxIncl, parWithScores);
 		assert(batch.replies().size() == 1);
 		return optional_string_list(batch.replies().front());
@@ -127,6 +415,7 @@ namespace redis {
 
 	bool IncRedis::script_flush() {
 		const auto ret = redis::get<StatusString>(m_command.run("SCRIPT", "FLUSH"));
+		m_command.forget_loaded_scripts();
 		return ret.is_ok();
 	}
 
@@ -136,11 +425,12 @@ namespace redis {
 	}
 
 	RedisInt IncRedis::dbsize() {
-		const auto ret = redis::get<RedisInt>(m_command.run("DBSIZE"));
+		const auto ret = redis::get<RedisInt>(run_read_only("DBSIZE"));
 		return ret;
 	}
 
 	bool IncRedis::expire (boost::string_view parKey, RedisInt parTTL) {
+		near_cache_invalidate(parKey);
 		const auto ret = redis::get<RedisInt>(m_command.run("EXPIRE", parKey, int_to_ary_dec(parTTL).to<boost::string_view>()));
 		return (ret == 1 ? true : false);
 	}
@@ -150,10 +440,29 @@ namespace redis {
 	}
 
 	auto IncRedis::get (boost::string_view parKey) -> opt_string {
-		return optional_string(m_command.run("GET", parKey));
+		//A filter that isn't ready says nothing, so a nil from it is no
+		//false positive
+		const bool filter_consulted = m_key_filter and m_key_filter->is_ready() and m_key_filter->covers(parKey);
+		if (known_absent(parKey))
+			return boost::none;
+		if (near_cache_active()) {
+			opt_string retval;
+			if (m_near_cache->find(parKey, retval))
+				return retval;
+
+			const auto ticket = m_near_cache->fetch_ticket(parKey);
+			retval = optional_string(m_command.run("GET", parKey));
+			m_near_cache->store(parKey, ticket, retval);
+			return retval;
+		}
+		opt_string retval = optional_string(run_read_only("GET", parKey));
+		if (not retval and filter_consulted)
+			m_key_filter->record_false_positive();
+		return retval;
 	}
 
 	bool IncRedis::set (boost::string_view parKey, boost::string_view parField) {
+		near_cache_invalidate(parKey);
 		auto batch = make_batch();
 		batch.set(parKey, parField, IncRedisBatch::ADD_None);
 		assert(batch.replies().size() == 1);
@@ -162,7 +471,13 @@ namespace redis {
 	}
 
 	RedisInt IncRedis::incr (boost::string_view parKey) {
+		near_cache_invalidate(parKey);
 		const auto ret = redis::get<RedisInt>(m_command.run("INCR", parKey));
 		return ret;
 	}
+
+	RedisInt IncRedis::publish (boost::string_view parChannel, boost::string_view parMessage) {
+		const auto ret = redis::get<RedisInt>(m_command.run("PUBLISH", parChannel, parMessage));
+		return ret;
+	}
 } //namespace redis
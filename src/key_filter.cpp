@@ -0,0 +1,162 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "key_filter.hpp"
+#include "incredis.hpp"
+#include "glob_pattern.hpp"
+#include <cmath>
+#include <functional>
+#include <string_view>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		const std::size_t g_words_per_block = 8;
+
+		//Same salts as the split block Bloom filter in Parquet
+		const uint32_t g_salts[g_words_per_block] = {
+			0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+			0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+		};
+
+		//Finalizer from MurmurHash3, std::hash makes no promise about how
+		//well mixed the high bits are
+		uint64_t fmix64 (uint64_t parValue) {
+			parValue ^= parValue >> 33;
+			parValue *= 0xff51afd7ed558ccdULL;
+			parValue ^= parValue >> 33;
+			parValue *= 0xc4ceb9fe1a85ec53ULL;
+			parValue ^= parValue >> 33;
+			return parValue;
+		}
+
+		inline uint32_t word_mask (uint32_t parKey, std::size_t parWord) {
+			return 1U << ((parKey * g_salts[parWord]) >> 27);
+		}
+	} //unnamed namespace
+
+	struct alignas(32) KeyFilter::Block {
+		std::atomic<uint32_t> words[g_words_per_block];
+	};
+
+	KeyFilter::KeyFilter (std::size_t parExpectedKeys, double parFalsePositiveRate, boost::string_view parPrefix) :
+		m_blocks(),
+		m_block_count(1),
+		m_prefix(parPrefix),
+		m_lookups(0),
+		m_definitely_absent(0),
+		m_false_positives(0),
+		m_inserted(0),
+		m_ready(true)
+	{
+		assert(parFalsePositiveRate > 0.0 and parFalsePositiveRate < 1.0);
+
+		//Bits needed for a split block filter with 8 words per block, as
+		//derived in the Parquet format specification
+		const double keys = static_cast<double>(std::max<std::size_t>(1, parExpectedKeys));
+		const double bits = -8.0 * keys / std::log(1.0 - std::pow(parFalsePositiveRate, 1.0 / 8.0));
+		m_block_count = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(bits / (sizeof(Block) * 8))));
+		m_blocks.reset(new Block[m_block_count]);
+		clear();
+	}
+
+	KeyFilter::~KeyFilter() noexcept = default;
+
+	uint64_t KeyFilter::hash (boost::string_view parKey) {
+		return fmix64(std::hash<std::string_view>()(std::string_view(parKey.data(), parKey.size())));
+	}
+
+	auto KeyFilter::block_for (uint64_t parHash) const -> Block& {
+		const std::size_t index = static_cast<std::size_t>(((parHash >> 32) * m_block_count) >> 32);
+		assert(index < m_block_count);
+		return m_blocks[index];
+	}
+
+	void KeyFilter::insert (boost::string_view parKey) {
+		if (not covers(parKey))
+			return;
+
+		const uint64_t key_hash = hash(parKey);
+		Block& block = block_for(key_hash);
+		const uint32_t key = static_cast<uint32_t>(key_hash);
+		for (std::size_t z = 0; z < g_words_per_block; ++z) {
+			block.words[z].fetch_or(word_mask(key, z), std::memory_order_relaxed);
+		}
+		m_inserted.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool KeyFilter::may_contain (boost::string_view parKey) const {
+		const uint64_t key_hash = hash(parKey);
+		const Block& block = block_for(key_hash);
+		const uint32_t key = static_cast<uint32_t>(key_hash);
+		for (std::size_t z = 0; z < g_words_per_block; ++z) {
+			const uint32_t mask = word_mask(key, z);
+			if ((block.words[z].load(std::memory_order_relaxed) & mask) != mask)
+				return false;
+		}
+		return true;
+	}
+
+	bool KeyFilter::definitely_absent (boost::string_view parKey) {
+		if (not covers(parKey) or not is_ready())
+			return false;
+
+		m_lookups.fetch_add(1, std::memory_order_relaxed);
+		if (may_contain(parKey))
+			return false;
+		m_definitely_absent.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void KeyFilter::clear() {
+		for (std::size_t z = 0; z < m_block_count; ++z) {
+			for (auto& word : m_blocks[z].words) {
+				word.store(0, std::memory_order_relaxed);
+			}
+		}
+		m_inserted = 0;
+	}
+
+	//Keys that are written while the scan runs are inserted by the normal
+	//write path, so they are not lost
+	std::size_t KeyFilter::load_from_scan (IncRedis& parRedis, const ScanOptions& parOptions) {
+		const std::string pattern = glob_escape(m_prefix) + '*';
+		std::size_t retval = 0;
+		for (const auto& page : parRedis.scan_pages(parOptions, pattern)) {
+			for (const auto& key : page) {
+				insert(key);
+			}
+			retval += page.size();
+		}
+		set_ready(true);
+		return retval;
+	}
+
+	std::size_t KeyFilter::size_bytes() const {
+		return m_block_count * sizeof(Block);
+	}
+
+	KeyFilterStats KeyFilter::stats() const {
+		KeyFilterStats retval;
+		retval.lookups = m_lookups.load(std::memory_order_relaxed);
+		retval.definitely_absent = m_definitely_absent.load(std::memory_order_relaxed);
+		retval.false_positives = m_false_positives.load(std::memory_order_relaxed);
+		retval.inserted = m_inserted.load(std::memory_order_relaxed);
+		return retval;
+	}
+} //namespace redis
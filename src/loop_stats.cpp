@@ -0,0 +1,50 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loop_stats.hpp"
+#include <memory>
+
+namespace redis {
+	LoopStatsRecorder::~LoopStatsRecorder() noexcept {
+		delete m_histograms.load(std::memory_order_acquire);
+	}
+
+	void LoopStatsRecorder::set_enabled (bool parEnable) {
+		if (parEnable and not m_histograms.load(std::memory_order_acquire)) {
+			std::unique_ptr<Histograms> histograms(new Histograms);
+			Histograms* expected = nullptr;
+			if (m_histograms.compare_exchange_strong(expected, histograms.get(), std::memory_order_acq_rel))
+				histograms.release();
+		}
+		m_enabled.store(parEnable, std::memory_order_release);
+	}
+
+	EventLoopStats LoopStatsRecorder::snapshot() const {
+		EventLoopStats retval;
+		if (const Histograms* histograms = m_histograms.load(std::memory_order_acquire)) {
+			retval.wakeup_latency = histograms->wakeup_latency.snapshot();
+			retval.iteration = histograms->iteration.snapshot();
+			retval.loop_mutex_wait = histograms->loop_mutex_wait.snapshot();
+			retval.caller_mutex_wait = histograms->caller_mutex_wait.snapshot();
+			retval.caller_mutex_hold = histograms->caller_mutex_hold.snapshot();
+			retval.reply_parse = histograms->reply_parse.snapshot();
+		}
+		retval.wakeups_sent = wakeups_sent.load(std::memory_order_relaxed);
+		retval.wakeups_coalesced = wakeups_coalesced.load(std::memory_order_relaxed);
+		return retval;
+	}
+} //namespace redis
@@ -0,0 +1,110 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id005B3D239B674DEDB11476768E22EFAA
+#define id005B3D239B674DEDB11476768E22EFAA
+
+#include "metrics_recorder.hpp"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+
+namespace redis {
+	//Recording side of EventLoopStats, one for each AsyncConnection. The
+	//histograms take about 25KB, so they are only allocated the first
+	//time stats are enabled. They are then kept until the recorder goes
+	//away, since the event thread might be about to write to them.
+	struct LoopStatsRecorder {
+		struct Histograms {
+			//Written by the event thread only
+			AtomicHistogram wakeup_latency;
+			AtomicHistogram iteration;
+			AtomicHistogram loop_mutex_wait;
+			AtomicHistogram reply_parse;
+			//Written by any thread
+			AtomicHistogram caller_mutex_wait;
+			AtomicHistogram caller_mutex_hold;
+		};
+
+		LoopStatsRecorder ( void ) :
+			wakeups_sent(0),
+			wakeups_coalesced(0),
+			wakeup_sent_at(0),
+			m_histograms(nullptr),
+			m_enabled(false)
+		{
+		}
+		~LoopStatsRecorder ( void ) noexcept;
+
+		void set_enabled ( bool parEnable );
+		bool is_enabled ( void ) const { return m_enabled.load(std::memory_order_acquire); }
+		//Null while stats are disabled
+		Histograms* histograms ( void ) const { return (is_enabled() ? m_histograms.load(std::memory_order_acquire) : nullptr); }
+		EventLoopStats snapshot ( void ) const;
+
+		std::atomic<uint64_t> wakeups_sent;
+		std::atomic<uint64_t> wakeups_coalesced;
+		//steady_clock ticks when the pending wakeup was sent, 0 if none
+		std::atomic<int64_t> wakeup_sent_at;
+
+	private:
+		std::atomic<Histograms*> m_histograms;
+		std::atomic<bool> m_enabled;
+	};
+
+	//Locks the event mutex, timing how long it took to get it and how long
+	//it was held when stats are enabled
+	class TimedEventLock {
+	public:
+		TimedEventLock ( std::mutex& parMutex, LoopStatsRecorder& parStats );
+		~TimedEventLock ( void ) noexcept;
+
+		TimedEventLock ( const TimedEventLock& ) = delete;
+		TimedEventLock& operator= ( const TimedEventLock& ) = delete;
+
+	private:
+		std::mutex& m_mutex;
+		LoopStatsRecorder::Histograms* m_stats;
+		std::chrono::steady_clock::time_point m_acquired;
+	};
+
+	inline TimedEventLock::TimedEventLock (std::mutex& parMutex, LoopStatsRecorder& parStats) :
+		m_mutex(parMutex),
+		m_stats(parStats.histograms()),
+		m_acquired()
+	{
+		if (m_stats) {
+			const auto start = std::chrono::steady_clock::now();
+			m_mutex.lock();
+			m_acquired = std::chrono::steady_clock::now();
+			m_stats->caller_mutex_wait.record(m_acquired - start);
+		}
+		else {
+			m_mutex.lock();
+		}
+	}
+
+	inline TimedEventLock::~TimedEventLock() noexcept {
+		const auto held = (m_stats ? std::chrono::steady_clock::now() - m_acquired : std::chrono::steady_clock::duration());
+		m_mutex.unlock();
+		if (m_stats)
+			m_stats->caller_mutex_hold.record(held);
+	}
+} //namespace redis
+
+#endif
@@ -0,0 +1,188 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "metrics.hpp"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		//Bucket bounds for the exported histograms, in nanoseconds
+		const uint64_t g_prometheus_bounds[] = {
+			50000, 100000, 250000, 500000,
+			1000000, 2500000, 5000000,
+			10000000, 25000000, 50000000,
+			100000000, 250000000, 500000000,
+			1000000000, 2500000000, 10000000000
+		};
+
+		inline int highest_bit (uint64_t parValue) {
+			assert(parValue);
+			return 63 - __builtin_clzll(parValue);
+		}
+
+		void write_seconds (std::ostream& parStream, uint64_t parNanoseconds) {
+			parStream << (parNanoseconds / 1000000000) << '.' << std::setw(9) << std::setfill('0') << (parNanoseconds % 1000000000);
+		}
+
+		void write_help (std::ostream& parStream, const std::string& parName, const char* parType, const char* parHelp) {
+			parStream << "# HELP " << parName << ' ' << parHelp << '\n';
+			parStream << "# TYPE " << parName << ' ' << parType << '\n';
+		}
+
+		//parLabels is either empty or a list of label="value" pairs
+		void write_histogram (std::ostream& parStream, const std::string& parName, const std::string& parLabels, const LatencyHistogram& parHistogram) {
+			const std::string separator = (parLabels.empty() ? "" : ",");
+			uint64_t cumulative = 0;
+			std::size_t bucket = 0;
+			for (const uint64_t bound : g_prometheus_bounds) {
+				//Fine buckets straddling the bound are counted in the next
+				//one, so this errs on the slow side
+				for (; bucket < parHistogram.counts.size() and LatencyHistogram::bucket_upper_bound(bucket) <= bound; ++bucket) {
+					cumulative += parHistogram.counts[bucket];
+				}
+				parStream << parName << "_bucket{" << parLabels << separator << "le=\"";
+				write_seconds(parStream, bound);
+				parStream << "\"} " << cumulative << '\n';
+			}
+			parStream << parName << "_bucket{" << parLabels << separator << "le=\"+Inf\"} " << parHistogram.count << '\n';
+			parStream << parName << "_sum";
+			if (not parLabels.empty())
+				parStream << '{' << parLabels << '}';
+			parStream << ' ';
+			write_seconds(parStream, static_cast<uint64_t>(parHistogram.sum.count()));
+			parStream << '\n';
+			parStream << parName << "_count";
+			if (not parLabels.empty())
+				parStream << '{' << parLabels << '}';
+			parStream << ' ' << parHistogram.count << '\n';
+		}
+
+		template <typename F>
+		void write_per_command (std::ostream& parStream, const MetricsSnapshot& parSnapshot, const std::string& parName, const char* parHelp, F parGetter) {
+			write_help(parStream, parName, "counter", parHelp);
+			for (const auto& command : parSnapshot.commands) {
+				parStream << parName << "{command=\"" << command.name << "\"} " << parGetter(command) << '\n';
+			}
+		}
+	} //unnamed namespace
+
+	LatencyHistogram::LatencyHistogram() :
+		counts(BucketCount, 0),
+		count(0),
+		sum(0),
+		min(0),
+		max(0)
+	{
+	}
+
+	std::size_t LatencyHistogram::bucket_index (uint64_t parNanoseconds) {
+		if (parNanoseconds < SubBucketCount)
+			return static_cast<std::size_t>(parNanoseconds);
+		const int exponent = highest_bit(parNanoseconds);
+		if (exponent >= MaxExponent)
+			return BucketCount - 1;
+		const std::size_t sub_bucket = (parNanoseconds >> (exponent - SubBucketBits)) & (SubBucketCount - 1);
+		return static_cast<std::size_t>(exponent - SubBucketBits + 1) * SubBucketCount + sub_bucket;
+	}
+
+	uint64_t LatencyHistogram::bucket_lower_bound (std::size_t parIndex) {
+		assert(parIndex < BucketCount);
+		if (parIndex < SubBucketCount)
+			return parIndex;
+		const int shift = static_cast<int>(parIndex / SubBucketCount) - 1;
+		return (SubBucketCount + parIndex % SubBucketCount) << shift;
+	}
+
+	uint64_t LatencyHistogram::bucket_upper_bound (std::size_t parIndex) {
+		assert(parIndex < BucketCount);
+		if (parIndex < SubBucketCount)
+			return parIndex;
+		const int shift = static_cast<int>(parIndex / SubBucketCount) - 1;
+		return bucket_lower_bound(parIndex) + (uint64_t(1) << shift) - 1;
+	}
+
+	std::chrono::nanoseconds LatencyHistogram::percentile (double parPercentile) const {
+		if (not count)
+			return std::chrono::nanoseconds(0);
+
+		const double wanted = parPercentile / 100.0 * static_cast<double>(count);
+		uint64_t seen = 0;
+		for (std::size_t z = 0; z < counts.size(); ++z) {
+			seen += counts[z];
+			if (counts[z] and static_cast<double>(seen) >= wanted)
+				return std::min(std::chrono::nanoseconds(bucket_upper_bound(z)), max);
+		}
+		return max;
+	}
+
+	std::chrono::nanoseconds LatencyHistogram::mean() const {
+		return std::chrono::nanoseconds(count ? sum.count() / static_cast<int64_t>(count) : 0);
+	}
+
+	std::string to_prometheus (const MetricsSnapshot& parSnapshot, boost::string_view parPrefix) {
+		std::ostringstream oss;
+		const std::string prefix = std::string(parPrefix) + '_';
+
+		{
+			const std::string name = prefix + "command_duration_seconds";
+			write_help(oss, name, "histogram", "Time from sending a command to receiving its reply.");
+			for (const auto& command : parSnapshot.commands) {
+				write_histogram(oss, name, "command=\"" + command.name + '"', command.latency);
+			}
+		}
+
+		write_per_command(oss, parSnapshot, prefix + "command_errors_total", "Error replies, including connections lost before the reply.", [](const CommandMetrics& parCommand) { return parCommand.errors; });
+		write_per_command(oss, parSnapshot, prefix + "command_sent_bytes_total", "Bytes sent to the server.", [](const CommandMetrics& parCommand) { return parCommand.bytes_sent; });
+		write_per_command(oss, parSnapshot, prefix + "command_received_bytes_total", "Bytes received from the server.", [](const CommandMetrics& parCommand) { return parCommand.bytes_received; });
+
+		write_help(oss, prefix + "in_flight_commands", "gauge", "Commands waiting for a reply.");
+		oss << prefix << "in_flight_commands " << parSnapshot.in_flight << '\n';
+		write_help(oss, prefix + "backpressure_waits_total", "counter", "Times a caller waited for in flight commands to drain.");
+		oss << prefix << "backpressure_waits_total " << parSnapshot.backpressure_waits << '\n';
+		write_help(oss, prefix + "connections_total", "counter", "Successful connections to the server.");
+		oss << prefix << "connections_total " << parSnapshot.connections << '\n';
+		write_help(oss, prefix + "connections_lost_total", "counter", "Connections closed by an error.");
+		oss << prefix << "connections_lost_total " << parSnapshot.connections_lost << '\n';
+
+		const EventLoopStats& loop = parSnapshot.event_loop;
+		const struct {
+			const char* name;
+			const char* help;
+			const LatencyHistogram& histogram;
+		} loop_histograms[] = {
+			{"event_loop_wakeup_seconds", "Time from waking the event thread up to it running.", loop.wakeup_latency},
+			{"event_loop_iteration_seconds", "Time the event thread spends between two calls to poll().", loop.iteration},
+			{"event_loop_mutex_wait_seconds", "Time the event thread waits for the event mutex.", loop.loop_mutex_wait},
+			{"caller_mutex_wait_seconds", "Time other threads wait for the event mutex.", loop.caller_mutex_wait},
+			{"caller_mutex_hold_seconds", "Time other threads hold the event mutex.", loop.caller_mutex_hold},
+			{"reply_parse_seconds", "Time spent converting hiredis replies.", loop.reply_parse}
+		};
+		for (const auto& item : loop_histograms) {
+			write_help(oss, prefix + item.name, "histogram", item.help);
+			write_histogram(oss, prefix + item.name, std::string(), item.histogram);
+		}
+		write_help(oss, prefix + "event_loop_wakeups_total", "counter", "Wakeups sent to the event thread.");
+		oss << prefix << "event_loop_wakeups_total " << loop.wakeups_sent << '\n';
+		write_help(oss, prefix + "event_loop_wakeups_coalesced_total", "counter", "Wakeups skipped because one was already pending.");
+		oss << prefix << "event_loop_wakeups_coalesced_total " << loop.wakeups_coalesced << '\n';
+		return oss.str();
+	}
+} //namespace redis
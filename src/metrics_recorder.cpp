@@ -0,0 +1,171 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "metrics_recorder.hpp"
+#include "command_table.hpp"
+#include <array>
+#include <limits>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		template <typename T>
+		inline void single_writer_add (std::atomic<T>& parCounter, T parValue) {
+			parCounter.store(parCounter.load(std::memory_order_relaxed) + parValue, std::memory_order_relaxed);
+		}
+
+		uint64_t to_nanoseconds (std::chrono::steady_clock::duration parElapsed) {
+			const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(parElapsed).count();
+			return static_cast<uint64_t>(elapsed > 0 ? elapsed : 0);
+		}
+
+		std::size_t slot_count() {
+			//One more for commands missing from the table
+			return command_table_size() + 1;
+		}
+	} //unnamed namespace
+
+	AtomicHistogram::AtomicHistogram() :
+		m_sum_ns(0),
+		m_min_ns(std::numeric_limits<uint64_t>::max()),
+		m_max_ns(0)
+	{
+		for (auto& bucket : m_buckets) {
+			bucket.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void AtomicHistogram::record (std::chrono::steady_clock::duration parElapsed) {
+		const uint64_t elapsed_ns = to_nanoseconds(parElapsed);
+		m_buckets[LatencyHistogram::bucket_index(elapsed_ns)].fetch_add(1, std::memory_order_relaxed);
+		m_sum_ns.fetch_add(elapsed_ns, std::memory_order_relaxed);
+
+		uint64_t min_ns = m_min_ns.load(std::memory_order_relaxed);
+		while (elapsed_ns < min_ns and not m_min_ns.compare_exchange_weak(min_ns, elapsed_ns, std::memory_order_relaxed)) {
+		}
+		uint64_t max_ns = m_max_ns.load(std::memory_order_relaxed);
+		while (elapsed_ns > max_ns and not m_max_ns.compare_exchange_weak(max_ns, elapsed_ns, std::memory_order_relaxed)) {
+		}
+	}
+
+	void AtomicHistogram::record_exclusive (std::chrono::steady_clock::duration parElapsed) {
+		const uint64_t elapsed_ns = to_nanoseconds(parElapsed);
+		single_writer_add<uint64_t>(m_buckets[LatencyHistogram::bucket_index(elapsed_ns)], 1);
+		single_writer_add<uint64_t>(m_sum_ns, elapsed_ns);
+		if (elapsed_ns < m_min_ns.load(std::memory_order_relaxed))
+			m_min_ns.store(elapsed_ns, std::memory_order_relaxed);
+		if (elapsed_ns > m_max_ns.load(std::memory_order_relaxed))
+			m_max_ns.store(elapsed_ns, std::memory_order_relaxed);
+	}
+
+	//Counters are read one by one while they may be getting updated, so
+	//a snapshot can be off by the samples recorded meanwhile
+	LatencyHistogram AtomicHistogram::snapshot() const {
+		LatencyHistogram retval;
+		for (std::size_t z = 0; z < m_buckets.size(); ++z) {
+			retval.counts[z] = m_buckets[z].load(std::memory_order_relaxed);
+			retval.count += retval.counts[z];
+		}
+		retval.sum = std::chrono::nanoseconds(m_sum_ns.load(std::memory_order_relaxed));
+		const uint64_t min_ns = m_min_ns.load(std::memory_order_relaxed);
+		retval.min = std::chrono::nanoseconds(retval.count ? min_ns : 0);
+		retval.max = std::chrono::nanoseconds(m_max_ns.load(std::memory_order_relaxed));
+		return retval;
+	}
+
+	struct MetricsRecorder::CommandSlot {
+		CommandSlot() :
+			latency(),
+			errors(0),
+			bytes_sent(0),
+			bytes_received(0)
+		{
+		}
+
+		AtomicHistogram latency;
+		std::atomic<uint64_t> errors;
+		std::atomic<uint64_t> bytes_sent;
+		std::atomic<uint64_t> bytes_received;
+	};
+
+	MetricsRecorder::MetricsRecorder() :
+		m_slots(new std::atomic<CommandSlot*>[slot_count()]),
+		m_backpressure_waits(0),
+		m_enabled(false)
+	{
+		for (std::size_t z = 0; z < slot_count(); ++z) {
+			m_slots[z].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	MetricsRecorder::~MetricsRecorder() noexcept {
+		for (std::size_t z = 0; z < slot_count(); ++z) {
+			delete m_slots[z].load(std::memory_order_relaxed);
+		}
+	}
+
+	//Histograms are a few KiB each, only allocate them for commands that
+	//are actually used
+	MetricsRecorder::CommandSlot* MetricsRecorder::slot (std::size_t parCommandIndex) {
+		assert(parCommandIndex < slot_count());
+		CommandSlot* retval = m_slots[parCommandIndex].load(std::memory_order_relaxed);
+		if (not retval) {
+			retval = new CommandSlot;
+			m_slots[parCommandIndex].store(retval, std::memory_order_release);
+		}
+		return retval;
+	}
+
+	void MetricsRecorder::record_reply (std::size_t parCommandIndex, std::chrono::steady_clock::duration parElapsed, std::size_t parBytesSent, std::size_t parBytesReceived, bool parError) {
+		CommandSlot& dst = *slot(parCommandIndex);
+		dst.latency.record_exclusive(parElapsed);
+		single_writer_add<uint64_t>(dst.bytes_sent, parBytesSent);
+		single_writer_add<uint64_t>(dst.bytes_received, parBytesReceived);
+		if (parError)
+			single_writer_add<uint64_t>(dst.errors, 1);
+	}
+
+	void MetricsRecorder::record_backpressure_wait() {
+		m_backpressure_waits.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	MetricsSnapshot MetricsRecorder::snapshot() const {
+		MetricsSnapshot retval;
+		retval.in_flight = 0;
+		retval.backpressure_waits = m_backpressure_waits.load(std::memory_order_relaxed);
+		retval.connections = 0;
+		retval.connections_lost = 0;
+		retval.event_loop.wakeups_sent = 0;
+		retval.event_loop.wakeups_coalesced = 0;
+
+		for (std::size_t z = 0; z < slot_count(); ++z) {
+			const CommandSlot* const src = m_slots[z].load(std::memory_order_acquire);
+			if (not src)
+				continue;
+
+			CommandMetrics metrics;
+			metrics.name = (z < command_table_size() ? command_info(z).name : "other");
+			metrics.errors = src->errors.load(std::memory_order_relaxed);
+			metrics.bytes_sent = src->bytes_sent.load(std::memory_order_relaxed);
+			metrics.bytes_received = src->bytes_received.load(std::memory_order_relaxed);
+			metrics.latency = src->latency.snapshot();
+			retval.commands.push_back(std::move(metrics));
+		}
+		return retval;
+	}
+} //namespace redis
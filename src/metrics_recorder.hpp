@@ -0,0 +1,77 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id8F89127D185D49B9BC322DFC824C6DCC
+#define id8F89127D185D49B9BC322DFC824C6DCC
+
+#include "incredis/metrics.hpp"
+#include <atomic>
+#include <array>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace redis {
+	//Recording side of LatencyHistogram
+	class AtomicHistogram {
+	public:
+		AtomicHistogram ( void );
+
+		//Safe to call from any number of threads
+		void record ( std::chrono::steady_clock::duration parElapsed );
+		//Cheaper, for when there is only one writer at a time
+		void record_exclusive ( std::chrono::steady_clock::duration parElapsed );
+		LatencyHistogram snapshot ( void ) const;
+
+	private:
+		std::array<std::atomic<uint64_t>, LatencyHistogram::BucketCount> m_buckets;
+		std::atomic<uint64_t> m_sum_ns;
+		std::atomic<uint64_t> m_min_ns;
+		std::atomic<uint64_t> m_max_ns;
+	};
+
+	//Per connection counters behind Command::metrics(). Replies are only
+	//recorded by whoever holds the event mutex, normally the event thread,
+	//so each counter has a single writer at a time and needs no atomic
+	//read-modify-write; snapshot() can be called from any thread.
+	class MetricsRecorder {
+	public:
+		MetricsRecorder ( void );
+		~MetricsRecorder ( void ) noexcept;
+
+		void set_enabled ( bool parEnable ) { m_enabled.store(parEnable, std::memory_order_relaxed); }
+		bool enabled ( void ) const { return m_enabled.load(std::memory_order_relaxed); }
+
+		void record_reply ( std::size_t parCommandIndex, std::chrono::steady_clock::duration parElapsed, std::size_t parBytesSent, std::size_t parBytesReceived, bool parError );
+		void record_backpressure_wait ( void );
+
+		//Fills everything except the connection level figures
+		MetricsSnapshot snapshot ( void ) const;
+
+	private:
+		struct CommandSlot;
+
+		CommandSlot* slot ( std::size_t parCommandIndex );
+
+		std::unique_ptr<std::atomic<CommandSlot*>[]> m_slots;
+		std::atomic<uint64_t> m_backpressure_waits;
+		std::atomic<bool> m_enabled;
+	};
+} //namespace redis
+
+#endif
@@ -0,0 +1,455 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "near_cache.hpp"
+#include "command.hpp"
+#include "stored_command.hpp"
+#include "async_connection.hpp"
+#include "loop_stats.hpp"
+#include "incredis/int_conv.hpp"
+#include <hiredis/hiredis.h>
+#include <hiredis/async.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <stdexcept>
+#include <sstream>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		typedef std::chrono::steady_clock clock_type;
+
+		const char g_invalidation_channel[] = "__redis__:invalidate";
+
+		struct ViewHash {
+			std::size_t operator() ( boost::string_view parView ) const {
+				return std::hash<std::string_view>()(std::string_view(parView.data(), parView.size()));
+			}
+		};
+
+		struct Entry {
+			explicit Entry ( boost::string_view parKey ) :
+				key(parKey.data(), parKey.size()),
+				value(),
+				fields(),
+				expires(),
+				has_value(false)
+			{
+			}
+
+			std::string key;
+			NearCache::opt_string value;
+			std::vector<std::pair<std::string, NearCache::opt_string>> fields;
+			clock_type::time_point expires;
+			bool has_value;
+		};
+
+		//The index refers to the key strings inside the list nodes, which
+		//never move for as long as the entry exists
+		struct Shard {
+			typedef std::list<Entry> EntryList;
+
+			Shard ( void ) :
+				mutex(),
+				lru(),
+				index(),
+				epoch(0)
+			{
+			}
+
+			EntryList::iterator find ( boost::string_view parKey );
+			void erase ( EntryList::iterator parEntry );
+
+			std::mutex mutex;
+			EntryList lru;
+			std::unordered_map<boost::string_view, EntryList::iterator, ViewHash> index;
+			std::atomic<uint64_t> epoch;
+		};
+
+		auto Shard::find (boost::string_view parKey) -> EntryList::iterator {
+			auto it_found = index.find(parKey);
+			return (index.end() == it_found ? lru.end() : it_found->second);
+		}
+
+		void Shard::erase (EntryList::iterator parEntry) {
+			index.erase(boost::string_view(parEntry->key));
+			lru.erase(parEntry);
+		}
+
+		void on_client_id (redisAsyncContext*, void* parReply, void* parPrivData) {
+			auto* id_promise = static_cast<std::promise<long long>*>(parPrivData);
+			auto* reply = static_cast<redisReply*>(parReply);
+			if (reply and REDIS_REPLY_INTEGER == reply->type)
+				id_promise->set_value(reply->integer);
+			else
+				id_promise->set_exception(std::make_exception_ptr(std::runtime_error("CLIENT ID failed on the invalidation connection")));
+		}
+	} //unnamed namespace
+
+	struct NearCache::LocalData {
+		explicit LocalData ( const NearCacheOptions& parOptions );
+
+		Shard& shard ( boost::string_view parKey ) { return *shards[ViewHash()(parKey) % shards.size()]; }
+		bool expired ( const Entry& parEntry, clock_type::time_point parNow ) const;
+		bool covers ( boost::string_view parKey ) const;
+		Entry& touch ( Shard& parShard, boost::string_view parKey );
+		void clear ( void );
+		static void on_invalidation ( redisAsyncContext* parContext, void* parReply, void* parPrivData );
+
+		NearCacheOptions options;
+		std::vector<std::unique_ptr<Shard>> shards;
+		std::size_t shard_capacity;
+		std::unique_ptr<AsyncConnection> invalidations;
+		std::promise<void> subscribed;
+		std::atomic<bool> active;
+		std::atomic<bool> subscribe_confirmed;
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+		std::atomic<uint64_t> invalidation_count;
+		std::atomic<uint64_t> evictions;
+	};
+
+	NearCache::LocalData::LocalData (const NearCacheOptions& parOptions) :
+		options(parOptions),
+		shards(),
+		shard_capacity(std::max<std::size_t>(1, parOptions.max_entries / std::max<std::size_t>(1, parOptions.shards))),
+		invalidations(),
+		subscribed(),
+		active(false),
+		subscribe_confirmed(false),
+		hits(0),
+		misses(0),
+		invalidation_count(0),
+		evictions(0)
+	{
+		const std::size_t shard_count = std::max<std::size_t>(1, options.shards);
+		shards.reserve(shard_count);
+		for (std::size_t z = 0; z < shard_count; ++z) {
+			shards.emplace_back(new Shard);
+		}
+	}
+
+	bool NearCache::LocalData::expired (const Entry& parEntry, clock_type::time_point parNow) const {
+		return options.ttl.count() and parEntry.expires <= parNow;
+	}
+
+	//In broadcasting mode the server only reports changes to keys under
+	//the tracked prefixes, any other key could go stale unnoticed
+	bool NearCache::LocalData::covers (boost::string_view parKey) const {
+		if (options.prefixes.empty())
+			return true;
+		for (const auto& prefix : options.prefixes) {
+			if (parKey.starts_with(boost::string_view(prefix)))
+				return true;
+		}
+		return false;
+	}
+
+	//Returns the entry for parKey as most recently used, creating it and
+	//evicting the least recently used one if needed. parShard must be locked.
+	Entry& NearCache::LocalData::touch (Shard& parShard, boost::string_view parKey) {
+		auto it_entry = parShard.find(parKey);
+		if (parShard.lru.end() != it_entry) {
+			parShard.lru.splice(parShard.lru.begin(), parShard.lru, it_entry);
+			return *it_entry;
+		}
+
+		if (parShard.index.size() >= shard_capacity) {
+			parShard.erase(std::prev(parShard.lru.end()));
+			evictions.fetch_add(1, std::memory_order_relaxed);
+		}
+		parShard.lru.emplace_front(parKey);
+		Entry& entry = parShard.lru.front();
+		parShard.index.emplace(boost::string_view(entry.key), parShard.lru.begin());
+		if (options.ttl.count())
+			entry.expires = clock_type::now() + options.ttl;
+		return entry;
+	}
+
+	void NearCache::LocalData::clear() {
+		for (auto& shard : shards) {
+			std::lock_guard<std::mutex> lock(shard->mutex);
+			shard->index.clear();
+			shard->lru.clear();
+			shard->epoch.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+	//Called on the event thread of the invalidation connection for every
+	//message on the invalidation channel, and with a null reply when the
+	//connection goes away
+	void NearCache::LocalData::on_invalidation (redisAsyncContext*, void* parReply, void* parPrivData) {
+		auto& self = *static_cast<LocalData*>(parPrivData);
+		auto* reply = static_cast<redisReply*>(parReply);
+		if (not reply) {
+			self.active = false;
+			self.clear();
+			if (not self.subscribe_confirmed.exchange(true))
+				self.subscribed.set_exception(std::make_exception_ptr(std::runtime_error("Invalidation connection lost before SUBSCRIBE completed")));
+			return;
+		}
+		if (REDIS_REPLY_ARRAY != reply->type or reply->elements < 3)
+			return;
+
+		const boost::string_view kind(reply->element[0]->str, reply->element[0]->len);
+		if (kind == "subscribe") {
+			if (not self.subscribe_confirmed.exchange(true))
+				self.subscribed.set_value();
+			return;
+		}
+		if (kind != "message")
+			return;
+
+		//A nil payload means the server flushed everything
+		const redisReply* payload = reply->element[2];
+		if (REDIS_REPLY_ARRAY == payload->type) {
+			for (std::size_t z = 0; z < payload->elements; ++z) {
+				const redisReply* key = payload->element[z];
+				if (REDIS_REPLY_STRING == key->type) {
+					Shard& shard = self.shard(boost::string_view(key->str, key->len));
+					std::lock_guard<std::mutex> lock(shard.mutex);
+					auto it_entry = shard.find(boost::string_view(key->str, key->len));
+					if (shard.lru.end() != it_entry)
+						shard.erase(it_entry);
+					shard.epoch.fetch_add(1, std::memory_order_release);
+				}
+			}
+			self.invalidation_count.fetch_add(payload->elements, std::memory_order_relaxed);
+		}
+		else {
+			self.clear();
+			self.invalidation_count.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	NearCache::NearCache (const NearCacheOptions& parOptions) :
+		m_local_data(new LocalData(parOptions))
+	{
+	}
+
+	//The invalidation callback touches the rest of LocalData while the
+	//connection shuts down, so close it before anything else goes away
+	NearCache::~NearCache() noexcept {
+		m_local_data->invalidations.reset();
+	}
+
+	void NearCache::enable (Command& parTracked) {
+		auto& local = *m_local_data;
+		if (local.active)
+			return;
+
+		//Tear down whatever is left of a previous, broken session first
+		local.invalidations.reset();
+		local.subscribed = std::promise<void>();
+		local.subscribe_confirmed = false;
+
+		std::unique_ptr<AsyncConnection> conn(new AsyncConnection(std::string(parTracked.address()), parTracked.port()));
+		conn->connect();
+		conn->wait_for_connect();
+		if (not conn->is_connected()) {
+			std::ostringstream oss;
+			oss << "Unable to open the invalidation connection: " << conn->connection_error();
+			throw std::runtime_error(oss.str());
+		}
+
+		std::promise<long long> id_promise;
+		auto id_future = id_promise.get_future();
+		auto subscribed_future = local.subscribed.get_future();
+		{
+			const char* client_id_argv[] = {"CLIENT", "ID"};
+			const std::size_t client_id_lengths[] = {6, 2};
+			const char* subscribe_argv[] = {"SUBSCRIBE", g_invalidation_channel};
+			const std::size_t subscribe_lengths[] = {9, sizeof(g_invalidation_channel) - 1};
+
+			TimedEventLock lock(conn->event_mutex(), conn->loop_stats());
+			redisAsyncCommandArgv(conn->connection(), &on_client_id, &id_promise, 2, client_id_argv, client_id_lengths);
+			redisAsyncCommandArgv(conn->connection(), &LocalData::on_invalidation, &local, 2, subscribe_argv, subscribe_lengths);
+		}
+		conn->wakeup_event_thread();
+		const long long client_id = id_future.get();
+		subscribed_future.get();
+		local.invalidations = std::move(conn);
+
+		StoredCommand tracking("CLIENT", "TRACKING", "ON", "REDIRECT", int_to_ary_dec(client_id).to<boost::string_view>());
+		if (not local.options.prefixes.empty()) {
+			tracking.push_back(boost::string_view("BCAST"));
+			for (const auto& prefix : local.options.prefixes) {
+				tracking.push_back(boost::string_view("PREFIX"));
+				tracking.push_back(boost::string_view(prefix));
+			}
+		}
+		auto batch = parTracked.make_batch();
+		tracking.run(batch);
+		batch.throw_if_failed();
+
+		local.clear();
+		local.active = true;
+	}
+
+	void NearCache::disable (Command& parTracked) {
+		auto& local = *m_local_data;
+		const bool was_active = local.active.exchange(false);
+		if (was_active and parTracked.is_connected()) {
+			try {
+				parTracked.run("CLIENT", "TRACKING", "OFF");
+			}
+			catch (const std::exception&) {
+			}
+		}
+		local.invalidations.reset();
+		local.clear();
+	}
+
+	bool NearCache::is_active (const Command& parTracked) {
+		auto& local = *m_local_data;
+		if (not local.active.load(std::memory_order_acquire))
+			return false;
+
+		if (not parTracked.is_connected() or not local.invalidations->is_connected()) {
+			local.active = false;
+			local.clear();
+			return false;
+		}
+		return true;
+	}
+
+	bool NearCache::find (boost::string_view parKey, opt_string& parValue) {
+		auto& local = *m_local_data;
+		if (not local.covers(parKey))
+			return false;
+		Shard& shard = local.shard(parKey);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it_entry = shard.find(parKey);
+		if (shard.lru.end() != it_entry and local.expired(*it_entry, clock_type::now())) {
+			shard.erase(it_entry);
+			it_entry = shard.lru.end();
+		}
+		if (shard.lru.end() == it_entry or not it_entry->has_value) {
+			local.misses.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		shard.lru.splice(shard.lru.begin(), shard.lru, it_entry);
+		parValue = it_entry->value;
+		local.hits.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool NearCache::find (boost::string_view parKey, boost::string_view parField, opt_string& parValue) {
+		auto& local = *m_local_data;
+		if (not local.covers(parKey))
+			return false;
+		Shard& shard = local.shard(parKey);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it_entry = shard.find(parKey);
+		if (shard.lru.end() != it_entry and local.expired(*it_entry, clock_type::now())) {
+			shard.erase(it_entry);
+			it_entry = shard.lru.end();
+		}
+		if (shard.lru.end() != it_entry) {
+			for (const auto& field : it_entry->fields) {
+				if (field.first == parField) {
+					shard.lru.splice(shard.lru.begin(), shard.lru, it_entry);
+					parValue = field.second;
+					local.hits.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+		}
+		local.misses.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	uint64_t NearCache::fetch_ticket (boost::string_view parKey) const {
+		return m_local_data->shard(parKey).epoch.load(std::memory_order_acquire);
+	}
+
+	void NearCache::store (boost::string_view parKey, uint64_t parTicket, const opt_string& parValue) {
+		auto& local = *m_local_data;
+		if (not local.covers(parKey))
+			return;
+		Shard& shard = local.shard(parKey);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		if (shard.epoch.load(std::memory_order_relaxed) != parTicket)
+			return;
+
+		Entry& entry = local.touch(shard, parKey);
+		entry.value = parValue;
+		entry.has_value = true;
+	}
+
+	void NearCache::store (boost::string_view parKey, boost::string_view parField, uint64_t parTicket, const opt_string& parValue) {
+		auto& local = *m_local_data;
+		if (not local.covers(parKey))
+			return;
+		Shard& shard = local.shard(parKey);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		if (shard.epoch.load(std::memory_order_relaxed) != parTicket)
+			return;
+
+		Entry& entry = local.touch(shard, parKey);
+		for (auto& field : entry.fields) {
+			if (field.first == parField) {
+				field.second = parValue;
+				return;
+			}
+		}
+		entry.fields.emplace_back(std::string(parField), parValue);
+	}
+
+	void NearCache::invalidate (boost::string_view parKey) {
+		auto& local = *m_local_data;
+		Shard& shard = local.shard(parKey);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it_entry = shard.find(parKey);
+		if (shard.lru.end() != it_entry)
+			shard.erase(it_entry);
+		shard.epoch.fetch_add(1, std::memory_order_release);
+		local.invalidation_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void NearCache::clear() {
+		m_local_data->clear();
+	}
+
+	std::size_t NearCache::size() const {
+		std::size_t retval = 0;
+		for (auto& shard : m_local_data->shards) {
+			std::lock_guard<std::mutex> lock(shard->mutex);
+			retval += shard->index.size();
+		}
+		return retval;
+	}
+
+	NearCacheStats NearCache::stats() const {
+		const auto& local = *m_local_data;
+		NearCacheStats retval;
+		retval.hits = local.hits.load(std::memory_order_relaxed);
+		retval.misses = local.misses.load(std::memory_order_relaxed);
+		retval.invalidations = local.invalidation_count.load(std::memory_order_relaxed);
+		retval.evictions = local.evictions.load(std::memory_order_relaxed);
+		return retval;
+	}
+} //namespace redis
@@ -0,0 +1,178 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parallel_scan.hpp"
+#include "incredis.hpp"
+#include "bounded_queue.hpp"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <stdexcept>
+#include <sstream>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		struct ScannedPage {
+			std::size_t source;
+			std::vector<std::string> keys;
+		};
+
+		class FirstError {
+		public:
+			FirstError ( void ) : m_mutex(), m_error(), m_failed(false) {}
+
+			void set ( std::exception_ptr parError ) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (not m_error)
+					m_error = parError;
+				m_failed = true;
+			}
+			bool failed ( void ) const { return m_failed; }
+			void rethrow_if_failed ( void ) {
+				if (m_error)
+					std::rethrow_exception(m_error);
+			}
+
+		private:
+			std::mutex m_mutex;
+			std::exception_ptr m_error;
+			std::atomic_bool m_failed;
+		};
+	} //unnamed namespace
+
+	ParallelScan::ParallelScan (std::size_t parWorkerCount, std::size_t parQueuedPages) :
+		m_sources(),
+		m_worker_count(parWorkerCount),
+		m_queued_pages(parQueuedPages)
+	{
+		assert(m_worker_count > 0);
+		assert(m_queued_pages > 0);
+	}
+
+	ParallelScan::~ParallelScan() noexcept = default;
+
+	std::size_t ParallelScan::add_source (std::string&& parAddress, uint16_t parPort, uint32_t parDB) {
+		m_sources.push_back(Source{std::move(parAddress), parPort, parDB});
+		return m_sources.size() - 1;
+	}
+
+	std::size_t ParallelScan::add_source (std::string&& parSocket, uint32_t parDB) {
+		return add_source(std::move(parSocket), 0, parDB);
+	}
+
+	std::size_t ParallelScan::run (Callback parCallback, boost::string_view parPattern, const ScanOptions& parOptions) {
+		assert(parCallback);
+
+		BoundedQueue<ScannedPage> queue(m_queued_pages);
+		FirstError error;
+		std::atomic_size_t key_count(0);
+		std::atomic_size_t running_producers(m_sources.size());
+		const std::string pattern(parPattern);
+
+		auto produce = [&](std::size_t parSourceIndex) {
+			try {
+				const Source& source = m_sources[parSourceIndex];
+				IncRedis incredis(std::string(source.address), source.port);
+				incredis.connect();
+				incredis.wait_for_connect();
+				if (not incredis.is_connected()) {
+					std::ostringstream oss;
+					oss << "Unable to connect to Redis server at " << source.address << ':' << source.port << ": " << incredis.command().connection_error();
+					throw std::runtime_error(oss.str());
+				}
+				if (source.db) {
+					auto batch = incredis.make_batch();
+					batch.select(static_cast<int>(source.db));
+					batch.throw_if_failed();
+				}
+
+				for (auto& page : incredis.scan_pages(parOptions, pattern)) {
+					if (error.failed() or not queue.push(ScannedPage{parSourceIndex, std::move(page)}))
+						break;
+				}
+			}
+			catch (...) {
+				error.set(std::current_exception());
+				queue.close();
+			}
+
+			if (1 == running_producers.fetch_sub(1))
+				queue.close();
+		};
+
+		//Pages still queued after a failure are dropped, the callback is
+		//not called again
+		auto consume = [&]() {
+			ScannedPage page;
+			while (not error.failed() and queue.pop(page)) {
+				try {
+					for (auto& key : page.keys) {
+						if (error.failed())
+							break;
+						parCallback(page.source, std::move(key));
+						++key_count;
+					}
+				}
+				catch (...) {
+					error.set(std::current_exception());
+					queue.close();
+				}
+			}
+		};
+
+		std::vector<std::thread> producers;
+		std::vector<std::thread> workers;
+		//Closing the queue wakes up every thread blocked on it, after that
+		//producers stop at their next page and workers find nothing to pop
+		auto join_all = [&]() {
+			for (auto& producer : producers) {
+				producer.join();
+			}
+			for (auto& worker : workers) {
+				worker.join();
+			}
+		};
+
+		try {
+			producers.reserve(m_sources.size());
+			for (std::size_t source_index = 0; source_index < m_sources.size(); ++source_index) {
+				producers.emplace_back(produce, source_index);
+			}
+			workers.reserve(m_worker_count);
+			for (std::size_t z = 0; z < m_worker_count; ++z) {
+				workers.emplace_back(consume);
+			}
+		}
+		catch (...) {
+			//Starting a thread failed, the ones already running must not be
+			//destroyed while still joinable
+			queue.close();
+			join_all();
+			throw;
+		}
+
+		if (m_sources.empty())
+			queue.close();
+		join_all();
+
+		error.rethrow_if_failed();
+		return key_count;
+	}
+} //namespace redis
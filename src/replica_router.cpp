@@ -0,0 +1,370 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replica_router.hpp"
+#include "command.hpp"
+#include "batch.hpp"
+#include "command_table.hpp"
+#include "incredis/int_conv.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		typedef std::chrono::steady_clock clock_type;
+
+		//One read in this many skips the latency comparison, so that a
+		//replica that looked slow once gets sampled again
+		const std::size_t g_probe_read_every = 64;
+
+		struct Replica {
+			Replica ( Command&& parCommand, uint32_t parDb ) :
+				command(std::move(parCommand)),
+				db(parDb),
+				fresh(true)
+			{
+			}
+
+			Command command;
+			uint32_t db;
+			std::atomic<bool> fresh;
+		};
+
+		//Returns the value of parField from the "field:value" lines of an
+		//INFO reply, or an empty view if it's not there
+		boost::string_view info_field (boost::string_view parInfo, boost::string_view parField) {
+			std::size_t line_start = 0;
+			while (line_start < parInfo.size()) {
+				std::size_t line_end = parInfo.find('\n', line_start);
+				if (boost::string_view::npos == line_end)
+					line_end = parInfo.size();
+				boost::string_view line = parInfo.substr(line_start, line_end - line_start);
+				if (not line.empty() and line.back() == '\r')
+					line.remove_suffix(1);
+				if (line.size() > parField.size() and line.starts_with(parField) and line[parField.size()] == ':')
+					return line.substr(parField.size() + 1);
+				line_start = line_end + 1;
+			}
+			return boost::string_view();
+		}
+
+		bool is_fresh (const Reply& parInfo, std::chrono::seconds parMaxStaleness) {
+			if (not parInfo.is_string())
+				return false;
+			const std::string& info = get_string(parInfo);
+			if (info_field(info, "master_link_status") != "up")
+				return false;
+
+			const boost::string_view last_io = info_field(info, "master_last_io_seconds_ago");
+			if (last_io.empty())
+				return false;
+			const long long seconds_ago = std::stoll(std::string(last_io));
+			return seconds_ago >= 0 and seconds_ago <= parMaxStaleness.count();
+		}
+
+		bool is_fresh (Command& parReplica, std::chrono::seconds parMaxStaleness) {
+			if (not parReplica.is_connected())
+				return false;
+			return is_fresh(parReplica.run("INFO", "replication"), parMaxStaleness);
+		}
+
+		//INFO replication sent to a replica by a background health check
+		struct PendingCheck {
+			PendingCheck ( Replica& parReplica, Batch&& parBatch ) :
+				replica(&parReplica),
+				batch(std::move(parBatch))
+			{
+			}
+
+			Replica* replica;
+			Batch batch;
+		};
+	} //unnamed namespace
+
+	struct ReplicaRouter::LocalData {
+		LocalData ( void ) :
+			replicas(),
+			policy(),
+			policy_mutex(),
+			check_mutex(),
+			pending_checks(),
+			next_check(clock_type::time_point().time_since_epoch().count()),
+			next_replica(0),
+			replica_reads(true),
+			latency_aware(policy.latency_aware),
+			hedge_reads(policy.hedge_reads),
+			abandoned_mutex(),
+			abandoned()
+		{
+		}
+
+		std::vector<std::unique_ptr<Replica>> replicas;
+		ReplicaPolicy policy;
+		mutable std::mutex policy_mutex;
+		std::mutex check_mutex;
+		std::vector<PendingCheck> pending_checks;
+		std::atomic<clock_type::rep> next_check;
+		std::atomic<std::size_t> next_replica;
+		std::atomic<bool> replica_reads;
+		std::atomic<bool> latency_aware;
+		std::atomic<bool> hedge_reads;
+		std::mutex abandoned_mutex;
+		std::list<Batch> abandoned;
+	};
+
+	ReplicaRouter::ReplicaRouter() :
+		m_local_data(new LocalData)
+	{
+	}
+
+	ReplicaRouter::ReplicaRouter (ReplicaRouter&&) = default;
+
+	ReplicaRouter::~ReplicaRouter() noexcept = default;
+
+	void ReplicaRouter::add_replica (std::string&& parAddress, uint16_t parPort, uint32_t parDb) {
+		m_local_data->replicas.emplace_back(new Replica(Command(std::move(parAddress), parPort), parDb));
+	}
+
+	void ReplicaRouter::add_replica (std::string&& parSocket, uint32_t parDb) {
+		m_local_data->replicas.emplace_back(new Replica(Command(std::move(parSocket)), parDb));
+	}
+
+	void ReplicaRouter::connect() {
+		for (auto& replica : m_local_data->replicas) {
+			replica->command.connect();
+		}
+	}
+
+	void ReplicaRouter::wait_for_connect() {
+		for (auto& replica : m_local_data->replicas) {
+			replica->command.wait_for_connect();
+			if (replica->db and replica->command.is_connected())
+				replica->command.run("SELECT", int_to_ary_dec(replica->db).to<boost::string_view>());
+		}
+	}
+
+	void ReplicaRouter::disconnect() {
+		for (auto& replica : m_local_data->replicas) {
+			replica->command.disconnect();
+		}
+	}
+
+	void ReplicaRouter::wait_for_disconnect() {
+		for (auto& replica : m_local_data->replicas) {
+			replica->command.wait_for_disconnect();
+		}
+	}
+
+	void ReplicaRouter::set_policy (const ReplicaPolicy& parPolicy) {
+		std::lock_guard<std::mutex> lock(m_local_data->policy_mutex);
+		m_local_data->policy = parPolicy;
+		m_local_data->replica_reads = (ReplicaPolicy::ReadFrom_Replica == parPolicy.read_from);
+		m_local_data->latency_aware = parPolicy.latency_aware;
+		m_local_data->hedge_reads = parPolicy.hedge_reads;
+		m_local_data->next_check = clock_type::time_point().time_since_epoch().count();
+	}
+
+	ReplicaPolicy ReplicaRouter::policy() const {
+		std::lock_guard<std::mutex> lock(m_local_data->policy_mutex);
+		return m_local_data->policy;
+	}
+
+	std::size_t ReplicaRouter::replica_count() const {
+		return m_local_data->replicas.size();
+	}
+
+	Command& ReplicaRouter::replica (std::size_t parIndex) {
+		assert(parIndex < m_local_data->replicas.size());
+		return m_local_data->replicas[parIndex]->command;
+	}
+
+	void ReplicaRouter::check_replicas() {
+		const ReplicaPolicy current_policy = policy();
+		for (auto& replica : m_local_data->replicas) {
+			bool fresh;
+			try {
+				fresh = is_fresh(replica->command, current_policy.max_staleness);
+			}
+			catch (const std::exception&) {
+				fresh = false;
+			}
+			replica->fresh.store(fresh, std::memory_order_release);
+		}
+	}
+
+	//Never waits for the server: when a check is due INFO is sent to every
+	//replica, and a later call collects the replies once they all arrived.
+	//Only one thread does this, the others keep using the last known state.
+	void ReplicaRouter::check_replicas_if_due() {
+		auto& local = *m_local_data;
+		const auto now = clock_type::now().time_since_epoch().count();
+		if (now < local.next_check.load(std::memory_order_relaxed))
+			return;
+
+		std::unique_lock<std::mutex> lock(local.check_mutex, std::try_to_lock);
+		if (not lock.owns_lock() or now < local.next_check.load(std::memory_order_relaxed))
+			return;
+
+		const ReplicaPolicy current_policy = policy();
+		const auto interval = std::chrono::duration_cast<clock_type::duration>(current_policy.health_check_interval);
+		if (interval.count() == 0) {
+			for (auto& replica : local.replicas) {
+				replica->fresh.store(true, std::memory_order_release);
+			}
+			local.next_check.store(clock_type::time_point::max().time_since_epoch().count(), std::memory_order_relaxed);
+			return;
+		}
+
+		if (local.pending_checks.empty()) {
+			for (auto& replica : local.replicas) {
+				if (replica->command.is_connected()) {
+					local.pending_checks.emplace_back(*replica, replica->command.make_batch());
+					local.pending_checks.back().batch.run("INFO", "replication");
+				}
+				else {
+					replica->fresh.store(false, std::memory_order_release);
+				}
+			}
+			if (not local.pending_checks.empty())
+				return;
+		}
+		else {
+			for (const auto& check : local.pending_checks) {
+				if (not check.batch.replies_ready())
+					return;
+			}
+			for (auto& check : local.pending_checks) {
+				bool fresh;
+				try {
+					fresh = is_fresh(check.batch.replies_nonconst().front(), current_policy.max_staleness);
+				}
+				catch (const std::exception&) {
+					fresh = false;
+				}
+				check.replica->fresh.store(fresh, std::memory_order_release);
+			}
+			local.pending_checks.clear();
+		}
+		local.next_check.store((clock_type::now() + interval).time_since_epoch().count(), std::memory_order_relaxed);
+	}
+
+	Command& ReplicaRouter::read_command (Command& parPrimary) {
+		auto& local = *m_local_data;
+		if (local.replicas.empty() or not local.replica_reads.load(std::memory_order_relaxed))
+			return parPrimary;
+
+		check_replicas_if_due();
+
+		const std::size_t count = local.replicas.size();
+		const std::size_t read_number = local.next_replica.fetch_add(1, std::memory_order_relaxed);
+		const bool probe = (0 == read_number % g_probe_read_every);
+		//Probes walk the replicas in turn on their own
+		const std::size_t start = (probe ? read_number / g_probe_read_every : read_number);
+		Command* chosen = nullptr;
+		for (std::size_t z = 0; z < count; ++z) {
+			Replica& replica = *local.replicas[(start + z) % count];
+			if (not replica.fresh.load(std::memory_order_acquire) or not replica.command.is_connected())
+				continue;
+
+			if (not chosen) {
+				chosen = &replica.command;
+				if (probe or not local.latency_aware.load(std::memory_order_relaxed))
+					break;
+			}
+			else {
+				if (replica.command.latency().mean < chosen->latency().mean)
+					chosen = &replica.command;
+				break;
+			}
+		}
+		return (chosen ? *chosen : parPrimary);
+	}
+
+	Command& ReplicaRouter::command_for (Command& parPrimary, boost::string_view parCommandName) {
+		if (is_read_only_command(parCommandName))
+			return read_command(parPrimary);
+		else
+			return parPrimary;
+	}
+
+	bool ReplicaRouter::hedging_enabled() const {
+		const auto& local = *m_local_data;
+		return not local.replicas.empty() and local.replica_reads.load(std::memory_order_relaxed) and local.hedge_reads.load(std::memory_order_relaxed);
+	}
+
+	//The fastest usable node other than parFirst, the primary included
+	Command* ReplicaRouter::hedge_target (Command& parPrimary, const Command& parFirst) {
+		Command* retval = (&parFirst != &parPrimary and parPrimary.is_connected() ? &parPrimary : nullptr);
+		for (auto& replica : m_local_data->replicas) {
+			if (&replica->command == &parFirst or not replica->fresh.load(std::memory_order_acquire) or not replica->command.is_connected())
+				continue;
+			if (not retval or replica->command.latency().mean < retval->latency().mean)
+				retval = &replica->command;
+		}
+		return retval;
+	}
+
+	//Destroying a Batch waits for its replies, so the losing one is parked
+	//here until its reply arrives rather than blocking the caller
+	void ReplicaRouter::abandon (Batch&& parBatch) {
+		auto& local = *m_local_data;
+		std::lock_guard<std::mutex> lock(local.abandoned_mutex);
+		local.abandoned.remove_if([](const Batch& parOld) { return parOld.replies_ready(); });
+		local.abandoned.push_back(std::move(parBatch));
+	}
+
+	Reply ReplicaRouter::run_hedged (Command& parPrimary, const StoredCommand& parCommand) {
+		Command& first = read_command(parPrimary);
+		Batch first_batch = first.make_batch();
+		parCommand.run(first_batch);
+
+		Command* const second = hedge_target(parPrimary, first);
+		const std::chrono::microseconds delay = std::max(
+			std::chrono::duration_cast<std::chrono::microseconds>(first.latency().p95()),
+			policy().min_hedge_delay
+		);
+		if (not second or first_batch.wait_for_replies(delay)) {
+			first_batch.throw_if_failed();
+			return std::move(first_batch.replies_nonconst().front());
+		}
+
+		Batch second_batch = second->make_batch();
+		parCommand.run(second_batch);
+		const std::chrono::microseconds slice = std::max(delay / 8, std::chrono::microseconds(20));
+		Batch* winner;
+		while (true) {
+			if (first_batch.replies_ready()) {
+				winner = &first_batch;
+				abandon(std::move(second_batch));
+				break;
+			}
+			if (second_batch.wait_for_replies(slice)) {
+				winner = &second_batch;
+				abandon(std::move(first_batch));
+				break;
+			}
+		}
+
+		winner->throw_if_failed();
+		return std::move(winner->replies_nonconst().front());
+	}
+} //namespace redis
@@ -52,6 +52,11 @@ namespace redis {
 		return boost::get<std::vector<Reply>>(parReply);
 	}
 
+	std::vector<Reply>& get_array (Reply& parReply) {
+		assert(parReply.is_array());
+		return boost::get<std::vector<Reply>>(parReply);
+	}
+
 	const ErrorString& get_error_string (const Reply& parReply) {
 		assert(parReply.is_error());
 		return boost::get<ErrorString>(parReply);
@@ -88,11 +93,33 @@ namespace redis {
 		return boost::get<StatusString>(parReply);
 	}
 
+	template <>
+	std::string take<std::string> (Reply& parReply) {
+		if (parReply.is_nil())
+			return std::string();
+
+		assert(parReply.is_string());
+		return std::move(boost::get<std::string>(parReply));
+	}
+
+	template <>
+	std::vector<Reply> take<std::vector<Reply>> (Reply& parReply) {
+		return std::move(get_array(parReply));
+	}
+
+	template <>
+	RedisInt take<RedisInt> (Reply& parReply) {
+		return get_integer(parReply);
+	}
+
 	template const std::string& get<std::string> ( const Reply& parReply );
 	template const std::vector<Reply>& get<std::vector<Reply>> ( const Reply& parReply );
 	template const RedisInt& get<RedisInt> ( const Reply& parReply );
 	template const ErrorString& get<ErrorString> ( const Reply& parReply );
 	template const StatusString& get<StatusString> ( const Reply& parReply );
+	template std::string take<std::string> ( Reply& parReply );
+	template std::vector<Reply> take<std::vector<Reply>> ( Reply& parReply );
+	template RedisInt take<RedisInt> ( Reply& parReply );
 
 	bool Reply::is_integer() const {
 		return RedisVariantType_Integer == this->which();
@@ -0,0 +1,63 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id7527402451504BA6B95B81775E1AB03D
+#define id7527402451504BA6B95B81775E1AB03D
+
+#include "incredis/reply.hpp"
+#include <sstream>
+#include <ostream>
+#include <stdexcept>
+#include <cstddef>
+
+namespace redis {
+	namespace implem {
+		template <typename R>
+		int array_throw_if_failed (int parErrCount, int parMaxReportedErrors, const R& parReplies, std::ostream& parStream) {
+			int err_count = 0;
+			for (const auto& rep : parReplies) {
+				if (rep.which() == RedisVariantType_Error) {
+					++err_count;
+					if (err_count + parErrCount <= parMaxReportedErrors)
+						parStream << '"' << get_error_string(rep).message() << "\" ";
+				}
+				else if (rep.which() == RedisVariantType_Array) {
+					err_count += array_throw_if_failed(err_count + parErrCount, parMaxReportedErrors, get_array(rep), parStream);
+				}
+			}
+			return err_count;
+		}
+	} //namespace implem
+
+	//Throws a std::runtime_error quoting the first few errors in
+	//parReplies, including the ones nested in array replies such as the
+	//result of EXEC. Shared by all the batch flavours.
+	template <typename R>
+	void throw_if_reply_errors (const R& parReplies, std::size_t parReplyCount) {
+		std::ostringstream oss;
+		const int max_reported_errors = 3;
+
+		oss << "Error in reply: ";
+		const int err_count = implem::array_throw_if_failed(0, max_reported_errors, parReplies, oss);
+		if (err_count) {
+			oss << " (showing " << err_count << '/' << max_reported_errors << " errors on " << parReplyCount << " total replies)";
+			throw std::runtime_error(oss.str());
+		}
+	}
+} //namespace redis
+
+#endif
@@ -0,0 +1,114 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scan_demux.hpp"
+#include "incredis.hpp"
+#include <cassert>
+#include <ciso646>
+#include <algorithm>
+
+namespace redis {
+	ScanDemux::Entry::Entry (boost::string_view parPattern, Callback&& parCallback) :
+		pattern(parPattern),
+		callback(std::move(parCallback)),
+		matches(0)
+	{
+	}
+
+	ScanDemux::ScanDemux() :
+		m_patterns(),
+		m_by_first_char(),
+		m_unprefixed()
+	{
+	}
+
+	ScanDemux::~ScanDemux() noexcept = default;
+
+	std::size_t ScanDemux::add (boost::string_view parPattern, Callback parCallback) {
+		assert(parCallback);
+		const std::size_t index = m_patterns.size();
+		m_patterns.emplace_back(parPattern, std::move(parCallback));
+
+		//Patterns with a literal prefix only need to be tried on keys
+		//starting with the same character
+		const std::string& prefix = m_patterns.back().pattern.literal_prefix();
+		if (prefix.empty())
+			m_unprefixed.push_back(index);
+		else
+			m_by_first_char[static_cast<uint8_t>(prefix.front())].push_back(index);
+		return index;
+	}
+
+	std::size_t ScanDemux::dispatch (const std::string& parKey) {
+		std::size_t matched = 0;
+		if (not parKey.empty()) {
+			for (auto index : m_by_first_char[static_cast<uint8_t>(parKey.front())]) {
+				Entry& entry = m_patterns[index];
+				if (entry.pattern.match(parKey)) {
+					++entry.matches;
+					++matched;
+					entry.callback(parKey);
+				}
+			}
+		}
+		for (auto index : m_unprefixed) {
+			Entry& entry = m_patterns[index];
+			if (entry.pattern.match(parKey)) {
+				++entry.matches;
+				++matched;
+				entry.callback(parKey);
+			}
+		}
+		return matched;
+	}
+
+	std::size_t ScanDemux::run (IncRedis& parIncRedis, const ScanOptions& parOptions) {
+		if (m_patterns.empty())
+			return 0;
+
+		const std::string match_pattern = server_pattern();
+		std::size_t scanned = 0;
+		for (const auto& page : parIncRedis.scan_pages(parOptions, match_pattern)) {
+			for (const auto& key : page) {
+				dispatch(key);
+			}
+			scanned += page.size();
+		}
+		return scanned;
+	}
+
+	std::size_t ScanDemux::match_count (std::size_t parIndex) const {
+		assert(parIndex < m_patterns.size());
+		return m_patterns[parIndex].matches;
+	}
+
+	std::string ScanDemux::server_pattern() const {
+		if (m_patterns.empty() or not m_unprefixed.empty())
+			return std::string();
+
+		//Longest literal prefix common to all patterns
+		boost::string_view common(m_patterns.front().pattern.literal_prefix());
+		for (const auto& entry : m_patterns) {
+			const std::string& prefix = entry.pattern.literal_prefix();
+			const auto mismatch = std::mismatch(common.begin(), common.end(), prefix.begin(), prefix.end());
+			common = common.substr(0, static_cast<std::size_t>(mismatch.first - common.begin()));
+		}
+		if (common.empty())
+			return std::string();
+		return glob_escape(common) + "*";
+	}
+} //namespace redis
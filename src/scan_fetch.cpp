@@ -0,0 +1,86 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scan_fetch.hpp"
+#include <cassert>
+#include <ciso646>
+#include <iterator>
+
+namespace redis {
+	ScanFetchCommand::ScanFetchCommand (std::vector<std::string>&& parArgs, std::size_t parKeyPosition) :
+		m_args(std::move(parArgs)),
+		m_key_position(parKeyPosition)
+	{
+		assert(not m_args.empty());
+		assert(m_key_position > 0);
+		assert(m_key_position <= m_args.size());
+	}
+
+	ScanFetchCommand ScanFetchCommand::get() {
+		return ScanFetchCommand({"GET"}, 1);
+	}
+
+	ScanFetchCommand ScanFetchCommand::hgetall() {
+		return ScanFetchCommand({"HGETALL"}, 1);
+	}
+
+	ScanFetchCommand ScanFetchCommand::hget (boost::string_view parField) {
+		return ScanFetchCommand({"HGET", std::string(parField)}, 1);
+	}
+
+	ScanFetchCommand ScanFetchCommand::hmget (std::vector<std::string>&& parFields) {
+		assert(not parFields.empty());
+		std::vector<std::string> args;
+		args.reserve(parFields.size() + 1);
+		args.emplace_back("HMGET");
+		std::move(parFields.begin(), parFields.end(), std::back_inserter(args));
+		return ScanFetchCommand(std::move(args), 1);
+	}
+
+	ScanFetchCommand ScanFetchCommand::type() {
+		return ScanFetchCommand({"TYPE"}, 1);
+	}
+
+	ScanFetchCommand ScanFetchCommand::ttl() {
+		return ScanFetchCommand({"TTL"}, 1);
+	}
+
+	ScanFetchCommand ScanFetchCommand::pttl() {
+		return ScanFetchCommand({"PTTL"}, 1);
+	}
+
+	ScanFetchCommand ScanFetchCommand::memory_usage() {
+		return ScanFetchCommand({"MEMORY", "USAGE"}, 2);
+	}
+
+	void ScanFetchCommand::enqueue (Batch& parBatch, boost::string_view parKey, std::vector<const char*>& parArgv, std::vector<std::size_t>& parLengths) const {
+		parArgv.clear();
+		parLengths.clear();
+		for (std::size_t z = 0; z <= m_args.size(); ++z) {
+			if (z == m_key_position) {
+				parArgv.push_back(parKey.data());
+				parLengths.push_back(parKey.size());
+			}
+			if (z < m_args.size()) {
+				parArgv.push_back(m_args[z].data());
+				parLengths.push_back(m_args[z].size());
+			}
+		}
+		assert(parArgv.size() == m_args.size() + 1);
+		parBatch.run_argv(static_cast<int>(parArgv.size()), parArgv.data(), parLengths.data());
+	}
+} //namespace redis
@@ -21,42 +21,131 @@
 #include <cassert>
 #include <ciso646>
 #include <string>
+#include <algorithm>
+#include <utility>
 
 namespace redis {
 	namespace implem {
-		ScanIteratorBaseClass::ScanIteratorBaseClass (Command* parCommand) :
-			ScanIteratorBaseClass(parCommand, boost::string_view())
-		{
-		}
+		struct PendingScan {
+			PendingScan ( Batch&& parBatch, const char* parCommand, RedisInt parScanContext ) :
+				batch(std::move(parBatch)),
+				sent(std::chrono::steady_clock::now()),
+				command(parCommand),
+				scan_context(parScanContext)
+			{
+			}
+
+			Batch batch;
+			std::chrono::steady_clock::time_point sent;
+			const char* command;
+			RedisInt scan_context;
+		};
 
-		ScanIteratorBaseClass::ScanIteratorBaseClass (Command* parCommand, boost::string_view parMatchPattern) :
+		ScanIteratorBaseClass::ScanIteratorBaseClass (Command* parCommand, boost::string_view parMatchPattern, const ScanOptions& parOptions, std::size_t parDefaultCount) :
 			m_command(parCommand),
-			m_match_pattern(parMatchPattern)
+			m_match_pattern(parMatchPattern),
+			m_pending(),
+			m_options(parOptions),
+			m_count(parOptions.count ? parOptions.count : parDefaultCount)
 		{
 			assert(m_command);
 			assert(m_command->is_connected());
+			assert(m_count > 0);
+			assert(m_options.min_count <= m_options.max_count);
 		}
 
 		bool ScanIteratorBaseClass::is_connected() const {
 			return m_command and m_command->is_connected();
 		}
 
-		Reply ScanIteratorBaseClass::run (const char* parCommand, RedisInt parScanContext, std::size_t parCount) {
-			const auto scan_context = int_conv<std::string>(parScanContext);
-			const auto count_hint = int_conv<std::string>(parCount);
-			if (m_match_pattern.empty())
-				return m_command->run(parCommand, scan_context, "COUNT", count_hint);
-			else
-				return m_command->run(parCommand, scan_context, "MATCH", m_match_pattern, "COUNT", count_hint);
+		Reply ScanIteratorBaseClass::run (const char* parCommand, RedisInt parScanContext) {
+			return fetch(parCommand, nullptr, parScanContext);
+		}
+
+		Reply ScanIteratorBaseClass::run (const char* parCommand, const boost::string_view& parParameter, RedisInt parScanContext) {
+			return fetch(parCommand, &parParameter, parScanContext);
+		}
+
+		void ScanIteratorBaseClass::prefetch (const char* parCommand, RedisInt parScanContext) {
+			start_prefetch(parCommand, nullptr, parScanContext);
+		}
+
+		void ScanIteratorBaseClass::prefetch (const char* parCommand, const boost::string_view& parParameter, RedisInt parScanContext) {
+			start_prefetch(parCommand, &parParameter, parScanContext);
+		}
+
+		Reply ScanIteratorBaseClass::fetch (const char* parCommand, const boost::string_view* parParameter, RedisInt parScanContext) {
+			using std::chrono::steady_clock;
+
+			//Copies of this iterator share the same pending request, so the
+			//reply can only be stolen by whoever holds the last reference
+			if (m_pending and m_pending->scan_context == parScanContext and m_pending->command == parCommand) {
+				const bool was_ready = m_pending->batch.replies_ready();
+				m_pending->batch.throw_if_failed();
+				update_count_hint(steady_clock::now() - m_pending->sent, was_ready);
+
+				std::shared_ptr<PendingScan> pending;
+				pending.swap(m_pending);
+				if (1 == pending.use_count())
+					return std::move(pending->batch.replies_nonconst().front());
+				else
+					return pending->batch.replies().front();
+			}
+			m_pending.reset();
+
+			auto batch = m_command->make_batch();
+			const auto start = steady_clock::now();
+			enqueue(batch, parCommand, parParameter, parScanContext);
+			batch.throw_if_failed();
+			update_count_hint(steady_clock::now() - start, false);
+			return std::move(batch.replies_nonconst().front());
 		}
 
-		Reply ScanIteratorBaseClass::run (const char* parCommand, const boost::string_view& parParameter, RedisInt parScanContext, std::size_t parCount) {
+		void ScanIteratorBaseClass::start_prefetch (const char* parCommand, const boost::string_view* parParameter, RedisInt parScanContext) {
+			if (not m_options.prefetch or not parScanContext)
+				return;
+
+			m_pending = std::make_shared<PendingScan>(m_command->make_batch(), parCommand, parScanContext);
+			enqueue(m_pending->batch, parCommand, parParameter, parScanContext);
+		}
+
+		void ScanIteratorBaseClass::enqueue (Batch& parBatch, const char* parCommand, const boost::string_view* parParameter, RedisInt parScanContext) const {
 			const auto scan_context = int_conv<std::string>(parScanContext);
-			const auto count_hint = int_conv<std::string>(parCount);
-			if (m_match_pattern.empty())
-				return m_command->run(parCommand, parParameter, scan_context, "COUNT", count_hint);
-			else
-				return m_command->run(parCommand, parParameter, scan_context, "MATCH", m_match_pattern, "COUNT", count_hint);
+			const auto count_hint = int_conv<std::string>(m_count);
+			if (parParameter) {
+				if (m_match_pattern.empty())
+					parBatch.run(parCommand, *parParameter, scan_context, "COUNT", count_hint);
+				else
+					parBatch.run(parCommand, *parParameter, scan_context, "MATCH", m_match_pattern, "COUNT", count_hint);
+			}
+			else {
+				if (m_match_pattern.empty())
+					parBatch.run(parCommand, scan_context, "COUNT", count_hint);
+				else
+					parBatch.run(parCommand, scan_context, "MATCH", m_match_pattern, "COUNT", count_hint);
+			}
+		}
+
+		void ScanIteratorBaseClass::update_count_hint (std::chrono::steady_clock::duration parElapsed, bool parWasReady) {
+			using std::chrono::duration_cast;
+			using std::chrono::microseconds;
+
+			const auto target = m_options.target_latency.count();
+			if (target <= 0)
+				return;
+
+			//If the reply was already there when we got to it, parElapsed is
+			//only an upper bound of the real latency, so it can be trusted
+			//to grow the page but not to shrink it
+			const auto elapsed = std::max<microseconds::rep>(duration_cast<microseconds>(parElapsed).count(), 1);
+			if (elapsed * 2 < target) {
+				m_count = std::min(m_count * 2, m_options.max_count);
+			}
+			else if (not parWasReady and elapsed > target) {
+				const auto scaled = static_cast<std::size_t>(static_cast<double>(m_count) * target / elapsed);
+				m_count = std::max(scaled, m_options.min_count);
+			}
+			m_count = std::max<std::size_t>(m_count, 1);
 		}
 	} //namespace implem
 } //namespace redis
@@ -19,14 +19,22 @@
 
 namespace redis {
 	Script::Script() :
-		m_sha1(),
+		m_script(),
 		m_manager(nullptr)
 	{
 	}
 
-	Script::Script (boost::string_view parSha1, ScriptManager& parManager) :
-		m_sha1(parSha1),
+	Script::Script (const LuaScript& parScript, ScriptManager& parManager) :
+		m_script(parScript),
 		m_manager(&parManager)
 	{
 	}
+
+	//If an earlier EVALSHA found the server without scripts reload them
+	//all now, rather than falling back to EVAL once for each of them
+	void Script::send (Batch& parBatch, StoredCommand&& parEvalSha) {
+		m_manager->reload_if_stale();
+		m_manager->load(m_script);
+		parBatch.run_evalsha(std::move(parEvalSha), m_script, *m_manager);
+	}
 } //namespace redis
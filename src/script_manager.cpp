@@ -16,100 +16,126 @@
  */
 
 #include "script_manager.hpp"
-#include "incredis/int_conv.hpp"
 #include "command.hpp"
+#include "sha1.hpp"
 #include <cassert>
-#if defined(MAKE_SHA1_WITH_CRYPTOPP)
-#	include <crypto++/sha.h>
-#endif
+#include <tuple>
+#include <utility>
+#include <ciso646>
 
 namespace redis {
-	namespace {
-#if defined(MAKE_SHA1_WITH_CRYPTOPP)
-		struct LuaScriptHash {
-			union {
-				struct {
-					uint64_t part_a, part_b;
-					uint32_t part_c;
-				};
-				uint8_t raw_bytes[20];
-			};
-		};
-#endif
-	} //unnamed namespace
-
 	ScriptManager::ScriptManager (Command* parCommand) :
-		m_command(parCommand)
+		m_command(parCommand),
+		m_known_scripts(),
+		m_mutex(),
+		m_stale(false)
 	{
 		assert(m_command);
 	}
 
-#if defined(MAKE_SHA1_WITH_CRYPTOPP)
-	boost::string_view ScriptManager::add_lua_script_ifn (const boost::string_view& parScript) {
+	LuaScript ScriptManager::submit_lua_script (const boost::string_view& parScript) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return add_script(parScript);
+	}
+
+	std::vector<LuaScript> ScriptManager::preload (const std::vector<boost::string_view>& parScripts) {
 		assert(m_command->is_connected());
+		std::lock_guard<std::mutex> lock(m_mutex);
 
-		if (parScript.empty())
-			return boost::string_view();
-
-		static_assert(20 == CryptoPP::SHA1::DIGESTSIZE, "Unexpected SHA1 digest size");
-		static_assert(sizeof(LuaScriptHash) >= CryptoPP::SHA1::DIGESTSIZE, "Wrong SHA1 struct size");
-		static_assert(Sha1Array().size() == CryptoPP::SHA1::DIGESTSIZE * 2, "Wrong array size");
-
-		LuaScriptHash digest;
-		CryptoPP::SHA1().CalculateDigest(digest.raw_bytes, reinterpret_cast<const uint8_t*>(parScript.data()), parScript.size());
-		//TODO: change when lexical_cast will support arrays
-		auto sha1_str_parta = int_to_ary_hex(__builtin_bswap64(digest.part_a));
-		auto sha1_str_partb = int_to_ary_hex(__builtin_bswap64(digest.part_b));
-		auto sha1_str_partc = int_to_ary_hex(__builtin_bswap32(digest.part_c));
-		const std::string sha1_str =
-			std::string(sizeof(digest.part_a) * 2 - sha1_str_parta.size() + 1, '0') + sha1_str_parta +
-			std::string(sizeof(digest.part_b) * 2 - sha1_str_partb.size() + 1, '0') + sha1_str_partb +
-			std::string(sizeof(digest.part_c) * 2 - sha1_str_partc.size() + 1, '0') + sha1_str_partc
-		;
-		Sha1Array sha1_array;
-		assert(sha1_str.size() == sha1_array.size());
-		std::copy(sha1_str.begin(), sha1_str.end(), sha1_array.begin());
-
-		auto it_found = m_known_hashes.find(sha1_array);
-		const bool was_present = (m_known_hashes.end() != it_found);
-		if (was_present) {
-			return boost::string_view(it_found->data(), it_found->size());
+		std::vector<LuaScript> retval;
+		std::vector<const LuaScript*> to_load;
+		retval.reserve(parScripts.size());
+		for (const auto& script : parScripts) {
+			retval.push_back(add_script(script));
+		}
+		for (const auto& script : retval) {
+			if (not script.loaded->load(std::memory_order_acquire))
+				to_load.push_back(&script);
 		}
 
-		auto reply = m_command->run("SCRIPT", "LOAD", parScript);
-		assert(not was_present);
+		if (not to_load.empty()) {
+			auto batch = m_command->make_batch();
+			for (const auto* script : to_load) {
+				batch.run("SCRIPT", "LOAD", script->text);
+			}
+			batch.throw_if_failed();
+			for (const auto* script : to_load) {
+				script->loaded->store(true, std::memory_order_release);
+			}
+		}
+		return retval;
+	}
 
-		assert(get_string(reply) == sha1_str);
-		const auto it_inserted = m_known_hashes.insert(it_found, sha1_array);
-		(void)reply;
+	//Two threads might both send SCRIPT LOAD for the same script, which is
+	//harmless, while holding the mutex would stall every other script
+	void ScriptManager::load (const LuaScript& parScript) {
+		assert(parScript.loaded);
+		if (parScript.loaded->load(std::memory_order_acquire))
+			return;
+
+		auto batch = m_command->make_batch();
+		batch.run("SCRIPT", "LOAD", parScript.text);
+		batch.throw_if_failed();
+		parScript.loaded->store(true, std::memory_order_release);
+	}
 
-		return boost::string_view(it_inserted->data(), it_inserted->size());
+	//After a restart or a SCRIPT FLUSH the server forgot all scripts, get
+	//them back in one round trip
+	void ScriptManager::reload() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stale = false;
+		if (m_known_scripts.empty())
+			return;
+
+		auto batch = m_command->make_batch();
+		for (const auto& known : m_known_scripts) {
+			batch.run("SCRIPT", "LOAD", known.second.text);
+		}
+		batch.throw_if_failed();
+		for (auto& known : m_known_scripts) {
+			known.second.loaded.store(true, std::memory_order_release);
+		}
 	}
-#else
-	boost::string_view ScriptManager::add_lua_script_ifn (const boost::string_view& parScript) {
-		assert(m_command->is_connected());
 
-		std::string script_cpy = std::string(parScript);
-		auto it_found = m_known_scripts.find(script_cpy);
-		const bool was_present = (m_known_scripts.end() != it_found);
-		if (was_present) {
-			return boost::string_view(it_found->second.data(), it_found->second.size());
+	void ScriptManager::reload_if_stale() {
+		if (m_stale.load(std::memory_order_relaxed) and m_stale.exchange(false)) {
+			try {
+				reload();
+			}
+			catch (...) {
+				m_stale = true;
+				throw;
+			}
 		}
+	}
 
-		auto reply = m_command->run("SCRIPT", "LOAD", parScript);
-		assert(not was_present);
+	void ScriptManager::mark_stale() noexcept {
+		m_stale = true;
+	}
 
-		const auto sha1_str = get_string(reply);
-		Sha1Array sha1_array;
-		std::copy(sha1_str.begin(), sha1_str.end(), sha1_array.begin());
-		auto it_inserted = m_known_scripts.insert(it_found, std::make_pair(std::move(script_cpy), sha1_array));
+	void ScriptManager::mark_unloaded() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& known : m_known_scripts) {
+			known.second.loaded.store(false, std::memory_order_release);
+		}
+	}
 
-		return boost::string_view(it_inserted->second.data(), it_inserted->second.size());
+	std::size_t ScriptManager::script_count() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_known_scripts.size();
 	}
-#endif
 
 	void ScriptManager::update_command_ptr (Command* parNewPtr) {
 		assert(parNewPtr);
 		m_command = parNewPtr;
 	}
+
+	LuaScript ScriptManager::add_script (const boost::string_view& parScript) {
+		const Sha1Array sha1 = sha1_hex(parScript);
+		auto it_found = m_known_scripts.lower_bound(sha1);
+		if (m_known_scripts.end() == it_found or it_found->first != sha1)
+			it_found = m_known_scripts.emplace_hint(it_found, std::piecewise_construct, std::forward_as_tuple(sha1), std::forward_as_tuple(parScript));
+		KnownScript& known = it_found->second;
+		return LuaScript{boost::string_view(it_found->first.data(), it_found->first.size()), known.text, &known.loaded};
+	}
 } //namespace redis
@@ -0,0 +1,359 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sha1.hpp"
+#include <cstring>
+#include <cstddef>
+#include <ciso646>
+#if defined(__x86_64__) || defined(__i386__)
+#	define INCREDIS_SHA1_X86
+#	include <cpuid.h>
+#	include <immintrin.h>
+#endif
+
+namespace redis {
+	namespace {
+		typedef void(*CompressFunc)(uint32_t*, const uint8_t*, std::size_t);
+
+		const uint32_t g_initial_state[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+		inline uint32_t rotl (uint32_t parValue, int parBits) {
+			return (parValue << parBits) | (parValue >> (32 - parBits));
+		}
+
+		inline uint32_t load_be32 (const uint8_t* parData) {
+			return (uint32_t(parData[0]) << 24) | (uint32_t(parData[1]) << 16) | (uint32_t(parData[2]) << 8) | uint32_t(parData[3]);
+		}
+
+		void compress_portable (uint32_t* parState, const uint8_t* parData, std::size_t parBlocks) {
+			uint32_t w[80];
+			for (; parBlocks; --parBlocks, parData += 64) {
+				for (int z = 0; z < 16; ++z) {
+					w[z] = load_be32(parData + z * 4);
+				}
+				for (int z = 16; z < 80; ++z) {
+					w[z] = rotl(w[z - 3] ^ w[z - 8] ^ w[z - 14] ^ w[z - 16], 1);
+				}
+
+				uint32_t a = parState[0], b = parState[1], c = parState[2], d = parState[3], e = parState[4];
+				for (int z = 0; z < 80; ++z) {
+					uint32_t f, k;
+					if (z < 20) {
+						f = (b & c) | (~b & d);
+						k = 0x5a827999;
+					}
+					else if (z < 40) {
+						f = b ^ c ^ d;
+						k = 0x6ed9eba1;
+					}
+					else if (z < 60) {
+						f = (b & c) | (b & d) | (c & d);
+						k = 0x8f1bbcdc;
+					}
+					else {
+						f = b ^ c ^ d;
+						k = 0xca62c1d6;
+					}
+					const uint32_t temp = rotl(a, 5) + f + e + k + w[z];
+					e = d;
+					d = c;
+					c = rotl(b, 30);
+					b = a;
+					a = temp;
+				}
+				parState[0] += a;
+				parState[1] += b;
+				parState[2] += c;
+				parState[3] += d;
+				parState[4] += e;
+			}
+		}
+
+#if defined(INCREDIS_SHA1_X86)
+		//Adapted from the reference flow in Intel's SHA extensions paper,
+		//each block of code runs four rounds while the message schedule
+		//for the following ones is computed
+		__attribute__((target("sha,sse4.1")))
+		void compress_shani (uint32_t* parState, const uint8_t* parData, std::size_t parBlocks) {
+			const __m128i byte_swap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+			__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(parState)), 0x1b);
+			__m128i e0 = _mm_set_epi32(static_cast<int>(parState[4]), 0, 0, 0);
+			__m128i e1;
+
+			for (; parBlocks; --parBlocks, parData += 64) {
+				const __m128i abcd_save = abcd;
+				const __m128i e0_save = e0;
+
+				__m128i msg0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(parData + 0)), byte_swap);
+				__m128i msg1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(parData + 16)), byte_swap);
+				__m128i msg2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(parData + 32)), byte_swap);
+				__m128i msg3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(parData + 48)), byte_swap);
+
+				//Rounds 0-3
+				e0 = _mm_add_epi32(e0, msg0);
+				e1 = abcd;
+				abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+				//Rounds 4-7
+				e1 = _mm_sha1nexte_epu32(e1, msg1);
+				e0 = abcd;
+				abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+				msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+				//Rounds 8-11
+				e0 = _mm_sha1nexte_epu32(e0, msg2);
+				e1 = abcd;
+				abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+				msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+				msg0 = _mm_xor_si128(msg0, msg2);
+
+				//Rounds 12-15
+				e1 = _mm_sha1nexte_epu32(e1, msg3);
+				e0 = abcd;
+				msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+				abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+				msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+				msg1 = _mm_xor_si128(msg1, msg3);
+
+				//Rounds 16-19
+				e0 = _mm_sha1nexte_epu32(e0, msg0);
+				e1 = abcd;
+				msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+				abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+				msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+				msg2 = _mm_xor_si128(msg2, msg0);
+
+				//Rounds 20-23
+				e1 = _mm_sha1nexte_epu32(e1, msg1);
+				e0 = abcd;
+				msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+				abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+				msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+				msg3 = _mm_xor_si128(msg3, msg1);
+
+				//Rounds 24-27
+				e0 = _mm_sha1nexte_epu32(e0, msg2);
+				e1 = abcd;
+				msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+				abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+				msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+				msg0 = _mm_xor_si128(msg0, msg2);
+
+				//Rounds 28-31
+				e1 = _mm_sha1nexte_epu32(e1, msg3);
+				e0 = abcd;
+				msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+				abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+				msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+				msg1 = _mm_xor_si128(msg1, msg3);
+
+				//Rounds 32-35
+				e0 = _mm_sha1nexte_epu32(e0, msg0);
+				e1 = abcd;
+				msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+				abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+				msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+				msg2 = _mm_xor_si128(msg2, msg0);
+
+				//Rounds 36-39
+				e1 = _mm_sha1nexte_epu32(e1, msg1);
+				e0 = abcd;
+				msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+				abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+				msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+				msg3 = _mm_xor_si128(msg3, msg1);
+
+				//Rounds 40-43
+				e0 = _mm_sha1nexte_epu32(e0, msg2);
+				e1 = abcd;
+				msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+				abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+				msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+				msg0 = _mm_xor_si128(msg0, msg2);
+
+				//Rounds 44-47
+				e1 = _mm_sha1nexte_epu32(e1, msg3);
+				e0 = abcd;
+				msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+				abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+				msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+				msg1 = _mm_xor_si128(msg1, msg3);
+
+				//Rounds 48-51
+				e0 = _mm_sha1nexte_epu32(e0, msg0);
+				e1 = abcd;
+				msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+				abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+				msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+				msg2 = _mm_xor_si128(msg2, msg0);
+
+				//Rounds 52-55
+				e1 = _mm_sha1nexte_epu32(e1, msg1);
+				e0 = abcd;
+				msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+				abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+				msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+				msg3 = _mm_xor_si128(msg3, msg1);
+
+				//Rounds 56-59
+				e0 = _mm_sha1nexte_epu32(e0, msg2);
+				e1 = abcd;
+				msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+				abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+				msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+				msg0 = _mm_xor_si128(msg0, msg2);
+
+				//Rounds 60-63
+				e1 = _mm_sha1nexte_epu32(e1, msg3);
+				e0 = abcd;
+				msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+				abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+				msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+				msg1 = _mm_xor_si128(msg1, msg3);
+
+				//Rounds 64-67
+				e0 = _mm_sha1nexte_epu32(e0, msg0);
+				e1 = abcd;
+				msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+				abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+				msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+				msg2 = _mm_xor_si128(msg2, msg0);
+
+				//Rounds 68-71
+				e1 = _mm_sha1nexte_epu32(e1, msg1);
+				e0 = abcd;
+				msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+				abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+				msg3 = _mm_xor_si128(msg3, msg1);
+
+				//Rounds 72-75
+				e0 = _mm_sha1nexte_epu32(e0, msg2);
+				e1 = abcd;
+				msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+				abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+				//Rounds 76-79
+				e1 = _mm_sha1nexte_epu32(e1, msg3);
+				e0 = abcd;
+				abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+				e0 = _mm_sha1nexte_epu32(e0, e0_save);
+				abcd = _mm_add_epi32(abcd, abcd_save);
+			}
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(parState), _mm_shuffle_epi32(abcd, 0x1b));
+			parState[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+		}
+
+		bool cpu_has_sha_extensions() {
+			unsigned int eax, ebx, ecx, edx;
+			if (not __get_cpuid(1, &eax, &ebx, &ecx, &edx))
+				return false;
+			const bool has_sse41 = (ecx & bit_SSE4_1) and (ecx & bit_SSSE3);
+			if (not __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+				return false;
+			return has_sse41 and (ebx & (1u << 29));
+		}
+#endif
+
+		CompressFunc select_compress() {
+#if defined(INCREDIS_SHA1_X86)
+			if (cpu_has_sha_extensions())
+				return &compress_shani;
+#endif
+			return &compress_portable;
+		}
+
+		//Function local so that hashing from another translation unit's
+		//static initialisation doesn't find it still zero
+		CompressFunc compress_func() {
+			static const CompressFunc compress = select_compress();
+			return compress;
+		}
+
+		Sha1Digest sha1_with (CompressFunc parCompress, boost::string_view parData) {
+			uint32_t state[5];
+			std::memcpy(state, g_initial_state, sizeof(state));
+
+			const auto* data = reinterpret_cast<const uint8_t*>(parData.data());
+			const std::size_t full_blocks = parData.size() / 64;
+			parCompress(state, data, full_blocks);
+
+			//The 0x80 terminator and the 64 bit bit count take one more
+			//block, or two if less than 9 bytes are left in the last one
+			uint8_t tail[128] = {0};
+			const std::size_t tail_size = parData.size() % 64;
+			std::memcpy(tail, data + full_blocks * 64, tail_size);
+			tail[tail_size] = 0x80;
+			const std::size_t tail_blocks = (tail_size < 56 ? 1 : 2);
+			const uint64_t bit_count = static_cast<uint64_t>(parData.size()) * 8;
+			for (int z = 0; z < 8; ++z) {
+				tail[tail_blocks * 64 - 1 - z] = static_cast<uint8_t>(bit_count >> (z * 8));
+			}
+			parCompress(state, tail, tail_blocks);
+
+			Sha1Digest retval;
+			for (int z = 0; z < 5; ++z) {
+				retval[z * 4 + 0] = static_cast<uint8_t>(state[z] >> 24);
+				retval[z * 4 + 1] = static_cast<uint8_t>(state[z] >> 16);
+				retval[z * 4 + 2] = static_cast<uint8_t>(state[z] >> 8);
+				retval[z * 4 + 3] = static_cast<uint8_t>(state[z]);
+			}
+			return retval;
+		}
+	} //unnamed namespace
+
+	Sha1Digest sha1 (boost::string_view parData) {
+		return sha1_with(compress_func(), parData);
+	}
+
+	Sha1Hex to_hex (const Sha1Digest& parDigest) {
+		static const char digits[] = "0123456789abcdef";
+		Sha1Hex retval;
+		for (std::size_t z = 0; z < parDigest.size(); ++z) {
+			retval[z * 2] = digits[parDigest[z] >> 4];
+			retval[z * 2 + 1] = digits[parDigest[z] & 0x0f];
+		}
+		return retval;
+	}
+
+	Sha1Hex sha1_hex (boost::string_view parData) {
+		return to_hex(sha1(parData));
+	}
+
+	bool sha1_uses_cpu_extensions() {
+		return compress_func() != &compress_portable;
+	}
+
+	namespace implem {
+		Sha1Digest sha1_portable (boost::string_view parData) {
+			return sha1_with(&compress_portable, parData);
+		}
+
+		bool sha1_cpu_extensions (boost::string_view parData, Sha1Digest& parOut) {
+#if defined(INCREDIS_SHA1_X86)
+			if (cpu_has_sha_extensions()) {
+				parOut = sha1_with(&compress_shani, parData);
+				return true;
+			}
+#endif
+			static_cast<void>(parData);
+			static_cast<void>(parOut);
+			return false;
+		}
+	} //namespace implem
+} //namespace redis
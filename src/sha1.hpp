@@ -0,0 +1,47 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef idD34DEBC8A30A455AB386FCCCE9B15A51
+#define idD34DEBC8A30A455AB386FCCCE9B15A51
+
+#include <boost/utility/string_view.hpp>
+#include <array>
+#include <cstdint>
+
+namespace redis {
+	typedef std::array<uint8_t, 20> Sha1Digest;
+	typedef std::array<char, 40> Sha1Hex;
+
+	//SHA1 as Redis computes it for script hashes. On x86 CPUs with the SHA
+	//extensions the compression function runs on those, the choice is made
+	//on first use.
+	Sha1Digest sha1 ( boost::string_view parData );
+	//Lowercase hex digits, same as the hashes SCRIPT LOAD returns
+	Sha1Hex sha1_hex ( boost::string_view parData );
+	Sha1Hex to_hex ( const Sha1Digest& parDigest );
+	bool sha1_uses_cpu_extensions ( void );
+
+	namespace implem {
+		//Each compression function on its own, so tests can check both
+		//whichever one sha1() picks. The second returns false if the CPU
+		//lacks the SHA extensions.
+		Sha1Digest sha1_portable ( boost::string_view parData );
+		bool sha1_cpu_extensions ( boost::string_view parData, Sha1Digest& parOut );
+	} //namespace implem
+} //namespace redis
+
+#endif
@@ -0,0 +1,201 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sharded_incredis.hpp"
+#include "hash_slot.hpp"
+#include "reply_errors.hpp"
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		uint64_t fnv1a_64 (boost::string_view parData) {
+			uint64_t retval = 14695981039346656037ULL;
+			for (char c : parData) {
+				retval ^= static_cast<uint8_t>(c);
+				retval *= 1099511628211ULL;
+			}
+			return retval;
+		}
+
+		//See "A Fast, Minimal Memory, Consistent Hash Algorithm",
+		//John Lamping and Eric Veach
+		int32_t jump_consistent_hash (uint64_t parKey, int32_t parBuckets) {
+			int64_t b = -1;
+			int64_t j = 0;
+			while (j < parBuckets) {
+				b = j;
+				parKey = parKey * 2862933555777941757ULL + 1;
+				j = static_cast<int64_t>((b + 1) * (static_cast<double>(1LL << 31) / static_cast<double>((parKey >> 33) + 1)));
+			}
+			return static_cast<int32_t>(b);
+		}
+	} //unnamed namespace
+
+	std::size_t shard_for_key (boost::string_view parKey, std::size_t parShardCount) {
+		assert(parShardCount > 0);
+		return static_cast<std::size_t>(jump_consistent_hash(fnv1a_64(hash_tag(parKey)), static_cast<int32_t>(parShardCount)));
+	}
+
+	ShardedIncRedis::ShardedIncRedis() :
+		m_nodes()
+	{
+	}
+
+	void ShardedIncRedis::add_node (std::string&& parAddress, uint16_t parPort) {
+		m_nodes.emplace_back(new IncRedis(std::move(parAddress), parPort));
+	}
+
+	void ShardedIncRedis::add_node (std::string&& parSocket) {
+		m_nodes.emplace_back(new IncRedis(std::move(parSocket)));
+	}
+
+	void ShardedIncRedis::connect() {
+		for (auto& node : m_nodes) {
+			node->connect();
+		}
+	}
+
+	void ShardedIncRedis::wait_for_connect() {
+		for (auto& node : m_nodes) {
+			node->wait_for_connect();
+		}
+	}
+
+	void ShardedIncRedis::disconnect() {
+		for (auto& node : m_nodes) {
+			node->disconnect();
+		}
+	}
+
+	void ShardedIncRedis::wait_for_disconnect() {
+		for (auto& node : m_nodes) {
+			node->wait_for_disconnect();
+		}
+	}
+
+	bool ShardedIncRedis::is_connected() const {
+		for (const auto& node : m_nodes) {
+			if (not node->is_connected())
+				return false;
+		}
+		return not m_nodes.empty();
+	}
+
+	ShardedBatch ShardedIncRedis::make_batch() {
+		return ShardedBatch(this);
+	}
+
+	std::size_t ShardedIncRedis::node_index_for_key (boost::string_view parKey) const {
+		return shard_for_key(parKey, m_nodes.size());
+	}
+
+	IncRedis& ShardedIncRedis::node (std::size_t parIndex) {
+		assert(parIndex < m_nodes.size());
+		return *m_nodes[parIndex];
+	}
+
+	struct ShardedBatch::LocalData {
+		explicit LocalData ( ShardedIncRedis* parRedis ) :
+			redis(parRedis),
+			batches(parRedis->node_count()),
+			positions(parRedis->node_count()),
+			replies(),
+			call_count(0),
+			collected(0)
+		{
+		}
+
+		ShardedIncRedis* redis;
+		std::vector<std::unique_ptr<Batch>> batches;
+		std::vector<std::vector<std::size_t>> positions;
+		std::vector<Reply> replies;
+		std::size_t call_count;
+		std::size_t collected;
+	};
+
+	ShardedBatch::ShardedBatch (ShardedIncRedis* parRedis) :
+		m_local_data(new LocalData(parRedis))
+	{
+		assert(parRedis->node_count() > 0);
+	}
+
+	ShardedBatch::ShardedBatch (ShardedBatch&&) = default;
+
+	ShardedBatch::~ShardedBatch() noexcept = default;
+
+	Batch& ShardedBatch::batch_for_key (boost::string_view parKey) {
+		auto& local = *m_local_data;
+		const std::size_t node_index = local.redis->node_index_for_key(parKey);
+		//Nodes might have been added after the batch was made
+		if (node_index >= local.batches.size()) {
+			local.batches.resize(local.redis->node_count());
+			local.positions.resize(local.redis->node_count());
+		}
+		auto& batch = local.batches[node_index];
+		if (not batch)
+			batch.reset(new Batch(local.redis->node(node_index).command().make_batch()));
+
+		local.positions[node_index].push_back(local.call_count++);
+		return *batch;
+	}
+
+	//Replies are moved out of each node's batch, batches that were already
+	//collected by a previous call are skipped so commands can keep being
+	//added after reading the replies.
+	std::vector<Reply>& ShardedBatch::replies() {
+		auto& local = *m_local_data;
+		if (local.collected == local.call_count)
+			return local.replies;
+
+		local.replies.resize(local.call_count);
+		for (std::size_t z = 0; z < local.batches.size(); ++z) {
+			auto& batch = local.batches[z];
+			auto& positions = local.positions[z];
+			if (not batch)
+				continue;
+
+			auto it_position = positions.begin();
+			for (auto& reply : batch->replies_nonconst()) {
+				assert(positions.end() != it_position);
+				local.replies[*it_position] = std::move(reply);
+				++it_position;
+			}
+			batch.reset();
+			positions.clear();
+		}
+		local.collected = local.call_count;
+		return local.replies;
+	}
+
+	void ShardedBatch::throw_if_failed() {
+		throw_if_reply_errors(replies(), m_local_data->replies.size());
+	}
+
+	void ShardedBatch::reset() noexcept {
+		auto& local = *m_local_data;
+		for (auto& batch : local.batches) {
+			batch.reset();
+		}
+		for (auto& positions : local.positions) {
+			positions.clear();
+		}
+		local.replies.clear();
+		local.call_count = 0;
+		local.collected = 0;
+	}
+} //namespace redis
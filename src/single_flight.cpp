@@ -0,0 +1,66 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "single_flight.hpp"
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	SingleFlight::SingleFlight() :
+		m_in_flight(),
+		m_mutex(),
+		m_coalesced(0)
+	{
+	}
+
+	SingleFlight::~SingleFlight() noexcept {
+		assert(m_in_flight.empty());
+	}
+
+	Reply SingleFlight::run (StoredCommand&& parCommand, const Sender& parSender) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		auto it_found = m_in_flight.find(parCommand);
+		if (m_in_flight.end() != it_found) {
+			std::shared_future<Reply> flight = it_found->second;
+			lock.unlock();
+			m_coalesced.fetch_add(1, std::memory_order_relaxed);
+			return flight.get();
+		}
+
+		//Inserts can rehash and invalidate iterators, but references to
+		//the elements stay valid until they are erased
+		std::promise<Reply> leader_promise;
+		const StoredCommand& command = m_in_flight.emplace(std::move(parCommand), leader_promise.get_future().share()).first->first;
+		lock.unlock();
+
+		Reply reply;
+		try {
+			reply = parSender(command);
+		}
+		catch (...) {
+			leader_promise.set_exception(std::current_exception());
+			lock.lock();
+			m_in_flight.erase(m_in_flight.find(command));
+			throw;
+		}
+
+		leader_promise.set_value(reply);
+		lock.lock();
+		m_in_flight.erase(m_in_flight.find(command));
+		return reply;
+	}
+} //namespace redis
@@ -0,0 +1,51 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id481BDB2690EF4661924EFA772A242023
+#define id481BDB2690EF4661924EFA772A242023
+
+#include "reply.hpp"
+#include "stored_command.hpp"
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+namespace redis {
+	//Lets concurrent callers of the same read share one request: the first
+	//caller (the leader) sends the command, later callers with an identical
+	//command wait for the leader's reply instead of sending their own.
+	class SingleFlight {
+	public:
+		typedef std::function<Reply(const StoredCommand&)> Sender;
+
+		SingleFlight ( void );
+		~SingleFlight ( void ) noexcept;
+
+		Reply run ( StoredCommand&& parCommand, const Sender& parSender );
+		uint64_t coalesced_count ( void ) const { return m_coalesced.load(std::memory_order_relaxed); }
+
+	private:
+		std::unordered_map<StoredCommand, std::shared_future<Reply>, StoredCommandHash> m_in_flight;
+		std::mutex m_mutex;
+		std::atomic<uint64_t> m_coalesced;
+	};
+} //namespace redis
+
+#endif
@@ -0,0 +1,112 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef id897C9BC8E4CD48A8986377A62470A55F
+#define id897C9BC8E4CD48A8986377A62470A55F
+
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <ciso646>
+
+namespace redis {
+	//Bounded single producer, single consumer ring buffer. Each side keeps
+	//a private copy of the other side's index and only reloads the shared
+	//one when the copy says the queue is full (or empty), so in the common
+	//case push and pop touch no cache line written by the other thread.
+	template <typename T>
+	class SpscQueue {
+	public:
+		explicit SpscQueue ( std::size_t parCapacity );
+		SpscQueue ( const SpscQueue& ) = delete;
+		SpscQueue& operator= ( const SpscQueue& ) = delete;
+
+		//Producer side
+		bool try_push ( T&& parItem );
+		//Consumer side
+		bool try_pop ( T& parItem );
+
+		bool empty ( void ) const;
+		std::size_t capacity ( void ) const { return m_items.size(); }
+
+	private:
+		enum { CacheLineSize = 64 };
+
+		static std::size_t round_up_pow2 ( std::size_t parValue );
+
+		std::vector<T> m_items;
+		const std::size_t m_mask;
+		alignas(CacheLineSize) std::atomic<std::size_t> m_head;
+		std::size_t m_cached_tail;
+		alignas(CacheLineSize) std::atomic<std::size_t> m_tail;
+		std::size_t m_cached_head;
+	};
+
+	template <typename T>
+	SpscQueue<T>::SpscQueue (std::size_t parCapacity) :
+		m_items(round_up_pow2(parCapacity)),
+		m_mask(m_items.size() - 1),
+		m_head(0),
+		m_cached_tail(0),
+		m_tail(0),
+		m_cached_head(0)
+	{
+	}
+
+	template <typename T>
+	std::size_t SpscQueue<T>::round_up_pow2 (std::size_t parValue) {
+		std::size_t retval = 2;
+		while (retval < parValue) {
+			retval <<= 1;
+		}
+		return retval;
+	}
+
+	template <typename T>
+	bool SpscQueue<T>::try_push (T&& parItem) {
+		const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_cached_head == m_items.size()) {
+			m_cached_head = m_head.load(std::memory_order_acquire);
+			if (tail - m_cached_head == m_items.size())
+				return false;
+		}
+		m_items[tail & m_mask] = std::move(parItem);
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	template <typename T>
+	bool SpscQueue<T>::try_pop (T& parItem) {
+		const std::size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_cached_tail) {
+			m_cached_tail = m_tail.load(std::memory_order_acquire);
+			if (head == m_cached_tail)
+				return false;
+		}
+		parItem = std::move(m_items[head & m_mask]);
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	template <typename T>
+	bool SpscQueue<T>::empty() const {
+		return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+	}
+} //namespace redis
+
+#endif
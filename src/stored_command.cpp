@@ -0,0 +1,72 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stored_command.hpp"
+#include "batch.hpp"
+#include <functional>
+#include <string_view>
+
+namespace redis {
+	StoredCommand::StoredCommand() :
+		m_buffer(),
+		m_ends()
+	{
+	}
+
+	StoredCommand::~StoredCommand() noexcept = default;
+
+	void StoredCommand::push_back (const char* parData, std::size_t parLength) {
+		m_buffer.append(parData, parLength);
+		m_ends.push_back(m_buffer.size());
+	}
+
+	void StoredCommand::reserve (std::size_t parArgCount, std::size_t parByteCount) {
+		m_ends.reserve(parArgCount);
+		m_buffer.reserve(parByteCount);
+	}
+
+	void StoredCommand::clear() {
+		m_buffer.clear();
+		m_ends.clear();
+	}
+
+	//Commands that only differ in where arguments are split hash the same,
+	//operator== tells them apart
+	std::size_t StoredCommand::hash() const {
+		return std::hash<std::string_view>()(std::string_view(m_buffer)) ^ (m_ends.size() * 0x9e3779b97f4a7c15ULL);
+	}
+
+	void StoredCommand::run (Batch& parBatch) const {
+		std::vector<const char*> argv;
+		std::vector<std::size_t> lengths;
+		run(parBatch, argv, lengths);
+	}
+
+	void StoredCommand::run (Batch& parBatch, std::vector<const char*>& parArgv, std::vector<std::size_t>& parLengths) const {
+		assert(not empty());
+
+		parArgv.resize(m_ends.size());
+		parLengths.resize(m_ends.size());
+		std::size_t start = 0;
+		for (std::size_t z = 0; z < m_ends.size(); ++z) {
+			parArgv[z] = m_buffer.data() + start;
+			parLengths[z] = m_ends[z] - start;
+			start = m_ends[z];
+		}
+		parBatch.run_argv(static_cast<int>(m_ends.size()), parArgv.data(), parLengths.data());
+	}
+} //namespace redis
@@ -0,0 +1,289 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "incredis/stream_consumer.hpp"
+#include "incredis/int_conv.hpp"
+#include "incredis/batch.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		//parEntries is an array of [id, [field, value, ...]] items, the
+		//second element is nil for entries deleted while pending. Redis 6.2
+		//XAUTOCLAIM puts a nil in place of the whole item instead, those are
+		//skipped since their id is not known.
+		void take_entries (Reply& parEntries, std::vector<StreamEntry>& parOut) {
+			if (not parEntries.is_array())
+				return;
+
+			auto& entries = get_array(parEntries);
+			parOut.reserve(parOut.size() + entries.size());
+			for (auto& entry_reply : entries) {
+				if (not entry_reply.is_array())
+					continue;
+				auto& entry = get_array(entry_reply);
+				if (entry.size() < 2)
+					continue;
+
+				parOut.emplace_back();
+				StreamEntry& out = parOut.back();
+				out.id = take<std::string>(entry[0]);
+				if (not entry[1].is_array())
+					continue;
+				auto& fields = get_array(entry[1]);
+				out.fields.reserve(fields.size() / 2);
+				for (std::size_t z = 0; z + 1 < fields.size(); z += 2) {
+					out.fields.emplace_back(take<std::string>(fields[z]), take<std::string>(fields[z + 1]));
+				}
+			}
+		}
+
+		Reply run_single (Command& parCommand, const StoredCommand& parToRun) {
+			auto batch = parCommand.make_batch();
+			parToRun.run(batch);
+			batch.throw_if_failed();
+			return std::move(batch.replies_nonconst().front());
+		}
+	} //unnamed namespace
+
+	struct StreamConsumer::LocalData {
+		LocalData ( Command& parCommand, uint32_t parDb, std::string&& parStream, std::string&& parGroup, std::string&& parConsumer, const StreamConsumerOptions& parOptions ) :
+			reader(std::string(parCommand.address()), parCommand.port()),
+			stream(std::move(parStream)),
+			group(std::move(parGroup)),
+			consumer(std::move(parConsumer)),
+			options(parOptions),
+			ack_queue(),
+			ack_batch(),
+			read_count(0),
+			acked_count(0),
+			db(parDb)
+		{
+			options.count = std::max<std::size_t>(1, options.count);
+			options.ack_batch = std::max<std::size_t>(1, options.ack_batch);
+			ack_queue.reserve(options.ack_batch);
+		}
+
+		Command reader;
+		std::string stream;
+		std::string group;
+		std::string consumer;
+		StreamConsumerOptions options;
+		std::vector<std::string> ack_queue;
+		std::unique_ptr<Batch> ack_batch;
+		uint64_t read_count;
+		uint64_t acked_count;
+		uint32_t db;
+	};
+
+	StreamConsumer::StreamConsumer (Command& parCommand, uint32_t parDb, std::string&& parStream, std::string&& parGroup, std::string&& parConsumer, const StreamConsumerOptions& parOptions) :
+		m_local_data(new LocalData(parCommand, parDb, std::move(parStream), std::move(parGroup), std::move(parConsumer), parOptions)),
+		m_command(parCommand)
+	{
+	}
+
+	StreamConsumer::~StreamConsumer() noexcept {
+		try {
+			if (m_command.is_connected())
+				flush_acks();
+		}
+		catch (const std::exception&) {
+		}
+	}
+
+	void StreamConsumer::connect() {
+		m_local_data->reader.connect();
+	}
+
+	void StreamConsumer::wait_for_connect() {
+		auto& local = *m_local_data;
+		local.reader.wait_for_connect();
+		if (local.db and local.reader.is_connected())
+			local.reader.run("SELECT", int_to_ary_dec(local.db).to<boost::string_view>());
+	}
+
+	void StreamConsumer::disconnect() {
+		m_local_data->reader.disconnect();
+		m_local_data->reader.wait_for_disconnect();
+	}
+
+	bool StreamConsumer::is_connected() const {
+		return m_local_data->reader.is_connected();
+	}
+
+	bool StreamConsumer::create_group (boost::string_view parStartId, bool parMakeStream) {
+		auto& local = *m_local_data;
+		StoredCommand create("XGROUP", "CREATE", local.stream, local.group, parStartId);
+		if (parMakeStream)
+			create.push_back(boost::string_view("MKSTREAM"));
+
+		auto batch = m_command.make_batch();
+		create.run(batch);
+		const Reply& reply = batch.replies().front();
+		if (reply.is_error()) {
+			const std::string& message = get_error_string(reply).message();
+			if (0 == message.compare(0, 9, "BUSYGROUP"))
+				return false;
+			throw RedisError(message.data(), message.size());
+		}
+		return true;
+	}
+
+	std::vector<StreamEntry> StreamConsumer::read() {
+		std::vector<StreamEntry> retval;
+		read_group(">", true, retval);
+		return retval;
+	}
+
+	//Each page starts after the last id of the previous one, a short page
+	//means the pending list is over
+	std::vector<StreamEntry> StreamConsumer::read_pending() {
+		std::vector<StreamEntry> retval;
+		std::string last_id("0");
+		while (read_group(last_id, false, retval) == m_local_data->options.count) {
+			last_id = retval.back().id;
+		}
+		return retval;
+	}
+
+	std::size_t StreamConsumer::read_group (boost::string_view parId, bool parBlock, std::vector<StreamEntry>& parOut) {
+		auto& local = *m_local_data;
+		const auto count = int_to_ary_dec(local.options.count);
+		StoredCommand read("XREADGROUP", "GROUP", local.group, local.consumer, "COUNT", count.to<boost::string_view>());
+		if (parBlock and local.options.block.count() > 0) {
+			read.push_back(boost::string_view("BLOCK"));
+			read.push_back(int_to_ary_dec(local.options.block.count()).to<boost::string_view>());
+		}
+		read.push_back(boost::string_view("STREAMS"));
+		read.push_back(boost::string_view(local.stream));
+		read.push_back(parId);
+
+		//Acks travel on the main connection while the reader waits
+		send_acks();
+		Reply reply = run_single(local.reader, read);
+		collect_acks();
+
+		//Nil on timeout, [[stream, entries]] otherwise
+		const std::size_t old_size = parOut.size();
+		if (reply.is_array()) {
+			for (auto& stream_reply : get_array(reply)) {
+				auto& stream = get_array(stream_reply);
+				if (stream.size() == 2)
+					take_entries(stream[1], parOut);
+			}
+		}
+		const std::size_t retval = parOut.size() - old_size;
+		local.read_count += retval;
+		return retval;
+	}
+
+	std::vector<StreamEntry> StreamConsumer::reclaim() {
+		auto& local = *m_local_data;
+		const auto count = int_to_ary_dec(local.options.count);
+		const auto min_idle = int_to_ary_dec(local.options.min_idle.count());
+		std::vector<StreamEntry> retval;
+		std::string cursor("0-0");
+		do {
+			StoredCommand claim(
+				"XAUTOCLAIM", local.stream, local.group, local.consumer,
+				min_idle.to<boost::string_view>(), cursor,
+				"COUNT", count.to<boost::string_view>()
+			);
+
+			//[next cursor, entries] and, since 7.0, the ids of deleted entries
+			Reply reply = run_single(local.reader, claim);
+			auto& parts = get_array(reply);
+			if (parts.size() < 2)
+				break;
+			cursor = take<std::string>(parts[0]);
+			take_entries(parts[1], retval);
+		} while (cursor != "0-0");
+		local.read_count += retval.size();
+		return retval;
+	}
+
+	void StreamConsumer::ack (boost::string_view parId) {
+		auto& local = *m_local_data;
+		local.ack_queue.emplace_back(parId.data(), parId.size());
+		if (local.ack_queue.size() >= local.options.ack_batch)
+			send_acks();
+	}
+
+	std::size_t StreamConsumer::flush_acks() {
+		const std::size_t retval = send_acks();
+		return retval + collect_acks();
+	}
+
+	//Sends the queued ids without waiting for the replies. Only one ack
+	//batch is in flight at any time, returns the count collected from the
+	//one before.
+	std::size_t StreamConsumer::send_acks() {
+		auto& local = *m_local_data;
+		if (local.ack_queue.empty())
+			return 0;
+		const std::size_t retval = collect_acks();
+
+		auto batch = m_command.make_batch();
+		std::vector<const char*> argv;
+		std::vector<std::size_t> lengths;
+		StoredCommand xack;
+		for (std::size_t start = 0; start < local.ack_queue.size(); start += local.options.ack_batch) {
+			const std::size_t end = std::min(start + local.options.ack_batch, local.ack_queue.size());
+			xack.clear();
+			xack.push_back(boost::string_view("XACK"));
+			xack.push_back(boost::string_view(local.stream));
+			xack.push_back(boost::string_view(local.group));
+			for (std::size_t z = start; z < end; ++z) {
+				xack.push_back(boost::string_view(local.ack_queue[z]));
+			}
+			xack.run(batch, argv, lengths);
+		}
+		local.ack_queue.clear();
+		local.ack_batch.reset(new Batch(std::move(batch)));
+		return retval;
+	}
+
+	std::size_t StreamConsumer::collect_acks() {
+		auto& local = *m_local_data;
+		if (not local.ack_batch)
+			return 0;
+
+		std::unique_ptr<Batch> batch(std::move(local.ack_batch));
+		batch->throw_if_failed();
+		std::size_t retval = 0;
+		for (const auto& reply : batch->replies()) {
+			retval += static_cast<std::size_t>(get_integer(reply));
+		}
+		local.acked_count += retval;
+		return retval;
+	}
+
+	uint64_t StreamConsumer::read_count() const {
+		return m_local_data->read_count;
+	}
+
+	uint64_t StreamConsumer::acked_count() const {
+		return m_local_data->acked_count;
+	}
+
+	const std::string& StreamConsumer::stream() const {
+		return m_local_data->stream;
+	}
+} //namespace redis
@@ -0,0 +1,418 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "incredis/subscriber.hpp"
+#include "async_connection.hpp"
+#include "loop_stats.hpp"
+#include "spsc_queue.hpp"
+#include <hiredis/hiredis.h>
+#include <hiredis/async.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		struct Counters {
+			Counters ( void ) :
+				received(0),
+				dropped(0)
+			{
+			}
+
+			std::atomic<uint64_t> received;
+			std::atomic<uint64_t> dropped;
+		};
+
+		struct Worker {
+			explicit Worker ( std::size_t parCapacity ) :
+				queue(parCapacity),
+				thread(),
+				mutex(),
+				wakeup(),
+				space_freed(),
+				sleeping(false),
+				producer_waiting(false)
+			{
+			}
+
+			SpscQueue<PubSubMessage> queue;
+			std::thread thread;
+			std::mutex mutex;
+			std::condition_variable wakeup;
+			//Signalled when the event thread waits for room in the queue
+			std::condition_variable space_freed;
+			std::atomic<bool> sleeping;
+			std::atomic<bool> producer_waiting;
+		};
+
+		boost::string_view element_view (const redisReply* parReply) {
+			return boost::string_view(parReply->str, parReply->len);
+		}
+
+		//hiredis hands the reply to an unsubscribe to the callback registered
+		//for that channel, and drops it if there is none. This is why only
+		//known subscriptions are ever removed.
+		bool is_subscribed (std::mutex& parMutex, const std::unordered_set<std::string>& parSet, boost::string_view parName) {
+			std::lock_guard<std::mutex> lock(parMutex);
+			return parSet.count(std::string(parName.data(), parName.size())) > 0;
+		}
+
+		bool is_subscription_change (boost::string_view parKind) {
+			return parKind == "subscribe" or parKind == "unsubscribe" or
+				parKind == "psubscribe" or parKind == "punsubscribe";
+		}
+	} //unnamed namespace
+
+	struct Subscriber::LocalData {
+		//Given to hiredis as the private data of a channel or pattern, which
+		//hands it back with every message, so counters need no lookup
+		struct Subscription {
+			explicit Subscription ( LocalData& parLocal ) :
+				local(parLocal),
+				counters()
+			{
+			}
+
+			LocalData& local;
+			Counters counters;
+		};
+
+		LocalData ( std::string&& parAddress, uint16_t parPort, Handler&& parHandler, const SubscriberOptions& parOptions );
+
+		void start_workers ( void );
+		void stop_workers ( void );
+		void run_worker ( Worker& parWorker );
+		void dispatch ( PubSubMessage&& parMessage, Counters& parCounters );
+		//Entries are never removed, so the pointer stays valid
+		Subscription& subscription ( const std::string& parName );
+		static void on_reply ( redisAsyncContext* parContext, void* parReply, void* parPrivData );
+
+		AsyncConnection connection;
+		Handler handler;
+		SubscriberOptions options;
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::atomic<bool> running;
+		mutable std::mutex counters_mutex;
+		std::unordered_map<std::string, std::unique_ptr<Subscription>> counters_map;
+		std::mutex change_mutex;
+		std::condition_variable change_confirmed;
+		uint64_t changes_sent;
+		uint64_t changes_confirmed;
+		std::unordered_set<std::string> channels;
+		std::unordered_set<std::string> patterns;
+		std::size_t subscriptions;
+		bool connection_lost;
+		std::atomic<uint64_t> handler_errors;
+	};
+
+	Subscriber::LocalData::LocalData (std::string&& parAddress, uint16_t parPort, Handler&& parHandler, const SubscriberOptions& parOptions) :
+		connection(std::move(parAddress), parPort),
+		handler(std::move(parHandler)),
+		options(parOptions),
+		workers(),
+		running(false),
+		counters_mutex(),
+		counters_map(),
+		change_mutex(),
+		change_confirmed(),
+		changes_sent(0),
+		changes_confirmed(0),
+		channels(),
+		patterns(),
+		subscriptions(0),
+		connection_lost(false),
+		handler_errors(0)
+	{
+		if (0 == options.worker_threads)
+			options.worker_threads = 1;
+	}
+
+	void Subscriber::LocalData::start_workers() {
+		assert(workers.empty());
+		running = true;
+		workers.reserve(options.worker_threads);
+		for (std::size_t z = 0; z < options.worker_threads; ++z) {
+			workers.emplace_back(new Worker(options.queue_capacity));
+			Worker& worker = *workers.back();
+			worker.thread = std::thread([this, &worker]() { run_worker(worker); });
+		}
+	}
+
+	void Subscriber::LocalData::stop_workers() {
+		running = false;
+		for (auto& worker : workers) {
+			{
+				std::lock_guard<std::mutex> lock(worker->mutex);
+				worker->wakeup.notify_one();
+			}
+			worker->thread.join();
+		}
+		workers.clear();
+	}
+
+	//Spin for a short while before going to sleep, a busy channel then
+	//never pays for a condition variable round trip. Workers drain their
+	//queue before quitting.
+	void Subscriber::LocalData::run_worker (Worker& parWorker) {
+		PubSubMessage message;
+		unsigned int idle_rounds = 0;
+		while (true) {
+			if (parWorker.queue.try_pop(message)) {
+				idle_rounds = 0;
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (parWorker.producer_waiting.load(std::memory_order_relaxed)) {
+					std::lock_guard<std::mutex> lock(parWorker.mutex);
+					parWorker.space_freed.notify_one();
+				}
+				try {
+					handler(message);
+				}
+				catch (...) {
+					handler_errors.fetch_add(1, std::memory_order_relaxed);
+				}
+				continue;
+			}
+			if (not running.load(std::memory_order_acquire))
+				break;
+			if (++idle_rounds < 64) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(parWorker.mutex);
+			parWorker.sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (parWorker.queue.empty() and running.load(std::memory_order_acquire))
+				parWorker.wakeup.wait_for(lock, std::chrono::milliseconds(1));
+			parWorker.sleeping.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	//Runs on the event thread. With Overflow_Block it sleeps until the
+	//worker pops a message, and nothing is read from the socket meanwhile.
+	void Subscriber::LocalData::dispatch (PubSubMessage&& parMessage, Counters& parCounters) {
+		parCounters.received.fetch_add(1, std::memory_order_relaxed);
+		Worker& worker = *workers[std::hash<std::string>()(parMessage.channel) % workers.size()];
+
+		bool pushed = worker.queue.try_push(std::move(parMessage));
+		if (not pushed and Overflow_Block == options.overflow) {
+			std::unique_lock<std::mutex> lock(worker.mutex);
+			worker.producer_waiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			while (not (pushed = worker.queue.try_push(std::move(parMessage))) and running.load(std::memory_order_relaxed)) {
+				worker.space_freed.wait_for(lock, std::chrono::milliseconds(1));
+			}
+			worker.producer_waiting.store(false, std::memory_order_relaxed);
+		}
+		if (not pushed) {
+			parCounters.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (worker.sleeping.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			worker.wakeup.notify_one();
+		}
+	}
+
+	auto Subscriber::LocalData::subscription (const std::string& parName) -> Subscription& {
+		std::lock_guard<std::mutex> lock(counters_mutex);
+		auto it_found = counters_map.find(parName);
+		if (counters_map.end() == it_found)
+			it_found = counters_map.emplace(parName, std::unique_ptr<Subscription>(new Subscription(*this))).first;
+		return *it_found->second;
+	}
+
+	//hiredis calls this for every reply on the connection, including pushed
+	//messages, and once per subscription with a null reply when the
+	//connection goes away
+	void Subscriber::LocalData::on_reply (redisAsyncContext*, void* parReply, void* parPrivData) {
+		auto& subscription = *static_cast<Subscription*>(parPrivData);
+		auto& self = subscription.local;
+		auto* reply = static_cast<redisReply*>(parReply);
+		if (not reply) {
+			std::lock_guard<std::mutex> lock(self.change_mutex);
+			self.connection_lost = true;
+			self.change_confirmed.notify_all();
+			return;
+		}
+		if (REDIS_REPLY_ARRAY != reply->type or reply->elements < 3)
+			return;
+
+		const boost::string_view kind = element_view(reply->element[0]);
+		if (kind == "message") {
+			PubSubMessage message;
+			message.channel.assign(reply->element[1]->str, reply->element[1]->len);
+			message.payload.assign(reply->element[2]->str, reply->element[2]->len);
+			self.dispatch(std::move(message), subscription.counters);
+		}
+		else if (kind == "pmessage" and reply->elements >= 4) {
+			PubSubMessage message;
+			message.pattern.assign(reply->element[1]->str, reply->element[1]->len);
+			message.channel.assign(reply->element[2]->str, reply->element[2]->len);
+			message.payload.assign(reply->element[3]->str, reply->element[3]->len);
+			self.dispatch(std::move(message), subscription.counters);
+		}
+		else if (is_subscription_change(kind)) {
+			std::string name(reply->element[1]->str, reply->element[1]->len);
+			std::lock_guard<std::mutex> lock(self.change_mutex);
+			if (kind == "subscribe")
+				self.channels.insert(std::move(name));
+			else if (kind == "unsubscribe")
+				self.channels.erase(name);
+			else if (kind == "psubscribe")
+				self.patterns.insert(std::move(name));
+			else
+				self.patterns.erase(name);
+			++self.changes_confirmed;
+			self.subscriptions = static_cast<std::size_t>(reply->element[2]->integer);
+			self.change_confirmed.notify_all();
+		}
+	}
+
+	Subscriber::Subscriber (std::string&& parAddress, uint16_t parPort, Handler parHandler, const SubscriberOptions& parOptions) :
+		m_local_data(new LocalData(std::move(parAddress), parPort, std::move(parHandler), parOptions))
+	{
+	}
+
+	Subscriber::Subscriber (std::string&& parSocket, Handler parHandler, const SubscriberOptions& parOptions) :
+		Subscriber(std::move(parSocket), 0, std::move(parHandler), parOptions)
+	{
+	}
+
+	Subscriber::~Subscriber() noexcept {
+		disconnect();
+	}
+
+	void Subscriber::connect() {
+		if (m_local_data->workers.empty())
+			m_local_data->start_workers();
+		{
+			std::lock_guard<std::mutex> lock(m_local_data->change_mutex);
+			m_local_data->connection_lost = false;
+			m_local_data->channels.clear();
+			m_local_data->patterns.clear();
+			m_local_data->subscriptions = 0;
+		}
+		m_local_data->connection.connect();
+	}
+
+	void Subscriber::wait_for_connect() {
+		m_local_data->connection.wait_for_connect();
+	}
+
+	//The event thread is gone once the connection is closed, so the workers
+	//can be stopped after that without anybody pushing to their queues
+	void Subscriber::disconnect() {
+		m_local_data->connection.disconnect();
+		m_local_data->connection.wait_for_disconnect();
+		if (not m_local_data->workers.empty())
+			m_local_data->stop_workers();
+	}
+
+	bool Subscriber::is_connected() const {
+		return m_local_data->connection.is_connected();
+	}
+
+	void Subscriber::subscribe (boost::string_view parChannel) {
+		change_subscription("SUBSCRIBE", parChannel);
+	}
+
+	void Subscriber::unsubscribe (boost::string_view parChannel) {
+		if (is_subscribed(m_local_data->change_mutex, m_local_data->channels, parChannel))
+			change_subscription("UNSUBSCRIBE", parChannel);
+	}
+
+	void Subscriber::psubscribe (boost::string_view parPattern) {
+		change_subscription("PSUBSCRIBE", parPattern);
+	}
+
+	void Subscriber::punsubscribe (boost::string_view parPattern) {
+		if (is_subscribed(m_local_data->change_mutex, m_local_data->patterns, parPattern))
+			change_subscription("PUNSUBSCRIBE", parPattern);
+	}
+
+	std::size_t Subscriber::subscription_count() const {
+		std::lock_guard<std::mutex> lock(m_local_data->change_mutex);
+		return m_local_data->subscriptions;
+	}
+
+	//All commands share the same callback, which counts the confirmations
+	//the server sends back in order. The event mutex is taken first, the
+	//same order as in on_reply(). The subscription is looked up here, once.
+	void Subscriber::change_subscription (const char* parCommand, boost::string_view parName) {
+		auto& local = *m_local_data;
+		if (not local.connection.is_connected())
+			throw std::runtime_error("Subscriber is not connected");
+
+		const char* argv[] = {parCommand, parName.data()};
+		const std::size_t lengths[] = {std::char_traits<char>::length(parCommand), parName.size()};
+		LocalData::Subscription& subscription = local.subscription(std::string(parName.data(), parName.size()));
+		uint64_t ticket;
+		{
+			TimedEventLock lock(local.connection.event_mutex(), local.connection.loop_stats());
+			{
+				std::lock_guard<std::mutex> change_lock(local.change_mutex);
+				ticket = ++local.changes_sent;
+			}
+			redisAsyncCommandArgv(local.connection.connection(), &LocalData::on_reply, &subscription, 2, argv, lengths);
+		}
+		local.connection.wakeup_event_thread();
+
+		std::unique_lock<std::mutex> lock(local.change_mutex);
+		local.change_confirmed.wait(lock, [&local, ticket]() { return local.connection_lost or local.changes_confirmed >= ticket; });
+		if (local.changes_confirmed < ticket)
+			throw std::runtime_error(std::string("Connection lost before ") + parCommand + " was confirmed");
+	}
+
+	SubscriptionStats Subscriber::stats (boost::string_view parSubscription) const {
+		std::lock_guard<std::mutex> lock(m_local_data->counters_mutex);
+		auto it_found = m_local_data->counters_map.find(std::string(parSubscription.data(), parSubscription.size()));
+		if (m_local_data->counters_map.end() == it_found)
+			return SubscriptionStats{0, 0};
+		const Counters& counters = it_found->second->counters;
+		return SubscriptionStats{
+			counters.received.load(std::memory_order_relaxed),
+			counters.dropped.load(std::memory_order_relaxed)
+		};
+	}
+
+	SubscriptionStats Subscriber::total_stats() const {
+		SubscriptionStats retval{0, 0};
+		std::lock_guard<std::mutex> lock(m_local_data->counters_mutex);
+		for (const auto& item : m_local_data->counters_map) {
+			retval.received += item.second->counters.received.load(std::memory_order_relaxed);
+			retval.dropped += item.second->counters.dropped.load(std::memory_order_relaxed);
+		}
+		return retval;
+	}
+
+	uint64_t Subscriber::handler_errors() const {
+		return m_local_data->handler_errors.load(std::memory_order_relaxed);
+	}
+} //namespace redis
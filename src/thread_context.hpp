@@ -18,17 +18,71 @@
 #ifndef idCF662C64AAB440879A3BA23C74AFF9BF
 #define idCF662C64AAB440879A3BA23C74AFF9BF
 
+#include "metrics_recorder.hpp"
+#if defined(INCREDIS_WITH_TRACING)
+#	include "incredis/command_observer.hpp"
+#endif
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 
 namespace redis {
+	class KeyFilter;
+
+	//Smoothed reply latency, updated the same way TCP estimates its round
+	//trip time (RFC 6298). Only the event thread writes to it, so there's
+	//no need for anything stronger than relaxed atomics.
+	struct LatencyStats {
+		LatencyStats ( void ) :
+			mean_ns(0),
+			deviation_ns(0),
+			samples(0)
+		{
+		}
+
+		void record ( std::chrono::steady_clock::duration parElapsed );
+
+		std::atomic<int64_t> mean_ns;
+		std::atomic<int64_t> deviation_ns;
+		std::atomic<uint64_t> samples;
+	};
+
 	struct ThreadContext {
 		ThreadContext() :
-			pending_futures(0)
+			pending_futures(0),
+			latency(),
+			metrics(),
+			key_filter(nullptr)
+#if defined(INCREDIS_WITH_TRACING)
+			, observer(nullptr)
+#endif
 		{
 		}
 
 		std::atomic_size_t pending_futures;
+		LatencyStats latency;
+		MetricsRecorder metrics;
+		std::atomic<KeyFilter*> key_filter;
+#if defined(INCREDIS_WITH_TRACING)
+		std::atomic<CommandObserver*> observer;
+#endif
 	};
+
+	inline void LatencyStats::record (std::chrono::steady_clock::duration parElapsed) {
+		const int64_t sample = std::chrono::duration_cast<std::chrono::nanoseconds>(parElapsed).count();
+		if (0 == samples.load(std::memory_order_relaxed)) {
+			mean_ns.store(sample, std::memory_order_relaxed);
+			deviation_ns.store(sample / 2, std::memory_order_relaxed);
+		}
+		else {
+			const int64_t mean = mean_ns.load(std::memory_order_relaxed);
+			const int64_t deviation = deviation_ns.load(std::memory_order_relaxed);
+			const int64_t error = (sample > mean ? sample - mean : mean - sample);
+			deviation_ns.store(deviation + (error - deviation) / 4, std::memory_order_relaxed);
+			mean_ns.store(mean + (sample - mean) / 8, std::memory_order_relaxed);
+		}
+		samples.fetch_add(1, std::memory_order_relaxed);
+	}
 } //namespace redis
 
 #endif
@@ -0,0 +1,182 @@
+/* Copyright 2016, Michele Santullo
+ * This file is part of "incredis".
+ *
+ * "incredis" is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * "incredis" is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with "incredis".  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "incredis/transaction.hpp"
+#include "incredis/command.hpp"
+#include "incredis/batch.hpp"
+#include <algorithm>
+#include <thread>
+#include <stdexcept>
+#include <string>
+#include <cassert>
+#include <ciso646>
+
+namespace redis {
+	namespace {
+		void throw_reply_error (const Reply& parReply) {
+			const std::string& message = get_error_string(parReply).message();
+			throw RedisError(message.data(), message.size());
+		}
+
+		bool is_status (const Reply& parReply, const char* parExpected) {
+			return parReply.is_status() and get<StatusString>(parReply).message() == parExpected;
+		}
+	} //unnamed namespace
+
+	Transaction::Transaction (ConnectionPool::Lease&& parLease, const TransactionOptions& parOptions) :
+		m_lease(new ConnectionPool::Lease(std::move(parLease))),
+		m_command(&m_lease->command()),
+		m_options(parOptions),
+		m_watched(),
+		m_reads(),
+		m_replies(),
+		m_random(std::random_device()()),
+		m_attempts(0)
+	{
+	}
+
+	Transaction::Transaction (Command& parExclusiveCommand, const TransactionOptions& parOptions) :
+		m_lease(),
+		m_command(&parExclusiveCommand),
+		m_options(parOptions),
+		m_watched(),
+		m_reads(),
+		m_replies(),
+		m_random(std::random_device()()),
+		m_attempts(0)
+	{
+	}
+
+	Transaction::~Transaction() noexcept = default;
+
+	Transaction& Transaction::watch (boost::string_view parKey) {
+		m_watched.emplace_back(parKey.data(), parKey.size());
+		return *this;
+	}
+
+	bool Transaction::run (const Builder& parBuilder) {
+		std::vector<StoredCommand> queue;
+		const std::size_t max_attempts = std::max<std::size_t>(1, m_options.max_attempts);
+		for (std::size_t attempt = 0; attempt < max_attempts; ++attempt) {
+			m_attempts = attempt + 1;
+			m_replies.clear();
+			try {
+				const std::vector<Reply> reads = send_reads();
+				queue.clear();
+				const bool go_on = parBuilder(reads, queue);
+				if (not go_on or queue.empty()) {
+					unwatch();
+					return go_on;
+				}
+				if (send_queued(queue))
+					return true;
+			}
+			catch (...) {
+				//Don't leave keys watched on a connection that goes back
+				//to the pool
+				try {
+					unwatch();
+				}
+				catch (const std::exception&) {
+				}
+				throw;
+			}
+			back_off(attempt);
+		}
+		throw std::runtime_error("Transaction aborted, watched keys kept changing in all " + std::to_string(max_attempts) + " attempts");
+	}
+
+	//First round trip: WATCH followed by the reads, the replies to the
+	//reads are returned
+	std::vector<Reply> Transaction::send_reads() {
+		std::vector<Reply> retval;
+		if (m_watched.empty() and m_reads.empty())
+			return retval;
+
+		auto batch = m_command->make_batch();
+		std::vector<const char*> argv;
+		std::vector<std::size_t> lengths;
+		if (not m_watched.empty()) {
+			StoredCommand watch("WATCH");
+			for (const auto& key : m_watched) {
+				watch.push_back(boost::string_view(key));
+			}
+			watch.run(batch, argv, lengths);
+		}
+		for (const auto& read : m_reads) {
+			read.run(batch, argv, lengths);
+		}
+		batch.throw_if_failed();
+
+		retval.reserve(m_reads.size());
+		auto replies = batch.replies_nonconst();
+		auto it_reply = replies.begin();
+		if (not m_watched.empty())
+			++it_reply;
+		for (; it_reply != replies.end(); ++it_reply) {
+			retval.push_back(std::move(*it_reply));
+		}
+		return retval;
+	}
+
+	//Second round trip: MULTI, the queued commands and EXEC. Returns false
+	//if EXEC was discarded because of a watched key.
+	bool Transaction::send_queued (const std::vector<StoredCommand>& parQueue) {
+		auto batch = m_command->make_batch();
+		std::vector<const char*> argv;
+		std::vector<std::size_t> lengths;
+		batch.run("MULTI");
+		for (const auto& command : parQueue) {
+			command.run(batch, argv, lengths);
+		}
+		batch.run("EXEC");
+
+		//Replies are +OK, one +QUEUED per command, then the EXEC array.
+		//A command rejected while queueing makes EXEC fail with
+		//EXECABORT, the first rejection is the more useful error.
+		auto replies = batch.replies_nonconst();
+		auto it_reply = replies.begin();
+		if (it_reply->is_error())
+			throw_reply_error(*it_reply);
+		assert(is_status(*it_reply, "OK"));
+		++it_reply;
+		for (std::size_t z = 0; z < parQueue.size(); ++z, ++it_reply) {
+			if (not is_status(*it_reply, "QUEUED"))
+				throw_reply_error(*it_reply);
+		}
+
+		Reply& exec = *it_reply;
+		if (exec.is_nil())
+			return false;
+		if (exec.is_error())
+			throw_reply_error(exec);
+		m_replies = std::move(get_array(exec));
+		return true;
+	}
+
+	void Transaction::unwatch() {
+		if (not m_watched.empty())
+			m_command->run("UNWATCH");
+	}
+
+	void Transaction::back_off (std::size_t parAttempt) {
+		const auto shift = std::min<std::size_t>(parAttempt, 20);
+		const long long ceiling = std::min<long long>(m_options.initial_backoff.count() << shift, m_options.max_backoff.count());
+		std::uniform_int_distribution<long long> distribution(ceiling / 2, ceiling);
+		std::this_thread::sleep_for(std::chrono::microseconds(distribution(m_random)));
+	}
+} //namespace redis
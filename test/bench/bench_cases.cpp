@@ -0,0 +1,99 @@
+#include "bench_harness.hpp"
+#include "incredis/incredis.hpp"
+#include "incredis/script.hpp"
+#include <string>
+#include <tuple>
+#include <vector>
+#include <stdexcept>
+
+namespace {
+	using incredis::bench::State;
+
+	redis::IncRedis make_connection() {
+		const incredis::bench::ServerAddress& address = incredis::bench::server_address();
+		redis::IncRedis retval = (address.socket.empty() ?
+			redis::IncRedis(std::string(address.hostname), address.port) :
+			redis::IncRedis(std::string(address.socket))
+		);
+		retval.connect();
+		retval.wait_for_connect();
+		if (not retval.is_connected())
+			throw std::runtime_error("Unable to connect to the server");
+		return retval;
+	}
+
+	void command_run (State& parState) {
+		redis::IncRedis incredis = make_connection();
+		redis::Command& command = incredis.command();
+		const std::string key("bench:key");
+		while (parState.keep_running()) {
+			command.run("GET", key);
+		}
+		parState.set_items_processed(parState.iterations());
+	}
+
+	void pipelined_set (State& parState) {
+		redis::IncRedis incredis = make_connection();
+		const std::string value("0123456789abcdef");
+		std::vector<std::string> keys;
+		for (int64_t z = 0; z < parState.arg(); ++z) {
+			keys.push_back("bench:set:" + std::to_string(z));
+		}
+
+		while (parState.keep_running()) {
+			auto batch = incredis.make_batch();
+			for (const auto& key : keys) {
+				batch.set(key, value, redis::IncRedisBatch::ADD_None);
+			}
+			batch.throw_if_failed();
+		}
+		parState.set_items_processed(parState.iterations() * keys.size());
+	}
+
+	void scan_iteration (State& parState) {
+		redis::IncRedis incredis = make_connection();
+		uint64_t items = 0;
+		while (parState.keep_running()) {
+			for (const auto& key : incredis.scan()) {
+				items += (key.empty() ? 0 : 1);
+			}
+		}
+		parState.set_items_processed(items);
+	}
+
+	void script_run (State& parState) {
+		redis::IncRedis incredis = make_connection();
+		redis::Script script = incredis.command().make_script("return #KEYS");
+		std::vector<std::string> keys;
+		for (int64_t z = 0; z < parState.arg(); ++z) {
+			keys.push_back("bench:script:" + std::to_string(z));
+		}
+		const std::vector<std::string> values(1, std::string("value"));
+
+		while (parState.keep_running()) {
+			auto batch = incredis.command().make_batch();
+			script.run(batch, keys, values);
+			batch.throw_if_failed();
+		}
+		parState.set_items_processed(parState.iterations());
+	}
+
+	void decode_large_array (State& parState) {
+		redis::IncRedis incredis = make_connection();
+		redis::Command& command = incredis.command();
+		const std::string key("bench:list");
+		const std::string stop = std::to_string(parState.arg() - 1);
+		uint64_t items = 0;
+		while (parState.keep_running()) {
+			const redis::Reply reply = command.run("LRANGE", key, std::string("0"), stop);
+			items += redis::get_array(reply).size();
+		}
+		parState.set_items_processed(items);
+	}
+} //unnamed namespace
+
+INCREDIS_BENCHMARK(command_run);
+INCREDIS_BENCHMARK(pipelined_set, 1, 16, 128, 1024);
+INCREDIS_BENCHMARK(scan_iteration);
+INCREDIS_BENCHMARK(script_run, 1, 100, 500);
+INCREDIS_BENCHMARK(decode_large_array, 100, 1000, 10000);
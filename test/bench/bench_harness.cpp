@@ -0,0 +1,120 @@
+#include "bench_harness.hpp"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <cassert>
+#include <ciso646>
+
+namespace incredis {
+	namespace bench {
+		namespace {
+			struct Benchmark {
+				std::string name;
+				BenchFunction function;
+				std::vector<int64_t> args;
+			};
+
+			std::vector<Benchmark>& registry() {
+				static std::vector<Benchmark> benchmarks;
+				return benchmarks;
+			}
+
+			std::unique_ptr<State> run_once (const Benchmark& parBenchmark, uint64_t parIterations, int64_t parArg) {
+				std::unique_ptr<State> state(new State(parIterations, parArg));
+				try {
+					parBenchmark.function(*state);
+				}
+				catch (const std::exception& parError) {
+					state->skip_with_error(parError.what());
+				}
+				return state;
+			}
+
+			//Grows the iteration count like Google Benchmark does, until a
+			//run takes at least parMinTime
+			std::unique_ptr<State> run_calibrated (const Benchmark& parBenchmark, int64_t parArg, std::chrono::milliseconds parMinTime) {
+				const uint64_t max_iterations = 1000000000;
+				uint64_t iterations = 1;
+				while (true) {
+					std::unique_ptr<State> state = run_once(parBenchmark, iterations, parArg);
+					if (not state->error().empty())
+						return state;
+					if (state->elapsed() >= parMinTime or iterations >= max_iterations)
+						return state;
+
+					const double elapsed = std::max<double>(1.0, static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(state->elapsed()).count()));
+					const double wanted = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(parMinTime).count()) * 1.4;
+					const double multiplier = std::min(10.0, std::max(2.0, wanted / elapsed));
+					iterations = std::min(max_iterations, static_cast<uint64_t>(static_cast<double>(iterations) * multiplier));
+				}
+			}
+
+			void print_result (const std::string& parName, const State& parState) {
+				std::cout << std::left << std::setw(40) << parName << std::right;
+				if (not parState.error().empty()) {
+					std::cout << " ERROR: " << parState.error() << std::endl;
+					return;
+				}
+
+				const double elapsed_ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(parState.elapsed()).count());
+				std::cout << std::setw(12) << parState.iterations() << ' '
+					<< std::setw(14) << std::fixed << std::setprecision(1) << elapsed_ns / static_cast<double>(parState.iterations()) << " ns/op";
+				if (parState.items_processed() and elapsed_ns > 0.0)
+					std::cout << ' ' << std::setw(14) << std::setprecision(0) << static_cast<double>(parState.items_processed()) / elapsed_ns * 1.0e9 << " items/s";
+				std::cout << std::endl;
+			}
+		} //unnamed namespace
+
+		State::State (uint64_t parIterations, int64_t parArg) :
+			m_start(),
+			m_end(),
+			m_error(),
+			m_iterations(parIterations),
+			m_remaining(parIterations),
+			m_items(0),
+			m_arg(parArg),
+			m_started(false)
+		{
+		}
+
+		bool State::keep_running() {
+			if (not m_started) {
+				m_started = true;
+				m_start = std::chrono::steady_clock::now();
+			}
+			if (m_remaining and m_error.empty()) {
+				--m_remaining;
+				return true;
+			}
+			m_end = std::chrono::steady_clock::now();
+			return false;
+		}
+
+		void State::skip_with_error (std::string&& parMessage) {
+			m_error = std::move(parMessage);
+		}
+
+		Registration::Registration (const char* parName, BenchFunction parFunction, std::vector<int64_t> parArgs) {
+			registry().push_back(Benchmark{parName, std::move(parFunction), std::move(parArgs)});
+		}
+
+		int run_benchmarks (const std::string& parFilter, std::chrono::milliseconds parMinTime) {
+			int failed = 0;
+			std::cout << std::left << std::setw(40) << "Benchmark" << std::right << std::setw(12) << "Iterations" << std::setw(21) << "Time" << std::endl;
+			for (const auto& benchmark : registry()) {
+				const std::vector<int64_t> args = (benchmark.args.empty() ? std::vector<int64_t>(1, 0) : benchmark.args);
+				for (const int64_t arg : args) {
+					const std::string name = (benchmark.args.empty() ? benchmark.name : benchmark.name + '/' + std::to_string(arg));
+					if (name.find(parFilter) == std::string::npos)
+						continue;
+					const std::unique_ptr<State> state = run_calibrated(benchmark, arg, parMinTime);
+					print_result(name, *state);
+					if (not state->error().empty())
+						++failed;
+				}
+			}
+			return failed;
+		}
+	} //namespace bench
+} //namespace incredis
@@ -0,0 +1,66 @@
+#ifndef id6C0F3D7E25A44B1E9B6D4A8F21C3E7B9
+#define id6C0F3D7E25A44B1E9B6D4A8F21C3E7B9
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace incredis {
+	namespace bench {
+		//Same idea as Google Benchmark's State: the loop
+		//	while (parState.keep_running()) { ... }
+		//is timed, anything before it is setup
+		class State {
+		public:
+			State ( uint64_t parIterations, int64_t parArg );
+
+			bool keep_running ( void );
+			int64_t arg ( void ) const { return m_arg; }
+			void set_items_processed ( uint64_t parItems ) { m_items = parItems; }
+			void skip_with_error ( std::string&& parMessage );
+
+			uint64_t iterations ( void ) const { return m_iterations; }
+			uint64_t items_processed ( void ) const { return m_items; }
+			std::chrono::steady_clock::duration elapsed ( void ) const { return m_end - m_start; }
+			const std::string& error ( void ) const { return m_error; }
+
+		private:
+			std::chrono::steady_clock::time_point m_start;
+			std::chrono::steady_clock::time_point m_end;
+			std::string m_error;
+			uint64_t m_iterations;
+			uint64_t m_remaining;
+			uint64_t m_items;
+			int64_t m_arg;
+			bool m_started;
+		};
+
+		typedef std::function<void(State&)> BenchFunction;
+
+		struct Registration {
+			Registration ( const char* parName, BenchFunction parFunction, std::vector<int64_t> parArgs=std::vector<int64_t>() );
+		};
+
+		//Runs every benchmark whose name contains parFilter, each one for
+		//at least parMinTime, and prints a line for each
+		int run_benchmarks ( const std::string& parFilter, std::chrono::milliseconds parMinTime );
+
+		//Where cases should connect to, either the stand-in server or a
+		//real one given on the command line
+		struct ServerAddress {
+			std::string socket;
+			std::string hostname;
+			uint16_t port;
+		};
+		const ServerAddress& server_address ( void );
+	} //namespace bench
+} //namespace incredis
+
+#define INCREDIS_BENCH_CONCAT_IMPL(a, b) a ## b
+#define INCREDIS_BENCH_CONCAT(a, b) INCREDIS_BENCH_CONCAT_IMPL(a, b)
+#define INCREDIS_BENCHMARK(func, ...) \
+	static const ::incredis::bench::Registration INCREDIS_BENCH_CONCAT(g_bench_registration_, __LINE__) (#func, &func, std::vector<int64_t>{__VA_ARGS__})
+
+#endif
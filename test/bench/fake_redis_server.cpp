@@ -0,0 +1,191 @@
+#include "fake_redis_server.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <vector>
+#include <cassert>
+#include <ciso646>
+
+namespace incredis {
+	namespace bench {
+		namespace {
+			const char g_value_reply[] = "$16\r\n0123456789abcdef\r\n";
+
+			void append_bulk (std::string& parOut, const std::string& parValue) {
+				parOut += '$';
+				parOut += std::to_string(parValue.size());
+				parOut += "\r\n";
+				parOut += parValue;
+				parOut += "\r\n";
+			}
+
+			std::string make_array_reply (std::size_t parSize, const char* parPrefix) {
+				std::string retval = '*' + std::to_string(parSize) + "\r\n";
+				for (std::size_t z = 0; z < parSize; ++z) {
+					append_bulk(retval, parPrefix + std::to_string(z));
+				}
+				return retval;
+			}
+
+			bool equals_nocase (const std::string& parA, const char* parB) {
+				const std::size_t len = std::strlen(parB);
+				return parA.size() == len and std::equal(parA.begin(), parA.end(), parB, [](char a, char b) {
+					return std::toupper(static_cast<unsigned char>(a)) == b;
+				});
+			}
+
+			//Returns the number of bytes consumed, 0 if the request is not
+			//complete yet
+			std::size_t parse_request (const char* parData, std::size_t parSize, std::vector<std::string>& parArgs) {
+				parArgs.clear();
+				const char* const end = parData + parSize;
+				const char* pos = parData;
+				auto read_line = [&pos, end](char parType, long& parValue) {
+					if (pos == end)
+						return false;
+					if (*pos != parType)
+						throw std::runtime_error("Unsupported request");
+					const char* const eol = static_cast<const char*>(std::memchr(pos, '\r', static_cast<std::size_t>(end - pos)));
+					if (not eol or eol + 1 >= end)
+						return false;
+					parValue = std::strtol(pos + 1, nullptr, 10);
+					pos = eol + 2;
+					return true;
+				};
+
+				long argc;
+				if (not read_line('*', argc))
+					return 0;
+				for (long z = 0; z < argc; ++z) {
+					long len;
+					if (not read_line('$', len))
+						return 0;
+					if (end - pos < len + 2)
+						return 0;
+					parArgs.emplace_back(pos, static_cast<std::size_t>(len));
+					pos += len + 2;
+				}
+				return static_cast<std::size_t>(pos - parData);
+			}
+		} //unnamed namespace
+
+		FakeRedisServer::FakeRedisServer (std::size_t parScanKeys) :
+			m_socket_path("/tmp/incredis_bench_" + std::to_string(::getpid()) + ".sock"),
+			m_scan_reply("*2\r\n$1\r\n0\r\n" + make_array_reply(parScanKeys, "key:")),
+			m_clients(),
+			m_clients_mutex(),
+			m_accept_thread(),
+			m_stopping(false),
+			m_listen_fd(::socket(AF_UNIX, SOCK_STREAM, 0))
+		{
+			if (m_listen_fd < 0)
+				throw std::runtime_error("Unable to create the server socket");
+
+			sockaddr_un address;
+			std::memset(&address, 0, sizeof(address));
+			address.sun_family = AF_UNIX;
+			assert(m_socket_path.size() < sizeof(address.sun_path));
+			std::strcpy(address.sun_path, m_socket_path.c_str());
+			::unlink(m_socket_path.c_str());
+			if (::bind(m_listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) or ::listen(m_listen_fd, 16)) {
+				::close(m_listen_fd);
+				throw std::runtime_error("Unable to listen on " + m_socket_path);
+			}
+			m_accept_thread = std::thread(&FakeRedisServer::accept_loop, this);
+		}
+
+		FakeRedisServer::~FakeRedisServer() noexcept {
+			m_stopping = true;
+			::shutdown(m_listen_fd, SHUT_RDWR);
+			m_accept_thread.join();
+			::close(m_listen_fd);
+			::unlink(m_socket_path.c_str());
+
+			std::lock_guard<std::mutex> lock(m_clients_mutex);
+			for (auto& client : m_clients) {
+				::shutdown(client.fd, SHUT_RDWR);
+				client.thread.join();
+				::close(client.fd);
+			}
+		}
+
+		void FakeRedisServer::accept_loop() {
+			while (not m_stopping) {
+				const int fd = ::accept(m_listen_fd, nullptr, nullptr);
+				if (fd < 0)
+					break;
+				std::lock_guard<std::mutex> lock(m_clients_mutex);
+				m_clients.push_back(Client{std::thread(), fd});
+				m_clients.back().thread = std::thread(&FakeRedisServer::serve, this, fd);
+			}
+		}
+
+		void FakeRedisServer::serve (int parFd) const {
+			std::vector<char> input(1 << 16);
+			std::size_t input_size = 0;
+			std::string output;
+			std::vector<std::string> args;
+			std::map<long, std::string> array_replies;
+
+			while (true) {
+				if (input_size == input.size())
+					input.resize(input.size() * 2);
+				const ssize_t got = ::read(parFd, input.data() + input_size, input.size() - input_size);
+				if (got <= 0)
+					return;
+				input_size += static_cast<std::size_t>(got);
+
+				std::size_t consumed = 0;
+				while (std::size_t used = parse_request(input.data() + consumed, input_size - consumed, args)) {
+					consumed += used;
+					if (args.empty())
+						continue;
+
+					const std::string& name = args.front();
+					if (equals_nocase(name, "PING")) {
+						output += "+PONG\r\n";
+					}
+					else if (equals_nocase(name, "GET") or equals_nocase(name, "HGET")) {
+						output += g_value_reply;
+					}
+					else if (equals_nocase(name, "LRANGE") and args.size() == 4) {
+						const long size = std::max(0L, std::strtol(args[3].c_str(), nullptr, 10) + 1);
+						auto it_reply = array_replies.find(size);
+						if (array_replies.end() == it_reply)
+							it_reply = array_replies.emplace(size, make_array_reply(static_cast<std::size_t>(size), "element:")).first;
+						output += it_reply->second;
+					}
+					else if (equals_nocase(name, "SCAN")) {
+						output += m_scan_reply;
+					}
+					else if (equals_nocase(name, "EVAL") or equals_nocase(name, "EVALSHA") or equals_nocase(name, "INCR")) {
+						output += ":1\r\n";
+					}
+					else if (equals_nocase(name, "SCRIPT")) {
+						output += "$40\r\n0000000000000000000000000000000000000000\r\n";
+					}
+					else {
+						output += "+OK\r\n";
+					}
+				}
+				std::memmove(input.data(), input.data() + consumed, input_size - consumed);
+				input_size -= consumed;
+
+				std::size_t written = 0;
+				while (written < output.size()) {
+					const ssize_t sent = ::write(parFd, output.data() + written, output.size() - written);
+					if (sent <= 0)
+						return;
+					written += static_cast<std::size_t>(sent);
+				}
+				output.clear();
+			}
+		}
+	} //namespace bench
+} //namespace incredis
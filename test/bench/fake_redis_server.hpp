@@ -0,0 +1,56 @@
+#ifndef idA4E1B7C96F0D4F3C8E2B5D7A9C1F3E60
+#define idA4E1B7C96F0D4F3C8E2B5D7A9C1F3E60
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cstddef>
+
+namespace incredis {
+	namespace bench {
+		//Just enough of a Redis server to keep the client busy: it parses
+		//RESP requests from a Unix socket and answers from canned replies
+		//without storing anything, so the time measured is the client's.
+		//Replies to all the requests read in one go are written together,
+		//like a real server does with pipelines.
+		//
+		//	PING                 +PONG
+		//	GET, HGET            a 16 byte string
+		//	LRANGE key 0 <stop>  an array of stop+1 strings
+		//	SCAN                 cursor 0 and parScanKeys keys
+		//	EVAL, EVALSHA, INCR  :1
+		//	SCRIPT LOAD          a fake 40 character hash
+		//	anything else        +OK
+		class FakeRedisServer {
+		public:
+			explicit FakeRedisServer ( std::size_t parScanKeys );
+			~FakeRedisServer ( void ) noexcept;
+
+			FakeRedisServer ( const FakeRedisServer& ) = delete;
+			FakeRedisServer& operator= ( const FakeRedisServer& ) = delete;
+
+			const std::string& socket_path ( void ) const { return m_socket_path; }
+
+		private:
+			struct Client {
+				std::thread thread;
+				int fd;
+			};
+
+			void accept_loop ( void );
+			void serve ( int parFd ) const;
+
+			std::string m_socket_path;
+			std::string m_scan_reply;
+			std::list<Client> m_clients;
+			std::mutex m_clients_mutex;
+			std::thread m_accept_thread;
+			std::atomic<bool> m_stopping;
+			int m_listen_fd;
+		};
+	} //namespace bench
+} //namespace incredis
+
+#endif
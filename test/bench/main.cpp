@@ -0,0 +1,62 @@
+#include "bench_harness.hpp"
+#include "fake_redis_server.hpp"
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace po = boost::program_options;
+
+namespace incredis {
+	namespace bench {
+		namespace {
+			ServerAddress g_server_address;
+		} //unnamed namespace
+
+		const ServerAddress& server_address() {
+			return g_server_address;
+		}
+	} //namespace bench
+} //namespace incredis
+
+int main (int parArgc, char* const parArgv[]) {
+	using incredis::bench::FakeRedisServer;
+
+	po::options_description options("Available options");
+	options.add_options()
+		("help", "Show this help")
+		("filter,f", po::value<std::string>()->default_value(std::string()), "Only run benchmarks whose name contains this")
+		("min-time,t", po::value<unsigned int>()->default_value(500), "Minimum time in milliseconds spent on each benchmark")
+		("scan-keys", po::value<std::size_t>()->default_value(1000), "Keys returned by each SCAN reply of the stand-in server")
+		("hostname,h", po::value<std::string>(), "Benchmark against a real server at this address instead")
+		("port,p", po::value<uint16_t>()->default_value(6379), "Port of the real server")
+		("socket,s", po::value<std::string>(), "Benchmark against a real server on this socket instead")
+	;
+	po::variables_map vm;
+	po::store(po::parse_command_line(parArgc, parArgv, options), vm);
+	po::notify(vm);
+	if (vm.count("help")) {
+		std::cout << options << std::endl;
+		return 0;
+	}
+
+	std::unique_ptr<FakeRedisServer> server;
+	incredis::bench::ServerAddress& address = incredis::bench::g_server_address;
+	if (vm.count("socket")) {
+		address.socket = vm["socket"].as<std::string>();
+	}
+	else if (vm.count("hostname")) {
+		address.hostname = vm["hostname"].as<std::string>();
+		address.port = vm["port"].as<uint16_t>();
+	}
+	else {
+		server.reset(new FakeRedisServer(vm["scan-keys"].as<std::size_t>()));
+		address.socket = server->socket_path();
+	}
+
+	const int failed = incredis::bench::run_benchmarks(
+		vm["filter"].as<std::string>(),
+		std::chrono::milliseconds(vm["min-time"].as<unsigned int>())
+	);
+	return (failed ? 1 : 0);
+}
@@ -0,0 +1,62 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <cstdint>
+
+namespace incredis {
+	namespace test {
+		extern uint32_t g_db;
+	} //namespace test
+} //namespace incredis
+
+using incredis::test::RedisConnectionFixture;
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Run blocking commands on pooled connections", "[blocking]") {
+	using std::chrono::milliseconds;
+
+	REQUIRE_FALSE(not incredis().flushdb());
+	incredis().enable_blocking_pool(incredis::test::g_db, 2);
+
+	SECTION("Timeout") {
+		const auto start = std::chrono::steady_clock::now();
+		CHECK_FALSE(incredis().blpop({"blocking_test:empty"}, milliseconds(200)));
+		CHECK(std::chrono::steady_clock::now() - start >= milliseconds(150));
+	}
+
+	SECTION("Main connection keeps working while a pop waits") {
+		auto popped = std::async(std::launch::async, [this]() {
+			return incredis().brpop({"blocking_test:none", "blocking_test:queue"}, milliseconds(5000));
+		});
+		for (int z = 0; z < 50; ++z) {
+			REQUIRE(incredis().set("blocking_test:key", std::to_string(z)));
+		}
+		REQUIRE(redis::get_integer(incredis().run("RPUSH", "blocking_test:queue", "item")) == 1);
+
+		const auto key_value = popped.get();
+		REQUIRE(key_value);
+		CHECK(key_value->first == "blocking_test:queue");
+		CHECK(key_value->second == "item");
+		CHECK(incredis().blocking_pool()->idle_count() == incredis().blocking_pool()->size());
+	}
+
+	SECTION("Move between lists and cancel") {
+		REQUIRE(redis::get_integer(incredis().run("RPUSH", "blocking_test:from", "a", "b")) == 2);
+		CHECK(incredis().blmove("blocking_test:from", "blocking_test:to", redis::ListEnd_Left, redis::ListEnd_Right, milliseconds(100)) == std::string("a"));
+		CHECK(redis::get_integer(incredis().run("LLEN", "blocking_test:to")) == 1);
+
+		auto waiting = std::async(std::launch::async, [this]() {
+			return incredis().blpop({"blocking_test:never"}, milliseconds(0));
+		});
+		while (incredis().blocking_pool()->idle_count() == incredis().blocking_pool()->size()) {
+			std::this_thread::sleep_for(milliseconds(1));
+		}
+		//Give BLPOP time to reach the server before unblocking it
+		std::this_thread::sleep_for(milliseconds(50));
+		incredis().cancel_blocking();
+		CHECK_FALSE(waiting.get());
+	}
+}
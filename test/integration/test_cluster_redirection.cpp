@@ -0,0 +1,280 @@
+#include "catch.hpp"
+#include "incredis/cluster_command.hpp"
+#include "incredis/command.hpp"
+#include "incredis/hash_slot.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+	//Minimal RESP server standing in for a cluster node. The handler gets
+	//the command and whether the previous command on the same connection
+	//was ASKING, and returns the raw reply.
+	class StubNode {
+	public:
+		typedef std::function<std::string(const std::vector<std::string>&, bool)> Handler;
+
+		explicit StubNode ( Handler parHandler ) :
+			m_handler(std::move(parHandler)),
+			m_acceptor(),
+			m_clients(),
+			m_client_fds(),
+			m_mutex(),
+			m_listen_fd(socket(AF_INET, SOCK_STREAM, 0)),
+			m_port(0)
+		{
+			REQUIRE(m_listen_fd >= 0);
+			sockaddr_in addr;
+			std::memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			addr.sin_port = 0;
+			REQUIRE(0 == bind(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+			REQUIRE(0 == listen(m_listen_fd, 8));
+			socklen_t addr_len = sizeof(addr);
+			REQUIRE(0 == getsockname(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len));
+			m_port = ntohs(addr.sin_port);
+			m_acceptor = std::thread([this]() { this->accept_loop(); });
+		}
+
+		~StubNode ( void ) noexcept {
+			shutdown(m_listen_fd, SHUT_RDWR);
+			m_acceptor.join();
+			close(m_listen_fd);
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (int fd : m_client_fds) {
+					shutdown(fd, SHUT_RDWR);
+				}
+			}
+			for (auto& client : m_clients) {
+				client.join();
+			}
+			for (int fd : m_client_fds) {
+				close(fd);
+			}
+		}
+
+		uint16_t port ( void ) const { return m_port; }
+
+	private:
+		void accept_loop ( void ) {
+			while (true) {
+				const int fd = accept(m_listen_fd, nullptr, nullptr);
+				if (fd < 0)
+					return;
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_client_fds.push_back(fd);
+				m_clients.emplace_back([this, fd]() { this->serve(fd); });
+			}
+		}
+
+		void serve ( int parFd ) {
+			std::string buffer;
+			char chunk[4096];
+			bool asking = false;
+			while (true) {
+				const ssize_t got = read(parFd, chunk, sizeof(chunk));
+				if (got <= 0)
+					break;
+				buffer.append(chunk, static_cast<std::size_t>(got));
+
+				std::vector<std::string> args;
+				std::size_t consumed;
+				while (parse_command(buffer, args, consumed)) {
+					buffer.erase(0, consumed);
+					const std::string reply = m_handler(args, asking);
+					asking = (args.front() == "ASKING");
+					if (write(parFd, reply.data(), reply.size()) != static_cast<ssize_t>(reply.size()))
+						break;
+				}
+			}
+		}
+
+		//Parses "*<n>\r\n$<len>\r\n<arg>\r\n...", false if incomplete
+		static bool parse_command ( const std::string& parBuffer, std::vector<std::string>& parArgs, std::size_t& parConsumed ) {
+			parArgs.clear();
+			if (parBuffer.empty() or parBuffer[0] != '*')
+				return false;
+			std::size_t pos = parBuffer.find("\r\n");
+			if (std::string::npos == pos)
+				return false;
+			const long count = std::stol(parBuffer.substr(1, pos - 1));
+			pos += 2;
+			for (long z = 0; z < count; ++z) {
+				const std::size_t len_end = parBuffer.find("\r\n", pos);
+				if (std::string::npos == len_end)
+					return false;
+				const std::size_t len = std::stoul(parBuffer.substr(pos + 1, len_end - pos - 1));
+				if (parBuffer.size() < len_end + 2 + len + 2)
+					return false;
+				parArgs.push_back(parBuffer.substr(len_end + 2, len));
+				pos = len_end + 2 + len + 2;
+			}
+			parConsumed = pos;
+			return not parArgs.empty();
+		}
+
+		Handler m_handler;
+		std::thread m_acceptor;
+		std::vector<std::thread> m_clients;
+		std::vector<int> m_client_fds;
+		std::mutex m_mutex;
+		int m_listen_fd;
+		uint16_t m_port;
+	};
+
+	std::string bulk (const std::string& parValue) {
+		return "$" + std::to_string(parValue.size()) + "\r\n" + parValue + "\r\n";
+	}
+
+	//All slots on one primary, with an empty host so the client reuses
+	//the host it asked
+	std::string slot_map (uint16_t parOwnerPort) {
+		return "*1\r\n*3\r\n:0\r\n:16383\r\n*2\r\n$0\r\n\r\n:" + std::to_string(parOwnerPort) + "\r\n";
+	}
+} //unnamed namespace
+
+TEST_CASE("Follow MOVED and ASK redirections", "[cluster]") {
+	const std::string moved_key = "moved_key";
+	const std::string ask_key = "ask_key";
+	std::atomic<uint16_t> owner_port(0);
+	std::atomic<uint16_t> port_a(0);
+	std::atomic<uint16_t> port_b(0);
+	std::atomic<int> asked_gets(0);
+
+	//A owns every slot at first, then gives them to B after the first
+	//MOVED. B is still importing ask_key, which lives on A.
+	StubNode node_a([&](const std::vector<std::string>& parArgs, bool parAsking) -> std::string {
+		if (parArgs[0] == "CLUSTER")
+			return slot_map(owner_port);
+		if (parArgs[0] == "ASKING")
+			return "+OK\r\n";
+		if (parArgs[0] == "GET" and parArgs[1] == moved_key) {
+			owner_port = port_b.load();
+			//Empty host, the client must stick to the host of this node
+			return "-MOVED " + std::to_string(redis::key_hash_slot(moved_key)) + " :" + std::to_string(port_b) + "\r\n";
+		}
+		if (parArgs[0] == "GET" and parArgs[1] == ask_key) {
+			if (not parAsking)
+				return "-MOVED " + std::to_string(redis::key_hash_slot(ask_key)) + " 127.0.0.1:" + std::to_string(port_b) + "\r\n";
+			++asked_gets;
+			return bulk("asked");
+		}
+		return "-ERR unexpected command on A\r\n";
+	});
+	StubNode node_b([&](const std::vector<std::string>& parArgs, bool) -> std::string {
+		if (parArgs[0] == "CLUSTER")
+			return slot_map(owner_port);
+		if (parArgs[0] == "GET" and parArgs[1] == moved_key)
+			return bulk("moved");
+		if (parArgs[0] == "GET" and parArgs[1] == ask_key)
+			return "-ASK " + std::to_string(redis::key_hash_slot(ask_key)) + " 127.0.0.1:" + std::to_string(port_a) + "\r\n";
+		if (parArgs[0] == "MULTIERR")
+			return "*2\r\n+OK\r\n-ERR nested failure\r\n";
+		return "-ERR unexpected command on B\r\n";
+	});
+	port_a = node_a.port();
+	port_b = node_b.port();
+	owner_port = node_a.port();
+
+	redis::ClusterCommand cluster({redis::ClusterCommand::NodeAddress("127.0.0.1", node_a.port())});
+	cluster.connect();
+	REQUIRE(cluster.is_connected());
+	CHECK(cluster.node_for_key(moved_key).port() == node_a.port());
+
+	{
+		auto batch = cluster.make_batch();
+		batch.run("GET", moved_key);
+		batch.throw_if_failed();
+		REQUIRE(batch.replies().size() == 1);
+		CHECK(redis::get_string(batch.replies()[0]) == "moved");
+		CHECK(cluster.node_for_key(moved_key).port() == node_b.port());
+		CHECK(cluster.node_for_key(moved_key).address() == "127.0.0.1");
+
+		//The batch still points to the nodes
+		CHECK_THROWS(cluster.disconnect());
+	}
+
+	{
+		auto batch = cluster.make_batch();
+		batch.run("GET", ask_key);
+		batch.throw_if_failed();
+		CHECK(redis::get_string(batch.replies()[0]) == "asked");
+		CHECK(asked_gets == 1);
+		//ASK is a one off, the slot stays with B
+		CHECK(cluster.node_for_key(ask_key).port() == node_b.port());
+	}
+
+	{
+		auto batch = cluster.make_batch();
+		batch.run("MULTIERR", moved_key);
+		CHECK_THROWS(batch.throw_if_failed());
+	}
+
+	cluster.disconnect();
+	CHECK_FALSE(cluster.is_connected());
+}
+
+TEST_CASE("Route cluster commands by their keys", "[cluster]") {
+	//Slots are split in half between A and B
+	const uint16_t half = redis::g_cluster_slot_count / 2;
+	std::string key_on_b;
+	std::string script_on_a;
+	for (int z = 0; key_on_b.empty() or script_on_a.empty(); ++z) {
+		const std::string candidate = "route_" + std::to_string(z);
+		if (redis::key_hash_slot(candidate) >= half)
+			key_on_b = candidate;
+		else
+			script_on_a = candidate;
+	}
+
+	std::atomic<uint16_t> port_a(0);
+	std::atomic<uint16_t> port_b(0);
+	auto split_slot_map = [&]() -> std::string {
+		return "*2\r\n"
+			"*3\r\n:0\r\n:" + std::to_string(half - 1) + "\r\n*2\r\n$0\r\n\r\n:" + std::to_string(port_a) + "\r\n"
+			"*3\r\n:" + std::to_string(half) + "\r\n:16383\r\n*2\r\n$0\r\n\r\n:" + std::to_string(port_b) + "\r\n";
+	};
+	StubNode node_a([&](const std::vector<std::string>& parArgs, bool) -> std::string {
+		if (parArgs[0] == "CLUSTER")
+			return split_slot_map();
+		if (parArgs[0] == "PING")
+			return "+PONG\r\n";
+		return "-ERR unexpected command on A\r\n";
+	});
+	StubNode node_b([&](const std::vector<std::string>& parArgs, bool) -> std::string {
+		if (parArgs[0] == "CLUSTER")
+			return split_slot_map();
+		if (parArgs[0] == "PING")
+			return "+PONG\r\n";
+		if (parArgs[0] == "EVAL" and parArgs[3] == key_on_b)
+			return bulk("b");
+		return "-ERR unexpected command on B\r\n";
+	});
+	port_a = node_a.port();
+	port_b = node_b.port();
+
+	redis::ClusterCommand cluster({redis::ClusterCommand::NodeAddress("127.0.0.1", node_a.port())});
+	cluster.connect();
+	REQUIRE(cluster.node_count() == 2);
+
+	auto batch = cluster.make_batch();
+	//The key is the fourth argument, the script hashes to A
+	batch.run("EVAL", script_on_a, "1", key_on_b);
+	//No keys, "hello" must not be taken for one
+	batch.run("PING", "hello");
+	CHECK_THROWS(batch.run("MGET", key_on_b, script_on_a));
+	batch.throw_if_failed();
+	REQUIRE(batch.replies().size() == 2);
+	CHECK(redis::get_string(batch.replies()[0]) == "b");
+	CHECK(redis::get_string(batch.replies()[1]) == "PONG");
+}
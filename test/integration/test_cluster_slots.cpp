@@ -0,0 +1,38 @@
+#include "catch.hpp"
+#include "incredis/hash_slot.hpp"
+#include "incredis/stored_command.hpp"
+#include <string>
+
+TEST_CASE("Compute cluster hash slots", "[cluster]") {
+	using redis::crc16;
+	using redis::key_hash_slot;
+
+	CHECK(crc16("123456789") == 0x31C3);
+	CHECK(key_hash_slot("foo") == 12182);
+	CHECK(key_hash_slot("123456789") == 12739);
+	CHECK(key_hash_slot("{user1000}.following") == key_hash_slot("{user1000}.followers"));
+	CHECK(key_hash_slot("{user1000}.following") == key_hash_slot("user1000"));
+}
+
+TEST_CASE("Extract hash tags from keys", "[cluster]") {
+	using redis::hash_tag;
+
+	CHECK(hash_tag("foo{bar}") == "bar");
+	CHECK(hash_tag("foo{bar}{zap}") == "bar");
+	CHECK(hash_tag("foo{}{bar}") == "foo{}{bar}");
+	CHECK(hash_tag("foo{{bar}}zap") == "{bar");
+	CHECK(hash_tag("nobraces") == "nobraces");
+	CHECK(hash_tag("foo{bar") == "foo{bar");
+}
+
+TEST_CASE("Store a command with its arguments", "[cluster]") {
+	redis::StoredCommand command("SET", "key", std::string("value"));
+	REQUIRE(command.size() == 3);
+	CHECK(command.name() == "SET");
+	CHECK(command[1] == "key");
+	CHECK(command[2] == "value");
+
+	command.push_back(boost::string_view("EX"));
+	CHECK(command.size() == 4);
+	CHECK(command[3] == "EX");
+}
@@ -0,0 +1,69 @@
+#include "catch.hpp"
+#include "incredis/command_table.hpp"
+#include <cstring>
+#include <string>
+#include <vector>
+
+TEST_CASE("Look up commands in the command table", "[replica]") {
+	using redis::find_command_info;
+	using redis::is_read_only_command;
+
+	CHECK(is_read_only_command("GET"));
+	CHECK(is_read_only_command("get"));
+	CHECK(is_read_only_command("HgetAll"));
+	CHECK(is_read_only_command("ZRANGEBYSCORE"));
+	CHECK(is_read_only_command("SSCAN"));
+	CHECK_FALSE(is_read_only_command("SET"));
+	CHECK_FALSE(is_read_only_command("EVALSHA"));
+	CHECK_FALSE(is_read_only_command("XREADGROUP"));
+	CHECK_FALSE(is_read_only_command("NOTACOMMAND"));
+	CHECK_FALSE(is_read_only_command(""));
+
+	REQUIRE(find_command_info("blpop"));
+	CHECK(find_command_info("blpop")->flags & redis::CommandFlag_Blocking);
+	CHECK(redis::needs_own_connection("BLPOP"));
+	CHECK_FALSE(redis::needs_own_connection("WAIT"));
+	CHECK_FALSE(redis::needs_own_connection("waitaof"));
+	CHECK_FALSE(redis::needs_own_connection("GET"));
+	CHECK(nullptr == find_command_info("GE"));
+	CHECK(nullptr == find_command_info("GETX"));
+}
+
+TEST_CASE("Command table is sorted and indexable", "[replica]") {
+	const auto size = redis::command_table_size();
+	REQUIRE(size > 0);
+	for (std::size_t z = 1; z < size; ++z) {
+		CHECK(std::strcmp(redis::command_info(z - 1).name, redis::command_info(z).name) < 0);
+	}
+	for (std::size_t z = 0; z < size; ++z) {
+		CHECK(redis::command_index(redis::command_info(z).name) == z);
+	}
+	CHECK(redis::command_index("NOTACOMMAND") == size);
+}
+
+TEST_CASE("Find the keys of a command", "[replica]") {
+	auto keys_of = [](std::vector<std::string> parArgs) {
+		std::vector<const char*> argv;
+		std::vector<std::size_t> lengths;
+		for (const auto& arg : parArgs) {
+			argv.push_back(arg.data());
+			lengths.push_back(arg.size());
+		}
+		std::vector<std::string> retval;
+		redis::for_each_key(static_cast<int>(argv.size()), argv.data(), lengths.data(), [&retval](boost::string_view parKey) {
+			retval.push_back(std::string(parKey));
+		});
+		return retval;
+	};
+	using list = std::vector<std::string>;
+
+	CHECK(keys_of({"SET", "a", "1"}) == list({"a"}));
+	CHECK(keys_of({"del", "a", "b", "c"}) == list({"a", "b", "c"}));
+	CHECK(keys_of({"MSET", "a", "1", "b", "2"}) == list({"a", "b"}));
+	CHECK(keys_of({"BLPOP", "a", "b", "5"}) == list({"a", "b"}));
+	CHECK(keys_of({"EVALSHA", "0123", "2", "a", "b", "arg"}) == list({"a", "b"}));
+	CHECK(keys_of({"EVAL", "return 1", "0", "arg"}).empty());
+	CHECK(keys_of({"PING"}).empty());
+	CHECK(keys_of({"GET"}).empty());
+	CHECK(keys_of({"NOTACOMMAND", "x", "y"}) == list({"x", "y"}));
+}
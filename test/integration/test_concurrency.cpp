@@ -0,0 +1,73 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using incredis::test::RedisConnectionFixture;
+
+namespace {
+	std::size_t hammer_get (redis::IncRedis& parIncredis, const std::string& parKey, const std::string& parExpected, std::size_t parThreads, std::size_t parIterations) {
+		std::atomic<std::size_t> mismatches(0);
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < parThreads; ++t) {
+			threads.emplace_back([&]() {
+				for (std::size_t z = 0; z < parIterations; ++z) {
+					const auto value = parIncredis.get(parKey);
+					if (not value or *value != parExpected)
+						++mismatches;
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		return mismatches;
+	}
+} //unnamed namespace
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Coalesce identical concurrent reads", "[concurrency]") {
+	REQUIRE(incredis().set("single_flight_test:hot", "hot_value"));
+	incredis().set_single_flight(true);
+
+	//Every reply on the connection is a latency sample, so they count
+	//the round trips actually made
+	const std::size_t callers = 16 * 200;
+	const auto coalesced_before = incredis().command().coalesced_reads();
+	const auto replies_before = incredis().command().latency().samples;
+	CHECK(hammer_get(incredis(), "single_flight_test:hot", "hot_value", 16, 200) == 0);
+	CHECK(incredis().command().coalesced_reads() > coalesced_before);
+	CHECK(incredis().command().latency().samples - replies_before < callers);
+
+	//Writes are never coalesced
+	const auto before = incredis().command().coalesced_reads();
+	CHECK(incredis().incr("single_flight_test:counter") == 1);
+	CHECK(incredis().incr("single_flight_test:counter") == 2);
+	CHECK(incredis().command().coalesced_reads() == before);
+
+	incredis().set_single_flight(false);
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Batch synchronous calls from many threads", "[concurrency]") {
+	REQUIRE(incredis().set("auto_batch_test:hot", "batched_value"));
+	redis::AutoBatchOptions options;
+	options.max_commands = 32;
+	options.window = std::chrono::microseconds(200);
+	incredis().set_auto_batching(options);
+
+	const auto flushes_before = incredis().command().auto_batch_flushes();
+	CHECK(hammer_get(incredis(), "auto_batch_test:hot", "batched_value", 16, 200) == 0);
+	const auto flushes = incredis().command().auto_batch_flushes() - flushes_before;
+	CHECK(flushes > 0);
+	CHECK(flushes < 16 * 200);
+
+	//Errors reach only the caller that caused them
+	REQUIRE(incredis().hmset("auto_batch_test:hash", "field", "value"));
+	CHECK_THROWS(incredis().incr("auto_batch_test:hash"));
+	CHECK(incredis().get("auto_batch_test:hot") == std::string("batched_value"));
+
+	incredis().disable_auto_batching();
+}
@@ -0,0 +1,71 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include "incredis/glob_pattern.hpp"
+#include "incredis/scan_demux.hpp"
+#include <string>
+#include <set>
+
+using incredis::test::RedisConnectionFixture;
+
+TEST_CASE("Match keys against glob patterns client-side", "[glob]") {
+	using redis::GlobPattern;
+
+	CHECK(GlobPattern("*").match(""));
+	CHECK(GlobPattern("*").match("anything"));
+	CHECK(GlobPattern("user:*").match("user:1000"));
+	CHECK(GlobPattern("user:*").match("user:"));
+	CHECK_FALSE(GlobPattern("user:*").match("users:1000"));
+	CHECK(GlobPattern("exact").match("exact"));
+	CHECK_FALSE(GlobPattern("exact").match("exactly"));
+	CHECK(GlobPattern("h?llo").match("hello"));
+	CHECK_FALSE(GlobPattern("h?llo").match("hllo"));
+	CHECK(GlobPattern("h*llo").match("hllo"));
+	CHECK(GlobPattern("h*llo").match("heeeello"));
+	CHECK(GlobPattern("h[ae]llo").match("hallo"));
+	CHECK_FALSE(GlobPattern("h[ae]llo").match("hillo"));
+	CHECK(GlobPattern("h[^e]llo").match("hallo"));
+	CHECK_FALSE(GlobPattern("h[^e]llo").match("hello"));
+	CHECK(GlobPattern("h[a-b]llo").match("hbllo"));
+	CHECK(GlobPattern("h[b-a]llo").match("hallo"));
+	CHECK_FALSE(GlobPattern("h[a-b]llo").match("hcllo"));
+	CHECK(GlobPattern("a\\*b").match("a*b"));
+	CHECK_FALSE(GlobPattern("a\\*b").match("axb"));
+	CHECK(GlobPattern("*:*:end").match("a:b:c:end"));
+	CHECK_FALSE(GlobPattern("*:*:end").match("a:end"));
+	CHECK(GlobPattern("a*b*c").match("abc"));
+	CHECK(GlobPattern("a*b*c").match("aXbYbZc"));
+	CHECK_FALSE(GlobPattern("a*b*c").match("aXbYbZ"));
+
+	CHECK(GlobPattern("user:*:name").literal_prefix() == "user:");
+	CHECK(GlobPattern("\\[tag]*").literal_prefix() == "[tag]");
+	CHECK(redis::glob_escape("a*b?[c]\\") == "a\\*b\\?\\[c]\\\\");
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Walk the keyspace once dispatching keys to several patterns", "[scan][glob]") {
+	using redis::IncRedisBatch;
+
+	REQUIRE_FALSE(not incredis().flushdb());
+
+	auto batch = incredis().make_batch();
+	for (int z = 0; z < 200; ++z) {
+		batch.set("demux:user:" + std::to_string(z), "u", IncRedisBatch::ADD_None);
+		batch.set("demux:session:" + std::to_string(z), "s", IncRedisBatch::ADD_None);
+		batch.set("demux:cache:" + std::to_string(z), "c", IncRedisBatch::ADD_None);
+	}
+	REQUIRE_NOTHROW(batch.throw_if_failed());
+
+	std::set<std::string> users, sessions, tens;
+	redis::ScanDemux demux;
+	demux.add("demux:user:*", [&users](const std::string& parKey) { users.insert(parKey); });
+	demux.add("demux:session:*", [&sessions](const std::string& parKey) { sessions.insert(parKey); });
+	demux.add("demux:*:1?", [&tens](const std::string& parKey) { tens.insert(parKey); });
+	REQUIRE(demux.server_pattern() == "demux:*");
+
+	const auto scanned = demux.run(incredis());
+	REQUIRE(scanned >= 600);
+	REQUIRE(users.size() == 200);
+	REQUIRE(sessions.size() == 200);
+	REQUIRE(tens.size() == 30);
+	REQUIRE(demux.match_count(2) >= 30);
+}
@@ -0,0 +1,95 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include "incredis/key_filter.hpp"
+#include <string>
+#include <tuple>
+#include <cstddef>
+
+using incredis::test::RedisConnectionFixture;
+
+TEST_CASE("Negative lookup filter has no false negatives and a bounded false positive rate", "[key_filter]") {
+	const std::size_t key_count = 20000;
+	redis::KeyFilter filter(key_count, 0.01);
+
+	for (std::size_t z = 0; z < key_count; ++z) {
+		filter.insert("present:" + std::to_string(z));
+	}
+	for (std::size_t z = 0; z < key_count; ++z) {
+		REQUIRE(filter.may_contain("present:" + std::to_string(z)));
+	}
+
+	std::size_t false_positives = 0;
+	const std::size_t probe_count = 100000;
+	for (std::size_t z = 0; z < probe_count; ++z) {
+		if (filter.may_contain("absent:" + std::to_string(z)))
+			++false_positives;
+	}
+	CHECK(false_positives < probe_count * 2 / 100);
+	CHECK(filter.stats().inserted == key_count);
+}
+
+TEST_CASE("Negative lookup filter only covers its prefix", "[key_filter]") {
+	redis::KeyFilter filter(100, 0.01, "user:");
+	CHECK(filter.covers("user:1"));
+	CHECK_FALSE(filter.covers("session:1"));
+	CHECK_FALSE(filter.definitely_absent("session:1"));
+	CHECK(filter.definitely_absent("user:1"));
+	filter.insert("user:1");
+	CHECK_FALSE(filter.definitely_absent("user:1"));
+	CHECK(filter.stats().lookups == 2);
+	CHECK(filter.stats().definitely_absent == 1);
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Skip reads of keys known to be absent", "[key_filter]") {
+	REQUIRE(incredis().flushdb());
+	REQUIRE(incredis().set("filter_test:scanned", "1"));
+
+	redis::KeyFilter& filter = incredis().enable_key_filter(1000, 0.01, "filter_test:");
+	CHECK(filter.is_ready());
+	CHECK(filter.stats().inserted == 1);
+
+	CHECK(incredis().get("filter_test:scanned"));
+	CHECK_FALSE(incredis().get("filter_test:missing"));
+	CHECK_FALSE(incredis().hget("filter_test:missing_hash", "field"));
+	CHECK(filter.stats().definitely_absent >= 1);
+
+	auto batch = incredis().make_batch();
+	batch.set("filter_test:written", "2", redis::IncRedisBatch::ADD_None);
+	batch.hmset("filter_test:hash", "a", "1");
+	batch.throw_if_failed();
+	REQUIRE(incredis().get("filter_test:written"));
+	CHECK(*incredis().get("filter_test:written") == "2");
+	REQUIRE(incredis().hget("filter_test:hash", "a"));
+	CHECK(*incredis().hget("filter_test:hash", "a") == "1");
+
+	//Only misses the filter let through are false positives
+	const auto false_positives = filter.stats().false_positives;
+	filter.set_ready(false);
+	CHECK_FALSE(incredis().get("filter_test:missing"));
+	CHECK(filter.stats().false_positives == false_positives);
+	filter.set_ready(true);
+
+	incredis().disable_key_filter();
+	CHECK(nullptr == incredis().key_filter());
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Negative lookup filter sees writes made outside IncRedis helpers", "[key_filter]") {
+	REQUIRE(incredis().flushdb());
+	incredis().enable_key_filter(1000, 0.01);
+
+	incredis().run("SET", "filter_test:run", "1");
+	REQUIRE(incredis().get("filter_test:run"));
+	CHECK(*incredis().get("filter_test:run") == "1");
+
+	auto script = incredis().command().make_script("return redis.call('SET', KEYS[1], ARGV[1])");
+	{
+		auto batch = incredis().command().make_batch();
+		script.run(batch, std::make_tuple(std::string("filter_test:script")), std::make_tuple(std::string("2")));
+		batch.throw_if_failed();
+	}
+	REQUIRE(incredis().get("filter_test:script"));
+	CHECK(*incredis().get("filter_test:script") == "2");
+
+	incredis().disable_key_filter();
+}
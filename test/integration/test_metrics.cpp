@@ -0,0 +1,103 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include "incredis/metrics.hpp"
+#include "incredis/command_observer.hpp"
+#include <algorithm>
+#include <string>
+#include <atomic>
+
+using incredis::test::RedisConnectionFixture;
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Per command metrics", "[metrics]") {
+	auto& command = incredis().command();
+	command.set_metrics(true);
+
+	{
+		auto batch = command.make_batch();
+		for (int z = 0; z < 100; ++z) {
+			batch.run("SET", std::string("metrics:key"), std::to_string(z));
+		}
+		batch.run("GET", std::string("metrics:key"));
+		batch.run("INCR", std::string("metrics:key"), std::string("extra argument"));
+		batch.replies();
+	}
+
+	const redis::MetricsSnapshot snapshot = command.metrics();
+	command.set_metrics(false);
+	CHECK(snapshot.in_flight == 0);
+	CHECK(snapshot.connections >= 1);
+
+	auto find = [&snapshot](const char* parName) {
+		return std::find_if(snapshot.commands.begin(), snapshot.commands.end(), [parName](const redis::CommandMetrics& parMetrics) { return parMetrics.name == parName; });
+	};
+	const auto set = find("SET");
+	REQUIRE(set != snapshot.commands.end());
+	CHECK(set->latency.count == 100);
+	CHECK(set->errors == 0);
+	CHECK(set->bytes_received == 100 * 5); //+OK\r\n
+	CHECK(set->latency.percentile(50) <= set->latency.max);
+	CHECK(set->latency.min <= set->latency.percentile(50));
+
+	const auto get = find("GET");
+	REQUIRE(get != snapshot.commands.end());
+	CHECK(get->bytes_sent == 31); //*2 $3 GET $11 metrics:key
+	CHECK(get->bytes_received == 8); //$2 99
+
+	const auto incr = find("INCR");
+	REQUIRE(incr != snapshot.commands.end());
+	CHECK(incr->errors == 1);
+
+	const redis::EventLoopStats& loop = snapshot.event_loop;
+	CHECK(loop.wakeups_sent > 0);
+	CHECK(loop.wakeup_latency.count > 0);
+	CHECK(loop.iteration.count > 0);
+	CHECK(loop.caller_mutex_hold.count >= 102);
+	CHECK(loop.reply_parse.count == 102);
+
+	const std::string text = redis::to_prometheus(snapshot);
+	CHECK(text.find("incredis_command_duration_seconds_count{command=\"SET\"} 100\n") != std::string::npos);
+	CHECK(text.find("incredis_command_errors_total{command=\"INCR\"} 1\n") != std::string::npos);
+}
+
+namespace {
+	struct CountingObserver : redis::CommandObserver {
+		CountingObserver() : enqueued(0), written(0), replied(0), consumed(0), errors(0) {}
+
+		void on_enqueue (const redis::CommandTrace& parTrace) override {
+			if (parTrace.name == "PING" and 1 == parTrace.arg_count and 5 == parTrace.arg_sizes[0])
+				++enqueued;
+		}
+		void on_write (uint64_t, std::chrono::steady_clock::time_point) override { ++written; }
+		void on_reply (uint64_t, std::chrono::steady_clock::time_point, bool parError) override { ++replied; errors += (parError ? 1 : 0); }
+		void on_consume (uint64_t, std::chrono::steady_clock::time_point) override { ++consumed; }
+
+		std::atomic<int> enqueued, written, replied, consumed, errors;
+	};
+} //unnamed namespace
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Command observer", "[metrics][tracing]") {
+	auto& command = incredis().command();
+	CountingObserver observer;
+
+	if (not redis::tracing_available()) {
+		CHECK_THROWS(command.set_observer(&observer));
+		return;
+	}
+
+	command.set_observer(&observer);
+	{
+		auto batch = command.make_batch();
+		batch.run("PING", std::string("hello"));
+		batch.run("PING", std::string("world"));
+		batch.replies();
+		batch.replies();
+	}
+	command.set_observer(nullptr);
+
+	CHECK(observer.enqueued == 2);
+	CHECK(observer.written == 2);
+	CHECK(observer.replied == 2);
+	CHECK(observer.consumed == 2);
+	CHECK(observer.errors == 0);
+}
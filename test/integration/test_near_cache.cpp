@@ -0,0 +1,96 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include <string>
+#include <thread>
+#include <chrono>
+
+namespace incredis {
+	namespace test {
+		extern std::string g_hostname;
+		extern uint16_t g_port;
+		extern std::string g_socket;
+		extern uint32_t g_db;
+	} //namespace test
+} //namespace incredis
+
+using incredis::test::RedisConnectionFixture;
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Serve reads from the near cache until invalidated", "[near_cache]") {
+	REQUIRE(incredis().set("near_cache_test:flag", "on"));
+	REQUIRE(incredis().hmset("near_cache_test:hash", "a", "1", "b", "2"));
+
+	try {
+		incredis().enable_near_cache();
+	}
+	catch (const std::runtime_error& err) {
+		WARN("CLIENT TRACKING not available, skipping: " << err.what());
+		return;
+	}
+	redis::NearCache& cache = *incredis().near_cache();
+
+	for (int z = 0; z < 10; ++z) {
+		REQUIRE(incredis().get("near_cache_test:flag"));
+		CHECK(*incredis().get("near_cache_test:flag") == "on");
+	}
+	CHECK(cache.stats().hits >= 18);
+	CHECK(cache.stats().misses == 1);
+
+	const auto fields = incredis().hmget("near_cache_test:hash", "a", "b");
+	REQUIRE(fields);
+	CHECK(*(*fields)[1] == "2");
+	REQUIRE(incredis().hget("near_cache_test:hash", "a"));
+	CHECK(*incredis().hget("near_cache_test:hash", "a") == "1");
+
+	SECTION("Writes through IncRedis are visible right away") {
+		REQUIRE(incredis().set("near_cache_test:flag", "off"));
+		CHECK(*incredis().get("near_cache_test:flag") == "off");
+	}
+
+	SECTION("Writes from elsewhere arrive as invalidations") {
+		incredis().command().run("SET", "near_cache_test:flag", "off");
+		std::string value;
+		for (int z = 0; z < 200 and value != "off"; ++z) {
+			value = *incredis().get("near_cache_test:flag");
+			if (value != "off")
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		CHECK(value == "off");
+		CHECK(cache.stats().invalidations > 0);
+	}
+
+	incredis().disable_near_cache();
+	CHECK(nullptr == incredis().near_cache());
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Only cache keys under the broadcast prefixes", "[near_cache]") {
+	using namespace incredis::test;
+
+	REQUIRE(incredis().set("near_cache_test:bcast:in", "old"));
+	REQUIRE(incredis().set("near_cache_test:outside", "old"));
+
+	redis::NearCacheOptions options;
+	options.prefixes.push_back("near_cache_test:bcast:");
+	try {
+		incredis().enable_near_cache(options);
+	}
+	catch (const std::runtime_error& err) {
+		WARN("CLIENT TRACKING not available, skipping: " << err.what());
+		return;
+	}
+
+	CHECK(*incredis().get("near_cache_test:bcast:in") == "old");
+	CHECK(*incredis().get("near_cache_test:outside") == "old");
+	CHECK(incredis().near_cache()->size() == 1);
+
+	//The server sends no invalidation for keys outside the prefixes
+	redis::Command other(g_socket.empty() ? redis::Command(std::string(g_hostname), g_port) : redis::Command(std::string(g_socket)));
+	other.connect();
+	other.wait_for_connect();
+	REQUIRE(other.is_connected());
+	other.run("SELECT", std::to_string(g_db));
+	other.run("SET", "near_cache_test:outside", "new");
+	CHECK(*incredis().get("near_cache_test:outside") == "new");
+
+	incredis().disable_near_cache();
+}
@@ -0,0 +1,95 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include "incredis/parallel_scan.hpp"
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace incredis {
+	namespace test {
+		extern std::string g_hostname;
+		extern uint16_t g_port;
+		extern std::string g_socket;
+		extern uint32_t g_db;
+	} //namespace test
+} //namespace incredis
+
+using incredis::test::RedisConnectionFixture;
+
+namespace {
+	void add_test_source (redis::ParallelScan& parScan) {
+		using namespace incredis::test;
+
+		if (g_socket.empty())
+			parScan.add_source(std::string(g_hostname), g_port, g_db);
+		else
+			parScan.add_source(std::string(g_socket), g_db);
+	}
+} //unnamed namespace
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Parallel scan visits every key", "[scan]") {
+	const std::size_t key_count = 2000;
+	REQUIRE(incredis().flushdb());
+	{
+		auto batch = incredis().make_batch();
+		for (std::size_t z = 0; z < key_count; ++z) {
+			batch.set("parallel_scan:" + std::to_string(z), "x", redis::IncRedisBatch::ADD_None);
+		}
+		batch.throw_if_failed();
+	}
+
+	redis::ParallelScan scan(4, 2);
+	add_test_source(scan);
+	std::mutex mutex;
+	std::set<std::string> seen;
+	redis::ScanOptions options;
+	options.count = 50;
+	const std::size_t visited = scan.run([&](std::size_t parSource, std::string&& parKey) {
+		CHECK(0 == parSource);
+		std::lock_guard<std::mutex> lock(mutex);
+		seen.insert(std::move(parKey));
+	}, "parallel_scan:*", options);
+
+	//SCAN can return a key more than once, duplicates are not an error
+	CHECK(visited >= key_count);
+	REQUIRE(key_count == seen.size());
+	for (std::size_t z = 0; z < key_count; ++z) {
+		CHECK(1 == seen.count("parallel_scan:" + std::to_string(z)));
+	}
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Parallel scan rethrows callback exceptions", "[scan]") {
+	REQUIRE(incredis().flushdb());
+	{
+		auto batch = incredis().make_batch();
+		for (int z = 0; z < 500; ++z) {
+			batch.set("parallel_scan:" + std::to_string(z), "x", redis::IncRedisBatch::ADD_None);
+		}
+		batch.throw_if_failed();
+	}
+
+	redis::ParallelScan scan(4, 2);
+	add_test_source(scan);
+	std::atomic<std::size_t> calls(0);
+	redis::ScanOptions options;
+	options.count = 10;
+	std::string message;
+	try {
+		scan.run([&](std::size_t, std::string&&) {
+			++calls;
+			throw std::runtime_error("callback failure");
+		}, "parallel_scan:*", options);
+	}
+	catch (const std::runtime_error& e) {
+		message = e.what();
+	}
+	CHECK(message == "callback failure");
+	//Workers already inside the callback may each fail once, nobody
+	//keeps going after that
+	CHECK(calls <= 4);
+}
@@ -0,0 +1,125 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include "incredis/subscriber.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+namespace incredis {
+	namespace test {
+		extern std::string g_hostname;
+		extern uint16_t g_port;
+		extern std::string g_socket;
+	} //namespace test
+} //namespace incredis
+
+using incredis::test::RedisConnectionFixture;
+
+namespace {
+	std::unique_ptr<redis::Subscriber> make_subscriber (redis::Subscriber::Handler parHandler, const redis::SubscriberOptions& parOptions) {
+		using namespace incredis::test;
+
+		std::unique_ptr<redis::Subscriber> retval;
+		if (g_socket.empty())
+			retval.reset(new redis::Subscriber(std::string(g_hostname), g_port, std::move(parHandler), parOptions));
+		else
+			retval.reset(new redis::Subscriber(std::string(g_socket), std::move(parHandler), parOptions));
+		retval->connect();
+		retval->wait_for_connect();
+		return retval;
+	}
+
+	bool wait_for_count (const std::atomic<std::size_t>& parCount, std::size_t parExpected) {
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (parCount < parExpected and std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return parCount >= parExpected;
+	}
+} //unnamed namespace
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Receive published messages on worker threads", "[pubsub]") {
+	redis::SubscriberOptions options;
+	options.worker_threads = 4;
+	//Tiny queues, so the event thread has to wait for the workers
+	options.queue_capacity = 4;
+	options.overflow = redis::Overflow_Block;
+
+	std::mutex order_mutex;
+	std::vector<std::string> ordered;
+	std::atomic<std::size_t> received(0);
+	auto subscriber = make_subscriber([&](const redis::PubSubMessage& parMessage) {
+		if (parMessage.channel == "pubsub_test:ordered") {
+			std::lock_guard<std::mutex> lock(order_mutex);
+			ordered.push_back(parMessage.payload);
+		}
+		++received;
+	}, options);
+	REQUIRE(subscriber->is_connected());
+
+	subscriber->subscribe("pubsub_test:ordered");
+	subscriber->psubscribe("pubsub_test:many:*");
+	CHECK(subscriber->subscription_count() == 2);
+
+	const std::size_t message_count = 1000;
+	for (std::size_t z = 0; z < message_count; ++z) {
+		CHECK(incredis().publish("pubsub_test:ordered", std::to_string(z)) == 1);
+		incredis().publish("pubsub_test:many:" + std::to_string(z % 7), "payload");
+	}
+	REQUIRE(wait_for_count(received, message_count * 2));
+
+	{
+		std::lock_guard<std::mutex> lock(order_mutex);
+		REQUIRE(ordered.size() == message_count);
+		for (std::size_t z = 0; z < message_count; ++z) {
+			CHECK(ordered[z] == std::to_string(z));
+		}
+	}
+	CHECK(subscriber->stats("pubsub_test:ordered").received == message_count);
+	CHECK(subscriber->stats("pubsub_test:many:*").received == message_count);
+	CHECK(subscriber->total_stats().dropped == 0);
+
+	subscriber->unsubscribe("pubsub_test:ordered");
+	subscriber->unsubscribe("pubsub_test:never_subscribed");
+	CHECK(subscriber->subscription_count() == 1);
+	CHECK(incredis().publish("pubsub_test:ordered", "nobody listens") == 0);
+	subscriber->disconnect();
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Drop messages when a worker falls behind", "[pubsub]") {
+	redis::SubscriberOptions options;
+	options.queue_capacity = 4;
+	options.overflow = redis::Overflow_Drop;
+
+	std::atomic<bool> release(false);
+	std::atomic<std::size_t> handled(0);
+	auto subscriber = make_subscriber([&](const redis::PubSubMessage&) {
+		while (not release) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		++handled;
+	}, options);
+	subscriber->subscribe("pubsub_test:slow");
+
+	const std::size_t message_count = 100;
+	for (std::size_t z = 0; z < message_count; ++z) {
+		incredis().publish("pubsub_test:slow", "x");
+	}
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (subscriber->stats("pubsub_test:slow").received < message_count and std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	release = true;
+
+	const auto stats = subscriber->stats("pubsub_test:slow");
+	CHECK(stats.received == message_count);
+	CHECK(stats.dropped > 0);
+	subscriber->disconnect();
+	CHECK(handled + stats.dropped == message_count);
+}
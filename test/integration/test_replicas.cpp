@@ -0,0 +1,89 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include <string>
+#include <cstdint>
+#include <chrono>
+
+namespace incredis {
+	namespace test {
+		extern std::string g_hostname;
+		extern uint16_t g_port;
+		extern std::string g_socket;
+		extern uint32_t g_db;
+	} //namespace test
+} //namespace incredis
+
+using incredis::test::RedisConnectionFixture;
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Track reply latency per connection", "[replica]") {
+	auto batch = incredis().command().make_batch();
+	for (int z = 0; z < 20; ++z) {
+		batch.run("PING");
+	}
+	REQUIRE(batch.wait_for_replies(std::chrono::seconds(5)));
+	REQUIRE(batch.replies().size() == 20);
+
+	const auto latency = incredis().command().latency();
+	CHECK(latency.samples >= 20);
+	CHECK(latency.mean.count() > 0);
+	CHECK(latency.p95() >= latency.mean);
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Read through a replica with hedging enabled", "[replica]") {
+	using namespace incredis::test;
+
+	REQUIRE(incredis().set("replica_test:key", "replica_value"));
+
+	//The test server plays its own replica, so health checks are disabled
+	if (g_socket.empty())
+		incredis().add_replica(std::string(g_hostname), g_port, g_db);
+	else
+		incredis().add_replica(std::string(g_socket), g_db);
+	incredis().replicas().connect();
+	incredis().replicas().wait_for_connect();
+	REQUIRE(incredis().replicas().replica(0).is_connected());
+
+	redis::ReplicaPolicy policy;
+	policy.health_check_interval = std::chrono::seconds(0);
+	policy.hedge_reads = true;
+	policy.min_hedge_delay = std::chrono::microseconds(1);
+	incredis().set_replica_policy(policy);
+
+	for (int z = 0; z < 50; ++z) {
+		const auto value = incredis().get("replica_test:key");
+		REQUIRE(value);
+		CHECK(*value == "replica_value");
+	}
+	CHECK(incredis().replicas().replica(0).latency().samples > 0);
+
+	const auto reply = incredis().run("GET", "replica_test:key");
+	CHECK(redis::get_string(reply) == "replica_value");
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Probe reads keep sampling every replica", "[replica]") {
+	using namespace incredis::test;
+
+	REQUIRE(incredis().set("replica_test:probe", "probe_value"));
+
+	//Two connections to the test server, latency decides between them
+	for (int z = 0; z < 2; ++z) {
+		if (g_socket.empty())
+			incredis().add_replica(std::string(g_hostname), g_port, g_db);
+		else
+			incredis().add_replica(std::string(g_socket), g_db);
+	}
+	incredis().replicas().connect();
+	incredis().replicas().wait_for_connect();
+
+	redis::ReplicaPolicy policy;
+	policy.health_check_interval = std::chrono::seconds(0);
+	policy.latency_aware = true;
+	incredis().set_replica_policy(policy);
+
+	for (int z = 0; z < 500; ++z) {
+		REQUIRE(incredis().get("replica_test:probe"));
+	}
+	CHECK(incredis().replicas().replica(0).latency().samples > 0);
+	CHECK(incredis().replicas().replica(1).latency().samples > 0);
+}
@@ -0,0 +1,125 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include <set>
+#include <string>
+#include <chrono>
+
+using incredis::test::RedisConnectionFixture;
+
+namespace {
+	std::set<std::string> insert_numbered_keys (redis::IncRedis& parIncredis, const std::string& parPrefix, std::size_t parCount) {
+		using redis::IncRedisBatch;
+
+		std::set<std::string> keys;
+		auto batch = parIncredis.make_batch();
+		for (std::size_t z = 0; z < parCount; ++z) {
+			std::string key = parPrefix + std::to_string(z);
+			batch.set(key, std::to_string(z), IncRedisBatch::ADD_None);
+			keys.insert(std::move(key));
+		}
+		batch.throw_if_failed();
+		return keys;
+	}
+} //unnamed namespace
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Scan the whole db with prefetching and adaptive COUNT", "[scan]") {
+	REQUIRE_FALSE(not incredis().flushdb());
+	const auto keys = insert_numbered_keys(incredis(), "scan_test:", 2500);
+
+	SECTION("Prefetch only") {
+		redis::ScanOptions options;
+		options.prefetch = true;
+		options.count = 100;
+
+		std::set<std::string> scanned;
+		for (const auto& key : incredis().scan(options))
+			scanned.insert(key);
+		REQUIRE(scanned == keys);
+	}
+
+	SECTION("Prefetch with adaptive COUNT and a pattern") {
+		redis::ScanOptions options;
+		options.prefetch = true;
+		options.target_latency = std::chrono::microseconds(2000);
+		options.min_count = 5;
+		options.max_count = 500;
+
+		std::set<std::string> scanned;
+		for (const auto& key : incredis().scan(options, "scan_test:1*"))
+			scanned.insert(key);
+
+		std::size_t expected = 0;
+		for (const auto& key : keys) {
+			REQUIRE(key.compare(0, 10, "scan_test:") == 0);
+			if (key[10] == '1') {
+				REQUIRE(scanned.count(key) == 1);
+				++expected;
+			}
+		}
+		REQUIRE(scanned.size() == expected);
+	}
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Scan the db one page at a time", "[scan]") {
+	REQUIRE_FALSE(not incredis().flushdb());
+	const auto keys = insert_numbered_keys(incredis(), "page_test:", 1000);
+
+	redis::ScanOptions options;
+	options.count = 50;
+
+	std::set<std::string> scanned;
+	std::size_t page_count = 0;
+	for (auto& page : incredis().scan_pages(options)) {
+		REQUIRE_FALSE(page.empty());
+		for (auto& key : page)
+			scanned.insert(std::move(key));
+		++page_count;
+	}
+	REQUIRE(scanned == keys);
+	REQUIRE(page_count > 1);
+
+	std::size_t nothing_found = 0;
+	for (const auto& page : incredis().scan_pages("no_such_key:*"))
+		nothing_found += page.size();
+	REQUIRE(0 == nothing_found);
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Scan keys and pipeline a read for each of them", "[scan][get][hget]") {
+	using redis::ScanFetchCommand;
+
+	REQUIRE_FALSE(not incredis().flushdb());
+	const auto keys = insert_numbered_keys(incredis(), "fetch_test:", 300);
+	REQUIRE(incredis().hmset("fetch_hash", "field_a", "value a", "field_b", "value b"));
+
+	SECTION("GET") {
+		redis::ScanOptions options;
+		options.prefetch = true;
+		options.count = 40;
+
+		std::size_t fetched = 0;
+		for (const auto& item : incredis().scan_fetch(ScanFetchCommand::get(), options, "fetch_test:*")) {
+			REQUIRE(keys.count(item.first) == 1);
+			REQUIRE(item.second.is_string());
+			REQUIRE("fetch_test:" + redis::get_string(item.second) == item.first);
+			++fetched;
+		}
+		REQUIRE(keys.size() == fetched);
+	}
+
+	SECTION("HMGET and TYPE") {
+		std::size_t fetched = 0;
+		for (const auto& item : incredis().scan_fetch(ScanFetchCommand::hmget({"field_b", "field_a"}), "fetch_hash")) {
+			const auto& values = redis::get_array(item.second);
+			REQUIRE(values.size() == 2);
+			REQUIRE(redis::get_string(values[0]) == "value b");
+			REQUIRE(redis::get_string(values[1]) == "value a");
+			++fetched;
+		}
+		REQUIRE(1 == fetched);
+
+		for (const auto& item : incredis().scan_fetch(ScanFetchCommand::type(), "fetch_test:1*")) {
+			REQUIRE(redis::get<redis::StatusString>(item.second).message() == "string");
+		}
+	}
+}
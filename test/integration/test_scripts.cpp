@@ -0,0 +1,112 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include "incredis/script.hpp"
+#include "incredis/command.hpp"
+#include <string>
+#include <tuple>
+#include <vector>
+
+using incredis::test::RedisConnectionFixture;
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Preload scripts and survive SCRIPT FLUSH", "[script]") {
+	using std::string;
+
+	auto& command = incredis().command();
+	const std::vector<boost::string_view> sources {
+		"return redis.call('SET', KEYS[1], ARGV[1])",
+		"return redis.call('GET', KEYS[1])",
+		"return tonumber(ARGV[1]) + tonumber(ARGV[2])"
+	};
+
+	auto scripts = command.preload_scripts(sources);
+	REQUIRE(scripts.size() == 3);
+	CHECK(scripts[0].sha1().size() == 40);
+
+	{
+		auto batch = command.make_batch();
+		scripts[0].run(batch, std::make_tuple(string("script_test:key")), std::make_tuple(string("before flush")));
+		scripts[1].run(batch, std::make_tuple(string("script_test:key")), std::make_tuple());
+		REQUIRE_NOTHROW(batch.throw_if_failed());
+		CHECK(redis::get_string(*std::next(batch.replies().begin())) == "before flush");
+	}
+
+	//script_flush() makes every script load again before its EVALSHA
+	REQUIRE(incredis().script_flush());
+	{
+		auto batch = command.make_batch();
+		scripts[0].run(batch, std::make_tuple(string("script_test:key")), std::make_tuple(string("after flush")));
+		scripts[2].run(batch, std::make_tuple(), std::make_tuple(string("40"), string("2")));
+		REQUIRE_NOTHROW(batch.throw_if_failed());
+		CHECK(redis::get_integer(*std::next(batch.replies().begin())) == 42);
+	}
+
+	//The flush went through the client, so no NOSCRIPT was needed
+	{
+		auto batch = command.make_batch();
+		scripts[1].run(batch, std::make_tuple(string("script_test:key")), std::make_tuple());
+		REQUIRE_NOTHROW(batch.throw_if_failed());
+		CHECK(redis::get_string(*batch.replies().begin()) == "after flush");
+	}
+	auto batch = command.make_batch();
+	batch.run("SCRIPT", "EXISTS", scripts[0].sha1(), scripts[1].sha1(), scripts[2].sha1());
+	for (const auto& exists : redis::get_array(*batch.replies().begin())) {
+		CHECK(redis::get_integer(exists) == 1);
+	}
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Script hashes are computed locally", "[script]") {
+	const std::string source = "return redis.call('PING')";
+
+	//Never connected, so the hash can't come from the server
+	redis::Command offline(std::string("127.0.0.1"), 1);
+	const auto script = offline.make_script(source);
+	CHECK(script.sha1() == "9e15db9d82a8a2f2029845f70d37494af8690c35");
+
+	auto batch = incredis().command().make_batch();
+	batch.run("SCRIPT", "LOAD", boost::string_view(source));
+	REQUIRE_NOTHROW(batch.throw_if_failed());
+	CHECK(redis::get_string(*batch.replies().begin()) == script.sha1());
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Scripts with a runtime number of keys", "[script]") {
+	using std::string;
+
+	auto& command = incredis().command();
+	auto script = command.make_script(
+		"for i, key in ipairs(KEYS) do redis.call('SET', key, ARGV[1]) end return #KEYS"
+	);
+
+	std::vector<string> keys;
+	for (int z = 0; z < 500; ++z) {
+		keys.push_back("script_range:" + std::to_string(z));
+	}
+	const std::vector<boost::string_view> values {"filled"};
+
+	auto batch = command.make_batch();
+	script.run(batch, keys, values);
+	batch.run("GET", boost::string_view(keys.back()));
+	REQUIRE_NOTHROW(batch.throw_if_failed());
+	CHECK(redis::get_integer(*batch.replies().begin()) == 500);
+	CHECK(redis::get_string(*std::next(batch.replies().begin())) == "filled");
+}
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Script writes are visible to the next command after SCRIPT FLUSH", "[script]") {
+	using std::string;
+
+	auto& command = incredis().command();
+	auto script = command.make_script("return redis.call('SET', KEYS[1], ARGV[1])");
+	{
+		auto batch = command.make_batch();
+		script.run(batch, std::make_tuple(string("script_order:key")), std::make_tuple(string("before flush")));
+		REQUIRE_NOTHROW(batch.throw_if_failed());
+	}
+
+	REQUIRE(incredis().script_flush());
+	//Were the EVALSHA to fail, its EVAL would run after the GET
+	auto batch = command.make_batch();
+	script.run(batch, std::make_tuple(string("script_order:key")), std::make_tuple(string("after flush")));
+	batch.run("GET", "script_order:key");
+	REQUIRE_NOTHROW(batch.throw_if_failed());
+	CHECK(redis::get_string(*std::next(batch.replies().begin())) == "after flush");
+}
@@ -0,0 +1,50 @@
+#include "catch.hpp"
+#include "sha1.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+namespace {
+	std::string hex (const redis::Sha1Digest& parDigest) {
+		const redis::Sha1Hex retval = redis::to_hex(parDigest);
+		return std::string(retval.data(), retval.size());
+	}
+} //unnamed namespace
+
+TEST_CASE("SHA1 matches the reference vectors on every code path", "[sha1]") {
+	using redis::implem::sha1_portable;
+	using redis::implem::sha1_cpu_extensions;
+
+	//Lengths around the padding boundaries: 55 bytes still fit the length
+	//in the last block, 56 to 63 need an extra one
+	std::vector<std::pair<std::string, std::string>> vectors {
+		{"", "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+		{"abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+		{"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+		{std::string(55, 'a'), "c1c8bbdc22796e28c0e15163d20899b65621d65a"},
+		{std::string(56, 'a'), "c2db330f6083854c99d4b5bfb6e8f29f201be699"},
+		{std::string(63, 'a'), "03f09f5b158a7a8cdad920bddc29b81c18a551f5"},
+		{std::string(64, 'a'), "0098ba824b5c16427bd7a1122a5a442a25ec644d"},
+		{std::string(65, 'a'), "11655326c708d70319be2610e8a57d9a5b959d3b"},
+		{std::string(119, 'a'), "ee971065aaa017e0632a8ca6c77bb3bf8b1dfc56"},
+		{std::string(120, 'a'), "f34c1488385346a55709ba056ddd08280dd4c6d6"},
+		{std::string(128, 'a'), "ad5b3fdbcb526778c2839d2f151ea753995e26a0"},
+		{std::string(1000, 'a'), "291e9a6c66994949b57ba5e650361e98fc36b1ba"}
+	};
+
+	bool cpu_path_available = false;
+	for (const auto& vector : vectors) {
+		INFO("input of " << vector.first.size() << " bytes");
+		CHECK(hex(redis::sha1(vector.first)) == vector.second);
+		CHECK(hex(sha1_portable(vector.first)) == vector.second);
+
+		redis::Sha1Digest digest;
+		cpu_path_available = sha1_cpu_extensions(vector.first, digest);
+		if (cpu_path_available)
+			CHECK(hex(digest) == vector.second);
+	}
+	CHECK(cpu_path_available == redis::sha1_uses_cpu_extensions());
+	if (not cpu_path_available)
+		WARN("No SHA extensions on this CPU, only the portable path was tested");
+}
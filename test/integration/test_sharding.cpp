@@ -0,0 +1,109 @@
+#include "catch.hpp"
+#include "incredis/sharded_incredis.hpp"
+#include "incredis/incredis_batch.hpp"
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace incredis {
+	namespace test {
+		extern std::string g_hostname;
+		extern uint16_t g_port;
+		extern std::string g_socket;
+		extern uint32_t g_db;
+	} //namespace test
+} //namespace incredis
+
+namespace {
+	void add_test_node (redis::ShardedIncRedis& parSharded) {
+		using namespace incredis::test;
+		if (g_socket.empty())
+			parSharded.add_node(std::string(g_hostname), g_port);
+		else
+			parSharded.add_node(std::string(g_socket));
+
+		auto& node = parSharded.node(parSharded.node_count() - 1);
+		node.connect();
+		node.wait_for_connect();
+		REQUIRE(node.is_connected());
+		auto batch = node.make_batch();
+		batch.select(static_cast<int>(g_db));
+		REQUIRE_NOTHROW(batch.throw_if_failed());
+	}
+} //unnamed namespace
+
+TEST_CASE("Spread keys over shards with jump consistent hash", "[sharding]") {
+	using redis::shard_for_key;
+
+	const std::size_t key_count = 10000;
+	std::vector<std::size_t> per_shard(4, 0);
+	std::size_t moved = 0;
+	for (std::size_t z = 0; z < key_count; ++z) {
+		const std::string key = "key:" + std::to_string(z);
+		const auto shard = shard_for_key(key, 4);
+		REQUIRE(shard < 4);
+		++per_shard[shard];
+
+		//Going from 4 to 5 shards only moves keys onto the new shard
+		const auto new_shard = shard_for_key(key, 5);
+		if (new_shard != shard) {
+			CHECK(new_shard == 4);
+			++moved;
+		}
+	}
+
+	for (auto count : per_shard) {
+		CHECK(count > key_count / 4 * 8 / 10);
+		CHECK(count < key_count / 4 * 12 / 10);
+	}
+	CHECK(moved > key_count / 5 * 8 / 10);
+	CHECK(moved < key_count / 5 * 12 / 10);
+
+	CHECK(shard_for_key("anything", 1) == 0);
+	CHECK(shard_for_key("{user1000}.following", 16) == shard_for_key("{user1000}.followers", 16));
+}
+
+TEST_CASE("Sharded batch replies follow the call order", "[sharding]") {
+	redis::ShardedIncRedis sharded;
+	add_test_node(sharded);
+	auto batch = sharded.make_batch();
+
+	//Both nodes are the same server, what matters is that each key goes
+	//through the batch of its own node. The second node comes after the
+	//batch was made.
+	add_test_node(sharded);
+	std::vector<std::string> keys;
+	std::size_t per_node[2] = {0, 0};
+	for (int z = 0; per_node[0] < 4 or per_node[1] < 4; ++z) {
+		const std::string key = "sharded_order:" + std::to_string(z);
+		const std::size_t node = sharded.node_index_for_key(key);
+		if (per_node[node] < 4) {
+			++per_node[node];
+			keys.push_back(key);
+		}
+	}
+
+	for (const auto& key : keys) {
+		batch.set(key, "value of " + key);
+	}
+	for (auto it = keys.rbegin(); it != keys.rend(); ++it) {
+		batch.get(*it);
+	}
+	REQUIRE_NOTHROW(batch.throw_if_failed());
+	REQUIRE(batch.replies().size() == keys.size() * 2);
+	for (std::size_t z = 0; z < keys.size(); ++z) {
+		CHECK(redis::get_string(batch.replies()[keys.size() + z]) == "value of " + keys[keys.size() - 1 - z]);
+	}
+
+	//Replies keep their place after the first ones were collected
+	for (const auto& key : keys) {
+		batch.get(key);
+		batch.del(key);
+	}
+	REQUIRE_NOTHROW(batch.throw_if_failed());
+	REQUIRE(batch.replies().size() == keys.size() * 4);
+	for (std::size_t z = 0; z < keys.size(); ++z) {
+		CHECK(redis::get_string(batch.replies()[keys.size() * 2 + z * 2]) == "value of " + keys[z]);
+		CHECK(redis::get_integer(batch.replies()[keys.size() * 2 + z * 2 + 1]) == 1);
+	}
+}
@@ -0,0 +1,99 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include "incredis/stream_consumer.hpp"
+#include <chrono>
+#include <set>
+#include <string>
+#include <cstdint>
+
+namespace incredis {
+	namespace test {
+		extern uint32_t g_db;
+	} //namespace test
+} //namespace incredis
+
+using incredis::test::RedisConnectionFixture;
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Consume a stream through a consumer group", "[streams]") {
+	using incredis::test::g_db;
+
+	REQUIRE_FALSE(not incredis().flushdb());
+
+	redis::StreamConsumerOptions options;
+	options.count = 50;
+	options.block = std::chrono::milliseconds(100);
+	options.ack_batch = 32;
+	options.min_idle = std::chrono::milliseconds(0);
+
+	redis::StreamConsumer first(incredis().command(), g_db, "stream_test", "group", "first", options);
+	first.connect();
+	first.wait_for_connect();
+	REQUIRE(first.is_connected());
+	REQUIRE(first.create_group("0"));
+	REQUIRE_FALSE(first.create_group("0"));
+
+	std::set<std::string> added;
+	for (int z = 0; z < 200; ++z) {
+		added.insert(first.add("index", std::to_string(z), "payload", "value"));
+	}
+
+	std::set<std::string> seen;
+	std::size_t left_unacked = 0;
+	for (auto entries = first.read(); not entries.empty(); entries = first.read()) {
+		CHECK(entries.size() <= options.count);
+		for (const auto& entry : entries) {
+			REQUIRE(entry.fields.size() == 2);
+			CHECK(entry.fields[0].first == "index");
+			seen.insert(entry.id);
+			//Leave some entries pending for the second consumer
+			if (seen.size() % 10 == 0)
+				++left_unacked;
+			else
+				first.ack(entry.id);
+		}
+	}
+	first.flush_acks();
+	CHECK(seen == added);
+	CHECK(first.read_count() == 200);
+	CHECK(first.acked_count() == 200 - left_unacked);
+	CHECK(first.read_pending().size() == left_unacked);
+
+	//Pages smaller than what is pending must be followed to the end
+	redis::StreamConsumerOptions small_pages(options);
+	small_pages.count = 3;
+	{
+		redis::StreamConsumer first_again(incredis().command(), g_db, "stream_test", "group", "first", small_pages);
+		first_again.connect();
+		first_again.wait_for_connect();
+		CHECK(first_again.read_pending().size() == left_unacked);
+	}
+
+	redis::StreamConsumer second(incredis().command(), g_db, "stream_test", "group", "second", small_pages);
+	second.connect();
+	second.wait_for_connect();
+	std::size_t reclaimed = 0;
+	for (auto entries = second.reclaim(); not entries.empty(); entries = second.reclaim()) {
+		for (const auto& entry : entries) {
+			second.ack(entry.id);
+			++reclaimed;
+		}
+		//Still pending entries would be claimed again with min_idle 0
+		second.flush_acks();
+	}
+	CHECK(second.acked_count() == left_unacked);
+	CHECK(reclaimed == left_unacked);
+	CHECK(first.read_pending().empty());
+
+	//The 32nd ack sends a batch, flush_acks() must count it together with
+	//the 8 acks still queued
+	for (int z = 0; z < 40; ++z) {
+		first.add("index", std::to_string(z), "payload", "late");
+	}
+	const auto late_entries = first.read();
+	REQUIRE(late_entries.size() == 40);
+	for (const auto& entry : late_entries) {
+		first.ack(entry.id);
+	}
+	CHECK(first.flush_acks() == 40);
+}
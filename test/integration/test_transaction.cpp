@@ -0,0 +1,75 @@
+#include "redis_connection_fixture.hpp"
+#include "catch.hpp"
+#include "incredis/incredis.hpp"
+#include "incredis/transaction.hpp"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace incredis {
+	namespace test {
+		extern uint32_t g_db;
+	} //namespace test
+} //namespace incredis
+
+using incredis::test::RedisConnectionFixture;
+
+TEST_CASE_METHOD(RedisConnectionFixture, "Optimistic transaction with WATCH and retry", "[transaction]") {
+	using redis::Reply;
+	using redis::StoredCommand;
+
+	REQUIRE_FALSE(not incredis().flushdb());
+	incredis().enable_blocking_pool(incredis::test::g_db, 2);
+	REQUIRE(incredis().set("transaction_test:balance", "100"));
+
+	SECTION("Conflicting write forces a second attempt") {
+		auto transaction = incredis().make_transaction();
+		transaction.watch("transaction_test:balance").read("GET", "transaction_test:balance");
+
+		bool interfered = false;
+		const bool done = transaction.run([&](const std::vector<Reply>& parReads, std::vector<StoredCommand>& parQueue) {
+			const int balance = std::stoi(redis::get_string(parReads.front()));
+			if (not interfered) {
+				//A write from another connection between WATCH and EXEC
+				REQUIRE(incredis().set("transaction_test:balance", "150"));
+				interfered = true;
+			}
+			parQueue.emplace_back("SET", "transaction_test:balance", std::to_string(balance - 30));
+			parQueue.emplace_back("INCR", "transaction_test:withdrawals");
+			return true;
+		});
+		REQUIRE(done);
+		CHECK(transaction.attempts() == 2);
+		REQUIRE(transaction.replies().size() == 2);
+		CHECK(redis::get_integer(transaction.replies()[1]) == 1);
+		CHECK(incredis().get("transaction_test:balance") == std::string("120"));
+	}
+
+	SECTION("Builder gives up") {
+		auto transaction = incredis().make_transaction();
+		transaction.watch("transaction_test:balance").read("GET", "transaction_test:balance");
+		const bool done = transaction.run([](const std::vector<Reply>& parReads, std::vector<StoredCommand>& parQueue) {
+			parQueue.emplace_back("SET", "transaction_test:balance", "0");
+			return std::stoi(redis::get_string(parReads.front())) > 1000;
+		});
+		CHECK_FALSE(done);
+		CHECK(incredis().get("transaction_test:balance") == std::string("100"));
+	}
+
+	SECTION("Errors inside EXEC and rejected commands") {
+		auto transaction = incredis().make_transaction();
+		REQUIRE(transaction.run([](const std::vector<Reply>&, std::vector<StoredCommand>& parQueue) {
+			parQueue.emplace_back("SET", "transaction_test:string", "text");
+			parQueue.emplace_back("INCR", "transaction_test:string");
+			return true;
+		}));
+		REQUIRE(transaction.replies().size() == 2);
+		CHECK(transaction.replies()[0].is_status());
+		CHECK(transaction.replies()[1].is_error());
+
+		CHECK_THROWS(transaction.run([](const std::vector<Reply>&, std::vector<StoredCommand>& parQueue) {
+			parQueue.emplace_back("SET", "transaction_test:only_key");
+			return true;
+		}));
+	}
+}
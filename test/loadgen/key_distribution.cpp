@@ -0,0 +1,149 @@
+#include "key_distribution.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <ciso646>
+
+namespace incredis {
+	namespace loadgen {
+		namespace {
+			class UniformDistribution : public KeyDistribution {
+			public:
+				explicit UniformDistribution ( uint64_t parKeyCount ) :
+					m_dist(0, parKeyCount - 1)
+				{
+				}
+
+				uint64_t next ( std::mt19937_64& parRng ) override {
+					return m_dist(parRng);
+				}
+
+				std::unique_ptr<KeyDistribution> clone ( void ) const override {
+					return std::unique_ptr<KeyDistribution>(new UniformDistribution(*this));
+				}
+
+			private:
+				std::uniform_int_distribution<uint64_t> m_dist;
+			};
+
+			//Gray et al., "Quickly generating billion-record synthetic
+			//databases", same as YCSB's ZipfianGenerator. Key 0 is the most
+			//popular one. Setup is linear in the number of keys.
+			class ZipfianDistribution : public KeyDistribution {
+			public:
+				ZipfianDistribution ( uint64_t parKeyCount, double parTheta ) :
+					m_unit(0.0, 1.0),
+					m_key_count(parKeyCount),
+					m_alpha(1.0 / (1.0 - parTheta)),
+					m_zetan(zeta(parKeyCount, parTheta)),
+					m_eta(0.0),
+					m_half_pow_theta(std::pow(0.5, parTheta))
+				{
+					const double zeta2 = zeta(2, parTheta);
+					m_eta = (1.0 - std::pow(2.0 / static_cast<double>(parKeyCount), 1.0 - parTheta)) / (1.0 - zeta2 / m_zetan);
+				}
+
+				uint64_t next ( std::mt19937_64& parRng ) override {
+					const double u = m_unit(parRng);
+					const double uz = u * m_zetan;
+					if (uz < 1.0)
+						return 0;
+					if (uz < 1.0 + m_half_pow_theta)
+						return std::min<uint64_t>(1, m_key_count - 1);
+					const auto retval = static_cast<uint64_t>(static_cast<double>(m_key_count) * std::pow(m_eta * u - m_eta + 1.0, m_alpha));
+					return std::min(retval, m_key_count - 1);
+				}
+
+				std::unique_ptr<KeyDistribution> clone ( void ) const override {
+					return std::unique_ptr<KeyDistribution>(new ZipfianDistribution(*this));
+				}
+
+			private:
+				static double zeta (uint64_t parCount, double parTheta) {
+					double retval = 0.0;
+					for (uint64_t z = 1; z <= parCount; ++z) {
+						retval += 1.0 / std::pow(static_cast<double>(z), parTheta);
+					}
+					return retval;
+				}
+
+				std::uniform_real_distribution<double> m_unit;
+				uint64_t m_key_count;
+				double m_alpha;
+				double m_zetan;
+				double m_eta;
+				double m_half_pow_theta;
+			};
+
+			class HotspotDistribution : public KeyDistribution {
+			public:
+				HotspotDistribution ( uint64_t parKeyCount, double parHotFraction, double parHotProbability ) :
+					m_pick_hot(parHotProbability),
+					m_hot(0, hot_count(parKeyCount, parHotFraction) - 1),
+					m_cold(std::min(hot_count(parKeyCount, parHotFraction), parKeyCount - 1), parKeyCount - 1)
+				{
+				}
+
+				uint64_t next ( std::mt19937_64& parRng ) override {
+					return (m_pick_hot(parRng) ? m_hot(parRng) : m_cold(parRng));
+				}
+
+				std::unique_ptr<KeyDistribution> clone ( void ) const override {
+					return std::unique_ptr<KeyDistribution>(new HotspotDistribution(*this));
+				}
+
+			private:
+				static uint64_t hot_count (uint64_t parKeyCount, double parHotFraction) {
+					const auto retval = static_cast<uint64_t>(static_cast<double>(parKeyCount) * parHotFraction);
+					return std::max<uint64_t>(1, std::min(retval, parKeyCount));
+				}
+
+				std::bernoulli_distribution m_pick_hot;
+				std::uniform_int_distribution<uint64_t> m_hot;
+				std::uniform_int_distribution<uint64_t> m_cold;
+			};
+		} //unnamed namespace
+
+		KeyDistributionType key_distribution_from_name (const std::string& parName) {
+			if (parName == "uniform")
+				return KeyDistribution_Uniform;
+			else if (parName == "zipfian")
+				return KeyDistribution_Zipfian;
+			else if (parName == "hotspot")
+				return KeyDistribution_Hotspot;
+			else
+				throw std::invalid_argument("Unknown key distribution \"" + parName + "\"");
+		}
+
+		const char* key_distribution_name (KeyDistributionType parType) {
+			switch (parType) {
+			case KeyDistribution_Uniform: return "uniform";
+			case KeyDistribution_Zipfian: return "zipfian";
+			case KeyDistribution_Hotspot: return "hotspot";
+			}
+			assert(false);
+			return "";
+		}
+
+		std::unique_ptr<KeyDistribution> make_key_distribution (const KeyDistributionOptions& parOptions) {
+			if (not parOptions.key_count)
+				throw std::invalid_argument("Key count must be greater than zero");
+
+			switch (parOptions.type) {
+			case KeyDistribution_Uniform:
+				return std::unique_ptr<KeyDistribution>(new UniformDistribution(parOptions.key_count));
+			case KeyDistribution_Zipfian:
+				if (parOptions.zipf_theta <= 0.0 or parOptions.zipf_theta >= 1.0)
+					throw std::invalid_argument("Zipfian theta must be between 0 and 1");
+				return std::unique_ptr<KeyDistribution>(new ZipfianDistribution(parOptions.key_count, parOptions.zipf_theta));
+			case KeyDistribution_Hotspot:
+				if (parOptions.hot_fraction <= 0.0 or parOptions.hot_fraction > 1.0)
+					throw std::invalid_argument("Hot fraction must be in (0, 1]");
+				return std::unique_ptr<KeyDistribution>(new HotspotDistribution(parOptions.key_count, parOptions.hot_fraction, parOptions.hot_probability));
+			}
+			assert(false);
+			return std::unique_ptr<KeyDistribution>();
+		}
+	} //namespace loadgen
+} //namespace incredis
@@ -0,0 +1,54 @@
+#ifndef id8B2E61D4F0C94A7E93D5A1C6E7F20B48
+#define id8B2E61D4F0C94A7E93D5A1C6E7F20B48
+
+#include <memory>
+#include <random>
+#include <string>
+#include <cstdint>
+
+namespace incredis {
+	namespace loadgen {
+		enum KeyDistributionType {
+			KeyDistribution_Uniform,
+			KeyDistribution_Zipfian,
+			KeyDistribution_Hotspot
+		};
+
+		//Picks key numbers in [0, key_count). Instances are not shared,
+		//each worker thread owns a clone() of the one made at startup, so
+		//setup costs such as the zipfian constants are only paid once.
+		class KeyDistribution {
+		public:
+			virtual ~KeyDistribution ( void ) noexcept = default;
+			virtual uint64_t next ( std::mt19937_64& parRng ) = 0;
+			virtual std::unique_ptr<KeyDistribution> clone ( void ) const = 0;
+		};
+
+		struct KeyDistributionOptions {
+			KeyDistributionOptions ( void ) :
+				type(KeyDistribution_Uniform),
+				key_count(100000),
+				zipf_theta(0.99),
+				hot_fraction(0.2),
+				hot_probability(0.8)
+			{
+			}
+
+			KeyDistributionType type;
+			uint64_t key_count;
+			//Skew of the zipfian distribution, 0.99 is what YCSB uses
+			double zipf_theta;
+			//Hotspot: hot_probability of the requests go to the first
+			//hot_fraction of the keys
+			double hot_fraction;
+			double hot_probability;
+		};
+
+		//Throws std::invalid_argument for unknown names
+		KeyDistributionType key_distribution_from_name ( const std::string& parName );
+		const char* key_distribution_name ( KeyDistributionType parType );
+		std::unique_ptr<KeyDistribution> make_key_distribution ( const KeyDistributionOptions& parOptions );
+	} //namespace loadgen
+} //namespace incredis
+
+#endif
@@ -0,0 +1,165 @@
+#include "workload.hpp"
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <ciso646>
+
+namespace po = boost::program_options;
+
+namespace {
+	using incredis::loadgen::OperationStats;
+	using incredis::loadgen::WorkloadOptions;
+	using incredis::loadgen::WorkloadResult;
+
+	std::string json_string (const std::string& parText) {
+		std::ostringstream oss;
+		oss << '"';
+		for (char c : parText) {
+			switch (c) {
+			case '"': oss << "\\\""; break;
+			case '\\': oss << "\\\\"; break;
+			case '\n': oss << "\\n"; break;
+			case '\t': oss << "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+					oss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+				else
+					oss << c;
+			}
+		}
+		oss << '"';
+		return oss.str();
+	}
+
+	double to_us (std::chrono::nanoseconds parTime) {
+		return static_cast<double>(parTime.count()) / 1000.0;
+	}
+
+	void write_stats (std::ostream& parStream, const OperationStats& parStats, double parSeconds, const char* parIndent) {
+		const redis::LatencyHistogram& latency = parStats.latency;
+		parStream << "{\n" <<
+			parIndent << "\t\"operations\": " << latency.count << ",\n" <<
+			parIndent << "\t\"errors\": " << parStats.errors << ",\n" <<
+			parIndent << "\t\"throughput\": " << (parSeconds > 0.0 ? static_cast<double>(latency.count) / parSeconds : 0.0) << ",\n" <<
+			parIndent << "\t\"latency_us\": {\n" <<
+			parIndent << "\t\t\"min\": " << to_us(latency.min) << ",\n" <<
+			parIndent << "\t\t\"mean\": " << to_us(latency.mean()) << ",\n" <<
+			parIndent << "\t\t\"p50\": " << to_us(latency.percentile(50.0)) << ",\n" <<
+			parIndent << "\t\t\"p90\": " << to_us(latency.percentile(90.0)) << ",\n" <<
+			parIndent << "\t\t\"p99\": " << to_us(latency.percentile(99.0)) << ",\n" <<
+			parIndent << "\t\t\"p999\": " << to_us(latency.percentile(99.9)) << ",\n" <<
+			parIndent << "\t\t\"max\": " << to_us(latency.max) << "\n" <<
+			parIndent << "\t}\n" <<
+			parIndent << "}";
+	}
+
+	void write_report (std::ostream& parStream, const WorkloadOptions& parOptions, const WorkloadResult& parResult) {
+		using incredis::loadgen::client_mode_name;
+		using incredis::loadgen::key_distribution_name;
+
+		OperationStats total;
+		total.merge(parResult.reads);
+		total.merge(parResult.writes);
+		const double seconds = static_cast<double>(parResult.elapsed.count()) / 1e9;
+
+		parStream << "{\n" <<
+			"\t\"config\": {\n" <<
+			"\t\t\"server\": " << json_string(parOptions.socket.empty() ? parOptions.hostname + ':' + std::to_string(parOptions.port) : parOptions.socket) << ",\n" <<
+			"\t\t\"db\": " << parOptions.db << ",\n" <<
+			"\t\t\"mode\": \"" << client_mode_name(parOptions.mode) << "\",\n" <<
+			"\t\t\"threads\": " << parOptions.thread_count << ",\n" <<
+			"\t\t\"connections\": " << parOptions.connection_count << ",\n" <<
+			"\t\t\"pipeline\": " << parOptions.pipeline_depth << ",\n" <<
+			"\t\t\"distribution\": \"" << key_distribution_name(parOptions.keys.type) << "\",\n" <<
+			"\t\t\"keys\": " << parOptions.keys.key_count << ",\n" <<
+			"\t\t\"zipf_theta\": " << parOptions.keys.zipf_theta << ",\n" <<
+			"\t\t\"hot_fraction\": " << parOptions.keys.hot_fraction << ",\n" <<
+			"\t\t\"hot_probability\": " << parOptions.keys.hot_probability << ",\n" <<
+			"\t\t\"value_size\": " << parOptions.value_size << ",\n" <<
+			"\t\t\"read_ratio\": " << parOptions.read_ratio << ",\n" <<
+			"\t\t\"seed\": " << parOptions.seed << ",\n" <<
+			"\t\t\"warmup_s\": " << static_cast<double>(parOptions.warmup.count()) / 1000.0 << ",\n" <<
+			"\t\t\"duration_s\": " << static_cast<double>(parOptions.duration.count()) / 1000.0 << "\n" <<
+			"\t},\n" <<
+			"\t\"elapsed_s\": " << seconds << ",\n" <<
+			"\t\"preloaded_keys\": " << parResult.preloaded_keys << ",\n" <<
+			"\t\"total\": ";
+		write_stats(parStream, total, seconds, "\t");
+		parStream << ",\n\t\"read\": ";
+		write_stats(parStream, parResult.reads, seconds, "\t");
+		parStream << ",\n\t\"write\": ";
+		write_stats(parStream, parResult.writes, seconds, "\t");
+		parStream << "\n}\n";
+	}
+} //unnamed namespace
+
+int main (int parArgc, char* const parArgv[]) {
+	using namespace incredis::loadgen;
+
+	WorkloadOptions options;
+	po::options_description connection_options("Redis connection options");
+	connection_options.add_options()
+		("hostname,h", po::value<std::string>(&options.hostname), "Server hostname")
+		("port,p", po::value<uint16_t>(&options.port), "Server port")
+		("socket,s", po::value<std::string>(&options.socket), "Server socket (overrides hostname and port)")
+		("db,n", po::value<uint32_t>(&options.db), "Database number")
+	;
+	po::options_description workload_options("Workload options");
+	workload_options.add_options()
+		("mode,m", po::value<std::string>()->default_value("sync"), "Client mode: sync, batch, pooled or auto")
+		("threads,t", po::value<std::size_t>(&options.thread_count)->default_value(options.thread_count), "Worker threads")
+		("connections,c", po::value<std::size_t>(&options.connection_count)->default_value(options.connection_count), "Connections, shared round robin by the threads or pool size in pooled mode")
+		("pipeline,P", po::value<std::size_t>(&options.pipeline_depth)->default_value(options.pipeline_depth), "Operations per batch in batch and pooled modes")
+		("distribution,d", po::value<std::string>()->default_value("uniform"), "Key distribution: uniform, zipfian or hotspot")
+		("keys,k", po::value<uint64_t>(&options.keys.key_count)->default_value(options.keys.key_count), "Number of distinct keys")
+		("zipf-theta", po::value<double>(&options.keys.zipf_theta)->default_value(options.keys.zipf_theta), "Skew of the zipfian distribution")
+		("hot-fraction", po::value<double>(&options.keys.hot_fraction)->default_value(options.keys.hot_fraction), "Fraction of the keys that are hot in the hotspot distribution")
+		("hot-probability", po::value<double>(&options.keys.hot_probability)->default_value(options.keys.hot_probability), "Fraction of the operations going to hot keys")
+		("value-size,v", po::value<std::size_t>(&options.value_size)->default_value(options.value_size), "Bytes in each value written")
+		("read-ratio,r", po::value<double>(&options.read_ratio)->default_value(options.read_ratio), "Fraction of GETs, the rest are SETs")
+		("key-prefix", po::value<std::string>(&options.key_prefix)->default_value(options.key_prefix), "Prefix of every key")
+		("seed", po::value<uint64_t>(&options.seed)->default_value(options.seed), "Random seed, worker n uses seed + n")
+		("warmup", po::value<unsigned int>()->default_value(1000), "Milliseconds to run before measuring")
+		("duration,D", po::value<unsigned int>()->default_value(10000), "Milliseconds to measure for")
+		("skip-preload", "Don't write every key before starting")
+		("output,o", po::value<std::string>(), "Write the JSON report to this file instead of stdout")
+		("help", "Show this help")
+	;
+	po::options_description all("Available options");
+	all.add(connection_options).add(workload_options);
+
+	try {
+		po::variables_map vm;
+		po::store(po::parse_command_line(parArgc, parArgv, all), vm);
+		po::notify(vm);
+		if (vm.count("help")) {
+			std::cout << all << std::endl;
+			return 0;
+		}
+
+		options.mode = client_mode_from_name(vm["mode"].as<std::string>());
+		options.keys.type = key_distribution_from_name(vm["distribution"].as<std::string>());
+		options.warmup = std::chrono::milliseconds(vm["warmup"].as<unsigned int>());
+		options.duration = std::chrono::milliseconds(vm["duration"].as<unsigned int>());
+		options.preload = not vm.count("skip-preload");
+
+		const WorkloadResult result = run_workload(options);
+		if (vm.count("output")) {
+			std::ofstream out(vm["output"].as<std::string>());
+			write_report(out, options, result);
+			if (not out)
+				throw std::runtime_error("Unable to write " + vm["output"].as<std::string>());
+		}
+		else {
+			write_report(std::cout, options, result);
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
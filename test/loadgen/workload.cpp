@@ -0,0 +1,349 @@
+#include "workload.hpp"
+#include "incredis/command.hpp"
+#include "incredis/connection_pool.hpp"
+#include <atomic>
+#include <algorithm>
+#include <cassert>
+#include <future>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <ciso646>
+
+namespace incredis {
+	namespace loadgen {
+		namespace {
+			const std::size_t g_preload_batch_size = 1000;
+
+			struct Operation {
+				std::string key;
+				bool read;
+			};
+
+			struct WorkerStats {
+				OperationStats reads;
+				OperationStats writes;
+			};
+
+			std::unique_ptr<redis::Command> open_connection (const WorkloadOptions& parOptions) {
+				std::unique_ptr<redis::Command> retval(parOptions.socket.empty() ?
+					new redis::Command(std::string(parOptions.hostname), parOptions.port) :
+					new redis::Command(std::string(parOptions.socket))
+				);
+				retval->connect();
+				retval->wait_for_connect();
+				if (not retval->is_connected())
+					throw std::runtime_error("Unable to connect to the server: " + std::string(retval->connection_error()));
+				if (parOptions.db)
+					retval->run("SELECT", std::to_string(parOptions.db));
+				return retval;
+			}
+
+			void make_key (std::string& parKey, std::size_t parPrefixLength, uint64_t parNumber) {
+				parKey.resize(parPrefixLength);
+				parKey += std::to_string(parNumber);
+			}
+
+			void validate (const WorkloadOptions& parOptions) {
+				if (not parOptions.thread_count)
+					throw std::invalid_argument("Thread count must be greater than zero");
+				if (not parOptions.connection_count)
+					throw std::invalid_argument("Connection count must be greater than zero");
+				if (not parOptions.pipeline_depth)
+					throw std::invalid_argument("Pipeline depth must be greater than zero");
+				if (parOptions.read_ratio < 0.0 or parOptions.read_ratio > 1.0)
+					throw std::invalid_argument("Read ratio must be between 0 and 1");
+				if (parOptions.pipeline_depth > 1 and (ClientMode_Sync == parOptions.mode or ClientMode_AutoBatch == parOptions.mode))
+					throw std::invalid_argument(std::string("Pipeline depth is not used in ") + client_mode_name(parOptions.mode) + " mode");
+			}
+
+			void preload (redis::Command& parCommand, const WorkloadOptions& parOptions) {
+				const std::string value(parOptions.value_size, 'x');
+				std::string key(parOptions.key_prefix);
+				uint64_t done = 0;
+				while (done < parOptions.keys.key_count) {
+					auto batch = parCommand.make_batch();
+					const uint64_t end = std::min<uint64_t>(done + g_preload_batch_size, parOptions.keys.key_count);
+					for (; done < end; ++done) {
+						make_key(key, parOptions.key_prefix.size(), done);
+						batch.run("SET", key, value);
+					}
+					batch.throw_if_failed();
+				}
+			}
+
+			//Runs parOps and returns false for each one that failed
+			class Executor {
+			public:
+				virtual ~Executor ( void ) noexcept = default;
+				virtual void run ( const std::vector<Operation>& parOps, const std::string& parValue, std::vector<bool>& parSucceeded ) = 0;
+			};
+
+			class SyncExecutor : public Executor {
+			public:
+				explicit SyncExecutor ( redis::Command& parCommand ) :
+					m_command(parCommand)
+				{
+				}
+
+				void run ( const std::vector<Operation>& parOps, const std::string& parValue, std::vector<bool>& parSucceeded ) override {
+					assert(1 == parOps.size());
+					try {
+						if (parOps.front().read)
+							m_command.run("GET", parOps.front().key);
+						else
+							m_command.run("SET", parOps.front().key, parValue);
+						parSucceeded.front() = true;
+					}
+					catch (const std::exception&) {
+						parSucceeded.front() = false;
+					}
+				}
+
+			private:
+				redis::Command& m_command;
+			};
+
+			void run_batch (redis::Command& parCommand, const std::vector<Operation>& parOps, const std::string& parValue, std::vector<bool>& parSucceeded) {
+				auto batch = parCommand.make_batch();
+				for (const auto& op : parOps) {
+					if (op.read)
+						batch.run("GET", op.key);
+					else
+						batch.run("SET", op.key, parValue);
+				}
+				std::size_t index = 0;
+				for (const auto& reply : batch.replies()) {
+					assert(index < parSucceeded.size());
+					parSucceeded[index++] = not reply.is_error();
+				}
+				assert(parOps.size() == index);
+			}
+
+			class BatchExecutor : public Executor {
+			public:
+				explicit BatchExecutor ( redis::Command& parCommand ) :
+					m_command(parCommand)
+				{
+				}
+
+				void run ( const std::vector<Operation>& parOps, const std::string& parValue, std::vector<bool>& parSucceeded ) override {
+					try {
+						run_batch(m_command, parOps, parValue, parSucceeded);
+					}
+					catch (const std::exception&) {
+						std::fill(parSucceeded.begin(), parSucceeded.end(), false);
+					}
+				}
+
+			private:
+				redis::Command& m_command;
+			};
+
+			class PooledExecutor : public Executor {
+			public:
+				explicit PooledExecutor ( redis::ConnectionPool& parPool ) :
+					m_pool(parPool)
+				{
+				}
+
+				void run ( const std::vector<Operation>& parOps, const std::string& parValue, std::vector<bool>& parSucceeded ) override {
+					try {
+						auto lease = m_pool.acquire();
+						try {
+							run_batch(lease.command(), parOps, parValue, parSucceeded);
+						}
+						catch (...) {
+							lease.discard();
+							throw;
+						}
+					}
+					catch (const std::exception&) {
+						std::fill(parSucceeded.begin(), parSucceeded.end(), false);
+					}
+				}
+
+			private:
+				redis::ConnectionPool& m_pool;
+			};
+
+			void run_worker (
+				Executor& parExecutor,
+				const WorkloadOptions& parOptions,
+				const KeyDistribution& parKeys,
+				std::size_t parIndex,
+				std::shared_future<std::chrono::steady_clock::time_point> parMeasureStart,
+				const std::atomic<bool>& parStop,
+				WorkerStats& parStats
+			) {
+				std::mt19937_64 rng(parOptions.seed + parIndex);
+				std::bernoulli_distribution pick_read(parOptions.read_ratio);
+				const std::unique_ptr<KeyDistribution> keys = parKeys.clone();
+				const std::string value(parOptions.value_size, 'x');
+				std::vector<Operation> ops(parOptions.pipeline_depth, Operation{parOptions.key_prefix, true});
+				std::vector<bool> succeeded(ops.size(), false);
+
+				const auto measure_start = parMeasureStart.get();
+				while (not parStop.load(std::memory_order_relaxed)) {
+					for (auto& op : ops) {
+						make_key(op.key, parOptions.key_prefix.size(), keys->next(rng));
+						op.read = pick_read(rng);
+					}
+
+					const auto start = std::chrono::steady_clock::now();
+					parExecutor.run(ops, value, succeeded);
+					const auto elapsed = std::chrono::steady_clock::now() - start;
+					if (start < measure_start)
+						continue;
+
+					for (std::size_t z = 0; z < ops.size(); ++z) {
+						OperationStats& stats = (ops[z].read ? parStats.reads : parStats.writes);
+						stats.record(elapsed);
+						if (not succeeded[z])
+							++stats.errors;
+					}
+				}
+			}
+		} //unnamed namespace
+
+		OperationStats::OperationStats() :
+			latency(),
+			errors(0)
+		{
+		}
+
+		void OperationStats::record (std::chrono::steady_clock::duration parElapsed) {
+			using redis::LatencyHistogram;
+
+			const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(parElapsed);
+			++latency.counts[LatencyHistogram::bucket_index(static_cast<uint64_t>(elapsed.count()))];
+			latency.min = (latency.count ? std::min(latency.min, elapsed) : elapsed);
+			latency.max = std::max(latency.max, elapsed);
+			latency.sum += elapsed;
+			++latency.count;
+		}
+
+		void OperationStats::merge (const OperationStats& parOther) {
+			if (not parOther.latency.count)
+				return;
+
+			for (std::size_t z = 0; z < latency.counts.size(); ++z) {
+				latency.counts[z] += parOther.latency.counts[z];
+			}
+			latency.min = (latency.count ? std::min(latency.min, parOther.latency.min) : parOther.latency.min);
+			latency.max = std::max(latency.max, parOther.latency.max);
+			latency.sum += parOther.latency.sum;
+			latency.count += parOther.latency.count;
+			errors += parOther.errors;
+		}
+
+		ClientMode client_mode_from_name (const std::string& parName) {
+			if (parName == "sync")
+				return ClientMode_Sync;
+			else if (parName == "batch")
+				return ClientMode_Batch;
+			else if (parName == "pooled")
+				return ClientMode_Pooled;
+			else if (parName == "auto")
+				return ClientMode_AutoBatch;
+			else
+				throw std::invalid_argument("Unknown client mode \"" + parName + "\"");
+		}
+
+		const char* client_mode_name (ClientMode parMode) {
+			switch (parMode) {
+			case ClientMode_Sync: return "sync";
+			case ClientMode_Batch: return "batch";
+			case ClientMode_Pooled: return "pooled";
+			case ClientMode_AutoBatch: return "auto";
+			}
+			assert(false);
+			return "";
+		}
+
+		WorkloadResult run_workload (const WorkloadOptions& parOptions) {
+			validate(parOptions);
+			//Also checks the key parameters, workers get a copy
+			const std::unique_ptr<KeyDistribution> keys = make_key_distribution(parOptions.keys);
+
+			WorkloadResult retval;
+			retval.preloaded_keys = 0;
+			if (parOptions.preload) {
+				const auto command = open_connection(parOptions);
+				preload(*command, parOptions);
+				retval.preloaded_keys = parOptions.keys.key_count;
+			}
+
+			//Threads share connections round robin, except in pooled mode
+			//where they compete for leases
+			std::vector<std::unique_ptr<redis::Command>> connections;
+			std::unique_ptr<redis::ConnectionPool> pool;
+			std::vector<std::unique_ptr<Executor>> executors;
+			if (ClientMode_Pooled == parOptions.mode) {
+				pool.reset(parOptions.socket.empty() ?
+					new redis::ConnectionPool(std::string(parOptions.hostname), parOptions.port, parOptions.db, parOptions.connection_count) :
+					new redis::ConnectionPool(std::string(parOptions.socket), parOptions.db, parOptions.connection_count)
+				);
+				pool->set_acquire_timeout(std::chrono::seconds(10));
+			}
+			else {
+				for (std::size_t z = 0; z < parOptions.connection_count; ++z) {
+					connections.push_back(open_connection(parOptions));
+					if (ClientMode_AutoBatch == parOptions.mode)
+						connections.back()->set_auto_batching(redis::AutoBatchOptions());
+				}
+			}
+			for (std::size_t z = 0; z < parOptions.thread_count; ++z) {
+				switch (parOptions.mode) {
+				case ClientMode_Sync:
+				case ClientMode_AutoBatch:
+					executors.emplace_back(new SyncExecutor(*connections[z % connections.size()]));
+					break;
+				case ClientMode_Batch:
+					executors.emplace_back(new BatchExecutor(*connections[z % connections.size()]));
+					break;
+				case ClientMode_Pooled:
+					executors.emplace_back(new PooledExecutor(*pool));
+					break;
+				}
+			}
+
+			std::promise<std::chrono::steady_clock::time_point> measure_start;
+			std::shared_future<std::chrono::steady_clock::time_point> measure_start_future(measure_start.get_future());
+			std::atomic<bool> stop(false);
+			std::vector<WorkerStats> stats(parOptions.thread_count);
+			std::vector<std::thread> threads;
+			threads.reserve(parOptions.thread_count);
+			for (std::size_t z = 0; z < parOptions.thread_count; ++z) {
+				threads.emplace_back(
+					&run_worker,
+					std::ref(*executors[z]),
+					std::cref(parOptions),
+					std::cref(*keys),
+					z,
+					measure_start_future,
+					std::cref(stop),
+					std::ref(stats[z])
+				);
+			}
+
+			const auto start = std::chrono::steady_clock::now() + parOptions.warmup;
+			measure_start.set_value(start);
+			std::this_thread::sleep_until(start + parOptions.duration);
+			stop = true;
+			const auto end = std::chrono::steady_clock::now();
+			for (auto& thread : threads) {
+				thread.join();
+			}
+
+			retval.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+			for (const auto& worker : stats) {
+				retval.reads.merge(worker.reads);
+				retval.writes.merge(worker.writes);
+			}
+			return retval;
+		}
+	} //namespace loadgen
+} //namespace incredis
@@ -0,0 +1,97 @@
+#ifndef idE41F7A09C3D2486BA25E8F1D6B07C395
+#define idE41F7A09C3D2486BA25E8F1D6B07C395
+
+#include "key_distribution.hpp"
+#include "incredis/metrics.hpp"
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace incredis {
+	namespace loadgen {
+		enum ClientMode {
+			//Command::run() for every operation
+			ClientMode_Sync,
+			//Batches of pipeline_depth operations
+			ClientMode_Batch,
+			//Batches of pipeline_depth operations, each one on a connection
+			//leased from a ConnectionPool of connection_count connections
+			ClientMode_Pooled,
+			//Command::run() with auto batching turned on, so concurrent
+			//callers share round trips
+			ClientMode_AutoBatch
+		};
+
+		struct WorkloadOptions {
+			WorkloadOptions ( void ) :
+				hostname("127.0.0.1"),
+				socket(),
+				key_prefix("loadgen:"),
+				keys(),
+				port(6379),
+				db(0),
+				mode(ClientMode_Sync),
+				thread_count(4),
+				connection_count(1),
+				pipeline_depth(1),
+				value_size(100),
+				read_ratio(0.9),
+				seed(1),
+				warmup(std::chrono::seconds(1)),
+				duration(std::chrono::seconds(10)),
+				preload(true)
+			{
+			}
+
+			std::string hostname;
+			//Takes precedence over hostname and port when not empty
+			std::string socket;
+			std::string key_prefix;
+			KeyDistributionOptions keys;
+			uint16_t port;
+			uint32_t db;
+			ClientMode mode;
+			std::size_t thread_count;
+			std::size_t connection_count;
+			std::size_t pipeline_depth;
+			std::size_t value_size;
+			//Fraction of the operations that are GETs, the rest are SETs
+			double read_ratio;
+			uint64_t seed;
+			//Operations started during the warmup are not counted
+			std::chrono::milliseconds warmup;
+			std::chrono::milliseconds duration;
+			//Write every key once before starting, so GETs don't hit
+			//missing keys
+			bool preload;
+		};
+
+		struct OperationStats {
+			OperationStats ( void );
+
+			void record ( std::chrono::steady_clock::duration parElapsed );
+			void merge ( const OperationStats& parOther );
+
+			//For batched modes this is the round trip of the whole batch
+			//the operation was part of
+			redis::LatencyHistogram latency;
+			uint64_t errors;
+		};
+
+		struct WorkloadResult {
+			OperationStats reads;
+			OperationStats writes;
+			//Measured part of the run, without the warmup
+			std::chrono::nanoseconds elapsed;
+			uint64_t preloaded_keys;
+		};
+
+		//Throws std::invalid_argument for unknown names
+		ClientMode client_mode_from_name ( const std::string& parName );
+		const char* client_mode_name ( ClientMode parMode );
+		WorkloadResult run_workload ( const WorkloadOptions& parOptions );
+	} //namespace loadgen
+} //namespace incredis
+
+#endif